@@ -1,7 +1,13 @@
 #pragma once
 #include <stdint.h>
 #include <climits>
+#ifdef BUILD_PICO
 #include "pico/stdlib.h"
+#else
+// host builds of the graphics libraries, for profiling without a board
+#include <chrono>
+typedef unsigned int uint;
+#endif
 
 #define PIMORONI_I2C_DEFAULT_INSTANCE i2c0
 #define PIMORONI_SPI_DEFAULT_INSTANCE spi0
@@ -75,7 +81,12 @@ namespace pimoroni {
     };
 
     inline uint32_t millis() {
+#ifdef BUILD_PICO
       return to_ms_since_boot(get_absolute_time());
+#else
+      static const auto start = std::chrono::steady_clock::now();
+      return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+#endif
     }
 
     inline constexpr uint8_t GAMMA_8BIT[256] = {
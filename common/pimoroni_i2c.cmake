@@ -3,9 +3,10 @@ add_library(${LIB_NAME} INTERFACE)
 
 target_sources(${LIB_NAME} INTERFACE
     ${CMAKE_CURRENT_LIST_DIR}/${LIB_NAME}.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/pimoroni_i2c_queue.cpp
 )
 
 target_include_directories(${LIB_NAME} INTERFACE ${CMAKE_CURRENT_LIST_DIR})
 
 # Pull in pico libraries that we need
-target_link_libraries(${LIB_NAME} INTERFACE pico_stdlib hardware_i2c)
+target_link_libraries(${LIB_NAME} INTERFACE pico_stdlib pico_sync hardware_i2c hardware_dma hardware_irq FreeRTOS-Kernel)
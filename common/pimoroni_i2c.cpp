@@ -1,3 +1,6 @@
+#include <string.h>
+#include <algorithm>
+
 #include "pimoroni_common.hpp"
 #include "pimoroni_i2c.hpp"
 
@@ -77,13 +80,30 @@ namespace pimoroni {
         return value;
     }
 
+    // the longest run of registers written or merged into one read or write,
+    // so the buffers for them can live on the stack
+    static const size_t MAX_MERGE = 256;
+
+    // write len bytes to the registers from reg, MAX_MERGE at a time with a
+    // repeated start between each. returns len + 1 as a single write would
+    static int write_chunked(i2c_inst_t *i2c, uint8_t address, uint8_t reg, const uint8_t *buf, size_t len, bool nostop) {
+        uint8_t buffer[MAX_MERGE + 1];
+        size_t done = 0;
+        do {
+            size_t n = std::min(len - done, MAX_MERGE);
+            buffer[0] = reg + done;
+            memcpy(buffer + 1, buf + done, n);
+            bool last = done + n == len;
+            if(i2c_write_blocking(i2c, address, buffer, n + 1, nostop || !last) != (int)n + 1) {
+                return PICO_ERROR_GENERIC;
+            }
+            done += n;
+        } while(done < len);
+        return len + 1;
+    }
+
     int I2C::write_bytes(uint8_t address, uint8_t reg, const uint8_t *buf, int len) {
-        uint8_t buffer[len + 1];
-        buffer[0] = reg;
-        for(int x = 0; x < len; x++) {
-            buffer[x + 1] = buf[x];
-        }
-        return i2c_write_blocking(i2c, address, buffer, len + 1, false);
+        return write_chunked(i2c, address, reg, buf, std::max(len, 0), false);
     };
 
     int I2C::read_bytes(uint8_t address, uint8_t reg, uint8_t *buf, int len) {
@@ -111,4 +131,117 @@ namespace pimoroni {
         value &= ~(mask << shift);
         write_bytes(address, reg, &value, 1);
     }
+
+    /* Batched register access, for reading or writing many blocks at once */
+    // ops are sorted this many at a time
+    static const size_t MAX_SORT = 32;
+
+    int I2C::read_registers(const RegisterOp *ops, size_t count) {
+        int total = 0;
+        for(size_t start = 0; start < count; start += MAX_SORT) {
+            int n = read_sorted(ops + start, std::min(count - start, MAX_SORT));
+            if(n < 0) return n;
+            total += n;
+        }
+        return total;
+    }
+
+    int I2C::read_sorted(const RegisterOp *ops, size_t count) {
+        // reads are sorted so neighbouring and overlapping blocks on a device
+        // come together and can be read in one go
+        uint8_t order[MAX_SORT];
+        size_t n = 0;
+        for(size_t i = 0; i < count; i++) {
+            if(ops[i].len) order[n++] = i;
+        }
+        count = n;
+        std::stable_sort(order, order + count, [ops](uint8_t a, uint8_t b) {
+            return ops[a].address != ops[b].address ? ops[a].address < ops[b].address : ops[a].reg < ops[b].reg;
+        });
+
+        int total = 0;
+        size_t i = 0;
+        while(i < count) {
+            const RegisterOp &op = ops[order[i]];
+
+            // extend the block over any others that start inside or right
+            // after it, without reading registers nobody asked for
+            size_t first = op.reg, last = op.reg + op.len;
+            size_t j = i + 1;
+            for(; j < count; j++) {
+                const RegisterOp &next = ops[order[j]];
+                if(next.address != op.address || next.reg > last) break;
+                size_t end = std::max(last, size_t(next.reg + next.len));
+                if(end - first > MAX_MERGE) break;
+                last = end;
+            }
+
+            // blocks on the same device follow on with a repeated start, so
+            // each device is one transaction however many blocks it has
+            bool more = j < count && ops[order[j]].address == op.address;
+            uint8_t reg = first;
+            size_t len = last - first;
+
+            if(j == i + 1) {
+                // a block on its own goes straight into its buffer
+                if(i2c_write_blocking(i2c, op.address, &reg, 1, true) != 1 ||
+                   i2c_read_blocking(i2c, op.address, op.buffer, len, more) != (int)len) {
+                    return PICO_ERROR_GENERIC;
+                }
+            } else {
+                uint8_t data[MAX_MERGE];
+                if(i2c_write_blocking(i2c, op.address, &reg, 1, true) != 1 ||
+                   i2c_read_blocking(i2c, op.address, data, len, more) != (int)len) {
+                    return PICO_ERROR_GENERIC;
+                }
+                for(size_t k = i; k < j; k++) {
+                    const RegisterOp &o = ops[order[k]];
+                    memcpy(o.buffer, data + (o.reg - first), o.len);
+                }
+            }
+
+            total += len;
+            i = j;
+        }
+        return total;
+    }
+
+    int I2C::write_registers(const RegisterOp *ops, size_t count) {
+        // writes keep the order they were given in, devices often care, so
+        // only blocks that follow on from each other are merged
+        int total = 0;
+        size_t i = 0;
+        while(i < count) {
+            const RegisterOp &op = ops[i];
+            size_t len = op.len;
+            size_t j = i + 1;
+            while(j < count && ops[j].address == op.address && ops[j].reg == op.reg + len && len + ops[j].len <= MAX_MERGE) {
+                len += ops[j].len;
+                j++;
+            }
+
+            bool more = j < count && ops[j].address == op.address;
+            if(j == i + 1) {
+                // a block on its own may be longer than MAX_MERGE
+                if(write_chunked(i2c, op.address, op.reg, op.buffer, len, more) != (int)len + 1) {
+                    return PICO_ERROR_GENERIC;
+                }
+            } else {
+                uint8_t buffer[MAX_MERGE + 1];
+                buffer[0] = op.reg;
+                uint8_t *p = buffer + 1;
+                for(size_t k = i; k < j; k++) {
+                    memcpy(p, ops[k].buffer, ops[k].len);
+                    p += ops[k].len;
+                }
+                if(i2c_write_blocking(i2c, op.address, buffer, len + 1, more) != (int)len + 1) {
+                    return PICO_ERROR_GENERIC;
+                }
+            }
+
+            total += len;
+            i = j;
+        }
+        return total;
+    }
 }
\ No newline at end of file
@@ -7,6 +7,14 @@
 #include "pimoroni_i2c.hpp"
 
 namespace pimoroni {
+    // a block of registers on one device, for the batched reads and writes
+    struct RegisterOp {
+        uint8_t address;
+        uint8_t reg;
+        uint8_t *buffer;
+        size_t len;
+    };
+
     class I2C {
       private:
         i2c_inst_t *i2c = PIMORONI_I2C_DEFAULT_INSTANCE;
@@ -75,6 +83,12 @@ namespace pimoroni {
         void set_bits(uint8_t address, uint8_t reg, uint8_t shift, uint8_t mask=0b1);
         void clear_bits(uint8_t address, uint8_t reg, uint8_t shift, uint8_t mask=0b1);
 
+        // read or write many register blocks in as few bus transactions as
+        // possible, returns the number of register bytes transferred or
+        // PICO_ERROR_GENERIC. reads are merged within each run of 32 ops
+        int read_registers(const RegisterOp *ops, size_t count);
+        int write_registers(const RegisterOp *ops, size_t count);
+
         int write_blocking(uint8_t addr, const uint8_t *src, size_t len, bool nostop);
         int read_blocking(uint8_t addr, uint8_t *dst, size_t len, bool nostop);
 
@@ -84,5 +98,6 @@ namespace pimoroni {
         uint32_t get_baudrate() {return baudrate;}
       private:
         void init();
+        int read_sorted(const RegisterOp *ops, size_t count);
     };
 }
\ No newline at end of file
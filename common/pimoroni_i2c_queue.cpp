@@ -0,0 +1,231 @@
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "pimoroni_i2c_queue.hpp"
+
+namespace pimoroni {
+    I2CQueue *I2CQueue::queues[2] = {nullptr, nullptr};
+
+    void I2CQueue::i2c0_irq() {
+        if(queues[0]) queues[0]->service();
+    }
+
+    void I2CQueue::i2c1_irq() {
+        if(queues[1]) queues[1]->service();
+    }
+
+    I2CQueue::I2CQueue(I2C *i2c, size_t max_transfer) : i2c(i2c), max_transfer(max_transfer) {
+        commands = new uint16_t[max_transfer];
+        tx_channel = dma_claim_unused_channel(true);
+        rx_channel = dma_claim_unused_channel(true);
+        critical_section_init(&lock);
+
+        uint index = i2c_hw_index(i2c->get_i2c());
+        queues[index] = this;
+
+        // the interrupts are only unmasked while a transaction is in flight,
+        // see start_next
+        i2c_get_hw(i2c->get_i2c())->intr_mask = 0;
+        uint irq = index ? I2C1_IRQ : I2C0_IRQ;
+        irq_set_exclusive_handler(irq, index ? i2c1_irq : i2c0_irq);
+        irq_set_enabled(irq, true);
+    }
+
+    I2CQueue::~I2CQueue() {
+        uint index = i2c_hw_index(i2c->get_i2c());
+        uint irq = index ? I2C1_IRQ : I2C0_IRQ;
+        irq_set_enabled(irq, false);
+        irq_remove_handler(irq, index ? i2c1_irq : i2c0_irq);
+        i2c_get_hw(i2c->get_i2c())->intr_mask = 0;
+        queues[index] = nullptr;
+
+        dma_channel_abort(tx_channel);
+        dma_channel_abort(rx_channel);
+        dma_channel_unclaim(tx_channel);
+        dma_channel_unclaim(rx_channel);
+        critical_section_deinit(&lock);
+        delete[] commands;
+    }
+
+    bool I2CQueue::submit(Transaction *t) {
+        size_t length = t->write_len + t->read_len;
+        if(length == 0 || length > max_transfer) return false;
+        if((t->write_len && !t->write) || (t->read_len && !t->read)) return false;
+
+        t->result = 0;
+        t->done = false;
+        t->next = nullptr;
+
+        critical_section_enter_blocking(&lock);
+        if(tail) {
+            tail->next = t;
+        } else {
+            head = t;
+        }
+        tail = t;
+        if(!current) start_next();
+        critical_section_exit(&lock);
+        return true;
+    }
+
+    int I2CQueue::transfer(Transaction *t) {
+#ifdef BUILD_PICO
+        if(xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+            t->notify = xTaskGetCurrentTaskHandle();
+            // counts left over from anything else can't wake us early
+            xTaskNotifyStateClear(nullptr);
+        }
+#endif
+        if(!submit(t)) return PICO_ERROR_GENERIC;
+
+#ifdef BUILD_PICO
+        // the interrupt sets done before it notifies, so block at least
+        // once to take that notification rather than leave it behind to
+        // wake whatever waits on this task next
+        if(t->notify) {
+            do {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            } while(!t->done);
+            return t->result;
+        }
+#endif
+        while(!t->done) {
+            tight_loop_contents();
+        }
+        return t->result;
+    }
+
+    bool I2CQueue::busy() {
+        return current != nullptr || head != nullptr;
+    }
+
+    void I2CQueue::start_next() {
+        i2c_inst_t *inst = i2c->get_i2c();
+        i2c_hw_t *hw = i2c_get_hw(inst);
+
+        // leave the stops of blocking calls and other drivers to them when
+        // there's nothing of ours on the bus
+        if(!head) {
+            hw->intr_mask = 0;
+            return;
+        }
+
+        // take turns between devices so a busy one can't hold up the rest,
+        // the next address up from the last one served goes first and each
+        // device's own transactions stay in the order they were submitted
+        Transaction *prev = nullptr, *best_prev = nullptr, *best = nullptr;
+        uint best_distance = UINT_MAX;
+        for(Transaction *t = head; t; prev = t, t = t->next) {
+            uint distance = (t->address - last_address - 1) & 0x7f;
+            if(distance < best_distance) {
+                best = t;
+                best_prev = prev;
+                best_distance = distance;
+            }
+        }
+
+        if(best_prev) {
+            best_prev->next = best->next;
+        } else {
+            head = best->next;
+        }
+        if(tail == best) tail = best_prev;
+
+        current = best;
+        last_address = best->address;
+
+        // each command is a byte to write or a byte to read, the read
+        // follows the write with a repeated start and a stop ends it all
+        uint16_t *cmd = commands;
+        for(size_t i = 0; i < best->write_len; i++) {
+            *cmd++ = best->write[i];
+        }
+        for(size_t i = 0; i < best->read_len; i++) {
+            *cmd++ = I2C_IC_DATA_CMD_CMD_BITS | (i == 0 && best->write_len ? I2C_IC_DATA_CMD_RESTART_BITS : 0);
+        }
+        cmd[-1] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+        hw->enable = 0;
+        hw->tar = best->address;
+        hw->enable = 1;
+        (void)hw->clr_stop_det;
+        (void)hw->clr_tx_abrt;
+
+        // only the end of a transfer needs the cpu, everything else is dma
+        hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+
+        if(best->read_len) {
+            dma_channel_config config = dma_channel_get_default_config(rx_channel);
+            channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+            channel_config_set_read_increment(&config, false);
+            channel_config_set_write_increment(&config, true);
+            channel_config_set_dreq(&config, i2c_get_dreq(inst, false));
+            dma_channel_configure(rx_channel, &config, best->read, &hw->data_cmd, best->read_len, true);
+        }
+
+        dma_channel_config config = dma_channel_get_default_config(tx_channel);
+        channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+        channel_config_set_read_increment(&config, true);
+        channel_config_set_write_increment(&config, false);
+        channel_config_set_dreq(&config, i2c_get_dreq(inst, true));
+        dma_channel_configure(tx_channel, &config, &hw->data_cmd, commands, cmd - commands, true);
+    }
+
+    void I2CQueue::service() {
+        i2c_hw_t *hw = i2c_get_hw(i2c->get_i2c());
+        uint32_t status = hw->raw_intr_stat;
+        if(!(status & (I2C_IC_RAW_INTR_STAT_STOP_DET_BITS | I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS))) return;
+
+        critical_section_enter_blocking(&lock);
+
+        // not ours, the status is left for whoever is waiting on it
+        Transaction *t = current;
+        if(!t) {
+            critical_section_exit(&lock);
+            return;
+        }
+
+        int result = 0;
+        if(status & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+            // a nak flushes the fifo and the dma would wait on it forever,
+            // the controller still sends a stop so wait for that as well
+            dma_channel_abort(tx_channel);
+            dma_channel_abort(rx_channel);
+            (void)hw->clr_tx_abrt;
+            while(!(hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS)) {
+                tight_loop_contents();
+            }
+            result = PICO_ERROR_GENERIC;
+        } else {
+            // the last bytes read may still be on their way out of the fifo
+            while(dma_channel_is_busy(rx_channel)) {
+                tight_loop_contents();
+            }
+            result = t->write_len + t->read_len;
+        }
+        (void)hw->clr_stop_det;
+
+        current = nullptr;
+        start_next();
+        critical_section_exit(&lock);
+
+        // the caller may reuse the transaction as soon as it is done, so
+        // take what is needed from it first
+        auto callback = t->callback;
+        auto context = t->context;
+#ifdef BUILD_PICO
+        TaskHandle_t notify = t->notify;
+#endif
+        t->result = result;
+        t->done = true;
+
+        if(callback) callback(t, context);
+
+#ifdef BUILD_PICO
+        if(notify) {
+            BaseType_t woken = pdFALSE;
+            vTaskNotifyGiveFromISR(notify, &woken);
+            portYIELD_FROM_ISR(woken);
+        }
+#endif
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "pico/sync.h"
+#include "pimoroni_i2c.hpp"
+
+#ifdef BUILD_PICO
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
+
+namespace pimoroni {
+    // runs transactions for the devices on an i2c bus in the background, the
+    // bytes go by dma and the i2c interrupt starts the next transaction as
+    // each one finishes. blocking calls and other drivers would collide with
+    // a transfer under way, but are left alone once busy() is false
+    class I2CQueue {
+      public:
+        // a write, a read, or a write followed by a read with a repeated
+        // start. the caller owns the transaction and its buffers, which must
+        // stay untouched until it is done
+        struct Transaction {
+            uint8_t address = 0;
+            const uint8_t *write = nullptr;
+            size_t write_len = 0;
+            uint8_t *read = nullptr;
+            size_t read_len = 0;
+
+            // called from the i2c interrupt once the transaction is over
+            void (*callback)(Transaction *t, void *context) = nullptr;
+            void *context = nullptr;
+
+#ifdef BUILD_PICO
+            // task to notify once the transaction is over
+            TaskHandle_t notify = nullptr;
+#endif
+
+            // bytes written and read, or PICO_ERROR_GENERIC if the device
+            // didn't acknowledge
+            volatile int result = 0;
+            volatile bool done = false;
+
+            Transaction *next = nullptr;
+        };
+
+        I2CQueue(I2C *i2c, size_t max_transfer = 256);
+        ~I2CQueue();
+
+        // false if the transaction is empty or longer than max_transfer
+        bool submit(Transaction *t);
+        // submit and wait for the result, the calling task sleeps meanwhile
+        // on its default notification, which is cleared first
+        int transfer(Transaction *t);
+        bool busy();
+
+        I2C *get_i2c() {return i2c;}
+
+      private:
+        I2C *i2c;
+        size_t max_transfer;
+        uint16_t *commands;
+        int tx_channel;
+        int rx_channel;
+        critical_section_t lock;
+
+        Transaction *head = nullptr;
+        Transaction *tail = nullptr;
+        Transaction *current = nullptr;
+        uint8_t last_address = 0;
+
+        void start_next();
+        void service();
+        static I2CQueue *queues[2];
+        static void i2c0_irq();
+        static void i2c1_irq();
+    };
+}
@@ -82,17 +82,22 @@ namespace bitmap {
 
     // Accents can be up to 8 pixels tall on both 8bit and 16bit fonts
     // Each accent's data is font->max_width bytes + 2 offset bytes long
-    const uint8_t *a = &font->data[(base_chars + extra_chars) * bytes_per_char + char_accent * (font->max_width + 2)];
-
-    // Effectively shift off the first two bytes of accent data-
-    // these are the lower and uppercase accent offsets
-    const uint8_t offset_lower = *a++;
-    const uint8_t offset_upper = *a++;
-
-    // Pick which offset we should use based on the case of the char
-    // This is only valid for A-Z a-z.
-    // Note this magic number is relative to the start of printable ASCII chars.
-    uint8_t accent_offset = char_index < 65 ? offset_upper : offset_lower;
+    // There is no data for ACCENT_NONE, it would be past the end of the font
+    const uint8_t *a = nullptr;
+    uint8_t accent_offset = 0;
+    if(char_accent != unicode_sorta::ACCENT_NONE) {
+      a = &font->data[(base_chars + extra_chars) * bytes_per_char + char_accent * (font->max_width + 2)];
+
+      // Effectively shift off the first two bytes of accent data-
+      // these are the lower and uppercase accent offsets
+      const uint8_t offset_lower = *a++;
+      const uint8_t offset_upper = *a++;
+
+      // Pick which offset we should use based on the case of the char
+      // This is only valid for A-Z a-z.
+      // Note this magic number is relative to the start of printable ASCII chars.
+      accent_offset = char_index < 65 ? offset_upper : offset_lower;
+    }
 
     // Offset our y position to account for our column canvas being 32 pixels
     // this gives us 8 "pixels" of headroom above the letters for diacritic marks
@@ -119,37 +124,41 @@ namespace bitmap {
         data |= *a << accent_offset;
       }
 
-      // Draw the 32 pixel column
+      // Draw the 32 pixel column, a run of set pixels at a time so the
+      // strokes of the glyph go out as one rectangle each
       for(uint8_t cy = 0; cy < 32; cy++) {
-        if((1U << cy) & data) {
-          int32_t o_y = cy * scale;
-          int32_t px = 0;
-          int32_t py = 0;
-          switch (rotation) {
-            case 0:
-              px = x + o_x;
-              py = y - font_offset + o_y;
-              break;
-            case 90:
-              px = x + font_offset - o_y;
-              py = y + o_x;
-              break;
-            case 180:
-              px = x - o_x;
-              py = y + font_offset - o_y;
-              break;
-            case 270:
-              px = x - font_offset + o_y;
-              py = y - o_x;
-              break;
-          }
-          rectangle(px, py, scale, scale);
+        if(!((1U << cy) & data)) continue;
+
+        uint8_t run = 1;
+        while(cy + run < 32 && ((1U << (cy + run)) & data)) run++;
+
+        int32_t o_y = cy * scale;
+        int32_t l = run * scale;
+        switch (rotation) {
+          case 0:
+            rectangle(x + o_x, y - font_offset + o_y, scale, l);
+            break;
+          case 90:
+            rectangle(x + font_offset - o_y - l + scale, y + o_x, l, scale);
+            break;
+          case 180:
+            rectangle(x - o_x, y + font_offset - o_y - l + scale, scale, l);
+            break;
+          case 270:
+            rectangle(x - font_offset + o_y, y - o_x, l, scale);
+            break;
+          default:
+            rectangle(0, 0, scale, scale);
+            break;
         }
+
+        // the pixel after the run is clear, skip it as well
+        cy += run;
       }
 
       // Move to the next columns of char and accent data
       d++;
-      a++;
+      if(a) a++;
     }
   }
 
@@ -0,0 +1,13 @@
+if(NOT TARGET frame_stream)
+    if(NOT TARGET tile_codec)
+        include(${CMAKE_CURRENT_LIST_DIR}/../tile_codec/tile_codec.cmake)
+    endif()
+
+    add_library(frame_stream
+        ${CMAKE_CURRENT_LIST_DIR}/frame_stream.cpp
+    )
+
+    target_include_directories(frame_stream INTERFACE ${CMAKE_CURRENT_LIST_DIR})
+
+    target_link_libraries(frame_stream tile_codec)
+endif()
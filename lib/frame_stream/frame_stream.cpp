@@ -0,0 +1,237 @@
+#include <string.h>
+#include <algorithm>
+
+#include "frame_stream.hpp"
+
+namespace pimoroni {
+
+  using namespace frame_stream;
+
+  // frames to wait for a requested keyframe before asking again
+  static const uint32_t KEYFRAME_RETRY = 16;
+
+  static void put16(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+  }
+
+  static void put32(uint8_t *p, uint32_t v) {
+    put16(p, v & 0xffff);
+    put16(p + 2, v >> 16);
+  }
+
+  static uint32_t get16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+  }
+
+  static uint32_t get32(const uint8_t *p) {
+    return get16(p) | (get16(p + 2) << 16);
+  }
+
+  struct Header {
+    PacketType type;
+    uint32_t sequence;
+    uint16_t index;
+    uint8_t flags;
+    uint8_t bits_per_pixel;
+    uint8_t tile_size;
+    uint16_t width;
+    uint16_t height;
+  };
+
+  static void write_header(uint8_t *p, const Header &h) {
+    put16(p, MAGIC);
+    p[2] = VERSION;
+    p[3] = h.type;
+    put32(p + 4, h.sequence);
+    put16(p + 8, h.index);
+    p[10] = h.flags;
+    p[11] = h.bits_per_pixel;
+    p[12] = h.tile_size;
+    put16(p + 13, h.width);
+    put16(p + 15, h.height);
+  }
+
+  static bool read_header(const uint8_t *p, size_t length, Header &h) {
+    if(length < HEADER_SIZE || get16(p) != MAGIC || p[2] != VERSION) return false;
+    h.type = (PacketType)p[3];
+    h.sequence = get32(p + 4);
+    h.index = get16(p + 8);
+    h.flags = p[10];
+    h.bits_per_pixel = p[11];
+    h.tile_size = p[12];
+    h.width = get16(p + 13);
+    h.height = get16(p + 15);
+    return true;
+  }
+
+  // pick the larger tiles as long as an unencoded one fits in a packet
+  static uint8_t choose_tile_size(uint8_t bits_per_pixel, size_t packet_size) {
+    TileCodec large(0, 0, bits_per_pixel, TileCodec::MAX_TILE_SIZE);
+    return HEADER_SIZE + TILE_HEADER_SIZE + large.max_encoded_size() <= packet_size ? TileCodec::MAX_TILE_SIZE : 8;
+  }
+
+  static size_t min_packet_size(uint8_t bits_per_pixel) {
+    // a packet must be able to hold at least one unencoded 8x8 tile
+    return HEADER_SIZE + TILE_HEADER_SIZE + TileCodec(0, 0, bits_per_pixel, 8).max_encoded_size();
+  }
+
+  FrameStreamServer::FrameStreamServer(uint16_t width, uint16_t height, uint8_t bits_per_pixel,
+                                       frame_stream_send_func send, void *context, size_t packet_size)
+    : codec(width, height, bits_per_pixel, choose_tile_size(bits_per_pixel, packet_size)),
+      send(send), context(context), packet_size(std::max(packet_size, min_packet_size(bits_per_pixel))) {
+    previous = new uint8_t[(width * height * bits_per_pixel + 7) / 8]();
+    packet = new uint8_t[this->packet_size];
+    scratch = new uint8_t[TILE_HEADER_SIZE + codec.max_encoded_size()];
+  }
+
+  FrameStreamServer::~FrameStreamServer() {
+    delete[] previous;
+    delete[] packet;
+    delete[] scratch;
+  }
+
+  void FrameStreamServer::request_keyframe() {
+    keyframe = true;
+  }
+
+  void FrameStreamServer::receive(const uint8_t *data, size_t length) {
+    Header h;
+    if(!read_header(data, length, h)) return;
+    if(h.type == PACKET_KEYFRAME_REQUEST) request_keyframe();
+  }
+
+  void FrameStreamServer::begin_packet(PacketType type, uint8_t flags) {
+    write_header(packet, {type, sequence, packet_index, flags, codec.bits_per_pixel, codec.tile_size, codec.width, codec.height});
+    packet_length = HEADER_SIZE;
+  }
+
+  void FrameStreamServer::flush_packet() {
+    send(context, packet, packet_length);
+    last_bytes += packet_length;
+    packet_index++;
+  }
+
+  void FrameStreamServer::send_frame(const void *frame_buffer) {
+    const uint8_t *frame = (const uint8_t *)frame_buffer;
+
+    bool key = keyframe || (keyframe_interval && frames_since_keyframe + 1 >= keyframe_interval);
+    uint8_t flags = key ? FLAG_KEYFRAME : 0;
+
+    packet_index = 0;
+    last_tiles = 0;
+    last_bytes = 0;
+    begin_packet(PACKET_TILES, flags);
+
+    for(uint32_t tile = 0; tile < codec.tile_count(); tile++) {
+      if(!key && !codec.changed(frame, previous, tile)) continue;
+
+      put16(scratch, tile);
+      size_t size = TILE_HEADER_SIZE + codec.encode(frame, delta && !key ? previous : nullptr, tile, scratch + TILE_HEADER_SIZE);
+      if(packet_length + size > packet_size) {
+        flush_packet();
+        begin_packet(PACKET_TILES, flags);
+      }
+      memcpy(packet + packet_length, scratch, size);
+      packet_length += size;
+      last_tiles++;
+
+      codec.copy(frame, previous, tile);
+    }
+
+    if(packet_length > HEADER_SIZE) flush_packet();
+
+    // the end of frame packet says how many tile packets to expect, it is
+    // also all that is sent when nothing has changed
+    uint16_t tile_packets = packet_index;
+    begin_packet(PACKET_END, flags);
+    put16(packet + packet_length, tile_packets);
+    packet_length += 2;
+    send(context, packet, packet_length);
+    last_bytes += packet_length;
+
+    sequence++;
+    keyframe = false;
+    frames_since_keyframe = key ? 0 : frames_since_keyframe + 1;
+  }
+
+  FrameStreamClient::FrameStreamClient(void *frame_buffer, uint16_t width, uint16_t height, uint8_t bits_per_pixel,
+                                       frame_stream_send_func send, void *context)
+    : frame_buffer((uint8_t *)frame_buffer), width(width), height(height), bits_per_pixel(bits_per_pixel),
+      send(send), context(context) {
+  }
+
+  void FrameStreamClient::request_keyframe() {
+    uint8_t data[HEADER_SIZE];
+    write_header(data, {PACKET_KEYFRAME_REQUEST, current, 0, 0, bits_per_pixel, 0, width, height});
+    send(context, data, sizeof(data));
+    request_pending = true;
+    requested_at = current;
+  }
+
+  void FrameStreamClient::begin_frame(uint32_t sequence, uint8_t flags) {
+    started = true;
+    current = sequence;
+    current_flags = flags;
+    packets_seen = 0;
+    packets_expected = -1;
+    frame_done = false;
+  }
+
+  bool FrameStreamClient::receive(const uint8_t *data, size_t length) {
+    Header h;
+    if(!read_header(data, length, h)) return false;
+    if(h.type != PACKET_TILES && h.type != PACKET_END) return false;
+    if(h.width != width || h.height != height || h.bits_per_pixel != bits_per_pixel) return false;
+    if(h.tile_size != 8 && h.tile_size != 16) return false;
+
+    // a keyframe is always taken as the start of a new frame, so a client
+    // recovers if the server restarts its sequence
+    bool keyframe = h.flags & FLAG_KEYFRAME;
+    if(!started || int32_t(h.sequence - current) > 0 || (keyframe && h.sequence != current)) {
+      // a new frame, anything missing from the last one (or whole frames
+      // skipped since) leaves the framebuffer out of date
+      bool gap = started && (!frame_done || h.sequence != current + 1);
+      begin_frame(h.sequence, h.flags);
+      if(gap) {
+        lost++;
+        in_sync = false;
+      }
+      if(!in_sync && !keyframe && (!request_pending || current - requested_at >= KEYFRAME_RETRY)) {
+        request_keyframe();
+      }
+    } else if(h.sequence != current || frame_done) {
+      // late or duplicated
+      return false;
+    }
+
+    const uint8_t *p = data + HEADER_SIZE;
+    const uint8_t *end = data + length;
+
+    if(h.type == PACKET_TILES) {
+      TileCodec codec(width, height, bits_per_pixel, h.tile_size);
+      while(end - p > (ptrdiff_t)TILE_HEADER_SIZE) {
+        size_t size = codec.decode(p + TILE_HEADER_SIZE, end - p - TILE_HEADER_SIZE, frame_buffer, get16(p));
+        if(!size) break;
+        p += TILE_HEADER_SIZE + size;
+      }
+      packets_seen++;
+    } else {
+      if(end - p < 2) return false;
+      packets_expected = get16(p);
+    }
+
+    if(packets_seen != packets_expected) return false;
+
+    frame_done = true;
+    if(current_flags & FLAG_KEYFRAME) {
+      in_sync = true;
+      request_pending = false;
+    }
+    if(!in_sync) return false;
+
+    frames++;
+    return true;
+  }
+
+}
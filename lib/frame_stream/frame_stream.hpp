@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "tile_codec.hpp"
+
+// Streams a framebuffer from a server to one or more clients as packets,
+// sending only the tiles that have changed since the previous frame.
+//
+// The framebuffer is any layout TileCodec supports (1BIT, P4, P8, RGB332,
+// RGB565 or RGB888 from PicoGraphics), given by its bits per pixel. Pixels
+// are copied as they are, so both ends must agree on the layout.
+//
+// Every packet is self contained: a header followed by whole tiles, each
+// holding the complete new contents of the tile. Lost packets leave stale
+// tiles behind, so a client that notices a gap (in the frame sequence or
+// the packet count of a frame) asks the server for a keyframe, which sends
+// every tile again.
+//
+// With delta enabled tiles may instead hold the difference from the last
+// frame, which is smaller for small changes but garbles the tile if the
+// client's copy was stale. Keyframes never use it.
+//
+// Packets are sized to fit a single datagram. Over a stream transport (TCP)
+// prefix each one with its length as a 16-bit little endian value.
+namespace pimoroni {
+
+  namespace frame_stream {
+    static const uint16_t MAGIC = 0x5346; // "FS"
+    static const uint8_t VERSION = 2;
+
+    enum PacketType : uint8_t {
+      PACKET_TILES = 1,           // tiles of a frame
+      PACKET_END = 2,             // end of a frame, carries the packet count
+      PACKET_KEYFRAME_REQUEST = 3 // client to server, also announces a client
+    };
+
+    enum PacketFlags : uint8_t {
+      FLAG_KEYFRAME = 1 << 0
+    };
+
+    // magic, version, type, sequence, packet index, flags, bits per pixel,
+    // tile size, width and height
+    static const size_t HEADER_SIZE = 17;
+
+    // tile index, followed by a TileCodec encoded tile
+    static const size_t TILE_HEADER_SIZE = 2;
+
+    static const size_t DEFAULT_PACKET_SIZE = 1024;
+  }
+
+  typedef void (*frame_stream_send_func)(void *context, const uint8_t *data, size_t length);
+
+  class FrameStreamServer {
+    public:
+      // frames sent, with the number of tiles and bytes in the last one
+      uint32_t sequence = 0;
+      uint32_t last_tiles = 0;
+      size_t last_bytes = 0;
+
+      // send a keyframe at least this often (in frames), 0 for only on request
+      uint32_t keyframe_interval = 0;
+
+      // allow tiles to be sent as the difference from the previous frame
+      bool delta = false;
+
+      FrameStreamServer(uint16_t width, uint16_t height, uint8_t bits_per_pixel,
+                        frame_stream_send_func send, void *context,
+                        size_t packet_size = frame_stream::DEFAULT_PACKET_SIZE);
+      FrameStreamServer(const FrameStreamServer &) = delete;
+      FrameStreamServer &operator=(const FrameStreamServer &) = delete;
+      ~FrameStreamServer();
+
+      // send everything that changed since the previous frame
+      void send_frame(const void *frame_buffer);
+
+      // send every tile with the next frame
+      void request_keyframe();
+
+      // handle a packet from a client
+      void receive(const uint8_t *data, size_t length);
+
+    private:
+      TileCodec codec;
+      frame_stream_send_func send;
+      void *context;
+      size_t packet_size;
+
+      uint8_t *previous = nullptr;
+      uint8_t *packet = nullptr;
+      uint8_t *scratch = nullptr;
+      size_t packet_length = 0;
+      uint16_t packet_index = 0;
+      bool keyframe = true;
+      uint32_t frames_since_keyframe = 0;
+
+      void begin_packet(frame_stream::PacketType type, uint8_t flags);
+      void flush_packet();
+  };
+
+  class FrameStreamClient {
+    public:
+      // frames completed, and frames found to be missing or incomplete
+      uint32_t frames = 0;
+      uint32_t lost = 0;
+
+      FrameStreamClient(void *frame_buffer, uint16_t width, uint16_t height, uint8_t bits_per_pixel,
+                        frame_stream_send_func send, void *context);
+
+      // apply a packet to the framebuffer, returns true when it completes a
+      // frame which was received in full on top of an up to date frame
+      bool receive(const uint8_t *data, size_t length);
+
+      // ask the server for a keyframe, also used to announce the client
+      void request_keyframe();
+
+      // true once a keyframe has arrived and nothing has been lost since
+      bool synced() const { return in_sync; }
+
+    private:
+      uint8_t *frame_buffer;
+      uint16_t width;
+      uint16_t height;
+      uint8_t bits_per_pixel;
+      frame_stream_send_func send;
+      void *context;
+
+      bool in_sync = false;
+      bool started = false;
+      uint32_t current = 0;
+      uint8_t current_flags = 0;
+      uint16_t packets_seen = 0;
+      int32_t packets_expected = -1;
+      bool frame_done = false;
+      bool request_pending = false;
+      uint32_t requested_at = 0;
+
+      void begin_frame(uint32_t sequence, uint8_t flags);
+  };
+
+}
@@ -41,12 +41,14 @@ namespace hershey {
   }
 
   const font_glyph_t* glyph_data(const font_t* font, unsigned char c) {
-    if(c < 32 || c > 127 + 64) { // + 64 char remappings defined in unicode_sorta.hpp
-      return nullptr;
+    if(c > 127 && c <= 127 + 64) { // + 64 char remappings defined in unicode_sorta.hpp
+      c = unicode_sorta::char_base_195[c - 128];
     }
 
-    if(c > 127) {
-      c = unicode_sorta::char_base_195[c - 128];
+    // the fonts only have glyphs for printable ascii, some remappings (eg. AE)
+    // are only present in the bitmap fonts
+    if(c < 32 || c > 126) {
+      return nullptr;
     }
 
     return &font->chars[c - 32];
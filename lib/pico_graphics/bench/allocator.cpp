@@ -0,0 +1,94 @@
+#include "bench.hpp"
+#include "surfaces.hpp"
+
+// a display reconfigured over and over, each time with another pen, size or
+// number of layers, while a second, smaller display is set up and torn down
+// alongside it. frame buffers come from the heap or from a FrameBufferArena
+// standing in for 512kB of PSRAM. fallbacks counts buffers the arena
+// couldn't place, largest_free is the biggest block left in it after the
+// run over its size, so 1 means it ended up unfragmented
+using namespace bench;
+
+static const size_t ARENA_SIZE = 512 * 1024;
+
+struct Config {
+  const char *pen;
+  uint16_t width;
+  uint16_t height;
+  uint16_t layers;
+};
+
+static PicoGraphics *create(const Config &c) {
+  std::string n(c.pen);
+  if(n == "1Bit") return new PicoGraphics_Pen1Bit(c.width, c.height, nullptr, c.layers);
+  if(n == "P4") return new PicoGraphics_PenP4(c.width, c.height, nullptr, c.layers);
+  if(n == "P8") return new PicoGraphics_PenP8(c.width, c.height, nullptr, c.layers);
+  if(n == "RGB332") return new PicoGraphics_PenRGB332(c.width, c.height, nullptr, c.layers);
+  if(n == "RGB565") return new PicoGraphics_PenRGB565(c.width, c.height, nullptr, c.layers);
+  return new PicoGraphics_PenRGB888(c.width, c.height, nullptr, c.layers);
+}
+
+// counts what the arena passes on, before handing it to the heap
+class CountingHeap : public FrameBufferAllocator {
+  public:
+    uint64_t allocations = 0;
+
+    void *allocate(size_t size, size_t alignment) override {
+      allocations++;
+      return new uint8_t[size];
+    }
+    void release(void *buffer) override {
+      delete[] (uint8_t *)buffer;
+    }
+};
+
+BENCH_SUITE(allocator) {
+  static const Config main[] = {
+    {"RGB565", 320, 240, 1}, {"P8", 320, 240, 2}, {"RGB332", 240, 240, 3},
+    {"P4", 320, 240, 4}, {"RGB888", 160, 120, 2}, {"1Bit", 296, 128, 2}
+  };
+  static const Config status[] = {
+    {"RGB565", 128, 32, 1}, {"P4", 160, 80, 2}, {"1Bit", 128, 64, 1}
+  };
+  static const uint32_t ROUNDS = 16;
+
+  static std::vector<uint8_t> psram(ARENA_SIZE);
+
+  for(bool use_arena : {false, true}) {
+    CountingHeap heap;
+    FrameBufferArena arena({psram.data(), psram.size()}, &heap);
+    PicoGraphics::allocator = use_arena ? &arena : nullptr;
+
+    auto churn = [&]() {
+      PicoGraphics *side = nullptr;
+      for(auto n = 0u; n < ROUNDS; n++) {
+        PicoGraphics *g = create(main[n % 6]);
+        // the small display is swapped every third round, so it is created
+        // and destroyed at different points to the big one
+        if(n % 3 == 0) {
+          delete side;
+          side = create(status[(n / 3) % 3]);
+        }
+        keep(g->frame_buffer);
+        delete g;
+      }
+      delete side;
+    };
+
+    heap.allocations = 0;
+    churn();
+    uint64_t fallbacks = heap.allocations;
+
+    Params params = {{"allocator", use_arena ? "arena" : "heap"}, {"rounds", str(int64_t(ROUNDS))}};
+    Result *r = runner.run("allocator", "reconfigure", params, churn);
+    if(r) {
+      r->counters.push_back({"reconfigs_per_sec", ROUNDS * 1e9 / r->ns_per_op});
+      if(use_arena) {
+        r->counters.push_back({"fallbacks", double(fallbacks)});
+        r->counters.push_back({"largest_free", double(arena.largest_free()) / ARENA_SIZE});
+      }
+    }
+
+    PicoGraphics::allocator = nullptr;
+  }
+}
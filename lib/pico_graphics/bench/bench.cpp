@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+
+#include "bench.hpp"
+
+namespace bench {
+
+  // every case is repeated this many times and the fastest is reported,
+  // each repeat running for at least MIN_TIME_NS
+  static const unsigned REPEATS = 5;
+  static const double MIN_TIME_NS = 20e6;
+
+  static std::vector<Suite> &suites() {
+    static std::vector<Suite> list;
+    return list;
+  }
+
+  Suite::Suite(const char *name, suite_func func) : name(name), func(func) {
+    suites().push_back(*this);
+  }
+
+  // heap accounting, operator new is replaced below so that each block
+  // carries its size in front of it
+  static std::atomic<size_t> in_use{0};
+  static std::atomic<size_t> peak{0};
+  static const size_t HEADER = alignof(std::max_align_t);
+
+  size_t heap_in_use() { return in_use; }
+  size_t heap_peak() { return peak; }
+  void reset_heap_peak() { peak = size_t(in_use); }
+
+  std::string str(double v) {
+    char s[32];
+    snprintf(s, sizeof(s), "%g", v);
+    return s;
+  }
+
+  static double time_ns(const std::function<void()> &op, uint64_t iterations) {
+    auto start = std::chrono::steady_clock::now();
+    for(uint64_t i = 0; i < iterations; i++) op();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count();
+  }
+
+  Result *Runner::run(const std::string &suite, const std::string &name, const Params &params, std::function<void()> op) {
+    std::string id = suite + "/" + name;
+    for(auto &p : params) id += "/" + p.first + "=" + p.second;
+    if(!filter.empty() && id.find(filter) == std::string::npos) return nullptr;
+
+    // the first call builds anything created lazily (dither tables, lookups)
+    // so that it isn't counted against every iteration
+    op();
+
+    size_t base = heap_in_use();
+    reset_heap_peak();
+
+    uint64_t iterations = 1;
+    double best = time_ns(op, 1);
+    if(!quick) {
+      double t = best;
+      while(t < MIN_TIME_NS && iterations < (1ull << 32)) {
+        iterations *= t < MIN_TIME_NS / 10 ? 10 : 2;
+        t = time_ns(op, iterations);
+      }
+      best = t / iterations;
+      for(unsigned r = 1; r < REPEATS; r++) {
+        best = std::min(best, time_ns(op, iterations) / iterations);
+      }
+    }
+    size_t peak_heap = heap_peak() - base;
+
+    Result result;
+    result.suite = suite;
+    result.name = name;
+    result.params = params;
+    result.iterations = iterations;
+    result.ns_per_op = best;
+    result.peak_heap = peak_heap;
+    done.push_back(result);
+
+    fprintf(stderr, "%-64s %12.1f ns\n", id.c_str(), best);
+    return &done.back();
+  }
+
+  static void write_string(std::FILE *f, const std::string &s) {
+    fputc('"', f);
+    for(char c : s) {
+      if(c == '"' || c == '\\') fputc('\\', f);
+      fputc(c, f);
+    }
+    fputc('"', f);
+  }
+
+  void Runner::write_json(std::FILE *f) const {
+    fprintf(f, "{\n  \"context\": {\"compiler\": ");
+    write_string(f, __VERSION__);
+    fprintf(f, ", \"quick\": %s},\n  \"benchmarks\": [", quick ? "true" : "false");
+
+    for(auto i = 0u; i < done.size(); i++) {
+      const Result &r = done[i];
+      fprintf(f, "%s\n    {\"suite\": ", i ? "," : "");
+      write_string(f, r.suite);
+      fprintf(f, ", \"name\": ");
+      write_string(f, r.name);
+      fprintf(f, ", \"params\": {");
+      for(auto j = 0u; j < r.params.size(); j++) {
+        if(j) fprintf(f, ", ");
+        write_string(f, r.params[j].first);
+        fprintf(f, ": ");
+        write_string(f, r.params[j].second);
+      }
+      fprintf(f, "}, \"iterations\": %llu, \"ns_per_op\": %.1f, \"ops_per_sec\": %.1f, \"peak_heap_bytes\": %zu",
+        (unsigned long long)r.iterations, r.ns_per_op, r.ns_per_op > 0 ? 1e9 / r.ns_per_op : 0.0, r.peak_heap);
+      for(auto &c : r.counters) {
+        fprintf(f, ", ");
+        write_string(f, c.first);
+        fprintf(f, ": %.6g", c.second);
+      }
+      fprintf(f, "}");
+    }
+    fprintf(f, "\n  ]\n}\n");
+  }
+}
+
+void *operator new(size_t size) {
+  void *p = std::malloc(size + bench::HEADER);
+  if(!p) throw std::bad_alloc();
+  *(size_t *)p = size;
+
+  size_t now = bench::in_use += size;
+  size_t high = bench::peak;
+  while(now > high && !bench::peak.compare_exchange_weak(high, now)) {}
+  return (uint8_t *)p + bench::HEADER;
+}
+
+void operator delete(void *p) noexcept {
+  if(!p) return;
+  p = (uint8_t *)p - bench::HEADER;
+  bench::in_use -= *(size_t *)p;
+  std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  operator delete(p);
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete[](void *p) noexcept {
+  operator delete(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+  operator delete(p);
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+    "usage: %s [--quick] [--filter text] [--out file.json]\n"
+    "  --quick   run each case once, to check the benchmarks work\n"
+    "  --filter  only run cases whose suite/name/params contain text\n"
+    "  --out     write the JSON results here rather than to stdout\n", name);
+}
+
+int main(int argc, char **argv) {
+  bench::Runner runner;
+  const char *out = nullptr;
+
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--quick") == 0) {
+      runner.quick = true;
+    } else if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      runner.filter = argv[++i];
+    } else if(strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      out = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  // registration order depends on link order, so run the suites by name
+  std::vector<bench::Suite> list = bench::suites();
+  std::sort(list.begin(), list.end(), [](const bench::Suite &a, const bench::Suite &b) {
+    return strcmp(a.name, b.name) < 0;
+  });
+  for(auto &s : list) s.func(runner);
+
+  std::FILE *f = out ? fopen(out, "w") : stdout;
+  if(!f) {
+    fprintf(stderr, "can't write %s\n", out);
+    return 1;
+  }
+  runner.write_json(f);
+  if(out) fclose(f);
+  return 0;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A small benchmark harness for the host build.
+//
+// Suites register themselves with BENCH_SUITE and call Runner::run for each
+// case. Every case is timed as the best of several repeats, each long
+// enough to be measured reliably, and the results are written out as JSON
+// so runs can be compared across commits. The heap high water mark of each
+// case is recorded too.
+namespace bench {
+
+  typedef std::vector<std::pair<std::string, std::string>> Params;
+
+  struct Result {
+    std::string suite;
+    std::string name;
+    Params params;
+    uint64_t iterations = 0;
+    double ns_per_op = 0;
+    size_t peak_heap = 0;
+    // extra figures reported by the case, eg. bytes per op
+    std::vector<std::pair<std::string, double>> counters;
+  };
+
+  class Runner {
+    public:
+      // --quick runs each case once, for checking the benchmarks still work
+      bool quick = false;
+      std::string filter;
+
+      // time op, returning the result so a case can add counters to it, or
+      // nullptr if the case was filtered out
+      Result *run(const std::string &suite, const std::string &name, const Params &params, std::function<void()> op);
+
+      const std::vector<Result> &results() const { return done; }
+      void write_json(std::FILE *f) const;
+
+    private:
+      std::vector<Result> done;
+  };
+
+  typedef void (*suite_func)(Runner &runner);
+
+  struct Suite {
+    const char *name;
+    suite_func func;
+    Suite(const char *name, suite_func func);
+  };
+
+  #define BENCH_SUITE(name) \
+    static void bench_suite_##name(bench::Runner &runner); \
+    static bench::Suite bench_suite_##name##_registration(#name, bench_suite_##name); \
+    static void bench_suite_##name(bench::Runner &runner)
+
+  // bytes currently allocated through operator new, and the most there has
+  // been since reset_peak
+  size_t heap_in_use();
+  size_t heap_peak();
+  void reset_heap_peak();
+
+  // stop the compiler discarding a result it thinks is unused
+  template<typename T> inline void keep(const T &v) {
+    asm volatile("" : : "g"(&v) : "memory");
+  }
+
+  inline std::string str(int64_t v) { return std::to_string(v); }
+  std::string str(double v);
+}
@@ -0,0 +1,65 @@
+#include "bench.hpp"
+#include "surfaces.hpp"
+
+// blit onto a 320x240 RGB565 surface from 8x8 and 32x32 sprites and a full
+// screen image. copy is RGB565 to RGB565, which copies pixel values,
+// key is the same with a colour key, convert reads P8 and RGB888 sources
+// back as RGB, and scaled and bilinear draw a half size source at twice
+// its size so the output is the same size as the other cases
+using namespace bench;
+
+static const uint16_t WIDTH = 320;
+static const uint16_t HEIGHT = 240;
+
+// diagonal bands of palette colours, black (the key) every eighth band
+static void fill(PicoGraphics *g) {
+  for(auto y = 0; y < g->bounds.h; y++) {
+    for(auto x = 0; x < g->bounds.w; x++) {
+      uint i = ((x + y) / 2) % 16;
+      if(i % 8 == 0) i = 0;
+      if(g->pen_type == PicoGraphics::PEN_P8) {
+        g->set_pen(i);
+      } else {
+        g->set_pen(PALETTE[i].r, PALETTE[i].g, PALETTE[i].b);
+      }
+      g->pixel(Point(x, y));
+    }
+  }
+}
+
+BENCH_SUITE(blit) {
+  static const struct { const char *name; uint16_t w, h; } sizes[] = {
+    {"8x8", 8, 8}, {"32x32", 32, 32}, {"320x240", WIDTH, HEIGHT}
+  };
+  static const struct { const char *kind; const char *src; bool half; uint flags; } kinds[] = {
+    {"copy", "RGB565", false, 0},
+    {"key", "RGB565", false, PicoGraphics::BLIT_COLOUR_KEY},
+    {"convert", "P8", false, 0},
+    {"convert", "RGB888", false, 0},
+    {"scaled", "RGB565", true, 0},
+    {"bilinear", "RGB565", true, PicoGraphics::BLIT_BILINEAR},
+  };
+
+  Surface dst = make_surface("RGB565", WIDTH, HEIGHT);
+  PicoGraphics *g = dst.graphics.get();
+
+  for(auto &size : sizes) {
+    for(auto &k : kinds) {
+      uint16_t w = k.half ? size.w / 2 : size.w, h = k.half ? size.h / 2 : size.h;
+      Surface src = make_surface(k.src, w, h);
+      fill(src.graphics.get());
+
+      Rect from(0, 0, w, h);
+      // sprites are placed away from the origin, but inside the frame
+      Rect to(size.w < WIDTH ? 100 : 0, size.h < HEIGHT ? 60 : 0, size.w, size.h);
+      Params params = {{"kind", k.kind}, {"src", k.src}, {"size", size.name}};
+      Result *r = runner.run("blit", "blit", params, [&]() {
+        g->blit(src.graphics.get(), from, to, k.flags);
+      });
+      if(r) {
+        r->counters.push_back({"blits_per_sec", 1e9 / r->ns_per_op});
+        r->counters.push_back({"mpixels_per_sec", size.w * size.h * 1e3 / r->ns_per_op});
+      }
+    }
+  }
+}
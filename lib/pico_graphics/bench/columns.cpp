@@ -0,0 +1,87 @@
+#include "bench.hpp"
+#include "bitmap_fonts.hpp"
+#include "surfaces.hpp"
+
+// vertical lines and bitmap text at every rotation, which go to the pens as
+// columns. engine=pixel draws the same pixels the way they were drawn
+// before the pens had set_pixel_column: vertical lines a clipped pixel()
+// per row, and text as one scale x scale rectangle per set glyph pixel.
+// both must draw the same frame
+using namespace bench;
+
+static const uint16_t WIDTH = 320;
+static const uint16_t HEIGHT = 240;
+static const uint LINES = 64;
+static const char *TEXT = "The quick brown fox";
+
+static void vertical_lines(PicoGraphics *g, int32_t length, bool columns) {
+  for(auto i = 0u; i < LINES; i++) {
+    Point p(2 + i * 5, (HEIGHT - length) * (i % 8) / 7);
+    if(columns) {
+      g->line(p, Point(p.x, p.y + length));
+    } else {
+      for(auto y = 0; y < length; y++) g->pixel(Point(p.x, p.y + y));
+    }
+  }
+}
+
+static void rotated_text(PicoGraphics *g, const bitmap::font_t *font, int32_t rotation, uint8_t scale, bool columns) {
+  Point p = rotation == 0 ? Point(0, 40) : rotation == 90 ? Point(200, 0)
+          : rotation == 180 ? Point(WIDTH - 1, 200) : Point(120, HEIGHT - 1);
+  if(columns) {
+    g->text(TEXT, p, 1000, scale, rotation);
+    return;
+  }
+  // the runs the font hands out, split back into a rectangle per pixel
+  bitmap::text(font, [&](int32_t x, int32_t y, int32_t w, int32_t h) {
+    for(auto cy = y; cy < y + h; cy += scale) {
+      for(auto cx = x; cx < x + w; cx += scale) {
+        g->rectangle(Rect(cx, cy, scale, scale));
+      }
+    }
+  }, TEXT, p.x, p.y, 1000, scale, 1, false, rotation);
+}
+
+BENCH_SUITE(columns) {
+  for(auto pen : {"RGB565", "P4", "1Bit"}) {
+    Surface s = make_surface(pen, WIDTH, HEIGHT);
+    PicoGraphics *g = s.graphics.get();
+    g->set_font("bitmap8");
+    const bitmap::font_t *font = g->bitmap_font;
+
+    // run f both ways, checking they draw the same frame, then time them
+    auto compare = [&](const char *name, Params params, std::function<void(bool)> f, uint count, const char *counter) {
+      std::vector<uint8_t> frames[2];
+      for(bool columns : {false, true}) {
+        g->set_pen(0);
+        g->clear();
+        g->set_pen(1);
+        f(columns);
+        frames[columns] = s.read_rgb();
+      }
+      if(frames[0] != frames[1]) fprintf(stderr, "columns: %s %s differs from engine=pixel\n", pen, name);
+
+      for(bool columns : {true, false}) {
+        Params p = params;
+        p.insert(p.begin(), {"pen", pen});
+        p.push_back({"engine", columns ? "column" : "pixel"});
+        Result *r = runner.run("columns", name, p, [&]() { f(columns); });
+        if(r) r->counters.push_back({counter, count * 1e3 / r->ns_per_op});
+      }
+    };
+
+    for(int32_t length : {8, 40, 200}) {
+      compare("vertical_line", {{"length", str(int64_t(length))}, {"lines", str(int64_t(LINES))}}, [&](bool columns) {
+        vertical_lines(g, length, columns);
+      }, LINES, "mlines_per_sec");
+    }
+
+    for(uint8_t scale : {1, 2}) {
+      for(int32_t rotation : {0, 90, 180, 270}) {
+        compare("text", {{"font", "bitmap8"}, {"scale", str(int64_t(scale))}, {"rotation", str(int64_t(rotation))}}, [&](bool columns) {
+          rotated_text(g, font, rotation, scale, columns);
+        }, 1, "mstrings_per_sec");
+      }
+    }
+  }
+}
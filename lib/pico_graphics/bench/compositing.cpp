@@ -0,0 +1,93 @@
+#include "bench.hpp"
+#include "surfaces.hpp"
+
+// frame_convert to RGB565 compositing 1-4 layers at 320x240, for the RGB565
+// and P8 pens. the bottom layer is always drawn over completely, above it
+// each layer is:
+//   full    - drawn over completely, opaque apart from colour keyed holes
+//   sparse  - a 20 pixel status bar, the rest cleared to transparent so
+//             only the bar is read
+//   opacity - drawn over completely at half opacity
+//   hidden  - drawn over completely but not visible
+// mpixels_per_sec is output pixels, layers_read the average number of
+// layers read for each of them, going by the layers' dirty areas
+using namespace bench;
+
+static const uint16_t WIDTH = 320;
+static const uint16_t HEIGHT = 240;
+
+static void convert_count(void *context, void *data, size_t length) {
+  *(size_t *)context += length;
+}
+
+static void draw_stripes(PicoGraphics *g, uint l) {
+  for(auto y = 0; y < HEIGHT; y += 16) {
+    const RGB &c = PALETTE[1 + (y / 16 + l) % 15];
+    g->set_pen(c.r, c.g, c.b);
+    g->rectangle(Rect(0, y, WIDTH, 16));
+  }
+  // holes of the transparent colour every so often
+  g->set_pen(0, 0, 0);
+  for(auto x = l * 8; x < WIDTH; x += 40) {
+    g->rectangle(Rect(x, 0, 8, HEIGHT));
+  }
+}
+
+BENCH_SUITE(compositing) {
+  static const char *modes[] = {"full", "sparse", "opacity", "hidden"};
+
+  static uint8_t buffers[2][1024];
+  static void *const pointers[2] = {buffers[0], buffers[1]};
+
+  for(auto pen : {"RGB565", "P8"}) {
+    for(uint16_t layers = 1; layers <= 4; layers++) {
+      for(auto mode : modes) {
+        // a single layer has nothing above it, so one case is enough
+        if(layers == 1 && mode != modes[0]) continue;
+
+        Surface s = make_surface(pen, WIDTH, HEIGHT, layers);
+        PicoGraphics *g = s.graphics.get();
+        std::string m(mode);
+
+        g->set_layer(0);
+        g->set_pen(64, 64, 64);
+        g->clear();
+        draw_stripes(g, 0);
+
+        for(auto l = 1u; l < layers; l++) {
+          g->set_layer(l);
+          if(m == "sparse") {
+            const RGB &c = PALETTE[1 + l];
+            g->clear_layer(l);
+            g->set_pen(c.r, c.g, c.b);
+            g->rectangle(Rect(0, HEIGHT - l * 20, WIDTH, 20));
+          } else {
+            draw_stripes(g, l);
+          }
+          if(m == "opacity") g->set_layer_opacity(l, 128);
+          if(m == "hidden") g->set_layer_visible(l, false);
+        }
+        g->set_layer(0);
+
+        // the area of each layer the compositor will read
+        uint64_t area = WIDTH * HEIGHT;
+        for(auto l = 1u; l < layers; l++) {
+          const PicoGraphics::LayerSettings &ls = g->layer_settings[l];
+          if(ls.visible && ls.opacity) area += ls.dirty.w * ls.dirty.h;
+        }
+
+        size_t converted = 0;
+        PicoGraphics::ConvertBuffers target = {pointers, 2, sizeof(buffers[0]), convert_count, &converted};
+        Params params = {{"pen", pen}, {"layers", str(int64_t(layers))}, {"mode", mode}, {"size", "320x240"}};
+        Result *r = runner.run("compositing", "frame_convert", params, [&]() {
+          g->frame_convert(PicoGraphics::PEN_RGB565, target);
+        });
+        if(r) {
+          r->counters.push_back({"frames_per_sec", 1e9 / r->ns_per_op});
+          r->counters.push_back({"mpixels_per_sec", WIDTH * HEIGHT * 1e3 / r->ns_per_op});
+          r->counters.push_back({"layers_read", double(area) / (WIDTH * HEIGHT)});
+        }
+      }
+    }
+  }
+}
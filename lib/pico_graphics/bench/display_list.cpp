@@ -0,0 +1,104 @@
+#include <cmath>
+#include <thread>
+
+#include "bench.hpp"
+#include "surfaces.hpp"
+
+// DisplayList::render drawing a busy frame with 1, 2, 4 and 8 workers, each
+// worker a target sharing the one framebuffer. speedup is against a single
+// worker, and can't exceed the number of cores the host has. record times
+// building the busy frame's list, replay drawing it onto a single surface
+// and diff comparing it with the next frame, in which a few shapes have moved
+using namespace bench;
+
+static const uint16_t WIDTH = 320;
+static const uint16_t HEIGHT = 240;
+
+// every 50th shape is offset by moved pixels
+static void busy_scene(DisplayList &list, int32_t moved = 0) {
+  list.set_pen(0);
+  list.clear();
+  for(auto i = 0; i < 200; i++) {
+    list.set_pen(1 + i % 15);
+    float a = i * 0.1f;
+    Point c(WIDTH / 2 + int32_t(120 * cosf(a)), HEIGHT / 2 + int32_t(100 * sinf(a * 1.3f)));
+    if(i % 50 == 0) c.x += moved;
+    switch(i % 4) {
+      case 0: list.rectangle(Rect(c.x - 15, c.y - 10, 30, 20)); break;
+      case 1: list.circle(c, 12); break;
+      case 2: list.triangle(c, Point(c.x + 30, c.y + 5), Point(c.x + 10, c.y + 25)); break;
+      case 3: list.line(Point(0, c.y), Point(WIDTH - 1, HEIGHT - 1 - c.y)); break;
+    }
+  }
+  list.set_font("sans");
+  list.set_pen(1);
+  for(auto y = 0; y < HEIGHT; y += 24) {
+    list.text("The quick brown fox jumps over the lazy dog", Point(0, y), WIDTH, 0.8f);
+  }
+}
+
+BENCH_SUITE(display_list) {
+  DisplayList list;
+  busy_scene(list);
+
+  {
+    DisplayList recorded;
+    Result *r = runner.run("display_list", "record", {{"size", "320x240"}}, [&]() {
+      recorded.reset();
+      busy_scene(recorded);
+    });
+    if(r) {
+      r->counters.push_back({"lists_per_sec", 1e9 / r->ns_per_op});
+      r->counters.push_back({"bytes", double(recorded.size())});
+    }
+  }
+
+  {
+    DisplayList next;
+    busy_scene(next, 4);
+    std::vector<Rect> changed;
+    Result *r = runner.run("display_list", "diff", {{"size", "320x240"}}, [&]() {
+      changed.clear();
+      next.diff(list, changed);
+    });
+    if(r) {
+      uint64_t area = 0;
+      for(auto &c : changed) area += c.w * c.h;
+      r->counters.push_back({"diffs_per_sec", 1e9 / r->ns_per_op});
+      r->counters.push_back({"regions", double(changed.size())});
+      r->counters.push_back({"changed", double(area) / (WIDTH * HEIGHT)});
+    }
+  }
+
+  for(auto name : {"RGB565", "P8"}) {
+    Surface s = make_surface(name, WIDTH, HEIGHT);
+    std::vector<std::unique_ptr<PicoGraphics>> owned;
+    std::vector<PicoGraphics *> targets = {s.graphics.get()};
+    for(auto i = 1; i < 8; i++) {
+      if(s->pen_type == PicoGraphics::PEN_P8) {
+        owned.emplace_back(new PicoGraphics_PenP8(WIDTH, HEIGHT, s->frame_buffer));
+      } else {
+        owned.emplace_back(new PicoGraphics_PenRGB565(WIDTH, HEIGHT, s->frame_buffer));
+      }
+      targets.push_back(owned.back().get());
+    }
+
+    Result *r = runner.run("display_list", "replay", {{"pen", name}, {"size", "320x240"}}, [&]() {
+      list.replay(s.graphics.get());
+    });
+    if(r) r->counters.push_back({"frames_per_sec", 1e9 / r->ns_per_op});
+
+    double single = 0;
+    for(auto workers : {1u, 2u, 4u, 8u}) {
+      Params params = {{"pen", name}, {"workers", str(int64_t(workers))}, {"size", "320x240"}};
+      Result *r = runner.run("display_list", "render", params, [&]() {
+        list.render(targets.data(), workers);
+      });
+      if(!r) continue;
+      if(workers == 1) single = r->ns_per_op;
+      r->counters.push_back({"frames_per_sec", 1e9 / r->ns_per_op});
+      if(single > 0) r->counters.push_back({"speedup", single / r->ns_per_op});
+      r->counters.push_back({"cores", double(std::thread::hardware_concurrency())});
+    }
+  }
+}
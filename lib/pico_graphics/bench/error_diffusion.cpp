@@ -0,0 +1,44 @@
+#include "bench.hpp"
+#include "surfaces.hpp"
+
+// ErrorDiffusion streaming a full frame, a row at a time, into the pens it's
+// meant for. peak_heap is everything the diffusion allocates, the error rows
+// and (for palettes over 16 entries) the nearest colour cache
+using namespace bench;
+
+BENCH_SUITE(error_diffusion) {
+  static const struct { uint16_t w, h; } sizes[] = {{320, 240}, {800, 480}};
+
+  for(auto size : sizes) {
+    // a smooth two axis gradient, the worst case for ordered dithering
+    std::vector<RGB> image(size.w * size.h);
+    for(auto y = 0; y < size.h; y++) {
+      for(auto x = 0; x < size.w; x++) {
+        image[y * size.w + x] = RGB(x * 255 / size.w, y * 255 / size.h, 255 - x * 255 / size.w);
+      }
+    }
+
+    for(auto name : {"1Bit", "3Bit", "P4", "P8", "RGB332", "Inky7"}) {
+      Surface s = make_surface(name, size.w, size.h);
+      Rect area(0, 0, size.w, size.h);
+
+      for(auto mode : {ErrorDiffusion::FLOYD_STEINBERG, ErrorDiffusion::ATKINSON}) {
+        Params params = {
+          {"pen", name},
+          {"mode", mode == ErrorDiffusion::ATKINSON ? "atkinson" : "floyd_steinberg"},
+          {"size", str(int64_t(size.w)) + "x" + str(int64_t(size.h))}
+        };
+        Result *r = runner.run("error_diffusion", "frame", params, [&]() {
+          ErrorDiffusion diffusion(s.graphics.get(), area, mode);
+          for(auto y = 0; y < size.h; y++) {
+            diffusion.write_row(&image[y * size.w]);
+          }
+        });
+        if(r) {
+          r->counters.push_back({"rows_per_sec", size.h * 1e9 / r->ns_per_op});
+          r->counters.push_back({"error_row_bytes", double(ErrorDiffusion::buffer_size(size.w, mode) * sizeof(int16_t))});
+        }
+      }
+    }
+  }
+}
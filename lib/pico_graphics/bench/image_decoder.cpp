@@ -0,0 +1,256 @@
+#include <cstring>
+
+#include "bench.hpp"
+#include "surfaces.hpp"
+
+// ImageDecoder decoding and drawing a whole image, QOI and PNG at 320x240
+// and 800x480. The images are encoded here at start up, the PNG with
+// Paeth filtered rows and fixed Huffman deflate, much as a small encoder on
+// the device side would produce. peak_heap is what the decoder allocates
+using namespace bench;
+
+// a photo-like test image, smooth gradients and soft edged discs with a
+// little noise so neither format can lean on long runs
+static std::vector<RGB> make_image(uint16_t w, uint16_t h) {
+  std::vector<RGB> image(w * h);
+  uint32_t seed = 1;
+  for(auto y = 0; y < h; y++) {
+    for(auto x = 0; x < w; x++) {
+      int r = x * 200 / w + 30, g = y * 180 / h + 40, b = 160;
+      for(auto i = 0; i < 5; i++) {
+        int cx = w * (i * 2 + 1) / 10, cy = h / 2 + (i & 1 ? h / 5 : -h / 5), radius = h / 6;
+        int d = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+        if(d < radius * radius) {
+          r = (r + 255 * (i & 1)) / 2;
+          b = (b + 40 * i) / 2;
+        }
+      }
+      seed = seed * 1103515245 + 12345;
+      int n = int((seed >> 16) & 7) - 4;
+      image[y * w + x] = RGB(std::clamp(r + n, 0, 255), std::clamp(g + n, 0, 255), std::clamp(b + n, 0, 255));
+    }
+  }
+  return image;
+}
+
+static void put_be32(std::vector<uint8_t> &out, uint32_t v) {
+  out.push_back(v >> 24);
+  out.push_back(v >> 16);
+  out.push_back(v >> 8);
+  out.push_back(v);
+}
+
+static std::vector<uint8_t> encode_qoi(const std::vector<RGB> &image, uint16_t w, uint16_t h) {
+  std::vector<uint8_t> out = {'q', 'o', 'i', 'f'};
+  put_be32(out, w);
+  put_be32(out, h);
+  out.push_back(3);
+  out.push_back(0);
+
+  RGB index[64] = {};
+  RGB prev(0, 0, 0);
+  uint run = 0;
+  for(auto i = 0u; i < image.size(); i++) {
+    const RGB &p = image[i];
+    if(p.r == prev.r && p.g == prev.g && p.b == prev.b) {
+      if(++run == 62 || i == image.size() - 1) {
+        out.push_back(0xc0 | (run - 1));
+        run = 0;
+      }
+      continue;
+    }
+    if(run) {
+      out.push_back(0xc0 | (run - 1));
+      run = 0;
+    }
+    uint h = (p.r * 3 + p.g * 5 + p.b * 7 + 255 * 11) & 63;
+    int dr = int8_t(p.r - prev.r), dg = int8_t(p.g - prev.g), db = int8_t(p.b - prev.b);
+    if(index[h].r == p.r && index[h].g == p.g && index[h].b == p.b) {
+      out.push_back(h);
+    } else if(dr >= -2 && dr < 2 && dg >= -2 && dg < 2 && db >= -2 && db < 2) {
+      out.push_back(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+    } else if(dg >= -32 && dg < 32 && dr - dg >= -8 && dr - dg < 8 && db - dg >= -8 && db - dg < 8) {
+      out.push_back(0x80 | (dg + 32));
+      out.push_back((dr - dg + 8) << 4 | (db - dg + 8));
+    } else {
+      out.insert(out.end(), {0xfe, uint8_t(p.r), uint8_t(p.g), uint8_t(p.b)});
+    }
+    index[h] = p;
+    prev = p;
+  }
+  out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+  return out;
+}
+
+// deflate with the fixed Huffman codes and greedy matching from a hash of
+// the next three bytes
+class Deflate {
+  public:
+    std::vector<uint8_t> out;
+
+    void compress(const std::vector<uint8_t> &data) {
+      static const uint16_t length_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+      static const uint16_t distance_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+      std::vector<int32_t> head(1 << 15, -1);
+
+      put(1, 1); // final block
+      put(1, 2); // fixed codes
+      size_t i = 0;
+      while(i < data.size()) {
+        size_t length = 0, distance = 0;
+        if(i + 3 <= data.size()) {
+          uint32_t key = ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & 0x7fff;
+          int32_t candidate = head[key];
+          head[key] = i;
+          if(candidate >= 0 && i - candidate <= 32768) {
+            while(length < 258 && i + length < data.size() && data[candidate + length] == data[i + length]) length++;
+            distance = i - candidate;
+          }
+        }
+
+        if(length >= 3) {
+          uint l = 28;
+          while(length_base[l] > length) l--;
+          symbol(257 + l);
+          put(length - length_base[l], l < 8 || l == 28 ? 0 : (l - 4) / 4);
+          uint d = 29;
+          while(distance_base[d] > distance) d--;
+          put_reversed(d, 5);
+          put(distance - distance_base[d], d < 4 ? 0 : (d - 2) / 2);
+          i += length;
+        } else {
+          symbol(data[i++]);
+        }
+      }
+      symbol(256);
+      if(count) out.push_back(bits);
+    }
+
+  private:
+    uint32_t bits = 0;
+    uint count = 0;
+
+    void put(uint32_t v, uint n) {
+      for(auto i = 0u; i < n; i++) {
+        bits |= ((v >> i) & 1) << count;
+        if(++count == 8) {
+          out.push_back(bits);
+          bits = 0;
+          count = 0;
+        }
+      }
+    }
+
+    // huffman codes are written most significant bit first
+    void put_reversed(uint32_t code, uint n) {
+      for(int i = n - 1; i >= 0; i--) put(code >> i, 1);
+    }
+
+    void symbol(uint s) {
+      if(s < 144) put_reversed(0x30 + s, 8);
+      else if(s < 256) put_reversed(0x190 + s - 144, 9);
+      else if(s < 280) put_reversed(s - 256, 7);
+      else put_reversed(0xc0 + s - 280, 8);
+    }
+};
+
+static uint32_t crc32(const uint8_t *data, size_t len) {
+  uint32_t crc = 0xffffffff;
+  for(auto i = 0u; i < len; i++) {
+    crc ^= data[i];
+    for(auto k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+static void png_chunk(std::vector<uint8_t> &out, const char *type, const std::vector<uint8_t> &data) {
+  put_be32(out, data.size());
+  size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data.begin(), data.end());
+  put_be32(out, crc32(&out[start], out.size() - start));
+}
+
+static std::vector<uint8_t> encode_png(const std::vector<RGB> &image, uint16_t w, uint16_t h) {
+  std::vector<uint8_t> raw;
+  std::vector<uint8_t> prev(w * 3), row(w * 3);
+  for(auto y = 0; y < h; y++) {
+    for(auto x = 0; x < w; x++) {
+      row[x * 3] = image[y * w + x].r;
+      row[x * 3 + 1] = image[y * w + x].g;
+      row[x * 3 + 2] = image[y * w + x].b;
+    }
+    raw.push_back(4);
+    for(auto i = 0u; i < row.size(); i++) {
+      int a = i >= 3 ? row[i - 3] : 0, b = prev[i], c = i >= 3 ? prev[i - 3] : 0;
+      int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+      raw.push_back(row[i] - ((pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c)));
+    }
+    std::swap(row, prev);
+  }
+
+  Deflate deflate;
+  deflate.out = {0x78, 0x01};
+  deflate.compress(raw);
+  uint32_t s1 = 1, s2 = 0;
+  for(auto v : raw) {
+    s1 = (s1 + v) % 65521;
+    s2 = (s2 + s1) % 65521;
+  }
+  put_be32(deflate.out, (s2 << 16) | s1);
+
+  std::vector<uint8_t> out = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  std::vector<uint8_t> header;
+  put_be32(header, w);
+  put_be32(header, h);
+  header.insert(header.end(), {8, 2, 0, 0, 0});
+  png_chunk(out, "IHDR", header);
+  png_chunk(out, "IDAT", deflate.out);
+  png_chunk(out, "IEND", {});
+  return out;
+}
+
+BENCH_SUITE(image_decoder) {
+  static const struct { uint16_t w, h; } sizes[] = {{320, 240}, {800, 480}};
+
+  for(auto size : sizes) {
+    std::vector<RGB> image = make_image(size.w, size.h);
+    std::string dimensions = str(int64_t(size.w)) + "x" + str(int64_t(size.h));
+
+    for(auto format : {"qoi", "png"}) {
+      std::vector<uint8_t> encoded = strcmp(format, "qoi") == 0 ? encode_qoi(image, size.w, size.h) : encode_png(image, size.w, size.h);
+
+      // drawn at its own size into RGB565, and dithered onto an Inky7
+      // panel the size of the image
+      static const struct { const char *pen; ImageDecoder::Dither dither; const char *name; } targets[] = {
+        {"RGB565", ImageDecoder::DITHER_NONE, "none"},
+        {"Inky7", ImageDecoder::DITHER_DIFFUSION, "diffusion"}
+      };
+      for(auto target : targets) {
+        Surface s = make_surface(target.pen, size.w, size.h);
+        Params params = {{"format", format}, {"size", dimensions}, {"pen", target.pen}, {"dither", target.name}};
+        bool ok = true;
+        Result *r = runner.run("image_decoder", "draw", params, [&]() {
+          ImageDecoder decoder(encoded.data(), encoded.size());
+          ok &= decoder.open() == ImageDecoder::OK && decoder.draw(s.graphics.get(), Point(0, 0), target.dither) == ImageDecoder::OK;
+        });
+        if(r) {
+          r->counters.push_back({"encoded_bytes", double(encoded.size())});
+          r->counters.push_back({"decoded_mpixels_per_sec", size.w * size.h * 1e3 / r->ns_per_op});
+          if(!ok) fprintf(stderr, "image_decoder: %s %s failed to decode\n", format, dimensions.c_str());
+        }
+      }
+
+      // scaled down to a 320x240 screen
+      if(size.w != 320) {
+        Surface s = make_surface("RGB565", 320, 240);
+        Params params = {{"format", format}, {"size", dimensions}, {"pen", "RGB565"}, {"dither", "none"}, {"dest", "320x240"}};
+        runner.run("image_decoder", "draw_scaled", params, [&]() {
+          ImageDecoder decoder(encoded.data(), encoded.size());
+          decoder.open();
+          decoder.draw(s.graphics.get(), Rect(0, 0, 320, 240));
+        });
+      }
+    }
+  }
+}
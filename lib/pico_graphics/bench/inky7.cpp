@@ -0,0 +1,41 @@
+#include "bench.hpp"
+#include "surfaces.hpp"
+
+// a full screen dithered clear of an 800x480 Inky7, with a driver taking
+// each row in one write_pixels call and with one that leaves write_pixels
+// to the default, a write_pixel per pixel. driver_calls and driver_bytes
+// are per clear, bytes being the pixel values passed to the driver
+using namespace bench;
+
+BENCH_SUITE(inky7) {
+  static const uint16_t WIDTH = 800;
+  static const uint16_t HEIGHT = 480;
+
+  for(bool bulk : {true, false}) {
+    CountingDriver driver(WIDTH, HEIGHT, bulk);
+    PicoGraphics_PenInky7 graphics(WIDTH, HEIGHT, driver);
+
+    // colours between the panel's seven, so every pixel is dithered
+    static const RGB colours[] = {{255, 128, 0}, {128, 128, 128}, {0, 128, 128}};
+    for(auto &c : colours) {
+      graphics.set_pen(c.r, c.g, c.b);
+      Params params = {
+        {"driver", bulk ? "write_pixels" : "write_pixel"},
+        {"colour", str(int64_t(c.r)) + "," + str(int64_t(c.g)) + "," + str(int64_t(c.b))},
+        {"size", "800x480"}
+      };
+      driver.reset();
+      graphics.clear();
+      uint64_t calls = driver.calls, bytes = driver.bytes;
+
+      Result *r = runner.run("inky7", "dithered_clear", params, [&]() {
+        graphics.clear();
+      });
+      if(r) {
+        r->counters.push_back({"driver_calls", double(calls)});
+        r->counters.push_back({"driver_bytes", double(bytes)});
+        r->counters.push_back({"clears_per_sec", 1e9 / r->ns_per_op});
+      }
+    }
+  }
+}
@@ -0,0 +1,144 @@
+#include <cmath>
+
+#include "bench.hpp"
+#include "surfaces.hpp"
+
+// line() at angles from horizontal to vertical and lengths of 8, 40 and 200
+// pixels, 64 lines a batch spread over a 320x240 frame, plus long lines
+// crossing the whole frame and clipped at its edges. engine=pixel is the
+// line drawer as it was before lines were clipped once and written as runs,
+// stepping in 16:16 fixed point with a clipped pixel() per step, for
+// comparison. both must draw the same pixels
+using namespace bench;
+
+static const uint16_t WIDTH = 320;
+static const uint16_t HEIGHT = 240;
+static const uint LINES = 64;
+
+static void pixel_line(PicoGraphics *g, Point p1, Point p2) {
+  if(p1.y == p2.y) {
+    int32_t start = std::min(p1.x, p2.x);
+    int32_t end   = std::max(p1.x, p2.x);
+    g->pixel_span(Point(start, p1.y), end - start);
+    return;
+  }
+
+  if(p1.x == p2.x) {
+    int32_t start  = std::min(p1.y, p2.y);
+    int32_t length = std::max(p1.y, p2.y) - start;
+    Point dest(p1.x, start);
+    while(length--) {
+      g->pixel(dest);
+      dest.y++;
+    }
+    return;
+  }
+
+  int32_t dx = p2.x - p1.x;
+  int32_t dy = p2.y - p1.y;
+  if(std::abs(dx) > std::abs(dy)) {
+    int32_t s = std::abs(dx);
+    int32_t sx = dx < 0 ? -1 : 1;
+    int32_t sy = (dy << 16) / s;
+    int32_t x = p1.x;
+    int32_t y = p1.y << 16;
+    while(s--) {
+      g->pixel(Point(x, y >> 16));
+      y += sy;
+      x += sx;
+    }
+  } else {
+    int32_t s = std::abs(dy);
+    int32_t sy = dy < 0 ? -1 : 1;
+    int32_t sx = (dx << 16) / s;
+    int32_t y = p1.y;
+    int32_t x = p1.x << 16;
+    while(s--) {
+      g->pixel(Point(x >> 16, y));
+      y += sy;
+      x += sx;
+    }
+  }
+}
+
+typedef std::vector<std::pair<Point, Point>> Batch;
+
+// LINES lines of the given angle and length, centred on points spread
+// over as much of the frame as keeps them on it
+static Batch batch(int32_t degrees, int32_t length) {
+  float a = degrees * float(M_PI) / 180.0f;
+  int32_t ex = int32_t(std::lround(cosf(a) * length / 2));
+  int32_t ey = int32_t(std::lround(sinf(a) * length / 2));
+  Batch lines;
+  for(auto i = 0u; i < LINES; i++) {
+    int32_t cx = ex + (WIDTH - 1 - 2 * ex) * int32_t(i % 8) / 7;
+    int32_t cy = ey + (HEIGHT - 1 - 2 * ey) * int32_t(i / 8) / 7;
+    // every other line drawn end to start
+    Point p1(cx - ex, cy - ey), p2(cx + ex, cy + ey);
+    if(i & 1) std::swap(p1, p2);
+    lines.push_back({p1, p2});
+  }
+  return lines;
+}
+
+// lines from well off one side of the frame to well off the other
+static Batch crossing() {
+  Batch lines;
+  for(auto i = 0u; i < LINES; i++) {
+    float a = i * float(M_PI) / LINES;
+    int32_t ex = int32_t(400 * cosf(a)), ey = int32_t(400 * sinf(a));
+    Point c(WIDTH / 2 + int32_t(i % 8) * 8 - 32, HEIGHT / 2 + int32_t(i / 8) * 8 - 32);
+    lines.push_back({Point(c.x - ex, c.y - ey), Point(c.x + ex, c.y + ey)});
+  }
+  return lines;
+}
+
+BENCH_SUITE(lines) {
+  std::vector<std::pair<std::string, Batch>> batches;
+  for(int32_t length : {8, 40, 200}) {
+    for(int32_t degrees : {0, 15, 30, 45, 60, 75, 90}) {
+      batches.push_back({str(int64_t(degrees)) + "/" + str(int64_t(length)), batch(degrees, length)});
+    }
+  }
+  batches.push_back({"crossing", crossing()});
+
+  for(auto pen : {"RGB565", "P4"}) {
+    Surface s = make_surface(pen, WIDTH, HEIGHT);
+    PicoGraphics *g = s.graphics.get();
+    g->set_pen(1);
+
+    for(auto &b : batches) {
+      const Batch &lines = b.second;
+      auto draw_line = [&]() {
+        for(auto &l : lines) g->line(l.first, l.second);
+      };
+      auto draw_pixel = [&]() {
+        for(auto &l : lines) pixel_line(g, l.first, l.second);
+      };
+
+      g->set_pen(0);
+      g->clear();
+      g->set_pen(1);
+      draw_pixel();
+      std::vector<uint8_t> expected = s.read_rgb();
+      g->set_pen(0);
+      g->clear();
+      g->set_pen(1);
+      draw_line();
+      if(s.read_rgb() != expected) fprintf(stderr, "lines: %s %s differs from the per-pixel lines\n", pen, b.first.c_str());
+
+      std::string angle = b.first, length = "-";
+      size_t slash = angle.find('/');
+      if(slash != std::string::npos) {
+        length = angle.substr(slash + 1);
+        angle = angle.substr(0, slash);
+      }
+
+      for(bool runs : {true, false}) {
+        Params params = {{"pen", pen}, {"angle", angle}, {"length", length}, {"engine", runs ? "line" : "pixel"}};
+        Result *r = runner.run("lines", "line", params, runs ? std::function<void()>(draw_line) : std::function<void()>(draw_pixel));
+        if(r) r->counters.push_back({"mlines_per_sec", LINES * 1e3 / r->ns_per_op});
+      }
+    }
+  }
+}
@@ -0,0 +1,206 @@
+#include <cmath>
+
+#include "bench.hpp"
+#include "surfaces.hpp"
+
+// every drawing primitive on every pen type, drawn into a 320x240 frame
+using namespace bench;
+
+static const uint16_t WIDTH = 320;
+static const uint16_t HEIGHT = 240;
+
+static void convert_count(void *context, void *data, size_t length) {
+  *(size_t *)context += length;
+}
+
+// thick_line as it was, a thickness x thickness square at each step of a
+// 16:16 fixed point line
+static void stamp_line(PicoGraphics *g, Point p1, Point p2, uint thickness) {
+  int32_t ht = thickness / 2;
+  int32_t t = (int32_t)thickness;
+
+  if(p1.y == p2.y) {
+    int32_t start = std::min(p1.x, p2.x);
+    int32_t end   = std::max(p1.x, p2.x);
+    g->rectangle(Rect(start, p1.y - ht, end - start, t));
+    return;
+  }
+
+  if(p1.x == p2.x) {
+    int32_t start  = std::min(p1.y, p2.y);
+    int32_t length = std::max(p1.y, p2.y) - start;
+    g->rectangle(Rect(p1.x - ht, start, t, length));
+    return;
+  }
+
+  int32_t dx = p2.x - p1.x;
+  int32_t dy = p2.y - p1.y;
+  if(std::abs(dx) > std::abs(dy)) {
+    int32_t s = std::abs(dx);
+    int32_t sx = dx < 0 ? -1 : 1;
+    int32_t sy = (dy << 16) / s;
+    int32_t x = p1.x;
+    int32_t y = p1.y << 16;
+    while(s--) {
+      g->rectangle(Rect(x - ht, (y >> 16) - ht, t, t));
+      y += sy;
+      x += sx;
+    }
+  } else {
+    int32_t s = std::abs(dy);
+    int32_t sy = dy < 0 ? -1 : 1;
+    int32_t sx = (dx << 16) / s;
+    int32_t y = p1.y;
+    int32_t x = p1.x << 16;
+    while(s--) {
+      g->rectangle(Rect((x >> 16) - ht, y - ht, t, t));
+      y += sy;
+      x += sx;
+    }
+  }
+}
+
+BENCH_SUITE(primitives) {
+  // a 64x64 coverage tile, fully transparent to fully opaque corner to corner
+  static uint8_t alpha[64 * 64];
+  for(auto y = 0; y < 64; y++) {
+    for(auto x = 0; x < 64; x++) {
+      alpha[y * 64 + x] = (x + y) * 2;
+    }
+  }
+
+  // an 8x8 sprite sheet of 16 sprites, in both 16-bit and 8-bit pixels
+  static RGB565 sheet565[128 * 8];
+  static RGB332 sheet332[128 * 8];
+  for(auto i = 0u; i < 128 * 8; i++) {
+    RGB c = PALETTE[(i / 8) % 16];
+    sheet565[i] = (i % 8) == 0 ? 0 : c.to_rgb565();
+    sheet332[i] = (i % 8) == 0 ? 0 : c.to_rgb332();
+  }
+
+  // a row of a colour gradient for dithering
+  std::vector<RGB> gradient(WIDTH);
+  for(auto x = 0; x < WIDTH; x++) {
+    gradient[x] = RGB(x * 255 / WIDTH, 255 - x * 255 / WIDTH, 128);
+  }
+
+  std::vector<Point> polygon;
+  for(auto i = 0; i < 6; i++) {
+    float a = i * float(M_PI) / 3.0f;
+    polygon.push_back(Point(160 + int32_t(100 * cosf(a)), 120 + int32_t(100 * sinf(a))));
+  }
+
+  for(auto name : pen_names()) {
+    Surface s = make_surface(name, WIDTH, HEIGHT);
+    PicoGraphics *g = s.graphics.get();
+    Params pen = {{"pen", name}};
+    auto params = [&](const Params &extra) {
+      Params p = pen;
+      p.insert(p.end(), extra.begin(), extra.end());
+      return p;
+    };
+
+    g->set_pen(255, 128, 0);
+
+    runner.run("primitives", "clear", pen, [&]() {
+      g->clear();
+    });
+
+    runner.run("primitives", "rectangle", params({{"size", "100x80"}}), [&]() {
+      g->rectangle(Rect(10, 10, 100, 80));
+    });
+
+    runner.run("primitives", "circle", params({{"radius", "50"}}), [&]() {
+      g->circle(Point(160, 120), 50);
+    });
+
+    // 16 lines radiating from the centre, one every 22.5 degrees
+    runner.run("primitives", "line", params({{"lines", "16"}, {"length", "100"}}), [&]() {
+      for(auto i = 0; i < 16; i++) {
+        float a = i * float(M_PI) / 8.0f;
+        g->line(Point(160, 120), Point(160 + int32_t(100 * cosf(a)), 120 + int32_t(100 * sinf(a))));
+      }
+    });
+
+    // thick lines against stamp_line, the square per step drawer that
+    // thick_line replaced. the two don't cover exactly the same pixels
+    for(auto thickness = 1u; thickness <= 16; thickness++) {
+      for(bool stamp : {false, true}) {
+        Params p = params({{"lines", "16"}, {"length", "100"}, {"thickness", str(int64_t(thickness))},
+                           {"engine", stamp ? "stamp" : "capsule"}});
+        Result *r = runner.run("primitives", "thick_line", p, [&]() {
+          for(auto i = 0; i < 16; i++) {
+            float a = i * float(M_PI) / 8.0f + 0.1f;
+            Point p2(160 + int32_t(100 * cosf(a)), 120 + int32_t(100 * sinf(a)));
+            if(stamp) {
+              stamp_line(g, Point(160, 120), p2, thickness);
+            } else {
+              g->thick_line(Point(160, 120), p2, thickness);
+            }
+          }
+        });
+        if(r) r->counters.push_back({"mlines_per_sec", 16 * 1e3 / r->ns_per_op});
+      }
+    }
+
+    runner.run("primitives", "triangle", pen, [&]() {
+      g->triangle(Point(20, 20), Point(300, 60), Point(120, 220));
+    });
+
+    runner.run("primitives", "polygon", params({{"points", "6"}}), [&]() {
+      g->polygon(polygon);
+    });
+
+    g->set_font("bitmap8");
+    runner.run("primitives", "text", params({{"font", "bitmap8"}, {"scale", "2"}}), [&]() {
+      g->text("The quick brown fox jumps over the lazy dog", Point(0, 0), WIDTH, 2.0f);
+    });
+
+    g->set_font("sans");
+    runner.run("primitives", "text", params({{"font", "sans"}, {"scale", "1"}}), [&]() {
+      g->text("The quick brown fox jumps over the lazy dog", Point(0, 20), WIDTH, 1.0f);
+    });
+    g->set_font("bitmap8");
+
+    // only the 8 and 16-bit RGB pens implement sprite, from sheets of
+    // their own format
+    void *sheet = g->pen_type == PicoGraphics::PEN_RGB565 ? (void *)sheet565
+                : g->pen_type == PicoGraphics::PEN_RGB332 ? (void *)sheet332 : nullptr;
+    if(sheet) {
+      runner.run("primitives", "sprite", params({{"sprites", "16"}, {"scale", "2"}}), [&]() {
+        for(auto i = 0; i < 16; i++) {
+          g->sprite(sheet, Point(i, 0), Point(i * 16, 100), 2, 0);
+        }
+      });
+    }
+
+    runner.run("primitives", "dither", params({{"size", "320x240"}}), [&]() {
+      for(auto y = 0; y < HEIGHT; y++) {
+        g->set_pixel_dither_span(Point(0, y), WIDTH, gradient.data());
+      }
+    });
+
+    static uint8_t buffers[2][1024];
+    static void *const pointers[2] = {buffers[0], buffers[1]};
+    size_t converted = 0;
+    PicoGraphics::ConvertBuffers target = {pointers, 2, sizeof(buffers[0]), convert_count, &converted};
+    g->frame_convert(s.convert_type, target);
+    size_t frame_bytes = converted;
+    if(frame_bytes) {
+      Result *r = runner.run("primitives", "frame_convert", params({{"to", s.convert_type == PicoGraphics::PEN_RGB565 ? "RGB565" : "native"}}), [&]() {
+        g->frame_convert(s.convert_type, target);
+      });
+      if(r) {
+        r->counters.push_back({"bytes", double(frame_bytes)});
+        r->counters.push_back({"mb_per_sec", frame_bytes * 1e3 / r->ns_per_op});
+      }
+    }
+
+    Tile tile = {100, 80, 64, 64, 64, alpha};
+    if(g->render_tile(&tile)) {
+      runner.run("primitives", "render_tile", params({{"size", "64x64"}}), [&]() {
+        g->render_tile(&tile);
+      });
+    }
+  }
+}
@@ -0,0 +1,127 @@
+#include <cstring>
+
+#include "surfaces.hpp"
+
+namespace bench {
+
+  const RGB PALETTE[16] = {
+    {  0,   0,   0}, {255, 255, 255}, {255,   0,   0}, {  0, 255,   0},
+    {  0,   0, 255}, {255, 255,   0}, {  0, 255, 255}, {255,   0, 255},
+    {128, 128, 128}, { 64,  64,  64}, {255, 128,   0}, {128,   0, 255},
+    {128,  64,   0}, {255, 128, 192}, {  0, 128,  64}, {  0,  32, 128}
+  };
+
+  void MemoryDriver::write_pixel(const Point &p, uint8_t colour) {
+    pixels[p.y * width + p.x] = colour;
+  }
+
+  void MemoryDriver::write_pixel_span(const Point &p, uint l, uint8_t colour) {
+    memset(&pixels[p.y * width + p.x], colour, l);
+  }
+
+  void MemoryDriver::write_pixels(const Point &p, uint l, const uint8_t *data) {
+    memcpy(&pixels[p.y * width + p.x], data, l);
+  }
+
+  void MemoryDriver::read_pixel(const Point &p, uint8_t &data) {
+    data = pixels[p.y * width + p.x];
+  }
+
+  void MemoryDriver::read_pixel_span(const Point &p, uint l, uint8_t *data) {
+    memcpy(data, &pixels[p.y * width + p.x], l);
+  }
+
+  void CountingDriver::write_pixel(const Point &p, uint8_t colour) {
+    calls++;
+    bytes++;
+    MemoryDriver::write_pixel(p, colour);
+  }
+
+  void CountingDriver::write_pixel_span(const Point &p, uint l, uint8_t colour) {
+    calls++;
+    bytes++;
+    MemoryDriver::write_pixel_span(p, l, colour);
+  }
+
+  void CountingDriver::write_pixels(const Point &p, uint l, const uint8_t *data) {
+    if(!bulk) {
+      IDirectDisplayDriver<uint8_t>::write_pixels(p, l, data);
+      return;
+    }
+    calls++;
+    bytes += l;
+    MemoryDriver::write_pixels(p, l, data);
+  }
+
+  const std::vector<const char *> &pen_names() {
+    static const std::vector<const char *> names = {
+      "1Bit", "1BitY", "3Bit", "P4", "P8", "RGB332", "RGB565", "RGB888", "Inky7"
+    };
+    return names;
+  }
+
+  Surface make_surface(const char *name, uint16_t width, uint16_t height, uint16_t layers) {
+    Surface s;
+    s.name = name;
+    s.convert_type = PicoGraphics::PEN_RGB565;
+
+    std::string n(name);
+    if(n == "1Bit") {
+      s.graphics.reset(new PicoGraphics_Pen1Bit(width, height, nullptr, layers));
+      s.convert_type = PicoGraphics::PEN_1BIT;
+    } else if(n == "1BitY") {
+      s.graphics.reset(new PicoGraphics_Pen1BitY(width, height, nullptr, layers));
+      s.convert_type = PicoGraphics::PEN_1BIT;
+    } else if(n == "3Bit") {
+      s.graphics.reset(new PicoGraphics_Pen3Bit(width, height, nullptr, layers));
+      s.convert_type = PicoGraphics::PEN_P4;
+    } else if(n == "P4") {
+      s.graphics.reset(new PicoGraphics_PenP4(width, height, nullptr, layers));
+    } else if(n == "P8") {
+      s.graphics.reset(new PicoGraphics_PenP8(width, height, nullptr, layers));
+    } else if(n == "RGB332") {
+      s.graphics.reset(new PicoGraphics_PenRGB332(width, height, nullptr, layers));
+    } else if(n == "RGB565") {
+      s.graphics.reset(new PicoGraphics_PenRGB565(width, height, nullptr, layers));
+    } else if(n == "RGB888") {
+      s.graphics.reset(new PicoGraphics_PenRGB888(width, height, nullptr, layers));
+    } else if(n == "Inky7") {
+      s.driver.reset(new MemoryDriver(width, height));
+      s.graphics.reset(new PicoGraphics_PenInky7(width, height, *s.driver, layers));
+      s.convert_type = PicoGraphics::PEN_INKY7;
+    } else {
+      return s;
+    }
+
+    PicoGraphics *g = s.graphics.get();
+    if(g->pen_type == PicoGraphics::PEN_P4 || g->pen_type == PicoGraphics::PEN_P8) {
+      for(auto i = 0u; i < 16; i++) {
+        g->update_pen(i, PALETTE[i].r, PALETTE[i].g, PALETTE[i].b);
+      }
+    }
+
+    for(auto l = 0u; l < layers; l++) {
+      g->set_layer(l);
+      g->set_pen(0);
+      g->clear();
+    }
+    g->set_layer(0);
+    return s;
+  }
+
+  std::vector<uint8_t> Surface::read_rgb() const {
+    const Rect &b = graphics->bounds;
+    std::vector<uint8_t> rgb(b.w * b.h * 3);
+    std::vector<RGB> row(b.w);
+    for(auto y = 0; y < b.h; y++) {
+      graphics->get_pixel_span(Point(0, y), b.w, row.data());
+      for(auto x = 0; x < b.w; x++) {
+        uint8_t *p = &rgb[(y * b.w + x) * 3];
+        p[0] = row[x].r;
+        p[1] = row[x].g;
+        p[2] = row[x].b;
+      }
+    }
+    return rgb;
+  }
+}
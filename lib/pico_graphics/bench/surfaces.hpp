@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "pico_graphics.hpp"
+
+// Pens of every type for the host benchmarks and tests, so each primitive can
+// be run against all of them without repeating the setup.
+namespace bench {
+  using namespace pimoroni;
+
+  // holds the pixels an Inky7 pen writes to its driver, one byte each, so
+  // the pen can be drawn to and read back like the framebuffer pens
+  class MemoryDriver : public IDirectDisplayDriver<uint8_t> {
+    public:
+      uint16_t width;
+      uint16_t height;
+      std::vector<uint8_t> pixels;
+
+      MemoryDriver(uint16_t width, uint16_t height) : width(width), height(height), pixels(width * height) {}
+
+      void write_pixel(const Point &p, uint8_t colour) override;
+      void write_pixel_span(const Point &p, uint l, uint8_t colour) override;
+      void write_pixels(const Point &p, uint l, const uint8_t *data) override;
+      void read_pixel(const Point &p, uint8_t &data) override;
+      void read_pixel_span(const Point &p, uint l, uint8_t *data) override;
+  };
+
+  // a MemoryDriver that counts the calls made to it and the bytes passed
+  // in them. without bulk it leaves write_pixels to the interface's
+  // default, a write_pixel per value, as drivers that don't override it do
+  class CountingDriver : public MemoryDriver {
+    public:
+      bool bulk;
+      uint64_t calls = 0;
+      uint64_t bytes = 0;
+
+      CountingDriver(uint16_t width, uint16_t height, bool bulk = true) : MemoryDriver(width, height), bulk(bulk) {}
+
+      void write_pixel(const Point &p, uint8_t colour) override;
+      void write_pixel_span(const Point &p, uint l, uint8_t colour) override;
+      void write_pixels(const Point &p, uint l, const uint8_t *data) override;
+      void reset() { calls = bytes = 0; }
+  };
+
+  struct Surface {
+    const char *name;
+    // what frame_convert is asked for, RGB565 unless the pen only converts
+    // to its own format (or can't be converted at all, as with 1Bit)
+    PicoGraphics::PenType convert_type;
+    std::unique_ptr<MemoryDriver> driver;
+    std::unique_ptr<PicoGraphics> graphics;
+
+    PicoGraphics *operator->() const { return graphics.get(); }
+    // read the frame back as 8-bit RGB, three bytes a pixel
+    std::vector<uint8_t> read_rgb() const;
+  };
+
+  extern const RGB PALETTE[16];
+
+  // "1Bit", "1BitY", "3Bit", "P4", "P8", "RGB332", "RGB565", "RGB888" and "Inky7"
+  const std::vector<const char *> &pen_names();
+
+  // a cleared surface of the named pen type, with its own frame buffer. the
+  // palette pens are given PALETTE so set_pen(r, g, b) picks from it
+  Surface make_surface(const char *name, uint16_t width, uint16_t height, uint16_t layers = 1);
+}
@@ -0,0 +1,136 @@
+#include <vector>
+
+#include "bench.hpp"
+#include "surfaces.hpp"
+
+// a 320x240 frame of nested widgets, each clipped to its own area within
+// its parent's and drawing a fill, a border, a circle, a triangle, a polygon
+// and a label. with layout=inset every child sits inside its parent, with
+// layout=overhang children stick out of their parent (and off the screen)
+// so much of the drawing is clipped. the clip is nested either with
+// push_clip/pop_clip or by saving, intersecting and restoring it by hand
+// with set_clip. inside is the fraction of primitives whose bounds lie
+// inside the clip they are drawn under, which skip clipping altogether
+using namespace bench;
+
+static const uint16_t WIDTH = 320;
+static const uint16_t HEIGHT = 240;
+static const uint DEPTH = 4;
+static const uint CHILDREN = 4;
+
+struct Stats {
+  uint32_t widgets = 0;
+  uint32_t primitives = 0;
+  uint32_t inside = 0;
+};
+
+static void count(Stats *stats, const Rect &clip, const Rect &r) {
+  if(!stats) return;
+  stats->primitives++;
+  if(clip.contains(r)) stats->inside++;
+}
+
+// lines skip clipping when both ends are inside
+static void count(Stats *stats, const Rect &clip, const Point &p1, const Point &p2) {
+  if(!stats) return;
+  stats->primitives++;
+  if(clip.contains(p1) && clip.contains(p2)) stats->inside++;
+}
+
+static void widget(PicoGraphics *g, const Rect &r, uint depth, bool overhang, bool stack, Stats *stats) {
+  Rect saved = g->clip;
+  if(stack) {
+    g->push_clip(r);
+  } else {
+    g->set_clip(saved.intersection(r));
+  }
+  const Rect &clip = g->clip;
+  if(stats) stats->widgets++;
+
+  const RGB &c = PALETTE[1 + (depth * 5 + r.x + r.y) % 15];
+  g->set_pen(c.r, c.g, c.b);
+  g->rectangle(r);
+  count(stats, clip, r);
+
+  g->set_pen(255, 255, 255);
+  Point tl(r.x, r.y), tr(r.x + r.w - 1, r.y), bl(r.x, r.y + r.h - 1), br(r.x + r.w - 1, r.y + r.h - 1);
+  g->line(tl, tr);
+  g->line(tr, br);
+  g->line(br, bl);
+  g->line(bl, tl);
+  count(stats, clip, tl, tr);
+  count(stats, clip, tr, br);
+  count(stats, clip, br, bl);
+  count(stats, clip, bl, tl);
+
+  int32_t s = std::max(2, std::min(r.w, r.h) / 6);
+  Point m(r.x + r.w / 2, r.y + r.h / 2);
+  g->set_pen(0, 0, 0);
+  g->circle(Point(r.x + s + 2, r.y + s + 2), s);
+  count(stats, clip, Rect(r.x + 2, r.y + 2, s * 2 + 1, s * 2 + 1));
+  g->triangle(Point(m.x, r.y + 2), Point(r.x + r.w - 3, m.y), Point(m.x, m.y));
+  count(stats, clip, Rect(m.x, r.y + 2, r.x + r.w - 2 - m.x, m.y - r.y - 1));
+  std::vector<Point> diamond = {
+    Point(m.x, m.y), Point(m.x + s, m.y + s), Point(m.x, m.y + s * 2), Point(m.x - s, m.y + s)
+  };
+  g->polygon(diamond);
+  count(stats, clip, Rect(m.x - s, m.y, s * 2 + 1, s * 2 + 1));
+  g->text("Widget", Point(r.x + 3, r.y + r.h - 10), r.w, 1.0f);
+  count(stats, clip, Rect(r.x + 3, r.y + r.h - 10, 36, 8));
+
+  if(depth < DEPTH) {
+    // children in a 2x2 grid, overhanging by a third of their size
+    int32_t w = r.w / 2, h = r.h / 2;
+    for(auto i = 0u; i < CHILDREN; i++) {
+      int32_t x = r.x + (i % 2) * w, y = r.y + (i / 2) * h;
+      Rect child = overhang ? Rect(x + w / 3, y + h / 3, w, h) : Rect(x + 2, y + 2, w - 4, h - 4);
+      widget(g, child, depth + 1, overhang, stack, stats);
+    }
+  }
+
+  if(stack) {
+    g->pop_clip();
+  } else {
+    g->set_clip(saved);
+  }
+}
+
+static void frame(PicoGraphics *g, bool overhang, bool stack, Stats *stats = nullptr) {
+  g->remove_clip();
+  g->set_pen(0, 0, 0);
+  g->clear();
+  g->set_font("bitmap8");
+  Rect root = overhang ? Rect(WIDTH / 4, HEIGHT / 4, WIDTH, HEIGHT) : Rect(0, 0, WIDTH, HEIGHT);
+  widget(g, root, 0, overhang, stack, stats);
+}
+
+BENCH_SUITE(widgets) {
+  for(auto pen : {"RGB565", "P8"}) {
+    Surface s = make_surface(pen, WIDTH, HEIGHT);
+    PicoGraphics *g = s.graphics.get();
+
+    for(bool overhang : {false, true}) {
+      // both ways of nesting the clip must draw the same frame
+      frame(g, overhang, false);
+      std::vector<uint8_t> expected = s.read_rgb();
+      Stats stats;
+      frame(g, overhang, true, &stats);
+      if(s.read_rgb() != expected) fprintf(stderr, "widgets: %s push_clip and set_clip frames differ\n", pen);
+
+      for(bool stack : {true, false}) {
+        Params params = {
+          {"pen", pen}, {"layout", overhang ? "overhang" : "inset"},
+          {"clip", stack ? "push_clip" : "set_clip"}, {"size", "320x240"}
+        };
+        Result *r = runner.run("widgets", "tree", params, [&]() {
+          frame(g, overhang, stack);
+        });
+        if(r) {
+          r->counters.push_back({"widgets", double(stats.widgets)});
+          r->counters.push_back({"inside", double(stats.inside) / stats.primitives});
+          r->counters.push_back({"frames_per_sec", 1e9 / r->ns_per_op});
+        }
+      }
+    }
+  }
+}
@@ -10,6 +10,10 @@ if(NOT TARGET pico_graphics)
     add_library(pico_graphics 
         ${CMAKE_CURRENT_LIST_DIR}/types.cpp
         ${CMAKE_CURRENT_LIST_DIR}/pico_graphics.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/pico_graphics_dither.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/pico_graphics_image.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/pico_graphics_display_list.cpp
+        ${CMAKE_CURRENT_LIST_DIR}/pico_graphics_allocator.cpp
         ${CMAKE_CURRENT_LIST_DIR}/pico_graphics_pen_1bit.cpp
         ${CMAKE_CURRENT_LIST_DIR}/pico_graphics_pen_1bitY.cpp
         ${CMAKE_CURRENT_LIST_DIR}/pico_graphics_pen_3bit.cpp
@@ -22,5 +26,41 @@ if(NOT TARGET pico_graphics)
     )
 
     target_include_directories(pico_graphics INTERFACE ${CMAKE_CURRENT_LIST_DIR})
-    target_link_libraries(pico_graphics bitmap_fonts hershey_fonts pico_stdlib)
+
+    if(DEFINED BUILD_PICO)
+        target_link_libraries(pico_graphics bitmap_fonts hershey_fonts pico_stdlib pico_sync FreeRTOS-Kernel)
+    else()
+        # host build, for profiling and checking output without a board
+        find_package(Threads REQUIRED)
+        target_include_directories(bitmap_fonts PUBLIC ${CMAKE_CURRENT_LIST_DIR}/../../common)
+        target_link_libraries(pico_graphics bitmap_fonts hershey_fonts Threads::Threads)
+
+        # pens of every type for the host benchmarks and tests
+        add_library(pico_graphics_surfaces
+            ${CMAKE_CURRENT_LIST_DIR}/bench/surfaces.cpp
+        )
+        target_include_directories(pico_graphics_surfaces INTERFACE ${CMAKE_CURRENT_LIST_DIR}/bench)
+        target_link_libraries(pico_graphics_surfaces pico_graphics)
+
+        # timing, heap accounting, JSON output and main() for benchmarks
+        add_library(pico_graphics_bench_harness
+            ${CMAKE_CURRENT_LIST_DIR}/bench/bench.cpp
+        )
+        target_include_directories(pico_graphics_bench_harness INTERFACE ${CMAKE_CURRENT_LIST_DIR}/bench)
+
+        add_executable(pico_graphics_bench
+            ${CMAKE_CURRENT_LIST_DIR}/bench/primitives.cpp
+            ${CMAKE_CURRENT_LIST_DIR}/bench/error_diffusion.cpp
+            ${CMAKE_CURRENT_LIST_DIR}/bench/image_decoder.cpp
+            ${CMAKE_CURRENT_LIST_DIR}/bench/display_list.cpp
+            ${CMAKE_CURRENT_LIST_DIR}/bench/inky7.cpp
+            ${CMAKE_CURRENT_LIST_DIR}/bench/allocator.cpp
+            ${CMAKE_CURRENT_LIST_DIR}/bench/compositing.cpp
+            ${CMAKE_CURRENT_LIST_DIR}/bench/widgets.cpp
+            ${CMAKE_CURRENT_LIST_DIR}/bench/lines.cpp
+            ${CMAKE_CURRENT_LIST_DIR}/bench/columns.cpp
+            ${CMAKE_CURRENT_LIST_DIR}/bench/blit.cpp
+        )
+        target_link_libraries(pico_graphics_bench pico_graphics_bench_harness pico_graphics_surfaces)
+    endif()
 endif()
@@ -1,9 +1,51 @@
+#include <string.h>
+
 #include "pico_graphics.hpp"
 
 namespace pimoroni {
 
   const uint8_t dither16_pattern[16] = {0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5};
 
+  FrameBufferAllocator *PicoGraphics::allocator = nullptr;
+
+  PicoGraphics::~PicoGraphics() {
+    if(buffer_owner) {
+      buffer_owner->release(allocated_buffer);
+    } else {
+      delete[] (uint8_t *)allocated_buffer;
+    }
+    delete[] layer_settings;
+    delete[] blit_rows;
+    delete[] blit_alphas;
+  }
+
+  void PicoGraphics::init_layers() {
+    if(layers < 2) return;
+
+    // what is already in the layers is unknown, so all of them are read
+    // until they are drawn on or cleared
+    layer_settings = new LayerSettings[layers];
+    for(auto l = 0u; l < layers; l++) {
+      layer_settings[l].dirty = bounds;
+    }
+  }
+
+  void *PicoGraphics::allocate_frame_buffer(size_t layer_size) {
+    // every layer lives in the one buffer, set_layer offsets into it
+    size_t size = layer_size * layers;
+    if(allocator) {
+      allocated_buffer = allocator->allocate(size, FRAME_BUFFER_ALIGNMENT);
+      buffer_owner = allocator;
+    }
+
+    // the heap is the last resort if the allocator is out of room
+    if(!allocated_buffer) {
+      allocated_buffer = new uint8_t[size];
+      buffer_owner = nullptr;
+    }
+    return allocated_buffer;
+  }
+
   int PicoGraphics::update_pen(uint8_t i, uint8_t r, uint8_t g, uint8_t b) {return -1;};
   int PicoGraphics::reset_pen(uint8_t i) {return -1;};
   int PicoGraphics::create_pen(uint8_t r, uint8_t g, uint8_t b) {return -1;};
@@ -12,7 +54,43 @@ namespace pimoroni {
   void PicoGraphics::set_pixel_dither(const Point &p, const RGB &c) {};
   void PicoGraphics::set_pixel_dither(const Point &p, const RGB565 &c) {};
   void PicoGraphics::set_pixel_dither(const Point &p, const uint8_t &c) {};
-  void PicoGraphics::frame_convert(PenType type, conversion_callback_func callback) {};
+  void PicoGraphics::set_pixel_dither_span(const Point &p, uint l, const RGB *c) {
+    Point dest = p;
+    while(l--) {
+      set_pixel_dither(dest, *c++);
+      dest.x++;
+    }
+  };
+  void PicoGraphics::get_pixel_span(const Point &p, uint l, RGB *c) {
+    std::fill(c, c + l, RGB());
+  };
+  void PicoGraphics::set_pixel_column(const Point &p, uint l) {
+    Point dest = p;
+    while(l--) {
+      set_pixel(dest);
+      dest.y++;
+    }
+  };
+  void PicoGraphics::frame_convert(PenType type, const ConvertBuffers &target) {};
+
+  void PicoGraphics::frame_convert(PenType type, conversion_callback_func callback) {
+    // 64 pixels at a time into a pair of buffers on the stack
+    uint32_t buffers[2][64];
+    void *const pointers[2] = {buffers[0], buffers[1]};
+
+    size_t length;
+    switch(type) {
+      case PEN_RGB888: length = 64 * sizeof(RGB888); break;
+      case PEN_P4:
+      case PEN_INKY7: length = 64 / 2; break;
+      default: length = 64 * sizeof(RGB565); break;
+    }
+
+    ConvertBuffers target = {pointers, 2, length, [](void *context, void *data, size_t length) {
+      (*(conversion_callback_func *)context)(data, length);
+    }, &callback};
+    frame_convert(type, target);
+  }
   void PicoGraphics::sprite(void* data, const Point &sprite, const Point &dest, const int scale, const int transparent) {};
 
   int PicoGraphics::get_palette_size() {return 0;}
@@ -27,8 +105,72 @@ namespace pimoroni {
     return this->layer;
   };
 
+  void PicoGraphics::set_layer_visible(uint l, bool visible) {
+    if(layer_settings && l < layers) layer_settings[l].visible = visible;
+  }
+
+  void PicoGraphics::set_layer_opacity(uint l, uint8_t opacity) {
+    if(layer_settings && l < layers) layer_settings[l].opacity = opacity;
+  }
+
+  void PicoGraphics::set_layer_colour_key(uint l, bool enabled, uint key) {
+    if(layer_settings && l < layers) {
+      layer_settings[l].colour_key = enabled;
+      layer_settings[l].key = key;
+    }
+  }
+
+  void PicoGraphics::clear_layer(uint l) {
+    if(l >= layers || !frame_buffer) return;
+
+    uint pixels = bounds.w * bounds.h;
+    uint key = layer_settings ? layer_settings[l].key : 0;
+    switch(pen_type) {
+      case PEN_P4:
+        memset((uint8_t *)frame_buffer + pixels * l / 2, (key & 0xf) * 0x11, pixels / 2);
+        break;
+      case PEN_P8:
+      case PEN_RGB332:
+        memset((uint8_t *)frame_buffer + pixels * l, key, pixels);
+        break;
+      case PEN_RGB565:
+        std::fill_n((uint16_t *)frame_buffer + pixels * l, pixels, key);
+        break;
+      case PEN_RGB888:
+        std::fill_n((uint32_t *)frame_buffer + pixels * l, pixels, key);
+        break;
+      default:
+        return;
+    }
+
+    if(layer_settings) layer_settings[l].dirty = Rect(0, 0, 0, 0);
+  }
+
+  void PicoGraphics::touch(const Rect &r) {
+    if(!layer_settings || layer >= layers) return;
+
+    Rect c = bounds.intersection(r);
+    if(c.empty()) return;
+
+    Rect &d = layer_settings[layer].dirty;
+    if(d.empty()) {
+      d = c;
+    } else if(!d.contains(c)) {
+      Point tl(std::min(d.x, c.x), std::min(d.y, c.y));
+      Point br(std::max(d.x + d.w, c.x + c.w), std::max(d.y + d.h, c.y + c.h));
+      d = Rect(tl, br);
+    }
+  }
+
   void PicoGraphics::set_dimensions(int width, int height) {
     bounds = clip = {0, 0, width, height};
+    clip_depth = 0;
+
+    if(layer_settings) {
+      for(auto l = 0u; l < layers; l++) {
+        layer_settings[l].dirty = bounds;
+      }
+    }
   }
 
   void PicoGraphics::set_framebuffer(void *frame_buffer) {
@@ -76,6 +218,18 @@ namespace pimoroni {
 
   void PicoGraphics::remove_clip() {
     clip = bounds;
+    clip_depth = 0;
+  }
+
+  bool PicoGraphics::push_clip(const Rect &r) {
+    if(clip_depth == MAX_CLIP_DEPTH) return false;
+    clip_stack[clip_depth++] = clip;
+    clip = clip.intersection(r);
+    return true;
+  }
+
+  void PicoGraphics::pop_clip() {
+    if(clip_depth) clip = clip_stack[--clip_depth];
   }
   
   void PicoGraphics::clear() {
@@ -89,16 +243,24 @@ namespace pimoroni {
 
   void PicoGraphics::pixel_span(const Point &p, int32_t l) {
     // check if span in bounds
-    if( p.x + l < clip.x || p.x >= clip.x + clip.w ||
-        p.y     < clip.y || p.y >= clip.y + clip.h) return;
+    if(p.y < clip.y || p.y >= clip.y + clip.h) return;
 
-    // clamp span horizontally
-    Point clipped = p;
-    if(clipped.x     <  clip.x)           {l += clipped.x - clip.x; clipped.x = clip.x;}
-    if(clipped.x + l >= clip.x + clip.w)  {l  = clip.x + clip.w - clipped.x;}
+    // clamp span horizontally, nothing is left of it if the clip is empty
+    int32_t start = std::max(p.x, clip.x);
+    int32_t end   = std::min(p.x + l, clip.x + clip.w);
+    if(start >= end) return;
 
-    Point dest(clipped.x, clipped.y);
-    set_pixel_span(dest, l);
+    set_pixel_span(Point(start, p.y), end - start);
+  }
+
+  void PicoGraphics::pixel_column(const Point &p, int32_t l) {
+    if(p.x < clip.x || p.x >= clip.x + clip.w) return;
+
+    int32_t start = std::max(p.y, clip.y);
+    int32_t end   = std::min(p.y + l, clip.y + clip.h);
+    if(start >= end) return;
+
+    set_pixel_column(Point(p.x, start), end - start);
   }
 
   void PicoGraphics::rectangle(const Rect &r) {
@@ -107,6 +269,15 @@ namespace pimoroni {
 
     if(clipped.empty()) return;
 
+    // tall narrow rectangles, like the strokes of text, go a column at a
+    // time to save a span per row
+    if(clipped.w <= 4 && clipped.h > clipped.w) {
+      for(Point dest(clipped.x, clipped.y); dest.x < clipped.x + clipped.w; dest.x++) {
+        set_pixel_column(dest, clipped.h);
+      }
+      return;
+    }
+
     Point dest(clipped.x, clipped.y);
     while(clipped.h--) {
       // draw span of pixels for this row
@@ -118,9 +289,19 @@ namespace pimoroni {
 
   void PicoGraphics::circle(const Point &p, int32_t radius) {
     // circle in screen bounds?
-    Rect bounds = Rect(p.x - radius, p.y - radius, radius * 2, radius * 2);
+    Rect bounds = Rect(p.x - radius, p.y - radius, radius * 2 + 1, radius * 2 + 1);
     if(!bounds.intersects(clip)) return;
 
+    // spans only need clipping when the circle crosses the clip edge
+    bool inside = clip.contains(bounds);
+    auto span = [&](const Point &s, int32_t l) {
+      if(inside) {
+        set_pixel_span(s, l);
+      } else {
+        pixel_span(s, l);
+      }
+    };
+
     int ox = radius, oy = 0, err = -radius;
     while (ox >= oy)
     {
@@ -128,15 +309,15 @@ namespace pimoroni {
 
       err += oy; oy++; err += oy;
 
-      pixel_span(Point(p.x - ox, p.y + last_oy), ox * 2 + 1);
+      span(Point(p.x - ox, p.y + last_oy), ox * 2 + 1);
       if (last_oy != 0) {
-        pixel_span(Point(p.x - ox, p.y - last_oy), ox * 2 + 1);
+        span(Point(p.x - ox, p.y - last_oy), ox * 2 + 1);
       }
 
       if(err >= 0 && ox != last_oy) {
-        pixel_span(Point(p.x - last_oy, p.y + ox), last_oy * 2 + 1);
+        span(Point(p.x - last_oy, p.y + ox), last_oy * 2 + 1);
         if (ox != 0) {
-          pixel_span(Point(p.x - last_oy, p.y - ox), last_oy * 2 + 1);
+          span(Point(p.x - last_oy, p.y - ox), last_oy * 2 + 1);
         }
 
         err -= ox; ox--; err -= ox;
@@ -194,6 +375,205 @@ namespace pimoroni {
     return 0;
   }
 
+  // Coverage rasteriser shared by thick_line and the antialiased primitives.
+  //
+  // `distance` returns the signed distance from a pixel centre to the edge of
+  // the shape, negative inside, and `extent` the horizontal range of a row in
+  // which that distance is below `reach` (or false if it never is).
+  //
+  // For convex shapes the extents are exact: pixels inside the inner extent
+  // are filled as a single span and only those between it and the outer
+  // extent are evaluated. Otherwise each row is walked within its extent, and
+  // since the distance changes by at most one pixel per pixel each sample
+  // tells us how many of the following pixels are certainly outside (skipped)
+  // or certainly inside (added to the span) so only edge pixels are evaluated.
+  //
+  // When the pen can blend, edge pixels are collected into a one row alpha
+  // tile and composited through render_tile, otherwise coverage is thresholded.
+  static const int32_t COVERAGE_BUFFER_SIZE = 64;
+
+  template<typename E, typename F>
+  static void fill_coverage(PicoGraphics *graphics, Rect area, bool antialias, bool convex, E extent, F distance) {
+    area = area.intersection(graphics->clip);
+    if(area.empty()) return;
+
+    bool blend = antialias && graphics->supports_alpha_blend();
+    float band = blend ? 0.5f : 0.0f;
+
+    uint8_t coverage[COVERAGE_BUFFER_SIZE];
+    Tile tile = {0, 0, 0, 1, COVERAGE_BUFFER_SIZE, coverage};
+    int32_t span = -1;
+
+    auto flush_tile = [&]() {
+      if(tile.w == 0) return;
+      if(!graphics->render_tile(&tile)) {
+        for(int32_t x = 0; x < tile.w; x++) {
+          graphics->set_pixel_alpha(Point(tile.x + x, tile.y), coverage[x]);
+        }
+      }
+      tile.w = 0;
+    };
+
+    auto flush_span = [&](int32_t x) {
+      if(span == -1) return;
+      graphics->set_pixel_span(Point(span, tile.y), x - span);
+      span = -1;
+    };
+
+    auto edge = [&](int32_t x, float d) {
+      if(tile.w == COVERAGE_BUFFER_SIZE) flush_tile();
+      if(tile.w == 0) tile.x = x;
+      coverage[tile.w++] = uint8_t(std::min(std::max(band - d, 0.0f), 1.0f) * 255.0f);
+    };
+
+    for(int32_t y = area.y; y < area.y + area.h; y++) {
+      float cy = y + 0.5f;
+      float x0, x1;
+      if(!extent(cy, band, x0, x1)) continue;
+
+      // pixels whose centres fall within the extent
+      int32_t start = std::max(area.x, int32_t(ceilf(x0 - 0.5f)));
+      int32_t end = std::min(area.x + area.w, int32_t(floorf(x1 - 0.5f)) + 1);
+      if(start >= end) continue;
+
+      tile.y = y;
+
+      if(convex) {
+        int32_t inner_start = end, inner_end = end;
+        if(!blend) {
+          inner_start = start;
+        } else if(extent(cy, -band, x0, x1)) {
+          inner_start = std::max(start, int32_t(ceilf(x0 - 0.5f)));
+          inner_end = std::max(inner_start, std::min(end, int32_t(floorf(x1 - 0.5f)) + 1));
+        }
+
+        for(int32_t x = start; x < inner_start; x++) {
+          edge(x, distance(x + 0.5f, cy));
+        }
+        flush_tile();
+
+        if(inner_start < inner_end) {
+          graphics->set_pixel_span(Point(inner_start, y), inner_end - inner_start);
+        }
+
+        for(int32_t x = inner_end; x < end; x++) {
+          edge(x, distance(x + 0.5f, cy));
+        }
+        flush_tile();
+        continue;
+      }
+
+      int32_t x = start;
+      while(x < end) {
+        float d = distance(x + 0.5f, cy);
+
+        if(d >= band) {
+          // outside, skip every pixel the edge cannot reach
+          flush_span(x);
+          flush_tile();
+          x += std::max(1, int32_t(ceilf(d - band)));
+        } else if(d < -band || (!blend && d < 0.0f)) {
+          // inside, extend the current span over every pixel that must be too
+          flush_tile();
+          if(span == -1) span = x;
+          x = std::min(end, x + std::max(1, int32_t(ceilf(-d - band))));
+        } else {
+          flush_span(x);
+          edge(x, d);
+          x++;
+        }
+      }
+
+      flush_span(end);
+      flush_tile();
+    }
+  }
+
+  static bool circle_extent(float cx, float cy, float r, float y, float &x0, float &x1) {
+    float oy = y - cy;
+    if(r <= 0.0f || fabsf(oy) >= r) return false;
+    float w = sqrtf(r * r - oy * oy);
+    x0 = cx - w;
+    x1 = cx + w;
+    return true;
+  }
+
+  static void stroke_segment(PicoGraphics *graphics, Point p1, Point p2, uint thickness, bool antialias) {
+    int32_t t = (int32_t)thickness;
+    int32_t ht = t / 2;
+
+    // odd thicknesses are centred on the pixel, even ones on its top left
+    // corner, which keeps the stroke symmetrical about the line
+    float o = (t & 1) ? 0.5f : 0.0f;
+    float ax = p1.x + o, ay = p1.y + o;
+    float dx = float(p2.x - p1.x), dy = float(p2.y - p1.y);
+    float len2 = dx * dx + dy * dy;
+    float len = sqrtf(len2);
+    float inv_len2 = len2 > 0.0f ? 1.0f / len2 : 0.0f;
+    float inv_dx = dx != 0.0f ? 1.0f / dx : 0.0f;
+    float inv_dy = dy != 0.0f ? 1.0f / dy : 0.0f;
+    float r = t / 2.0f;
+
+    Rect area(
+      Point(std::min(p1.x, p2.x) - ht - 1, std::min(p1.y, p2.y) - ht - 1),
+      Point(std::max(p1.x, p2.x) + ht + 2, std::max(p1.y, p2.y) + ht + 2));
+
+    auto extent = [=](float y, float reach, float &x0, float &x1) {
+      float rr = r + reach;
+      if(rr <= 0.0f) return false;
+
+      // a row crosses the capsule in a single interval, the union of where it
+      // crosses the two end caps and the body between them
+      float py = y - ay;
+      x0 = INFINITY; x1 = -INFINITY;
+
+      float cy = py;
+      if(fabsf(cy) < rr) {
+        float w = sqrtf(rr * rr - cy * cy);
+        x0 = std::min(x0, ax - w); x1 = std::max(x1, ax + w);
+      }
+      cy = py - dy;
+      if(fabsf(cy) < rr) {
+        float w = sqrtf(rr * rr - cy * cy);
+        x0 = std::min(x0, ax + dx - w); x1 = std::max(x1, ax + dx + w);
+      }
+
+      if(len2 == 0.0f) return x0 < x1;
+
+      // the body is bounded by its sides (|perpendicular| < rr) and ends
+      // (0 <= projection <= 1), both of which are linear in x
+      float bx0 = -INFINITY, bx1 = INFINITY;
+      if(dy != 0.0f) {
+        float e0 = ax + (py * dx - rr * len) * inv_dy;
+        float e1 = ax + (py * dx + rr * len) * inv_dy;
+        bx0 = std::max(bx0, std::min(e0, e1)); bx1 = std::min(bx1, std::max(e0, e1));
+      } else if(fabsf(py) >= rr) {
+        return x0 < x1;
+      }
+      if(dx != 0.0f) {
+        float e0 = ax - py * dy * inv_dx;
+        float e1 = ax + (len2 - py * dy) * inv_dx;
+        bx0 = std::max(bx0, std::min(e0, e1)); bx1 = std::min(bx1, std::max(e0, e1));
+      } else if(py * dy < 0.0f || py * dy > len2) {
+        return x0 < x1;
+      }
+      if(bx0 < bx1) {
+        x0 = std::min(x0, bx0); x1 = std::max(x1, bx1);
+      }
+
+      return x0 < x1;
+    };
+
+    fill_coverage(graphics, area, antialias, true, extent, [=](float x, float y) {
+      // distance to the nearest point on the segment
+      float px = x - ax, py = y - ay;
+      float h = std::min(std::max((px * dx + py * dy) * inv_len2, 0.0f), 1.0f);
+      px -= dx * h;
+      py -= dy * h;
+      return sqrtf(px * px + py * py) - r;
+    });
+  }
+
   int32_t orient2d(Point p1, Point p2, Point p3) {
     return (p2.x - p1.x) * (p3.y - p1.y) - (p2.y - p1.y) * (p3.x - p1.x);
   }
@@ -244,18 +624,24 @@ namespace pimoroni {
       int32_t w1 = w1row;
       int32_t w2 = w2row;
 
-      Point dest = Point(triangle_bounds.x, triangle_bounds.y + y);
+      // a triangle covers a single run of each row, written as one span
+      // once its end is found
+      int32_t start = -1, end = triangle_bounds.w;
       for (int32_t x = 0; x < triangle_bounds.w; x++) {
         if ((w0 | w1 | w2) >= 0) {
-          set_pixel(dest);
+          if (start < 0) start = x;
+        } else if (start >= 0) {
+          end = x;
+          break;
         }
 
-        dest.x++;
-
         w0 += a12;
         w1 += a20;
         w2 += a01;
       }
+      if (start >= 0) {
+        set_pixel_span(Point(triangle_bounds.x + start, triangle_bounds.y + y), end - start);
+      }
 
       w0row += b12;
       w1row += b20;
@@ -264,15 +650,23 @@ namespace pimoroni {
   }
 
   void PicoGraphics::polygon(const std::vector<Point> &points) {
-    static int32_t nodes[64]; // maximum allowed number of nodes per scanline for polygon rendering
+    int32_t nodes[64]; // maximum allowed number of nodes per scanline for polygon rendering
 
+    int32_t minx = points[0].x, maxx = points[0].x;
     int32_t miny = points[0].y, maxy = points[0].y;
 
     for (uint16_t i = 1; i < points.size(); i++) {
+      minx = std::min(minx, points[i].x);
+      maxx = std::max(maxx, points[i].x);
       miny = std::min(miny, points[i].y);
       maxy = std::max(maxy, points[i].y);
     }
 
+    // spans only need clipping when the polygon crosses the clip edge
+    Rect area(Point(minx, miny), Point(maxx + 1, maxy + 1));
+    if (!area.intersects(clip)) return;
+    bool inside = clip.contains(area);
+
     // for each scanline within the polygon bounds (clipped to clip rect)
     Point p;
 
@@ -283,7 +677,7 @@ namespace pimoroni {
         int32_t sy = points[i].y;
         int32_t ey = points[j].y;
         int32_t fy = p.y;
-        if ((sy < fy && ey >= fy) || (ey < fy && sy >= fy)) {
+        if (n < 64 && ((sy < fy && ey >= fy) || (ey < fy && sy >= fy))) {
           int32_t sx = points[i].x;
           int32_t ex = points[j].x;
           int32_t px = int32_t(sx + float(fy - sy) / float(ey - sy) * float(ex - sx));
@@ -304,12 +698,22 @@ namespace pimoroni {
       }
 
       for (uint16_t i = 0; i < n; i += 2) {
-        pixel_span(Point(nodes[i], p.y), nodes[i + 1] - nodes[i] + 1);
+        if (inside) {
+          set_pixel_span(Point(nodes[i], p.y), nodes[i + 1] - nodes[i] + 1);
+        } else {
+          pixel_span(Point(nodes[i], p.y), nodes[i + 1] - nodes[i] + 1);
+        }
       }
     }
   }
 
   void PicoGraphics::thick_line(Point p1, Point p2, uint thickness) {
+    // one pixel wide lines do not need the capsule rasteriser
+    if(thickness == 1) {
+      line(p1, p2);
+      return;
+    }
+
     int32_t ht = thickness / 2;
     int32_t t = (int32_t)thickness;
 
@@ -329,36 +733,93 @@ namespace pimoroni {
       return;
     }
 
-    // general purpose line
-    // lines are either "shallow" or "steep" based on whether the x delta
-    // is greater than the y delta
-    int32_t dx = p2.x - p1.x;
-    int32_t dy = p2.y - p1.y;
-    bool shallow = std::abs(dx) > std::abs(dy);
-    if(shallow) {
-      // shallow version
-      int32_t s = std::abs(dx);       // number of steps
-      int32_t sx = dx < 0 ? -1 : 1;   // x step value
-      int32_t sy = (dy << 16) / s;    // y step value in fixed 16:16
-      int32_t x = p1.x;
-      int32_t y = p1.y << 16;
-      while(s--) {
-        rectangle({x - ht, (y >> 16) - ht, t, t});
-        y += sy;
-        x += sx;
+    // general purpose line, rasterised as a capsule (a rectangle with round
+    // caps) so every covered pixel is written exactly once
+    stroke_segment(this, p1, p2, thickness, false);
+  }
+
+  void PicoGraphics::aa_line(Point p1, Point p2, uint thickness) {
+    stroke_segment(this, p1, p2, thickness, true);
+  }
+
+  void PicoGraphics::aa_circle(const Point &p, int32_t r) {
+    // match the extent of the aliased circle, which covers 2r + 1 pixels
+    float cx = p.x + 0.5f;
+    float cy = p.y + 0.5f;
+    float radius = r + 0.5f;
+
+    Rect area(p.x - r - 1, p.y - r - 1, r * 2 + 3, r * 2 + 3);
+    fill_coverage(this, area, true, true, [=](float y, float reach, float &x0, float &x1) {
+      return circle_extent(cx, cy, radius + reach, y, x0, x1);
+    }, [=](float x, float y) {
+      return sqrtf((x - cx) * (x - cx) + (y - cy) * (y - cy)) - radius;
+    });
+  }
+
+  void PicoGraphics::aa_arc(const Point &p, int32_t r, float from, float to, uint thickness) {
+    // angles are in degrees, clockwise from 3 o'clock
+    float cx = p.x + 0.5f;
+    float cy = p.y + 0.5f;
+    float radius = (float)r;
+    float ht = thickness / 2.0f;
+
+    float sweep = fmodf(to - from, 360.0f);
+    if(sweep <= 0.0f) sweep += 360.0f;
+    bool full = (to - from) >= 360.0f;
+
+    float ax = cosf(from * (float)M_PI / 180.0f), ay = sinf(from * (float)M_PI / 180.0f);
+    float bx = cosf(to * (float)M_PI / 180.0f),   by = sinf(to * (float)M_PI / 180.0f);
+
+    int32_t reach = r + thickness / 2 + 2;
+    Rect area(p.x - reach, p.y - reach, reach * 2 + 1, reach * 2 + 1);
+    fill_coverage(this, area, true, false, [=](float y, float reach, float &x0, float &x1) {
+      return circle_extent(cx, cy, radius + ht + reach, y, x0, x1);
+    }, [=](float x, float y) {
+      float qx = x - cx;
+      float qy = y - cy;
+
+      // the sector is tested with cross products rather than atan2, for sweeps
+      // over 180 degrees test against the (convex) sector that is left out
+      bool inside;
+      if(full) {
+        inside = true;
+      } else if(sweep <= 180.0f) {
+        inside = (ax * qy - ay * qx) >= 0.0f && (qx * by - qy * bx) >= 0.0f;
+      } else {
+        inside = !((bx * qy - by * qx) > 0.0f && (qx * ay - qy * ax) > 0.0f);
       }
-    }else{
-      // steep version
-      int32_t s = std::abs(dy);       // number of steps
-      int32_t sy = dy < 0 ? -1 : 1;   // y step value
-      int32_t sx = (dx << 16) / s;    // x step value in fixed 16:16
-      int32_t y = p1.y;
-      int32_t x = p1.x << 16;
-      while(s--) {
-        rectangle({(x >> 16) - ht, y - ht, t, t});
-        y += sy;
-        x += sx;
+
+      if(inside) {
+        return fabsf(sqrtf(qx * qx + qy * qy) - radius) - ht;
       }
+
+      // beyond the ends of the arc the nearest point is one of the end caps
+      float dax = qx - ax * radius, day = qy - ay * radius;
+      float dbx = qx - bx * radius, dby = qy - by * radius;
+      return sqrtf(std::min(dax * dax + day * day, dbx * dbx + dby * dby)) - ht;
+    });
+  }
+
+  // division rounding down and up, d must be positive
+  static int64_t floor_div(int64_t n, int64_t d) {
+    return n >= 0 ? n / d : -((-n + d - 1) / d);
+  }
+
+  static int64_t ceil_div(int64_t n, int64_t d) {
+    return -floor_div(-n, d);
+  }
+
+  // narrow the steps [k0, k1) of v + k * step to those where it falls in
+  // [lo, hi), it only ever moves one way so they are a single range
+  static void clip_steps(int64_t v, int64_t step, int64_t lo, int64_t hi, int64_t &k0, int64_t &k1) {
+    if(step > 0) {
+      k0 = std::max(k0, ceil_div(lo - v, step));
+      k1 = std::min(k1, ceil_div(hi - v, step));
+    } else if(step < 0) {
+      k0 = std::max(k0, floor_div(v - hi, -step) + 1);
+      k1 = std::min(k1, floor_div(v - lo, -step) + 1);
+    } else if(v < lo || v >= hi) {
+      k1 = k0;
     }
   }
 
@@ -373,109 +834,323 @@ namespace pimoroni {
 
     // fast vertical line
     if(p1.x == p2.x) {
-      int32_t start  = std::min(p1.y, p2.y);
-      int32_t length = std::max(p1.y, p2.y) - start;
-      Point dest(p1.x, start);
-      while(length--) {
-        pixel(dest);
-        dest.y++;
-      }
+      int32_t start = std::min(p1.y, p2.y);
+      int32_t end   = std::max(p1.y, p2.y);
+      pixel_column(Point(p1.x, start), end - start);
       return;
     }
 
-
     // general purpose line
     // lines are either "shallow" or "steep" based on whether the x delta
-    // is greater than the y delta
+    // is greater than the y delta. either way the line takes one pixel steps
+    // along its major axis from p1 (stopping short of p2) while the minor
+    // axis moves in fixed 16:16, both handled here as (a, b)
     int32_t dx = p2.x - p1.x;
     int32_t dy = p2.y - p1.y;
     bool shallow = std::abs(dx) > std::abs(dy);
-    if(shallow) {
-      // shallow version
-      int32_t s = std::abs(dx);       // number of steps
-      int32_t sx = dx < 0 ? -1 : 1;   // x step value
-      int32_t sy = (dy << 16) / s;    // y step value in fixed 16:16
-      int32_t x = p1.x;
-      int32_t y = p1.y << 16;
-      while(s--) {
-        Point p(x, y >> 16);
-        pixel(p);
-        y += sy;
-        x += sx;
+
+    int32_t a = shallow ? p1.x : p1.y;
+    int32_t da = shallow ? dx : dy;
+    int32_t db = shallow ? dy : dx;
+    int32_t s = std::abs(da);                     // number of steps
+    int32_t sa = da < 0 ? -1 : 1;                 // major step value
+    int32_t b = shallow ? p1.y : p1.x;
+    // minor step value in fixed 16:16, only very long lines need 64 bits
+    int32_t sb = std::abs(db) < 0x8000 ? db * 65536 / s : int32_t(int64_t(db) * 65536 / s);
+
+    int32_t pos, n;
+    if(clip.contains(p1) && clip.contains(p2)) {
+      pos = b * 65536;
+      n = s;
+    } else {
+      // clip the steps once, rather than every pixel, to those inside on
+      // both axes. this is exact so the pixels drawn are the same as if
+      // each one was checked
+      Rect c = shallow ? clip : Rect(clip.y, clip.x, clip.h, clip.w);
+      int64_t k0 = 0, k1 = s;
+      clip_steps(a, sa, c.x, c.x + c.w, k0, k1);
+      clip_steps(int64_t(b) * 65536, sb, int64_t(c.y) * 65536, int64_t(c.y + c.h) * 65536, k0, k1);
+      if(k0 >= k1) return;
+
+      // inside the clip the minor position is small and positive again
+      a += k0 * sa;
+      pos = int32_t(int64_t(b) * 65536 + k0 * sb);
+      n = k1 - k0;
+    }
+
+    // lines too close to diagonal for pixels to share a row or column are
+    // written a pixel at a time
+    if(std::abs(db) * 2 > s) {
+      if(shallow) {
+        for(Point dest(a, 0); n--; dest.x += sa, pos += sb) {
+          dest.y = pos >> 16;
+          set_pixel(dest);
+        }
+      } else {
+        for(Point dest(0, a); n--; dest.y += sa, pos += sb) {
+          dest.x = pos >> 16;
+          set_pixel(dest);
+        }
       }
-    }else{
-      // steep version
-      int32_t s = std::abs(dy);       // number of steps
-      int32_t sy = dy < 0 ? -1 : 1;   // y step value
-      int32_t sx = (dx << 16) / s;    // x step value in fixed 16:16
-      int32_t y = p1.y;
-      int32_t x = p1.x << 16;
-      while(s--) {
-        Point p(x >> 16, y);
-        pixel(p);
-        y += sy;
-        x += sx;
+      return;
+    }
+
+    // otherwise each run of pixels is written as a span, or as a column for
+    // steep lines
+    while(n) {
+      int32_t minor = pos >> 16;
+      int32_t run = 0;
+      do {
+        run++;
+        pos += sb;
+      } while(run < n && (pos >> 16) == minor);
+
+      int32_t start = sa > 0 ? a : a - run + 1;
+      if(shallow) {
+        set_pixel_span(Point(start, minor), run);
+      } else {
+        set_pixel_column(Point(minor, start), run);
       }
+      a += run * sa;
+      n -= run;
     }
   }
 
-  // Common function for frame buffer conversion to 565 pixel format
-  void PicoGraphics::frame_convert_rgb565(conversion_callback_func callback, next_pixel_func get_next_pixel)
-  {
-    // Allocate two temporary buffers, as the callback may transfer by DMA
-    // while we're preparing the next part of the row
-    const int BUF_LEN = 64;
-    uint16_t row_buf[2][BUF_LEN];
-    int buf_idx = 0;
-    int buf_entry = 0;
-    for(auto i = 0; i < bounds.w * bounds.h; i++) {
-      row_buf[buf_idx][buf_entry] = get_next_pixel();
-      buf_entry++;
-
-      // Transfer a filled buffer and swap to the next one
-      if (buf_entry == BUF_LEN) {
-          callback(row_buf[buf_idx], BUF_LEN * sizeof(RGB565));
-          buf_idx ^= 1;
-          buf_entry = 0;
+  // copy between surfaces of the same type without converting pixels, nearest
+  // neighbour scaled and optionally skipping pixels for which keyed is true
+  template<typename T, typename Keyed>
+  static void blit_copy(const T *src, int32_t src_w, const Rect &area, T *dst, int32_t dst_w,
+                        const Rect &src_rect, const Rect &dst_rect, const Rect &visible,
+                        int32_t step_x, int32_t step_y, bool use_key, Keyed keyed) {
+    int32_t fx0 = int32_t(int64_t(visible.x - dst_rect.x) * step_x + step_x / 2);
+    int32_t first = src_rect.x + (fx0 >> 16);
+    int32_t last = src_rect.x + int32_t((int64_t(visible.x + visible.w - 1 - dst_rect.x) * step_x + step_x / 2) >> 16);
+
+    // unscaled rows that lie entirely within the source are copied whole
+    bool whole = step_x == 0x10000 && !use_key && first >= area.x && last < area.x + area.w;
+
+    for(auto y = visible.y; y < visible.y + visible.h; y++) {
+      int32_t sy = src_rect.y + int32_t((int64_t(y - dst_rect.y) * step_y + step_y / 2) >> 16);
+      sy = std::min(std::max(sy, area.y), area.y + area.h - 1);
+      const T *s = &src[sy * src_w];
+      T *d = &dst[y * dst_w + visible.x];
+
+      if(whole) {
+        memmove(d, s + first, visible.w * sizeof(T));
+        continue;
       }
-    }
 
-    // Transfer any remaining pixels ( < BUF_LEN )
-    if(buf_entry > 0) {
-        callback(row_buf[buf_idx], buf_entry * sizeof(RGB565));
+      int32_t fx = fx0;
+      for(auto x = 0; x < visible.w; x++) {
+        int32_t sx = std::min(std::max(src_rect.x + (fx >> 16), area.x), area.x + area.w - 1);
+        T v = s[sx];
+        if(!use_key || !keyed(v)) d[x] = v;
+        fx += step_x;
+      }
     }
-
-    // Callback with zero length to ensure previous buffer is fully written
-    callback(row_buf[buf_idx], 0);
   }
 
-  // Common function for frame buffer conversion to 565 pixel format
-  void PicoGraphics::frame_convert_rgb888(conversion_callback_func callback, next_pixel_func_rgb888 get_next_pixel)
-  {
-    // Allocate two temporary buffers, as the callback may transfer by DMA
-    // while we're preparing the next part of the row
-    const int BUF_LEN = 64;
-    RGB888 row_buf[2][BUF_LEN];
-    int buf_idx = 0;
-    int buf_entry = 0;
-    for(auto i = 0; i < bounds.w * bounds.h; i++) {
-      row_buf[buf_idx][buf_entry] = get_next_pixel();
-      buf_entry++;
-
-      // Transfer a filled buffer and swap to the next one
-      if (buf_entry == BUF_LEN) {
-          callback(row_buf[buf_idx], BUF_LEN * sizeof(RGB888));
-          buf_idx ^= 1;
-          buf_entry = 0;
+  void PicoGraphics::blit(PicoGraphics *src, const Rect &src_rect, const Rect &dst_rect, uint flags, const RGB &key) {
+    Rect area = src_rect.intersection(src->bounds);
+    Rect visible = dst_rect.intersection(clip);
+    if(area.empty() || visible.empty()) return;
+
+    // source distance covered by each destination pixel in 16.16 fixed point
+    int32_t step_x = (int64_t(src_rect.w) << 16) / dst_rect.w;
+    int32_t step_y = (int64_t(src_rect.h) << 16) / dst_rect.h;
+
+    // unscaled bilinear samples land on pixel centres, so it's just a copy
+    bool bilinear = (flags & BLIT_BILINEAR) && (step_x != 0x10000 || step_y != 0x10000);
+    bool alpha = (flags & BLIT_ALPHA) && src->pen_type == PEN_RGB888;
+    bool use_key = flags & BLIT_COLOUR_KEY;
+
+    // the key is compared with source colours, as the generic path below
+    // does, so a key the format can't represent matches nothing
+    auto same = [](const RGB &a, const RGB &b) { return a.r == b.r && a.g == b.g && a.b == b.b; };
+
+    if(src->pen_type == pen_type && !bilinear && !alpha) {
+      RGB c = key;
+      switch(pen_type) {
+        case PEN_P8: {
+          // indices only mean the same thing if the palettes match
+          RGB *src_palette = src->get_palette();
+          RGB *dst_palette = get_palette();
+          int size = get_palette_size();
+          bool match = src->get_palette_size() == size;
+          for(auto i = 0; i < size && match && src_palette != dst_palette; i++) {
+            match = same(src_palette[i], dst_palette[i]);
+          }
+          if(!match) break;
+
+          // every index whose colour is the key is skipped
+          bool keyed[256] = {};
+          bool any = false;
+          for(auto i = 0; i < size && i < 256; i++) {
+            keyed[i] = same(src_palette[i], key);
+            any |= keyed[i];
+          }
+          touch(visible);
+          blit_copy<uint8_t>((uint8_t *)src->frame_buffer + src->layer_offset, src->bounds.w, area,
+                             (uint8_t *)frame_buffer + layer_offset, bounds.w, src_rect, dst_rect, visible,
+                             step_x, step_y, use_key && any, [&](uint8_t v) { return keyed[v]; });
+          return;
+        }
+        case PEN_RGB332: {
+          RGB332 k = c.to_rgb332();
+          touch(visible);
+          blit_copy<uint8_t>((uint8_t *)src->frame_buffer + src->layer_offset, src->bounds.w, area,
+                             (uint8_t *)frame_buffer + layer_offset, bounds.w, src_rect, dst_rect, visible,
+                             step_x, step_y, use_key && same(RGB(k), key), [k](uint8_t v) { return v == k; });
+          return;
+        }
+        case PEN_RGB565: {
+          RGB565 k = c.to_rgb565();
+          touch(visible);
+          blit_copy<uint16_t>((uint16_t *)src->frame_buffer + src->layer_offset, src->bounds.w, area,
+                              (uint16_t *)frame_buffer + layer_offset, bounds.w, src_rect, dst_rect, visible,
+                              step_x, step_y, use_key && same(RGB(k), key), [k](uint16_t v) { return v == k; });
+          return;
+        }
+        case PEN_RGB888: {
+          RGB888 k = c.to_rgb888();
+          touch(visible);
+          blit_copy<uint32_t>((uint32_t *)src->frame_buffer + src->layer_offset, src->bounds.w, area,
+                              (uint32_t *)frame_buffer + layer_offset, bounds.w, src_rect, dst_rect, visible,
+                              step_x, step_y, use_key, [k](uint32_t v) { return (v & 0xffffff) == k; });
+          return;
+        }
+        default:
+          break;
       }
     }
 
-    // Transfer any remaining pixels ( < BUF_LEN )
-    if(buf_entry > 0) {
-        callback(row_buf[buf_idx], buf_entry * sizeof(RGB888));
+    // everything else is read back as RGB a source row at a time, with up to
+    // two rows held for bilinear filtering. the rows are kept for the next
+    // blit, so drawing sprites doesn't go to the heap each time
+    if(blit_row_size < uint(area.w)) {
+      delete[] blit_rows;
+      delete[] blit_alphas;
+      blit_rows = new RGB[area.w * 2];
+      blit_alphas = new uint8_t[area.w * 2];
+      blit_row_size = area.w;
+    }
+    RGB *rows[2] = {blit_rows, blit_rows + area.w};
+    uint8_t *alphas[2] = {blit_alphas, blit_alphas + area.w};
+    int32_t cached[2] = {-1, -1};
+
+    auto load = [&](int slot, int32_t sy) {
+      if(cached[slot] == sy) return;
+      src->get_pixel_span(Point(area.x, sy), area.w, rows[slot]);
+      if(alpha) {
+        // RGB888 sources carry their alpha in the top byte
+        const uint32_t *p = (const uint32_t *)src->frame_buffer + src->layer_offset + sy * src->bounds.w + area.x;
+        for(auto i = 0; i < area.w; i++) alphas[slot][i] = p[i] >> 24;
+      }
+      cached[slot] = sy;
+    };
+
+    auto opacity = [&](int slot, int32_t i) -> uint32_t {
+      const RGB &c = rows[slot][i];
+      if(use_key && c.r == key.r && c.g == key.g && c.b == key.b) return 0;
+      return alpha ? alphas[slot][i] : 255;
+    };
+
+    bool blend = supports_alpha_blend();
+
+    // runs are drawn by setting the pen, the caller's is put back at the end
+    SavedPen pen = save_pen();
+
+    for(auto y = visible.y; y < visible.y + visible.h; y++) {
+      int32_t wy = 0;
+      if(bilinear) {
+        int32_t fy = int32_t(int64_t(y - dst_rect.y) * step_y + step_y / 2) - 0x8000;
+        int32_t y0 = std::min(std::max(src_rect.y + (fy >> 16), area.y), area.y + area.h - 1);
+        int32_t y1 = std::min(std::max(src_rect.y + (fy >> 16) + 1, area.y), area.y + area.h - 1);
+        wy = (fy >> 8) & 0xff;
+        if(cached[1] == y0) {
+          std::swap(rows[0], rows[1]);
+          std::swap(alphas[0], alphas[1]);
+          std::swap(cached[0], cached[1]);
+        }
+        load(0, y0);
+        load(1, y1);
+      } else {
+        int32_t sy = src_rect.y + int32_t((int64_t(y - dst_rect.y) * step_y + step_y / 2) >> 16);
+        load(0, std::min(std::max(sy, area.y), area.y + area.h - 1));
+      }
+
+      // opaque pixels are gathered into runs of the same colour
+      int32_t run_x = 0, run = 0;
+      RGB run_c;
+      auto flush = [&]() {
+        if(run == 0) return;
+        set_pen(run_c.r, run_c.g, run_c.b);
+        set_pixel_span(Point(run_x, y), run);
+        run = 0;
+      };
+
+      int32_t fx = int32_t(int64_t(visible.x - dst_rect.x) * step_x + step_x / 2);
+      for(auto x = visible.x; x < visible.x + visible.w; x++, fx += step_x) {
+        RGB c;
+        uint32_t a;
+
+        if(bilinear) {
+          int32_t bx = fx - 0x8000;
+          int32_t i0 = std::min(std::max(src_rect.x + (bx >> 16), area.x), area.x + area.w - 1) - area.x;
+          int32_t i1 = std::min(std::max(src_rect.x + (bx >> 16) + 1, area.x), area.x + area.w - 1) - area.x;
+          uint32_t wx = (bx >> 8) & 0xff;
+
+          const RGB *s[4] = {&rows[0][i0], &rows[0][i1], &rows[1][i0], &rows[1][i1]};
+          uint32_t w[4] = {(256 - wx) * (256 - wy), wx * (256 - wy), (256 - wx) * wy, wx * wy};
+          uint32_t o[4] = {opacity(0, i0), opacity(0, i1), opacity(1, i0), opacity(1, i1)};
+
+          if((o[0] & o[1] & o[2] & o[3]) == 255) {
+            uint32_t r = 0, g = 0, b = 0;
+            for(auto i = 0; i < 4; i++) {
+              r += w[i] * s[i]->r;
+              g += w[i] * s[i]->g;
+              b += w[i] * s[i]->b;
+            }
+            c = RGB(r >> 16, g >> 16, b >> 16);
+            a = 255;
+          } else {
+            // weight each sample by its opacity so transparent colours don't bleed
+            uint32_t total = 0, r = 0, g = 0, b = 0;
+            for(auto i = 0; i < 4; i++) {
+              uint32_t wo = w[i] * o[i];
+              total += wo;
+              r += wo * s[i]->r;
+              g += wo * s[i]->g;
+              b += wo * s[i]->b;
+            }
+            if(total == 0) continue;
+            c = RGB(r / total, g / total, b / total);
+            a = total >> 16;
+          }
+        } else {
+          int32_t i = std::min(std::max(src_rect.x + (fx >> 16), area.x), area.x + area.w - 1) - area.x;
+          c = rows[0][i];
+          a = opacity(0, i);
+        }
+
+        if(a == 255 || (a >= 128 && !blend)) {
+          if(run && run_x + run == x && c.r == run_c.r && c.g == run_c.g && c.b == run_c.b) {
+            run++;
+          } else {
+            flush();
+            run_x = x;
+            run_c = c;
+            run = 1;
+          }
+        } else if(a > 0 && blend) {
+          flush();
+          set_pen(c.r, c.g, c.b);
+          set_pixel_alpha(Point(x, y), a);
+        }
+      }
+      flush();
     }
 
-    // Callback with zero length to ensure previous buffer is fully written
-    callback(row_buf[buf_idx], 0);
+    restore_pen(pen);
   }
 }
@@ -3,6 +3,7 @@
 #include <string>
 #include <string_view>
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <algorithm>
 #include <vector>
@@ -211,6 +212,112 @@ namespace pimoroni {
 
   extern const uint8_t dither16_pattern[16];
 
+  // Ordered dither lookup for the palette pens.
+  //
+  // Maps a colour, quantised to 3 bits per channel, to the 16 palette entries
+  // that best approximate it when mixed in the 4x4 dither pattern. Tables are
+  // shared between every pen with an identical palette (found by a hash of the
+  // palette, then compared with a copy of it) and each entry is only searched
+  // the first time it's hit. Pens on either core may share a table, so the
+  // list of tables is only changed under a lock and entries are published
+  // atomically once built.
+  class PaletteDither {
+    public:
+      // when `expand` is set the quantised channels are stretched back to the
+      // full 0-255 range before searching the palette
+      PaletteDither(bool expand = false) : expand(expand) {}
+      PaletteDither(const PaletteDither &) = delete;
+      PaletteDither &operator=(const PaletteDither &) = delete;
+      ~PaletteDither() { invalidate(); }
+
+      bool ready() const { return table != nullptr; }
+      void set_palette(const RGB *palette, size_t len);
+      void invalidate();
+
+      uint8_t get(const Point &p, const RGB &c) {
+        return candidates(key(c))[dither16_pattern[(p.x & 0b11) | ((p.y & 0b11) << 2)]];
+      }
+
+      // dither a row of colours starting at `p` into palette indices
+      void dither_span(const Point &p, uint l, const RGB *src, uint8_t *dst);
+
+    private:
+      struct Table {
+        uint32_t hash;
+        bool expand;
+        uint refs;
+        Table *next;
+        // the palette the candidates are picked from
+        RGB *palette;
+        size_t len;
+        std::atomic<uint32_t> built[512 / 32];
+        uint8_t candidates[512][16];
+      };
+      static Table *tables;
+
+      Table *table = nullptr;
+      bool expand;
+
+      static uint key(const RGB &c) {
+        return ((c.r & 0xE0) << 1) | ((c.g & 0xE0) >> 2) | ((c.b & 0xE0) >> 5);
+      }
+      const uint8_t *candidates(uint key) {
+        if(!(table->built[key >> 5].load(std::memory_order_acquire) & (1u << (key & 31)))) build(key);
+        return table->candidates[key];
+      }
+      void build(uint key);
+  };
+
+  // where pens get a frame buffer from when the caller doesn't supply one,
+  // see PicoGraphics::allocator
+  class FrameBufferAllocator {
+    public:
+      virtual void *allocate(size_t size, size_t alignment) = 0;
+      virtual void release(void *buffer) = 0;
+  };
+
+  // a block of memory to place frame buffers in, a bank of SRAM or the
+  // PSRAM window for example
+  struct MemoryRegion {
+    void *base;
+    size_t size;
+  };
+
+  // hands out frame buffers from a memory region. released buffers go back
+  // into the pool, so a display set up again with another size or pen reuses
+  // the same memory. requests that don't fit are passed on to `fallback`,
+  // so an SRAM arena can overflow into PSRAM
+  class FrameBufferArena : public FrameBufferAllocator {
+    public:
+      static const uint MAX_BLOCKS = 16;
+
+      FrameBufferArena(const MemoryRegion &region, FrameBufferAllocator *fallback = nullptr);
+
+      void *allocate(size_t size, size_t alignment) override;
+      void release(void *buffer) override;
+
+      size_t free_space() const;
+      size_t largest_free() const;
+
+    private:
+      // the region is kept as a list of blocks in address order, `data` is
+      // where the buffer starts once aligned
+      struct Block {
+        size_t offset;
+        size_t size;
+        size_t data;
+        bool used;
+      };
+
+      MemoryRegion region;
+      FrameBufferAllocator *fallback;
+      Block blocks[MAX_BLOCKS];
+      uint count = 1;
+
+      void insert(uint i, const Block &b);
+      void remove(uint i);
+  };
+
   class PicoGraphics {
   public:
     enum PenType {
@@ -228,6 +335,12 @@ namespace pimoroni {
       PEN_DV_RGB888,
     };
 
+    enum BlitFlags {
+      BLIT_BILINEAR   = 1 << 0,
+      BLIT_COLOUR_KEY = 1 << 1,
+      BLIT_ALPHA      = 1 << 2,
+    };
+
     void *frame_buffer;
 
     PenType pen_type;
@@ -235,13 +348,46 @@ namespace pimoroni {
     Rect clip;
     uint thickness = 1;
 
+    // clips saved by push_clip, for nested widgets to restrict their
+    // children to their own area
+    static const uint MAX_CLIP_DEPTH = 8;
+    Rect clip_stack[MAX_CLIP_DEPTH];
+    uint clip_depth = 0;
+
     uint layers = 1;
     uint layer = 0;
     uint layer_offset = 0;
 
+    // how a layer is combined with those below it by frame_convert, the
+    // first layer is the background and always opaque
+    struct LayerSettings {
+      bool visible = true;
+      uint8_t opacity = 255;
+      // pixels of this value let the layers below show through
+      bool colour_key = true;
+      uint key = 0;
+      // the part of the layer drawn on since it was last cleared, nothing
+      // outside it is read when compositing
+      Rect dirty = Rect(0, 0, 0, 0);
+    };
+    LayerSettings *layer_settings = nullptr;
+
     typedef std::function<void(void *data, size_t length)> conversion_callback_func;
-    typedef std::function<RGB565()> next_pixel_func;
-    typedef std::function<RGB888()> next_pixel_func_rgb888;
+    typedef void (*frame_convert_func)(void *context, void *data, size_t length);
+
+    // Caller owned buffers for frame_convert.
+    //
+    // The frame is converted into each buffer in turn and handed to callback,
+    // so one can be sent (by DMA for example) while the next is filled. When
+    // callback returns it must be finished with the buffer it was given count
+    // calls earlier. A final zero length call marks the end of the frame.
+    struct ConvertBuffers {
+      void *const *buffers;
+      uint count;
+      size_t length;
+      frame_convert_func callback;
+      void *context;
+    };
     //typedef std::function<void(int y)> scanline_interrupt_func;
 
     //scanline_interrupt_func scanline_interrupt = nullptr;
@@ -283,6 +429,13 @@ namespace pimoroni {
       return RGB((RGB565)c);
     };
 
+    // when set, pens place the frame buffers they allocate here rather than
+    // on the heap
+    static FrameBufferAllocator *allocator;
+
+    // frame buffers are aligned for word access and dma
+    static const size_t FRAME_BUFFER_ALIGNMENT = 4;
+
     PicoGraphics(uint16_t width, uint16_t height, void *frame_buffer)
     : frame_buffer(frame_buffer), bounds(0, 0, width, height), clip(0, 0, width, height) {
       set_font(&font6);
@@ -292,17 +445,39 @@ namespace pimoroni {
     PicoGraphics(uint16_t width, uint16_t height, uint16_t layers, void *frame_buffer)
     : frame_buffer(frame_buffer), bounds(0, 0, width, height), clip(0, 0, width, height), layers(layers) {
       set_font(&font6);
+      init_layers();
     };
 
+    PicoGraphics(const PicoGraphics &) = delete;
+    PicoGraphics &operator=(const PicoGraphics &) = delete;
+    virtual ~PicoGraphics();
+
     virtual void set_pen(uint c) = 0;
     virtual void set_pen(uint8_t r, uint8_t g, uint8_t b) = 0;
+    // the pen as set_pen left it, so blit can draw in the source's colours
+    // and give the caller their pen back afterwards
+    struct SavedPen {
+      uint color;
+      RGB src_color;
+    };
+    virtual SavedPen save_pen() const { return {0, RGB()}; }
+    virtual void restore_pen(const SavedPen &pen) {}
     virtual void set_pixel(const Point &p) = 0;
     virtual void set_pixel_span(const Point &p, uint l) = 0;
+    // a run of l pixels down from p, pens that can step through their
+    // framebuffer a row at a time do better than a set_pixel per pixel
+    virtual void set_pixel_column(const Point &p, uint l);
     void set_thickness(uint t);
 
     void set_layer(uint l);
     uint get_layer();
 
+    void set_layer_visible(uint l, bool visible);
+    void set_layer_opacity(uint l, uint8_t opacity);
+    void set_layer_colour_key(uint l, bool enabled, uint key = 0);
+    // fill a layer with its colour key, leaving nothing to composite
+    void clear_layer(uint l);
+
     virtual int get_palette_size();
     virtual RGB* get_palette();
     virtual bool supports_alpha_blend();
@@ -314,8 +489,11 @@ namespace pimoroni {
     virtual void set_pixel_dither(const Point &p, const RGB &c);
     virtual void set_pixel_dither(const Point &p, const RGB565 &c);
     virtual void set_pixel_dither(const Point &p, const uint8_t &c);
+    virtual void set_pixel_dither_span(const Point &p, uint l, const RGB *c);
+    virtual void get_pixel_span(const Point &p, uint l, RGB *c);
     virtual void set_pixel_alpha(const Point &p, const uint8_t a);
-    virtual void frame_convert(PenType type, conversion_callback_func callback);
+    void frame_convert(PenType type, conversion_callback_func callback);
+    virtual void frame_convert(PenType type, const ConvertBuffers &target);
     virtual void sprite(void* data, const Point &sprite, const Point &dest, const int scale, const int transparent);
 
     virtual bool render_tile(const Tile *tile) { return false; }
@@ -334,10 +512,15 @@ namespace pimoroni {
 
     void set_clip(const Rect &r);
     void remove_clip();
+    // narrow the clip to its intersection with r until the matching
+    // pop_clip, false if the stack is full and nothing was pushed
+    bool push_clip(const Rect &r);
+    void pop_clip();
 
     void clear();
     void pixel(const Point &p);
     void pixel_span(const Point &p, int32_t l);
+    void pixel_column(const Point &p, int32_t l);
     void rectangle(const Rect &r);
     void circle(const Point &p, int32_t r);
     void character(const char c, const Point &p, float s = 2.0f, float a = 0.0f);
@@ -347,10 +530,118 @@ namespace pimoroni {
     void triangle(Point p1, Point p2, Point p3);
     void line(Point p1, Point p2);
     void thick_line(Point p1, Point p2, uint thickness);
+    void aa_line(Point p1, Point p2, uint thickness = 1);
+    void aa_circle(const Point &p, int32_t r);
+    void aa_arc(const Point &p, int32_t r, float from, float to, uint thickness = 1);
+    void blit(PicoGraphics *src, const Rect &src_rect, const Rect &dst_rect, uint flags = 0, const RGB &key = RGB());
 
   protected:
-    void frame_convert_rgb565(conversion_callback_func callback, next_pixel_func get_next_pixel);
-    void frame_convert_rgb888(conversion_callback_func callback, next_pixel_func_rgb888 get_next_pixel);
+    // allocate a frame buffer of `layer_size` bytes for each layer, the pen
+    // releases it again when destroyed
+    void *allocate_frame_buffer(size_t layer_size);
+
+    // the pens call these as they write, so the compositor knows which part
+    // of each layer above the first has been drawn on
+    void touch(const Point &p, uint l = 1) {
+      if(layer) touch(Rect(p.x, p.y, l, 1));
+    }
+    void touch_column(const Point &p, uint l) {
+      if(layer) touch(Rect(p.x, p.y, 1, l));
+    }
+    void touch(const Rect &r);
+
+    static RGB565 blend_pixel(RGB565 below, RGB565 above, uint8_t a) {
+      return RGB(below).blend(RGB(above), a).to_rgb565();
+    }
+    static RGB888 blend_pixel(RGB888 below, RGB888 above, uint8_t a) {
+      return RGB((uint)below).blend(RGB((uint)above), a).to_rgb888();
+    }
+
+    // combine the layers into `count` output pixels from pixel index
+    // `offset` in a single pass. base(dst, offset, count) converts a run of
+    // the first layer, fetch(layer, index) reads a raw value from any layer
+    // and convert(value) turns it into the output format. layers above the
+    // first are painted on top, but only read inside their dirty areas
+    template<typename D, typename B, typename F, typename C>
+    void composite(D *dst, uint offset, uint count, B base, F fetch, C convert) {
+      if(layers < 2 || !layer_settings) {
+        base(dst, offset, count);
+        return;
+      }
+
+      while(count) {
+        int32_t y = offset / bounds.w;
+        int32_t x0 = offset % bounds.w;
+        uint n = std::min(count, uint(bounds.w - x0));
+
+        if(layer_settings[0].visible) {
+          base(dst, offset, n);
+        } else {
+          std::fill(dst, dst + n, D(0));
+        }
+
+        for(auto l = 1u; l < layers; l++) {
+          const LayerSettings &s = layer_settings[l];
+          const Rect &d = s.dirty;
+          if(!s.visible || s.opacity == 0 || y < d.y || y >= d.y + d.h) continue;
+
+          int32_t from = std::max(x0, d.x);
+          int32_t to = std::min(x0 + int32_t(n), d.x + d.w);
+          uint i = y * bounds.w + from;
+          for(D *out = dst + (from - x0); from < to; from++, i++, out++) {
+            auto v = fetch(l, i);
+            if(s.colour_key && v == s.key) continue;
+            *out = s.opacity == 255 ? convert(v) : blend_pixel(*out, convert(v), s.opacity);
+          }
+        }
+
+        dst += n;
+        offset += n;
+        count -= n;
+      }
+    }
+
+    // run kernel(buffer, offset, count) over the frame, converting count pixels
+    // from pixel index offset into each buffer of target in turn
+    template<typename K>
+    void frame_convert_kernel(const ConvertBuffers &target, uint bits_per_pixel, K kernel) {
+      uint chunk = target.length * 8 / bits_per_pixel;
+      if(target.count == 0 || chunk == 0) return;
+
+      uint total = bounds.w * bounds.h;
+      uint index = 0;
+      for(uint offset = 0; offset < total; offset += chunk) {
+        uint count = std::min(chunk, total - offset);
+        kernel(target.buffers[index], offset, count);
+        target.callback(target.context, target.buffers[index], (count * bits_per_pixel + 7) / 8);
+        if(++index == target.count) index = 0;
+      }
+
+      target.callback(target.context, target.buffers[index], 0);
+    }
+
+    // look up each source value in lut, unrolled by four
+    template<typename S, typename D>
+    static void convert_lut(const S *src, D *dst, uint count, const D *lut) {
+      for(; count >= 4; count -= 4, src += 4, dst += 4) {
+        dst[0] = lut[src[0]];
+        dst[1] = lut[src[1]];
+        dst[2] = lut[src[2]];
+        dst[3] = lut[src[3]];
+      }
+      while(count--) *dst++ = lut[*src++];
+    }
+
+  private:
+    void *allocated_buffer = nullptr;
+    FrameBufferAllocator *buffer_owner = nullptr;
+
+    // source rows read back by blit, grown to the widest blit so far
+    RGB *blit_rows = nullptr;
+    uint8_t *blit_alphas = nullptr;
+    uint blit_row_size = 0;
+
+    void init_layers();
   };
 
   class PicoGraphics_Pen1Bit : public PicoGraphics {
@@ -360,9 +651,13 @@ namespace pimoroni {
       PicoGraphics_Pen1Bit(uint16_t width, uint16_t height, void *frame_buffer, uint16_t layers = 1);
       void set_pen(uint c) override;
       void set_pen(uint8_t r, uint8_t g, uint8_t b) override;
+      SavedPen save_pen() const override { return {color, RGB()}; }
+      void restore_pen(const SavedPen &pen) override { color = pen.color; }
 
       void set_pixel(const Point &p) override;
       void set_pixel_span(const Point &p, uint l) override;
+      void set_pixel_column(const Point &p, uint l) override;
+      void get_pixel_span(const Point &p, uint l, RGB *c) override;
 
       static size_t buffer_size(uint w, uint h) {
           return w * h / 8;
@@ -376,9 +671,13 @@ namespace pimoroni {
       PicoGraphics_Pen1BitY(uint16_t width, uint16_t height, void *frame_buffer, uint16_t layers = 1);
       void set_pen(uint c) override;
       void set_pen(uint8_t r, uint8_t g, uint8_t b) override;
+      SavedPen save_pen() const override { return {color, RGB()}; }
+      void restore_pen(const SavedPen &pen) override { color = pen.color; }
 
       void set_pixel(const Point &p) override;
       void set_pixel_span(const Point &p, uint l) override;
+      void set_pixel_column(const Point &p, uint l) override;
+      void get_pixel_span(const Point &p, uint l, RGB *c) override;
 
       static size_t buffer_size(uint w, uint h) {
           return w * h / 8;
@@ -410,14 +709,14 @@ namespace pimoroni {
         {220, 180, 200}  // clean / taupe?!
       };
 
-      std::array<std::array<uint8_t, 16>, 512> candidate_cache;
-      bool cache_built = false;
-      std::array<uint8_t, 16> candidates;
+      PaletteDither dither{true};
 
       PicoGraphics_Pen3Bit(uint16_t width, uint16_t height, void *frame_buffer, uint16_t layers = 1);
 
       void set_pen(uint c) override;
       void set_pen(uint8_t r, uint8_t g, uint8_t b) override;
+      SavedPen save_pen() const override { return {color, RGB()}; }
+      void restore_pen(const SavedPen &pen) override { color = pen.color; }
       int create_pen(uint8_t r, uint8_t g, uint8_t b) override;
       int create_pen_hsv(float h, float s, float v) override;
 
@@ -427,10 +726,12 @@ namespace pimoroni {
       void _set_pixel(const Point &p, uint col);
       void set_pixel(const Point &p) override;
       void set_pixel_span(const Point &p, uint l) override;
-      void get_dither_candidates(const RGB &col, const RGB *palette, size_t len, std::array<uint8_t, 16> &candidates);
+      void set_pixel_column(const Point &p, uint l) override;
+      void get_pixel_span(const Point &p, uint l, RGB *c) override;
       void set_pixel_dither(const Point &p, const RGB &c) override;
 
-      void frame_convert(PenType type, conversion_callback_func callback) override;
+      using PicoGraphics::frame_convert;
+      void frame_convert(PenType type, const ConvertBuffers &target) override;
       static size_t buffer_size(uint w, uint h) {
           return (w * h / 8) * 3;
       }
@@ -440,16 +741,28 @@ namespace pimoroni {
     public:
       static const uint16_t palette_size = 16;
       uint8_t color;
+      // change entries with update_pen, or call palette_changed() after
+      // writing them directly so the dither and convert lookups are rebuilt
       RGB palette[palette_size];
       bool used[palette_size];
 
-      std::array<std::array<uint8_t, 16>, 512> candidate_cache;
-      bool cache_built = false;
-      std::array<uint8_t, 16> candidates;
+      PaletteDither dither;
+
+      // frame_convert lookups, each byte of the framebuffer maps to a pair of
+      // output pixels. allocated on first use, freed with the pen and rebuilt
+      // after the palette has changed
+      RGB565 (*rgb565_lut)[2] = nullptr;
+      RGB888 (*rgb888_lut)[2] = nullptr;
+      bool rgb565_lut_valid = false;
+      bool rgb888_lut_valid = false;
 
       PicoGraphics_PenP4(uint16_t width, uint16_t height, void *frame_buffer, uint16_t layers = 1);
+      ~PicoGraphics_PenP4();
+      void palette_changed();
       void set_pen(uint c) override;
       void set_pen(uint8_t r, uint8_t g, uint8_t b) override;
+      SavedPen save_pen() const override { return {color, RGB()}; }
+      void restore_pen(const SavedPen &pen) override { color = pen.color; }
       int update_pen(uint8_t i, uint8_t r, uint8_t g, uint8_t b) override;
       int create_pen(uint8_t r, uint8_t g, uint8_t b) override;
       int create_pen_hsv(float h, float s, float v) override;
@@ -460,10 +773,13 @@ namespace pimoroni {
 
       void set_pixel(const Point &p) override;
       void set_pixel_span(const Point &p, uint l) override;
-      void get_dither_candidates(const RGB &col, const RGB *palette, size_t len, std::array<uint8_t, 16> &candidates);
+      void set_pixel_column(const Point &p, uint l) override;
+      void get_pixel_span(const Point &p, uint l, RGB *c) override;
       void set_pixel_dither(const Point &p, const RGB &c) override;
+      void set_pixel_dither_span(const Point &p, uint l, const RGB *c) override;
 
-      void frame_convert(PenType type, conversion_callback_func callback) override;
+      using PicoGraphics::frame_convert;
+      void frame_convert(PenType type, const ConvertBuffers &target) override;
       static size_t buffer_size(uint w, uint h) {
           return w * h / 2;
       }
@@ -475,16 +791,27 @@ namespace pimoroni {
     public:
       static const uint16_t palette_size = 256;
       uint8_t color;
+      // change entries with update_pen, or call palette_changed() after
+      // writing them directly so the dither and convert lookups are rebuilt
       RGB palette[palette_size];
       bool used[palette_size];
-    
-      std::array<std::array<uint8_t, 16>, 512> candidate_cache;
-      bool cache_built = false;
-      std::array<uint8_t, 16> candidates;
+
+      PaletteDither dither;
+
+      // frame_convert lookups, allocated on first use, freed with the pen and
+      // rebuilt after the palette has changed
+      RGB565 *rgb565_lut = nullptr;
+      RGB888 *rgb888_lut = nullptr;
+      bool rgb565_lut_valid = false;
+      bool rgb888_lut_valid = false;
 
       PicoGraphics_PenP8(uint16_t width, uint16_t height, void *frame_buffer, uint16_t layers = 1);
+      ~PicoGraphics_PenP8();
+      void palette_changed();
       void set_pen(uint c) override;
       void set_pen(uint8_t r, uint8_t g, uint8_t b) override;
+      SavedPen save_pen() const override { return {color, RGB()}; }
+      void restore_pen(const SavedPen &pen) override { color = pen.color; }
       int update_pen(uint8_t i, uint8_t r, uint8_t g, uint8_t b) override;
       int create_pen(uint8_t r, uint8_t g, uint8_t b) override;
       int create_pen_hsv(float h, float s, float v) override;
@@ -495,10 +822,13 @@ namespace pimoroni {
 
       void set_pixel(const Point &p) override;
       void set_pixel_span(const Point &p, uint l) override;
-      void get_dither_candidates(const RGB &col, const RGB *palette, size_t len, std::array<uint8_t, 16> &candidates);
+      void set_pixel_column(const Point &p, uint l) override;
+      void get_pixel_span(const Point &p, uint l, RGB *c) override;
       void set_pixel_dither(const Point &p, const RGB &c) override;
+      void set_pixel_dither_span(const Point &p, uint l, const RGB *c) override;
 
-      void frame_convert(PenType type, conversion_callback_func callback) override;
+      using PicoGraphics::frame_convert;
+      void frame_convert(PenType type, const ConvertBuffers &target) override;
       static size_t buffer_size(uint w, uint h) {
         return w * h;
       }
@@ -512,10 +842,14 @@ namespace pimoroni {
       PicoGraphics_PenRGB332(uint16_t width, uint16_t height, void *frame_buffer, uint16_t layers = 1);
       void set_pen(uint c) override;
       void set_pen(uint8_t r, uint8_t g, uint8_t b) override;
+      SavedPen save_pen() const override { return {color, RGB()}; }
+      void restore_pen(const SavedPen &pen) override { color = pen.color; }
       int create_pen(uint8_t r, uint8_t g, uint8_t b) override;
       int create_pen_hsv(float h, float s, float v) override;
       void set_pixel(const Point &p) override;
       void set_pixel_span(const Point &p, uint l) override;
+      void set_pixel_column(const Point &p, uint l) override;
+      void get_pixel_span(const Point &p, uint l, RGB *c) override;
       void set_pixel_dither(const Point &p, const RGB &c) override;
       void set_pixel_dither(const Point &p, const RGB565 &c) override;
       void set_pixel_alpha(const Point &p, const uint8_t a) override;
@@ -524,7 +858,8 @@ namespace pimoroni {
 
       void sprite(void* data, const Point &sprite, const Point &dest, const int scale, const int transparent) override;
 
-      void frame_convert(PenType type, conversion_callback_func callback) override;
+      using PicoGraphics::frame_convert;
+      void frame_convert(PenType type, const ConvertBuffers &target) override;
       static size_t buffer_size(uint w, uint h) {
         return w * h;
       }
@@ -539,10 +874,14 @@ namespace pimoroni {
       PicoGraphics_PenRGB565(uint16_t width, uint16_t height, void *frame_buffer, uint16_t layers = 1);
       void set_pen(uint c) override;
       void set_pen(uint8_t r, uint8_t g, uint8_t b) override;
+      SavedPen save_pen() const override { return {color, src_color}; }
+      void restore_pen(const SavedPen &pen) override { color = pen.color; src_color = pen.src_color; }
       int create_pen(uint8_t r, uint8_t g, uint8_t b) override;
       int create_pen_hsv(float h, float s, float v) override;
       void set_pixel(const Point &p) override;
       void set_pixel_span(const Point &p, uint l) override;
+      void set_pixel_column(const Point &p, uint l) override;
+      void get_pixel_span(const Point &p, uint l, RGB *c) override;
 
       void sprite(void* data, const Point &sprite, const Point &dest, const int scale, const int transparent) override;
 
@@ -550,7 +889,8 @@ namespace pimoroni {
         return w * h * sizeof(RGB565);
       }
 
-      void frame_convert(PenType type, conversion_callback_func callback) override;
+      using PicoGraphics::frame_convert;
+      void frame_convert(PenType type, const ConvertBuffers &target) override;
       void set_pixel_alpha(const Point &p, const uint8_t a) override;
 
       bool supports_alpha_blend() override {return true;}
@@ -565,10 +905,21 @@ namespace pimoroni {
       PicoGraphics_PenRGB888(uint16_t width, uint16_t height, void *frame_buffer, uint16_t layers = 1);
       void set_pen(uint c) override;
       void set_pen(uint8_t r, uint8_t g, uint8_t b) override;
+      SavedPen save_pen() const override { return {color, src_color}; }
+      void restore_pen(const SavedPen &pen) override { color = pen.color; src_color = pen.src_color; }
       int create_pen(uint8_t r, uint8_t g, uint8_t b) override;
       int create_pen_hsv(float h, float s, float v) override;
       void set_pixel(const Point &p) override;
       void set_pixel_span(const Point &p, uint l) override;
+      void set_pixel_column(const Point &p, uint l) override;
+      void get_pixel_span(const Point &p, uint l, RGB *c) override;
+      void set_pixel_alpha(const Point &p, const uint8_t a) override;
+
+      bool supports_alpha_blend() override {return true;}
+
+      using PicoGraphics::frame_convert;
+      void frame_convert(PenType type, const ConvertBuffers &target) override;
+
       static size_t buffer_size(uint w, uint h) {
         return w * h * sizeof(uint32_t);
       }
@@ -577,6 +928,272 @@ namespace pimoroni {
   };
 
 
+  // Streaming error diffusion dither.
+  //
+  // Rows of colours are pushed top to bottom and written straight into the
+  // target, so only the error carried to the next row (Floyd-Steinberg) or
+  // next two rows (Atkinson) is held rather than a whole image. This makes it
+  // suitable for feeding directly from an image decoder.
+  //
+  // Palette pens, RGB332, RGB565 and 1Bit quantise to their nearest colour and
+  // diffuse the error, other pens are written as-is. The current pen of the
+  // target is changed while drawing.
+  class ErrorDiffusion {
+    public:
+      enum Mode {
+        FLOYD_STEINBERG,
+        ATKINSON
+      };
+
+      ErrorDiffusion(PicoGraphics *graphics, const Rect &area, Mode mode = FLOYD_STEINBERG, int16_t *buffer = nullptr);
+      ErrorDiffusion(const ErrorDiffusion &) = delete;
+      ErrorDiffusion &operator=(const ErrorDiffusion &) = delete;
+      ~ErrorDiffusion();
+
+      // dither the next row of `area.w` colours into the target
+      void write_row(const RGB *row);
+      bool done() const { return y >= area.y + area.h; }
+
+      // error rows, in int16_t entries
+      static size_t buffer_size(uint w, Mode mode) {
+        return (mode == ATKINSON ? 3 : 2) * (w + 4) * 3;
+      }
+
+    private:
+      static const uint NEAREST_SIZE = 4096;
+
+      PicoGraphics *graphics;
+      Rect area;
+      Mode mode;
+      int32_t y;
+
+      int16_t *buffer;
+      bool owns_buffer;
+      int16_t *rows[3];
+
+      const RGB *palette;
+      int palette_len;
+      uint8_t *nearest = nullptr;
+      uint32_t *nearest_built = nullptr;
+
+      uint quantise(const RGB &c, RGB &q);
+  };
+
+  // Streaming QOI and PNG decoder.
+  //
+  // Encoded data is pulled from a read function in small chunks and decoded
+  // one row at a time straight into a PicoGraphics surface, scaled to fit the
+  // destination and clipped, so the decoded image is never held in memory.
+  // PNG needs a 32K inflate window, QOI needs nothing beyond a row.
+  //
+  // Alpha is ignored and interlaced PNGs are not supported since they can't
+  // be drawn without buffering the whole image.
+  class ImageDecoder {
+    public:
+      // fill data with up to len bytes, returning the number read or 0 at the end
+      typedef std::function<size_t(uint8_t *data, size_t len)> read_func;
+
+      enum Format {
+        FORMAT_UNKNOWN,
+        FORMAT_QOI,
+        FORMAT_PNG
+      };
+
+      enum Dither {
+        DITHER_NONE,
+        DITHER_ORDERED,
+        DITHER_DIFFUSION
+      };
+
+      enum Result {
+        OK,
+        ERROR_READ,
+        ERROR_FORMAT,
+        ERROR_UNSUPPORTED,
+        ERROR_CORRUPT
+      };
+
+      Format format = FORMAT_UNKNOWN;
+      uint16_t width = 0;
+      uint16_t height = 0;
+
+      ImageDecoder(read_func read);
+      ImageDecoder(const uint8_t *data, size_t len);
+      ImageDecoder(const ImageDecoder &) = delete;
+      ImageDecoder &operator=(const ImageDecoder &) = delete;
+      ~ImageDecoder();
+
+      // read the header, filling in format, width and height
+      Result open();
+
+      // decode the image at its natural size or scaled to fill dest
+      Result draw(PicoGraphics *graphics, const Point &p, Dither dither = DITHER_NONE);
+      Result draw(PicoGraphics *graphics, const Rect &dest, Dither dither = DITHER_NONE);
+
+    private:
+      static const uint INPUT_SIZE = 256;
+      static const uint WINDOW_SIZE = 32768;
+
+      read_func read;
+      uint8_t input[INPUT_SIZE];
+      uint input_pos = 0;
+      uint input_len = 0;
+      bool failed = false;
+      bool corrupt = false;
+      bool complete = false;
+
+      // png header and state
+      uint8_t bit_depth = 0;
+      uint8_t colour_type = 0;
+      uint8_t *png_palette = nullptr;
+      uint32_t idat_remaining = 0;
+      uint8_t *row_data = nullptr;
+      uint8_t *prev_row = nullptr;
+      uint row_bytes = 0;
+      uint row_pos = 0;
+      uint8_t filter = 0;
+      bool need_filter = true;
+
+      // inflate state
+      uint8_t *window = nullptr;
+      uint32_t window_pos = 0;
+      uint32_t bit_buffer = 0;
+      uint bit_count = 0;
+
+      struct Huffman {
+        uint16_t count[16];
+        uint16_t symbol[288];
+      };
+      Huffman *huffman = nullptr;
+
+      // output state
+      PicoGraphics *graphics = nullptr;
+      Rect dest;
+      Dither dither = DITHER_NONE;
+      ErrorDiffusion *diffusion = nullptr;
+      RGB *src_row = nullptr;
+      RGB *dest_row = nullptr;
+      int32_t src_y = 0;
+      int32_t dest_y = 0;
+
+      uint8_t read_byte();
+      uint32_t read_be32();
+
+      Result decode_qoi();
+      Result decode_png();
+
+      uint8_t idat_byte();
+      uint bits(uint n);
+      int decode_symbol(const Huffman &h);
+      bool build_huffman(Huffman &h, const uint8_t *lengths, uint n);
+      Result inflate();
+      Result inflate_block(const Huffman &lengths, const Huffman &distances);
+      void png_output(uint8_t v);
+      void png_row();
+
+      void emit_row();
+  };
+
+  // A recorded sequence of drawing operations that can be replayed into
+  // any PicoGraphics later, or split into horizontal bands which several
+  // workers draw at the same time.
+  //
+  // Every drawing operation is stored with its bounding box (already clipped
+  // to the recorded clip) so replay can skip anything outside the target's
+  // clip, and two lists can be compared to find the regions that changed.
+  //
+  // Replay starts with whatever pen the target already has, so a list
+  // should set its pen before it draws anything. Coordinates are stored as
+  // 16-bit values: rectangles are stored clipped, and any other op with a
+  // point or radius that doesn't fit is dropped when it is recorded.
+  // Thickness is limited to 65535.
+  class DisplayList {
+    public:
+      enum Op : uint8_t {
+        // state
+        OP_PEN,
+        OP_PEN_RGB,
+        OP_THICKNESS,
+        OP_FONT,
+        OP_CLIP,
+        OP_REMOVE_CLIP,
+
+        // drawing, followed by a bounding box
+        OP_CLEAR,
+        OP_PIXEL,
+        OP_RECTANGLE,
+        OP_CIRCLE,
+        OP_LINE,
+        OP_TRIANGLE,
+        OP_POLYGON,
+        OP_TEXT
+      };
+
+      // bands are a multiple of this many rows so that no two workers ever
+      // write to the same byte of a packed framebuffer
+      static const uint BAND_ALIGN = 8;
+
+      // the clip when none has been set, covering every 16-bit coordinate
+      static const Rect UNBOUNDED;
+
+      void reset();
+      size_t size() const { return data.size(); }
+      const uint8_t *get_data() const { return data.data(); }
+
+      // replace the contents with a list recorded elsewhere (eg. received
+      // over the network), the data is checked as it is replayed
+      void set_data(const uint8_t *d, size_t len);
+
+      void set_pen(uint c);
+      void set_pen(uint8_t r, uint8_t g, uint8_t b);
+      void set_thickness(uint t);
+      void set_font(std::string_view name);
+      void set_clip(const Rect &r);
+      void remove_clip();
+      bool push_clip(const Rect &r);
+      void pop_clip();
+
+      void clear();
+      void pixel(const Point &p);
+      void rectangle(const Rect &r);
+      void circle(const Point &p, int32_t r);
+      void line(Point p1, Point p2);
+      void triangle(Point p1, Point p2, Point p3);
+      void polygon(const std::vector<Point> &points);
+      void text(const std::string_view &t, const Point &p, int32_t wrap, float s = 2.0f, float a = 0.0f, uint8_t letter_spacing = 1, bool fixed_width = false);
+
+      // draw the list into graphics, optionally limited to area
+      void replay(PicoGraphics *graphics) const;
+      void replay(PicoGraphics *graphics, const Rect &area) const;
+
+      // draw the list using count workers, one per target. every target must
+      // be a framebuffer pen of the same type and size sharing one buffer,
+      // they are used as the per worker clip and pen state. the layer dirty
+      // areas of the other targets are moved to targets[0] afterwards
+      void render(PicoGraphics *const *targets, uint count) const;
+
+      // fill changed with the regions that may differ between a frame drawn
+      // from previous and one drawn from this list, replaying this list
+      // clipped to each of them brings the old frame up to date
+      void diff(const DisplayList &previous, std::vector<Rect> &changed) const;
+
+    private:
+      std::vector<uint8_t> data;
+
+      // recording state, used to work out bounding boxes
+      Rect clip = UNBOUNDED;
+      std::vector<Rect> clip_stack;
+      uint thickness = 1;
+      std::string font = "bitmap6";
+
+      void put8(uint8_t v) { data.push_back(v); }
+      void put16(int32_t v);
+      void put32(uint32_t v);
+      void put_point(const Point &p);
+      void put_rect(const Rect &r);
+      bool begin(Op op, Rect bounds);
+  };
+
   class DisplayDriver {
     public:
       uint16_t width;
@@ -600,6 +1217,14 @@ namespace pimoroni {
        virtual void write_pixel(const Point &p, T colour) = 0;
        virtual void write_pixel_span(const Point &p, uint l, T colour) = 0;
 
+       // a row of different values in one call, drivers that can do better
+       // than a write_pixel per value should override this
+       virtual void write_pixels(const Point &p, uint l, const T *data) {
+         for(auto i = 0u; i < l; i++) {
+           write_pixel(Point(p.x + i, p.y), data[i]);
+         }
+       }
+
        virtual void read_pixel(const Point &p, T &data) {};
        virtual void read_pixel_span(const Point &p, uint l, T *data) {};
    };
@@ -635,28 +1260,34 @@ namespace pimoroni {
         {220, 180, 200}  // clean / taupe?!
       };
 
-      std::array<std::array<uint8_t, 16>, 512> candidate_cache;
-      bool cache_built = false;
-      std::array<uint8_t, 16> candidates;
-    
+      PaletteDither dither{true};
+
       uint color;
       IDirectDisplayDriver<uint8_t> &driver;
 
+      // dithered spans are built up here and handed to the driver in one go
+      uint8_t *row;
+
       PicoGraphics_PenInky7(uint16_t width, uint16_t height, IDirectDisplayDriver<uint8_t> &direct_display_driver, uint16_t layers = 1);
+      ~PicoGraphics_PenInky7();
       void set_pen(uint c) override;
       void set_pen(uint8_t r, uint8_t g, uint8_t b) override;
+      SavedPen save_pen() const override { return {color, RGB()}; }
+      void restore_pen(const SavedPen &pen) override { color = pen.color; }
       int create_pen(uint8_t r, uint8_t g, uint8_t b) override;
       int create_pen_hsv(float h, float s, float v) override;
       void set_pixel(const Point &p) override;
       void set_pixel_span(const Point &p, uint l) override;
+      void get_pixel_span(const Point &p, uint l, RGB *c) override;
 
       int get_palette_size() override {return palette_size;};
       RGB* get_palette() override {return palette;};
 
-      void get_dither_candidates(const RGB &col, const RGB *palette, size_t len, std::array<uint8_t, 16> &candidates);
       void set_pixel_dither(const Point &p, const RGB &c) override;
+      void set_pixel_dither_span(const Point &p, uint l, const RGB *c) override;
 
-      void frame_convert(PenType type, conversion_callback_func callback) override;
+      using PicoGraphics::frame_convert;
+      void frame_convert(PenType type, const ConvertBuffers &target) override;
       static size_t buffer_size(uint w, uint h) {
         return w * h;
       }
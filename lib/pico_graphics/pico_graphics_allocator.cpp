@@ -0,0 +1,113 @@
+#include <string.h>
+
+#include "pico_graphics.hpp"
+
+namespace pimoroni {
+
+  FrameBufferArena::FrameBufferArena(const MemoryRegion &region, FrameBufferAllocator *fallback)
+    : region(region), fallback(fallback) {
+    blocks[0] = {0, region.size, 0, false};
+  }
+
+  void FrameBufferArena::insert(uint i, const Block &b) {
+    memmove(&blocks[i + 1], &blocks[i], (count - i) * sizeof(Block));
+    blocks[i] = b;
+    count++;
+  }
+
+  void FrameBufferArena::remove(uint i) {
+    count--;
+    memmove(&blocks[i], &blocks[i + 1], (count - i) * sizeof(Block));
+  }
+
+  void *FrameBufferArena::allocate(size_t size, size_t alignment) {
+    uintptr_t base = (uintptr_t)region.base;
+    if(alignment == 0) alignment = 1;
+
+    // the free block that leaves the least over once the buffer is placed,
+    // so big holes are kept for big buffers
+    uint best = count;
+    size_t best_waste = SIZE_MAX, best_data = 0;
+    for(uint i = 0; i < count; i++) {
+      const Block &b = blocks[i];
+      if(b.used) continue;
+      size_t data = ((base + b.offset + alignment - 1) / alignment) * alignment - base;
+      size_t pad = data - b.offset;
+      if(pad > b.size || b.size - pad < size) continue;
+      size_t waste = b.size - pad - size;
+      if(waste < best_waste) {
+        best = i;
+        best_waste = waste;
+        best_data = data;
+      }
+    }
+
+    if(best == count) {
+      return fallback ? fallback->allocate(size, alignment) : nullptr;
+    }
+
+    // split off what is left after the buffer, and the padding before it,
+    // as free blocks while there is room to track them
+    Block &b = blocks[best];
+    size_t end = best_data + size;
+    if(end < b.offset + b.size && count < MAX_BLOCKS) {
+      insert(best + 1, {end, b.offset + b.size - end, 0, false});
+      b.size = end - b.offset;
+    }
+    if(best_data > b.offset && count < MAX_BLOCKS) {
+      insert(best, {b.offset, best_data - b.offset, 0, false});
+      best++;
+      blocks[best].offset = best_data;
+      blocks[best].size -= best_data - blocks[best - 1].offset;
+    }
+
+    blocks[best].used = true;
+    blocks[best].data = best_data;
+    return (uint8_t *)region.base + best_data;
+  }
+
+  void FrameBufferArena::release(void *buffer) {
+    if(!buffer) return;
+
+    uint8_t *p = (uint8_t *)buffer;
+    uint8_t *base = (uint8_t *)region.base;
+    if(p < base || p >= base + region.size) {
+      if(fallback) fallback->release(buffer);
+      return;
+    }
+
+    for(uint i = 0; i < count; i++) {
+      if(!blocks[i].used || blocks[i].data != size_t(p - base)) continue;
+
+      blocks[i].used = false;
+
+      // merge with free neighbours so the space can hold a bigger buffer
+      if(i + 1 < count && !blocks[i + 1].used) {
+        blocks[i].size += blocks[i + 1].size;
+        remove(i + 1);
+      }
+      if(i > 0 && !blocks[i - 1].used) {
+        blocks[i - 1].size += blocks[i].size;
+        remove(i);
+      }
+      return;
+    }
+  }
+
+  size_t FrameBufferArena::free_space() const {
+    size_t total = 0;
+    for(uint i = 0; i < count; i++) {
+      if(!blocks[i].used) total += blocks[i].size;
+    }
+    return total;
+  }
+
+  size_t FrameBufferArena::largest_free() const {
+    size_t largest = 0;
+    for(uint i = 0; i < count; i++) {
+      if(!blocks[i].used) largest = std::max(largest, blocks[i].size);
+    }
+    return largest;
+  }
+
+}
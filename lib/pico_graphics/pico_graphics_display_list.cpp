@@ -0,0 +1,692 @@
+#include <atomic>
+#include <string.h>
+
+#include "pico_graphics.hpp"
+
+#ifdef BUILD_PICO
+#include "FreeRTOS.h"
+#include "task.h"
+#include "pico/mutex.h"
+#else
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace pimoroni {
+
+  // run fn(arg, index) for each index below count, all at the same time.
+  // the calling task or thread is worker zero, the others are started the
+  // first time they are needed and then wait for the next render, so a
+  // frame doesn't pay for creating them. one render runs at a time
+#ifdef BUILD_PICO
+  // tasks on top of the calling one, renders asking for more share the
+  // bands between those there are
+#ifndef DISPLAY_LIST_WORKERS
+#define DISPLAY_LIST_WORKERS 2
+#endif
+
+  // in words. the deepest path through replay, hershey text drawn with thick
+  // lines, needs around 1.5K (from -fstack-usage) so this leaves room for
+  // the allocator, the port and interrupts
+#ifndef DISPLAY_LIST_WORKER_STACK_SIZE
+#define DISPLAY_LIST_WORKER_STACK_SIZE 1024
+#endif
+
+  static struct {
+    TaskHandle_t tasks[DISPLAY_LIST_WORKERS];
+    uint started;
+    void (*fn)(void *arg, uint index);
+    void *arg;
+    TaskHandle_t caller;
+  } pool;
+
+  auto_init_mutex(pool_lock);
+
+  static void worker_task(void *param) {
+    uint index = (uint)(uintptr_t)param;
+    while(true) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      pool.fn(pool.arg, index);
+      xTaskNotifyGive(pool.caller);
+    }
+  }
+
+  static void run_workers(uint count, void (*fn)(void *arg, uint index), void *arg) {
+    mutex_enter_blocking(&pool_lock);
+    pool.fn = fn;
+    pool.arg = arg;
+    pool.caller = xTaskGetCurrentTaskHandle();
+
+    // bands are shared out as workers ask for them, so if a task can't be
+    // created the ones that are running just do more of the frame
+    uint woken = 0;
+    for(uint i = 1; i < count && i <= DISPLAY_LIST_WORKERS; i++) {
+      if(i > pool.started) {
+        if(xTaskCreate(worker_task, "dlist", DISPLAY_LIST_WORKER_STACK_SIZE, (void *)(uintptr_t)i,
+                       uxTaskPriorityGet(nullptr), &pool.tasks[i - 1]) != pdPASS) break;
+        pool.started = i;
+      }
+      xTaskNotifyGive(pool.tasks[i - 1]);
+      woken++;
+    }
+
+    fn(arg, 0);
+
+    while(woken--) {
+      ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+    }
+    mutex_exit(&pool_lock);
+  }
+#else
+  class WorkerPool {
+    public:
+      ~WorkerPool() {
+        {
+          std::lock_guard<std::mutex> l(state);
+          stop = true;
+        }
+        wake.notify_all();
+        for(auto &t : threads) t.join();
+      }
+
+      void run(uint count, void (*fn)(void *arg, uint index), void *arg) {
+        std::lock_guard<std::mutex> one_at_a_time(lock);
+        {
+          std::lock_guard<std::mutex> l(state);
+          while(threads.size() + 1 < count) {
+            uint index = threads.size() + 1;
+            threads.emplace_back([this, index]() { worker(index); });
+          }
+          this->fn = fn;
+          this->arg = arg;
+          active = count;
+          remaining = count - 1;
+          generation++;
+        }
+        wake.notify_all();
+
+        fn(arg, 0);
+
+        std::unique_lock<std::mutex> l(state);
+        done.wait(l, [this]() { return remaining == 0; });
+      }
+
+    private:
+      std::mutex lock;
+      std::mutex state;
+      std::condition_variable wake;
+      std::condition_variable done;
+      std::vector<std::thread> threads;
+      bool stop = false;
+      uint64_t generation = 0;
+      uint active = 0;
+      uint remaining = 0;
+      void (*fn)(void *arg, uint index) = nullptr;
+      void *arg = nullptr;
+
+      void worker(uint index) {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> l(state);
+        while(true) {
+          wake.wait(l, [&]() { return stop || (generation != seen && index < active); });
+          if(stop) return;
+          seen = generation;
+
+          l.unlock();
+          fn(arg, index);
+          l.lock();
+
+          if(--remaining == 0) done.notify_one();
+        }
+      }
+  };
+
+  static void run_workers(uint count, void (*fn)(void *arg, uint index), void *arg) {
+    static WorkerPool pool;
+    pool.run(count, fn, arg);
+  }
+#endif
+
+  const Rect DisplayList::UNBOUNDED(-32768, -32768, 65535, 65535);
+
+  // a surface without any pixels that tracks the extent of what is drawn to
+  // it, used to find the bounds of text
+  class BoundsRecorder : public PicoGraphics {
+    public:
+      Point tl, br;
+
+      BoundsRecorder(const Rect &clip) : PicoGraphics(0, 0, nullptr), tl(INT32_MAX, INT32_MAX), br(INT32_MIN, INT32_MIN) {
+        this->bounds = DisplayList::UNBOUNDED;
+        this->clip = clip;
+      }
+      void set_pen(uint c) override {}
+      void set_pen(uint8_t r, uint8_t g, uint8_t b) override {}
+      void set_pixel(const Point &p) override {
+        set_pixel_span(p, 1);
+      }
+      void set_pixel_span(const Point &p, uint l) override {
+        tl.x = std::min(tl.x, p.x);
+        tl.y = std::min(tl.y, p.y);
+        br.x = std::max(br.x, p.x + (int32_t)l);
+        br.y = std::max(br.y, p.y + 1);
+      }
+      void set_pixel_column(const Point &p, uint l) override {
+        set_pixel_span(p, 1);
+        set_pixel_span(Point(p.x, p.y + l - 1), 1);
+      }
+      Rect extent() const {
+        return tl.x < br.x ? Rect(tl, br) : Rect();
+      }
+  };
+
+  // steps through the ops of a list, does not read past the end even if the
+  // data is truncated or corrupt
+  struct DisplayListReader {
+    const uint8_t *p;
+    const uint8_t *end;
+
+    bool more(size_t n) const { return size_t(end - p) >= n; }
+    uint8_t u8() { return more(1) ? *p++ : (p = end, 0); }
+    uint32_t u16() { uint32_t v = u8(); return v | (u8() << 8); }
+    int32_t s16() { return int16_t(u16()); }
+    uint32_t u32() { uint32_t v = u16(); return v | (u16() << 16); }
+    float f32() { uint32_t v = u32(); float f; memcpy(&f, &v, sizeof(f)); return f; }
+    Point point() { int32_t x = s16(); return Point(x, s16()); }
+    Rect rect() { Point o = point(); int32_t w = u16(); return Rect(o.x, o.y, w, u16()); }
+  };
+
+  static Rect combine(const Rect &a, const Rect &b) {
+    if(a.empty()) return b;
+    if(b.empty()) return a;
+    Point tl(std::min(a.x, b.x), std::min(a.y, b.y));
+    Point br(std::max(a.x + a.w, b.x + b.w), std::max(a.y + a.h, b.y + b.h));
+    return Rect(tl, br);
+  }
+
+  // whether points can be stored in the signed 16-bit fields of a list
+  static bool fits(const Point *points, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+      if(points[i].x < INT16_MIN || points[i].x > INT16_MAX || points[i].y < INT16_MIN || points[i].y > INT16_MAX) return false;
+    }
+    return true;
+  }
+
+  static Rect point_bounds(const Point *points, size_t count) {
+    Point tl = points[0], br = points[0];
+    for(size_t i = 1; i < count; i++) {
+      tl.x = std::min(tl.x, points[i].x); tl.y = std::min(tl.y, points[i].y);
+      br.x = std::max(br.x, points[i].x); br.y = std::max(br.y, points[i].y);
+    }
+    return Rect(tl, br + Point(1, 1));
+  }
+
+  void DisplayList::reset() {
+    data.clear();
+    clip = UNBOUNDED;
+    clip_stack.clear();
+    thickness = 1;
+    font = "bitmap6";
+  }
+
+  void DisplayList::set_data(const uint8_t *d, size_t len) {
+    reset();
+    data.assign(d, d + len);
+  }
+
+  void DisplayList::put16(int32_t v) {
+    data.push_back(v & 0xff);
+    data.push_back((v >> 8) & 0xff);
+  }
+
+  void DisplayList::put32(uint32_t v) {
+    put16(v & 0xffff);
+    put16(v >> 16);
+  }
+
+  void DisplayList::put_point(const Point &p) {
+    put16(p.x); put16(p.y);
+  }
+
+  void DisplayList::put_rect(const Rect &r) {
+    put16(r.x); put16(r.y); put16(r.w); put16(r.h);
+  }
+
+  // start a drawing op, or skip it entirely if the clip hides all of it
+  bool DisplayList::begin(Op op, Rect bounds) {
+    bounds = bounds.intersection(clip);
+    if(bounds.empty()) return false;
+    put8(op);
+    put_rect(bounds);
+    return true;
+  }
+
+  void DisplayList::set_pen(uint c) {
+    put8(OP_PEN);
+    put32(c);
+  }
+
+  void DisplayList::set_pen(uint8_t r, uint8_t g, uint8_t b) {
+    put8(OP_PEN_RGB);
+    put8(r);
+    put8(g);
+    put8(b);
+  }
+
+  // anything thicker than 16 bits covers every coordinate a list can hold
+  void DisplayList::set_thickness(uint t) {
+    thickness = std::min(t, 0xffffu);
+    put8(OP_THICKNESS);
+    put16(thickness);
+  }
+
+  void DisplayList::set_font(std::string_view name) {
+    name = name.substr(0, 255);
+    font = name;
+    put8(OP_FONT);
+    put8(name.size());
+    data.insert(data.end(), name.begin(), name.end());
+  }
+
+  void DisplayList::set_clip(const Rect &r) {
+    clip = UNBOUNDED.intersection(r);
+    put8(OP_CLIP);
+    put_rect(clip);
+  }
+
+  void DisplayList::remove_clip() {
+    clip = UNBOUNDED;
+    clip_stack.clear();
+    put8(OP_REMOVE_CLIP);
+  }
+
+  // the stack only exists while recording, the list holds the clip that
+  // results from each push and pop
+  bool DisplayList::push_clip(const Rect &r) {
+    clip_stack.push_back(clip);
+    clip = clip.intersection(r);
+    put8(OP_CLIP);
+    put_rect(clip);
+    return true;
+  }
+
+  void DisplayList::pop_clip() {
+    if(clip_stack.empty()) return;
+    clip = clip_stack.back();
+    clip_stack.pop_back();
+    put8(OP_CLIP);
+    put_rect(clip);
+  }
+
+  void DisplayList::clear() {
+    begin(OP_CLEAR, clip);
+  }
+
+  void DisplayList::pixel(const Point &p) {
+    if(!begin(OP_PIXEL, Rect(p.x, p.y, 1, 1))) return;
+    put_point(p);
+  }
+
+  // stored clipped, which draws the same and always fits
+  void DisplayList::rectangle(const Rect &r) {
+    if(!begin(OP_RECTANGLE, r)) return;
+    put_rect(r.intersection(clip));
+  }
+
+  void DisplayList::circle(const Point &p, int32_t r) {
+    if(!fits(&p, 1) || r < 0 || r > INT16_MAX) return;
+    if(!begin(OP_CIRCLE, Rect(p.x - r, p.y - r, r * 2 + 1, r * 2 + 1))) return;
+    put_point(p);
+    put16(r);
+  }
+
+  void DisplayList::line(Point p1, Point p2) {
+    Point points[] = {p1, p2};
+    if(!fits(points, 2) || !begin(OP_LINE, point_bounds(points, 2))) return;
+    put_point(p1);
+    put_point(p2);
+  }
+
+  void DisplayList::triangle(Point p1, Point p2, Point p3) {
+    Point points[] = {p1, p2, p3};
+    if(!fits(points, 3) || !begin(OP_TRIANGLE, point_bounds(points, 3))) return;
+    put_point(p1);
+    put_point(p2);
+    put_point(p3);
+  }
+
+  void DisplayList::polygon(const std::vector<Point> &points) {
+    if(points.empty() || points.size() > 0xffff || !fits(points.data(), points.size())) return;
+    if(!begin(OP_POLYGON, point_bounds(points.data(), points.size()))) return;
+    put16(points.size());
+    for(auto &p : points) put_point(p);
+  }
+
+  void DisplayList::text(const std::string_view &t, const Point &p, int32_t wrap, float s, float a, uint8_t letter_spacing, bool fixed_width) {
+    if(t.empty() || t.size() > 0xffff || !fits(&p, 1)) return;
+
+    // the layout of text depends on the font, so draw it once to find out
+    // where it goes
+    BoundsRecorder recorder(clip);
+    recorder.set_font(font);
+    recorder.set_thickness(thickness);
+    recorder.text(t, p, wrap, s, a, letter_spacing, fixed_width);
+
+    if(!begin(OP_TEXT, recorder.extent())) return;
+    put_point(p);
+    put32(wrap);
+    uint32_t v;
+    memcpy(&v, &s, sizeof(v)); put32(v);
+    memcpy(&v, &a, sizeof(v)); put32(v);
+    put8(letter_spacing);
+    put8(fixed_width);
+    put16(t.size());
+    data.insert(data.end(), t.begin(), t.end());
+  }
+
+  void DisplayList::replay(PicoGraphics *graphics) const {
+    replay(graphics, graphics->bounds);
+  }
+
+  void DisplayList::replay(PicoGraphics *graphics, const Rect &area) const {
+    Rect saved_clip = graphics->clip;
+    Rect base_clip = saved_clip.intersection(area);
+    if(base_clip.empty()) return;
+
+    uint saved_thickness = graphics->thickness;
+    const bitmap::font_t *saved_bitmap_font = graphics->bitmap_font;
+#ifdef HERSHEY_FONTS
+    const hershey::font_t *saved_hershey_font = graphics->hershey_font;
+#endif
+
+    graphics->clip = base_clip;
+
+    DisplayListReader r{data.data(), data.data() + data.size()};
+    std::vector<Point> points;
+
+    while(r.p < r.end) {
+      uint8_t op = r.u8();
+
+      // anything outside the clip is skipped over without being drawn
+      bool visible = true;
+      if(op >= OP_CLEAR) {
+        Rect bounds = r.rect();
+        visible = !bounds.intersection(graphics->clip).empty();
+      }
+
+      switch(op) {
+        case OP_PEN:
+          graphics->set_pen(r.u32());
+          break;
+        case OP_PEN_RGB: {
+          uint8_t red = r.u8(), green = r.u8(), blue = r.u8();
+          graphics->set_pen(red, green, blue);
+          break;
+        }
+        case OP_THICKNESS:
+          graphics->set_thickness(r.u16());
+          break;
+        case OP_FONT: {
+          uint8_t len = r.u8();
+          if(!r.more(len)) { r.p = r.end; break; }
+          graphics->set_font(std::string_view((const char *)r.p, len));
+          r.p += len;
+          break;
+        }
+        case OP_CLIP:
+          graphics->clip = base_clip.intersection(r.rect());
+          break;
+        case OP_REMOVE_CLIP:
+          graphics->clip = base_clip;
+          break;
+        case OP_CLEAR:
+          if(visible) graphics->clear();
+          break;
+        case OP_PIXEL: {
+          Point p = r.point();
+          if(visible) graphics->pixel(p);
+          break;
+        }
+        case OP_RECTANGLE: {
+          Rect rect = r.rect();
+          if(visible) graphics->rectangle(rect);
+          break;
+        }
+        case OP_CIRCLE: {
+          Point c = r.point();
+          int32_t radius = r.s16();
+          if(visible) graphics->circle(c, radius);
+          break;
+        }
+        case OP_LINE: {
+          Point p1 = r.point();
+          Point p2 = r.point();
+          if(visible) graphics->line(p1, p2);
+          break;
+        }
+        case OP_TRIANGLE: {
+          Point p1 = r.point();
+          Point p2 = r.point();
+          Point p3 = r.point();
+          if(visible) graphics->triangle(p1, p2, p3);
+          break;
+        }
+        case OP_POLYGON: {
+          uint n = r.u16();
+          if(!visible || n == 0) {
+            r.p += std::min(size_t(n) * 4, size_t(r.end - r.p));
+            break;
+          }
+          points.resize(n);
+          for(auto &p : points) p = r.point();
+          graphics->polygon(points);
+          break;
+        }
+        case OP_TEXT: {
+          Point p = r.point();
+          int32_t wrap = r.u32();
+          float s = r.f32();
+          float a = r.f32();
+          uint8_t letter_spacing = r.u8();
+          bool fixed_width = r.u8();
+          uint len = r.u16();
+          if(!r.more(len)) { r.p = r.end; break; }
+          if(visible) graphics->text(std::string_view((const char *)r.p, len), p, wrap, s, a, letter_spacing, fixed_width);
+          r.p += len;
+          break;
+        }
+        default:
+          // unknown op, nothing after it can be trusted
+          r.p = r.end;
+          break;
+      }
+    }
+
+    graphics->clip = saved_clip;
+    graphics->thickness = saved_thickness;
+    graphics->bitmap_font = saved_bitmap_font;
+#ifdef HERSHEY_FONTS
+    graphics->hershey_font = saved_hershey_font;
+#endif
+  }
+
+  // a drawing op identified by a hash of its bytes and the state it was
+  // drawn with, along with its bounds
+  struct DisplayListEntry {
+    uint32_t hash;
+    Rect bounds;
+  };
+
+  static void display_list_entries(const uint8_t *data, size_t len, std::vector<DisplayListEntry> &entries) {
+    DisplayListReader r{data, data + len};
+
+    // the most recent state ops, as hashes of their bytes
+    enum {PEN, THICKNESS, FONT, CLIP, STATE_COUNT};
+    uint32_t state[STATE_COUNT] = {0, 0, 0, 0};
+
+    auto hash = [](const uint8_t *p, const uint8_t *end, uint32_t h) {
+      // FNV-1a
+      while(p < end) h = (h ^ *p++) * 16777619u;
+      return h;
+    };
+
+    std::vector<Point> points;
+    while(r.p < r.end) {
+      const uint8_t *start = r.p;
+      uint8_t op = r.u8();
+      Rect bounds;
+      if(op >= DisplayList::OP_CLEAR) bounds = r.rect();
+
+      switch(op) {
+        case DisplayList::OP_PEN: r.u32(); break;
+        case DisplayList::OP_PEN_RGB: r.u8(); r.u8(); r.u8(); break;
+        case DisplayList::OP_THICKNESS: r.u16(); break;
+        case DisplayList::OP_FONT: { uint8_t n = r.u8(); r.p += std::min(size_t(n), size_t(r.end - r.p)); break; }
+        case DisplayList::OP_CLIP: r.rect(); break;
+        case DisplayList::OP_REMOVE_CLIP: break;
+        case DisplayList::OP_CLEAR: break;
+        case DisplayList::OP_PIXEL: r.point(); break;
+        case DisplayList::OP_RECTANGLE: r.rect(); break;
+        case DisplayList::OP_CIRCLE: r.point(); r.s16(); break;
+        case DisplayList::OP_LINE: r.point(); r.point(); break;
+        case DisplayList::OP_TRIANGLE: r.point(); r.point(); r.point(); break;
+        case DisplayList::OP_POLYGON: { uint n = r.u16(); r.p += std::min(size_t(n) * 4, size_t(r.end - r.p)); break; }
+        case DisplayList::OP_TEXT: {
+          r.point(); r.u32(); r.u32(); r.u32(); r.u8(); r.u8();
+          uint n = r.u16();
+          r.p += std::min(size_t(n), size_t(r.end - r.p));
+          break;
+        }
+        default:
+          r.p = r.end;
+          break;
+      }
+
+      switch(op) {
+        case DisplayList::OP_PEN:
+        case DisplayList::OP_PEN_RGB:
+          state[PEN] = hash(start, r.p, 2166136261u);
+          break;
+        case DisplayList::OP_THICKNESS:
+          state[THICKNESS] = hash(start, r.p, 2166136261u);
+          break;
+        case DisplayList::OP_FONT:
+          state[FONT] = hash(start, r.p, 2166136261u);
+          break;
+        case DisplayList::OP_CLIP:
+        case DisplayList::OP_REMOVE_CLIP:
+          state[CLIP] = hash(start, r.p, 2166136261u);
+          break;
+        default:
+          if(op >= DisplayList::OP_CLEAR && op <= DisplayList::OP_TEXT) {
+            uint32_t h = hash(start, r.p, 2166136261u);
+            h = hash((const uint8_t *)state, (const uint8_t *)(state + STATE_COUNT), h);
+            entries.push_back({h, bounds});
+          }
+          break;
+      }
+    }
+  }
+
+  void DisplayList::diff(const DisplayList &previous, std::vector<Rect> &changed) const {
+    changed.clear();
+
+    std::vector<DisplayListEntry> a, b;
+    display_list_entries(previous.data.data(), previous.data.size(), a);
+    display_list_entries(data.data(), data.size(), b);
+
+    auto same = [](const DisplayListEntry &x, const DisplayListEntry &y) {
+      return x.hash == y.hash && x.bounds.x == y.bounds.x && x.bounds.y == y.bounds.y
+          && x.bounds.w == y.bounds.w && x.bounds.h == y.bounds.h;
+    };
+
+    // anything drawn the same way, in the same order, in both lists gives
+    // the same pixels so only the ops that don't line up need redrawing.
+    // after a mismatch look a little way ahead in each list for the point
+    // where they line up again, so an op being added or removed doesn't
+    // mark everything after it as changed
+    static const size_t RESYNC_WINDOW = 8;
+
+    auto add = [&changed](const Rect &r) {
+      // merge with any region this overlaps, repeating as the result grows
+      Rect merged = r;
+      for(size_t i = 0; i < changed.size();) {
+        if(!changed[i].intersection(merged).empty()) {
+          merged = combine(merged, changed[i]);
+          changed.erase(changed.begin() + i);
+          i = 0;
+        } else {
+          i++;
+        }
+      }
+      changed.push_back(merged);
+    };
+
+    size_t i = 0, j = 0;
+    while(i < a.size() || j < b.size()) {
+      if(i < a.size() && j < b.size() && same(a[i], b[j])) {
+        i++;
+        j++;
+        continue;
+      }
+
+      size_t skip_a = 0, skip_b = 0;
+      for(size_t k = 1; k <= RESYNC_WINDOW && !skip_a && !skip_b; k++) {
+        if(j < b.size() && i + k < a.size() && same(a[i + k], b[j])) skip_a = k;
+        else if(i < a.size() && j + k < b.size() && same(a[i], b[j + k])) skip_b = k;
+      }
+
+      if(!skip_a && !skip_b) {
+        // replaced rather than added or removed
+        skip_a = i < a.size() ? 1 : 0;
+        skip_b = j < b.size() ? 1 : 0;
+      }
+
+      for(; skip_a; skip_a--) add(a[i++].bounds);
+      for(; skip_b; skip_b--) add(b[j++].bounds);
+    }
+  }
+
+  void DisplayList::render(PicoGraphics *const *targets, uint count) const {
+    if(count == 0) return;
+
+    Rect bounds = targets[0]->bounds;
+    if(count == 1) {
+      replay(targets[0], bounds);
+      return;
+    }
+
+    // several bands per worker, taken in turn, so that a worker that gets
+    // a quiet part of the frame moves on and helps with the busy parts
+    int32_t band_h = (bounds.h + count * 4 - 1) / (count * 4);
+    band_h = (band_h + BAND_ALIGN - 1) / BAND_ALIGN * BAND_ALIGN;
+
+    struct Job {
+      const DisplayList *list;
+      PicoGraphics *const *targets;
+      Rect bounds;
+      int32_t band_h;
+      std::atomic<int32_t> next;
+    } job{this, targets, bounds, band_h, {0}};
+
+    run_workers(count, [](void *arg, uint index) {
+      Job *job = (Job *)arg;
+      int32_t y;
+      while((y = job->next.fetch_add(job->band_h)) < job->bounds.h) {
+        job->list->replay(job->targets[index], Rect(job->bounds.x, job->bounds.y + y, job->bounds.w, job->band_h));
+      }
+    }, &job);
+
+    // each target tracked what it drew on the layers above the first, the
+    // first target is the one the frame is converted from so it needs all of it
+    PicoGraphics *surface = targets[0];
+    for(auto i = 1u; i < count; i++) {
+      for(auto l = 1u; l < surface->layers && l < targets[i]->layers; l++) {
+        Rect &d = surface->layer_settings[l].dirty;
+        d = combine(d, targets[i]->layer_settings[l].dirty);
+        targets[i]->layer_settings[l].dirty = Rect(0, 0, 0, 0);
+      }
+    }
+  }
+
+}
@@ -0,0 +1,338 @@
+#include <string.h>
+
+#include "pico_graphics.hpp"
+
+#ifdef BUILD_PICO
+#include "pico/mutex.h"
+#else
+#include <mutex>
+#endif
+
+namespace pimoroni {
+
+  PaletteDither::Table *PaletteDither::tables = nullptr;
+
+  // guards the table list, reference counts and storing built entries
+#ifdef BUILD_PICO
+  auto_init_mutex(tables_lock);
+  static void lock_tables() { mutex_enter_blocking(&tables_lock); }
+  static void unlock_tables() { mutex_exit(&tables_lock); }
+#else
+  static std::mutex tables_lock;
+  static void lock_tables() { tables_lock.lock(); }
+  static void unlock_tables() { tables_lock.unlock(); }
+#endif
+
+  static uint32_t palette_hash(const RGB *palette, size_t len, bool expand) {
+    // FNV-1a over the palette contents
+    uint32_t hash = 2166136261u;
+    auto mix = [&hash](uint8_t v) { hash = (hash ^ v) * 16777619u; };
+
+    mix(expand);
+    mix(len & 0xff);
+    mix(len >> 8);
+    for(size_t i = 0; i < len; i++) {
+      mix(palette[i].r);
+      mix(palette[i].g);
+      mix(palette[i].b);
+    }
+    return hash;
+  }
+
+  static bool same_palette(const RGB *a, const RGB *b, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+      if(a[i].r != b[i].r || a[i].g != b[i].g || a[i].b != b[i].b) return false;
+    }
+    return true;
+  }
+
+  void PaletteDither::set_palette(const RGB *palette, size_t len) {
+    invalidate();
+
+    uint32_t hash = palette_hash(palette, len, expand);
+
+    lock_tables();
+
+    // share a table with any other pen using the same palette
+    Table *idle = nullptr;
+    for(Table *t = tables; t; t = t->next) {
+      if(t->hash == hash && t->expand == expand && t->len == len && same_palette(t->palette, palette, len)) {
+        t->refs++;
+        table = t;
+        unlock_tables();
+        return;
+      }
+      if(t->refs == 0) idle = t;
+    }
+
+    // otherwise recycle the idle table, if there is one, or make a new one
+    if(!idle) {
+      idle = new Table;
+      idle->palette = nullptr;
+      idle->len = 0;
+      idle->next = tables;
+      tables = idle;
+    }
+
+    if(idle->len != len) {
+      delete[] idle->palette;
+      idle->palette = new RGB[len];
+    }
+    std::copy(palette, palette + len, idle->palette);
+    idle->len = len;
+    idle->hash = hash;
+    idle->expand = expand;
+    idle->refs = 1;
+    for(auto &b : idle->built) b.store(0, std::memory_order_relaxed);
+    table = idle;
+
+    unlock_tables();
+  }
+
+  void PaletteDither::invalidate() {
+    if(!table) return;
+
+    lock_tables();
+    if(--table->refs == 0) {
+      // keep this table around in case the palette comes back, but free any
+      // other unused ones so at most one idle table is ever held
+      Table **link = &tables;
+      while(*link) {
+        Table *t = *link;
+        if(t->refs == 0 && t != table) {
+          *link = t->next;
+          delete[] t->palette;
+          delete t;
+        } else {
+          link = &t->next;
+        }
+      }
+    }
+    unlock_tables();
+
+    table = nullptr;
+  }
+
+  void PaletteDither::build(uint key) {
+    // searched without the lock, so two pens sharing the table may both work
+    // out the same entry but only the first stores it
+    uint8_t candidates[16];
+    const RGB *palette = table->palette;
+    size_t len = table->len;
+
+    uint r = (key & 0x1C0) >> 1;
+    uint g = (key & 0x38) << 2;
+    uint b = (key & 0x7) << 5;
+    if(expand) {
+      r |= (r >> 3) | (r >> 6);
+      g |= (g >> 3) | (g >> 6);
+      b |= (b >> 3) | (b >> 6);
+    }
+    RGB col(r, g, b);
+
+    RGB error;
+    for(size_t i = 0; i < 16; i++) {
+      candidates[i] = (col + error).closest(palette, len);
+      error += (col - palette[candidates[i]]);
+    }
+
+    // sort by a rough approximation of luminance, this ensures that neighbouring
+    // pixels in the dither matrix are at extreme opposites of luminence
+    // giving a more balanced output
+    std::sort(candidates, candidates + 16, [palette](int a, int b) {
+      return palette[a].luminance() > palette[b].luminance();
+    });
+
+    uint32_t bit = 1u << (key & 31);
+    lock_tables();
+    if(!(table->built[key >> 5].load(std::memory_order_relaxed) & bit)) {
+      memcpy(table->candidates[key], candidates, sizeof(candidates));
+      table->built[key >> 5].fetch_or(bit, std::memory_order_release);
+    }
+    unlock_tables();
+  }
+
+  void PaletteDither::dither_span(const Point &p, uint l, const RGB *src, uint8_t *dst) {
+    const uint8_t *pattern = &dither16_pattern[(p.y & 0b11) << 2];
+
+    // neighbouring pixels are often the same colour, so avoid looking
+    // the candidates up again if the key hasn't changed
+    uint last_key = ~0u;
+    const uint8_t *c = nullptr;
+
+    for(uint i = 0; i < l; i++) {
+      uint k = key(src[i]);
+      if(k != last_key) {
+        c = candidates(k);
+        last_key = k;
+      }
+      dst[i] = c[pattern[(p.x + i) & 0b11]];
+    }
+  }
+
+
+  ErrorDiffusion::ErrorDiffusion(PicoGraphics *graphics, const Rect &area, Mode mode, int16_t *buffer)
+    : graphics(graphics), area(area), mode(mode), y(area.y), buffer(buffer), owns_buffer(buffer == nullptr) {
+    if(this->buffer == nullptr) {
+      this->buffer = new int16_t[buffer_size(area.w, mode)];
+    }
+    memset(this->buffer, 0, buffer_size(area.w, mode) * sizeof(int16_t));
+
+    // each row is padded by two entries either side so the kernels never
+    // need to check for the edges
+    size_t stride = (area.w + 4) * 3;
+    for(int i = 0; i < 3; i++) {
+      rows[i] = this->buffer + std::min(i, mode == ATKINSON ? 2 : 1) * stride + 2 * 3;
+    }
+
+    palette = graphics->get_palette();
+    palette_len = graphics->get_palette_size();
+    if(graphics->pen_type == PicoGraphics::PEN_P4) {
+      palette_len = PicoGraphics_PenP4::palette_size;
+    }
+
+    // searching large palettes for every pixel is slow, so cache the result
+    // for each 4-bit per channel bucket the first time it is hit
+    if(palette && palette_len > 16) {
+      nearest = new uint8_t[NEAREST_SIZE];
+      nearest_built = new uint32_t[NEAREST_SIZE / 32]();
+    }
+  }
+
+  ErrorDiffusion::~ErrorDiffusion() {
+    if(owns_buffer) delete[] buffer;
+    delete[] nearest;
+    delete[] nearest_built;
+  }
+
+  uint ErrorDiffusion::quantise(const RGB &c, RGB &q) {
+    if(palette) {
+      int i;
+      if(nearest) {
+        uint key = ((c.r & 0xf0) << 4) | (c.g & 0xf0) | ((c.b & 0xf0) >> 4);
+        if(!(nearest_built[key >> 5] & (1u << (key & 31)))) {
+          nearest[key] = RGB((c.r & 0xf0) | 8, (c.g & 0xf0) | 8, (c.b & 0xf0) | 8).closest(palette, palette_len);
+          nearest_built[key >> 5] |= 1u << (key & 31);
+        }
+        i = nearest[key];
+      } else {
+        i = c.closest(palette, palette_len);
+      }
+      q = palette[i];
+      return i;
+    }
+
+    switch(graphics->pen_type) {
+      case PicoGraphics::PEN_RGB332: {
+        RGB332 v = RGB(c).to_rgb332();
+        q = RGB(v);
+        return v;
+      }
+      case PicoGraphics::PEN_RGB565: {
+        RGB565 v = RGB(c).to_rgb565();
+        q = RGB(v);
+        return v;
+      }
+      case PicoGraphics::PEN_1BIT: {
+        bool on = c.luminance() >= 128 * 100;
+        q = on ? RGB(255, 255, 255) : RGB(0, 0, 0);
+        return on ? 15 : 0;
+      }
+      default:
+        q = c;
+        return RGB(c).to_rgb888();
+    }
+  }
+
+  void ErrorDiffusion::write_row(const RGB *row) {
+    if(done()) return;
+
+    bool visible = y >= graphics->clip.y && y < graphics->clip.y + graphics->clip.h;
+    int32_t clip_x0 = graphics->clip.x, clip_x1 = graphics->clip.x + graphics->clip.w;
+
+    // serpentine scanning, alternate rows run right to left which
+    // avoids the diagonal artefacts of always diffusing one way
+    int32_t dir = ((y - area.y) & 1) ? -1 : 1;
+    int32_t x = dir > 0 ? 0 : area.w - 1;
+    int32_t end = dir > 0 ? area.w : -1;
+
+    int16_t *cur = rows[0], *next = rows[1], *next2 = rows[2];
+
+    // runs of the same value are written as a single span
+    int32_t run_start = 0, run_length = 0;
+    uint run_value = 0;
+    auto flush = [&]() {
+      if(run_length == 0) return;
+      graphics->set_pen(run_value);
+      int32_t x0 = std::max(area.x + run_start, clip_x0);
+      int32_t x1 = std::min(area.x + run_start + run_length, clip_x1);
+      if(x0 < x1) graphics->set_pixel_span(Point(x0, y), x1 - x0);
+      run_length = 0;
+    };
+
+    for(; x != end; x += dir) {
+      int16_t *e = &cur[x * 3];
+      RGB c(
+        std::min(std::max(row[x].r + e[0], 0), 255),
+        std::min(std::max(row[x].g + e[1], 0), 255),
+        std::min(std::max(row[x].b + e[2], 0), 255)
+      );
+
+      RGB q;
+      uint v = quantise(c, q);
+
+      if(visible) {
+        if(run_length && v == run_value && (dir > 0 ? x == run_start + run_length : x == run_start - 1)) {
+          if(dir < 0) run_start = x;
+          run_length++;
+        } else {
+          flush();
+          run_start = x;
+          run_length = 1;
+          run_value = v;
+        }
+      }
+
+      int16_t err[3] = {int16_t(c.r - q.r), int16_t(c.g - q.g), int16_t(c.b - q.b)};
+      int d = dir * 3;
+
+      for(int i = 0; i < 3; i++) {
+        int16_t ei = err[i];
+        if(mode == ATKINSON) {
+          // 1/8 to six neighbours, the remaining quarter is dropped
+          int16_t e8 = ei / 8;
+          e[i + d] += e8;
+          e[i + d * 2] += e8;
+          next[x * 3 + i - d] += e8;
+          next[x * 3 + i] += e8;
+          next[x * 3 + i + d] += e8;
+          next2[x * 3 + i] += e8;
+        } else {
+          // 7/16 ahead, 3/16, 5/16 and 1/16 below with any rounding
+          // error folded into the last so none is lost
+          int16_t e7 = ei * 7 / 16;
+          int16_t e3 = ei * 3 / 16;
+          int16_t e5 = ei * 5 / 16;
+          e[i + d] += e7;
+          next[x * 3 + i - d] += e3;
+          next[x * 3 + i] += e5;
+          next[x * 3 + i + d] += ei - e7 - e3 - e5;
+        }
+      }
+    }
+
+    flush();
+
+    // rotate the error rows and clear the one that is now furthest ahead
+    size_t stride = (area.w + 4) * 3;
+    if(mode == ATKINSON) {
+      rows[0] = next; rows[1] = next2; rows[2] = cur;
+    } else {
+      rows[0] = next; rows[1] = cur; rows[2] = cur;
+    }
+    memset(cur - 2 * 3, 0, stride * sizeof(int16_t));
+
+    y++;
+  }
+
+}
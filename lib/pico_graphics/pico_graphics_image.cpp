@@ -0,0 +1,589 @@
+#include <string.h>
+
+#include "pico_graphics.hpp"
+
+namespace pimoroni {
+
+  static const uint8_t png_signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+  static const uint32_t PNG_IHDR = 0x49484452;
+  static const uint32_t PNG_PLTE = 0x504c5445;
+  static const uint32_t PNG_IDAT = 0x49444154;
+  static const uint32_t PNG_IEND = 0x49454e44;
+
+  static uint png_channels(uint8_t colour_type) {
+    switch(colour_type) {
+      case 2: return 3;
+      case 4: return 2;
+      case 6: return 4;
+      default: return 1;
+    }
+  }
+
+  ImageDecoder::ImageDecoder(read_func read) : read(read) {}
+
+  ImageDecoder::ImageDecoder(const uint8_t *data, size_t len)
+    : read([data, len](uint8_t *buf, size_t n) mutable {
+      n = std::min(n, len);
+      memcpy(buf, data, n);
+      data += n;
+      len -= n;
+      return n;
+    }) {}
+
+  ImageDecoder::~ImageDecoder() {
+    delete[] png_palette;
+  }
+
+  uint8_t ImageDecoder::read_byte() {
+    if(input_pos == input_len) {
+      input_pos = 0;
+      input_len = failed ? 0 : read(input, INPUT_SIZE);
+      if(input_len == 0) {
+        failed = true;
+        return 0;
+      }
+    }
+    return input[input_pos++];
+  }
+
+  uint32_t ImageDecoder::read_be32() {
+    uint32_t v = read_byte() << 24;
+    v |= read_byte() << 16;
+    v |= read_byte() << 8;
+    v |= read_byte();
+    return v;
+  }
+
+  ImageDecoder::Result ImageDecoder::open() {
+    uint8_t magic[8];
+    for(auto i = 0u; i < 4; i++) magic[i] = read_byte();
+
+    if(memcmp(magic, "qoif", 4) == 0) {
+      uint32_t w = read_be32();
+      uint32_t h = read_be32();
+      read_byte(); // channels, alpha is ignored so it doesn't matter
+      read_byte(); // colourspace
+      if(failed) return ERROR_READ;
+      if(w == 0 || h == 0) return ERROR_FORMAT;
+      if(w > UINT16_MAX || h > UINT16_MAX) return ERROR_UNSUPPORTED;
+
+      width = w;
+      height = h;
+      format = FORMAT_QOI;
+      return OK;
+    }
+
+    for(auto i = 4u; i < 8; i++) magic[i] = read_byte();
+    if(failed) return ERROR_READ;
+    if(memcmp(magic, png_signature, 8) != 0) return ERROR_FORMAT;
+
+    // IHDR must be the first chunk
+    if(read_be32() != 13 || read_be32() != PNG_IHDR) return failed ? ERROR_READ : ERROR_FORMAT;
+    uint32_t w = read_be32();
+    uint32_t h = read_be32();
+    bit_depth = read_byte();
+    colour_type = read_byte();
+    uint8_t compression = read_byte();
+    uint8_t filter_method = read_byte();
+    uint8_t interlace = read_byte();
+    read_be32(); // crc
+    if(failed) return ERROR_READ;
+
+    if(w == 0 || h == 0 || compression != 0 || filter_method != 0) return ERROR_FORMAT;
+
+    bool valid_depth;
+    switch(colour_type) {
+      case 0: valid_depth = bit_depth == 1 || bit_depth == 2 || bit_depth == 4 || bit_depth == 8 || bit_depth == 16; break;
+      case 3: valid_depth = bit_depth == 1 || bit_depth == 2 || bit_depth == 4 || bit_depth == 8; break;
+      case 2:
+      case 4:
+      case 6: valid_depth = bit_depth == 8 || bit_depth == 16; break;
+      default: valid_depth = false; break;
+    }
+    if(!valid_depth) return ERROR_FORMAT;
+
+    // adam7 needs the whole image before any row is complete
+    if(interlace != 0 || w > UINT16_MAX || h > UINT16_MAX) return ERROR_UNSUPPORTED;
+
+    width = w;
+    height = h;
+    format = FORMAT_PNG;
+    return OK;
+  }
+
+  ImageDecoder::Result ImageDecoder::draw(PicoGraphics *graphics, const Point &p, Dither dither) {
+    if(format == FORMAT_UNKNOWN) {
+      Result result = open();
+      if(result != OK) return result;
+    }
+    return draw(graphics, Rect(p.x, p.y, width, height), dither);
+  }
+
+  ImageDecoder::Result ImageDecoder::draw(PicoGraphics *graphics, const Rect &dest, Dither dither) {
+    if(format == FORMAT_UNKNOWN) {
+      Result result = open();
+      if(result != OK) return result;
+    }
+    if(dest.empty()) return OK;
+
+    // only the palette pens and RGB332 know how to ordered dither
+    if(dither == DITHER_ORDERED) {
+      switch(graphics->pen_type) {
+        case PicoGraphics::PEN_3BIT:
+        case PicoGraphics::PEN_P4:
+        case PicoGraphics::PEN_P8:
+        case PicoGraphics::PEN_RGB332:
+        case PicoGraphics::PEN_INKY7:
+          break;
+        default:
+          dither = DITHER_NONE;
+          break;
+      }
+    }
+
+    this->graphics = graphics;
+    this->dest = dest;
+    this->dither = dither;
+    src_y = 0;
+    dest_y = 0;
+    complete = false;
+
+    src_row = new RGB[width];
+    dest_row = dest.w != width ? new RGB[dest.w] : nullptr;
+    diffusion = dither == DITHER_DIFFUSION ? new ErrorDiffusion(graphics, dest) : nullptr;
+
+    Result result = format == FORMAT_QOI ? decode_qoi() : decode_png();
+
+    delete diffusion;
+    delete[] dest_row;
+    delete[] src_row;
+    diffusion = nullptr;
+    dest_row = nullptr;
+    src_row = nullptr;
+
+    // the data has been consumed so the image can't be drawn again
+    format = FORMAT_UNKNOWN;
+
+    return result;
+  }
+
+  void ImageDecoder::emit_row() {
+    const RGB *row = src_row;
+    bool scaled = false;
+    Rect clip = graphics->clip;
+
+    // nearest neighbour, a source row is drawn to every destination row
+    // whose centre falls within it
+    while(dest_y < dest.h && int32_t(((2 * dest_y + 1) * int64_t(height)) / (2 * dest.h)) == src_y) {
+      if(dest_row && !scaled) {
+        for(auto x = 0; x < dest.w; x++) {
+          dest_row[x] = src_row[((2 * x + 1) * int64_t(width)) / (2 * dest.w)];
+        }
+        row = dest_row;
+        scaled = true;
+      }
+
+      int32_t y = dest.y + dest_y;
+      if(diffusion) {
+        diffusion->write_row(row);
+      } else if(y >= clip.y && y < clip.y + clip.h) {
+        int32_t x0 = std::max(dest.x, clip.x);
+        int32_t x1 = std::min(dest.x + dest.w, clip.x + clip.w);
+        const RGB *c = row + (x0 - dest.x);
+
+        if(x0 >= x1) {
+        } else if(dither == DITHER_ORDERED) {
+          graphics->set_pixel_dither_span(Point(x0, y), x1 - x0, c);
+        } else {
+          // runs of the same colour are drawn as a single span
+          int32_t l = x1 - x0;
+          int32_t start = 0;
+          while(start < l) {
+            int32_t end = start + 1;
+            while(end < l && c[end].r == c[start].r && c[end].g == c[start].g && c[end].b == c[start].b) end++;
+            graphics->set_pen(c[start].r, c[start].g, c[start].b);
+            graphics->set_pixel_span(Point(x0 + start, y), end - start);
+            start = end;
+          }
+        }
+      }
+
+      dest_y++;
+    }
+
+    src_y++;
+
+    // nothing further down can be seen so there is no need to decode it
+    if(dest_y >= dest.h || dest.y + dest_y >= clip.y + clip.h) complete = true;
+  }
+
+  ImageDecoder::Result ImageDecoder::decode_qoi() {
+    uint8_t index[64][4] = {};
+    uint8_t px[4] = {0, 0, 0, 255};
+    uint run = 0;
+
+    while(src_y < height && !complete) {
+      for(auto x = 0u; x < width; x++) {
+        if(run > 0) {
+          run--;
+        } else {
+          uint8_t b1 = read_byte();
+          if(b1 == 0xfe) {
+            px[0] = read_byte();
+            px[1] = read_byte();
+            px[2] = read_byte();
+          } else if(b1 == 0xff) {
+            px[0] = read_byte();
+            px[1] = read_byte();
+            px[2] = read_byte();
+            px[3] = read_byte();
+          } else if((b1 & 0xc0) == 0x00) {
+            memcpy(px, index[b1], 4);
+          } else if((b1 & 0xc0) == 0x40) {
+            px[0] += ((b1 >> 4) & 0x03) - 2;
+            px[1] += ((b1 >> 2) & 0x03) - 2;
+            px[2] += (b1 & 0x03) - 2;
+          } else if((b1 & 0xc0) == 0x80) {
+            uint8_t b2 = read_byte();
+            int vg = (b1 & 0x3f) - 32;
+            px[0] += vg - 8 + ((b2 >> 4) & 0x0f);
+            px[1] += vg;
+            px[2] += vg - 8 + (b2 & 0x0f);
+          } else {
+            run = b1 & 0x3f;
+          }
+          memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) & 63], px, 4);
+        }
+        src_row[x] = RGB(px[0], px[1], px[2]);
+      }
+
+      if(failed) return ERROR_READ;
+      emit_row();
+    }
+
+    return OK;
+  }
+
+  ImageDecoder::Result ImageDecoder::decode_png() {
+    uint bits_per_pixel = png_channels(colour_type) * bit_depth;
+    row_bytes = (width * bits_per_pixel + 7) / 8;
+    row_pos = 0;
+    need_filter = true;
+    corrupt = false;
+
+    row_data = new uint8_t[row_bytes];
+    prev_row = new uint8_t[row_bytes]();
+    window = new uint8_t[WINDOW_SIZE];
+    huffman = new Huffman[2];
+
+    Result result = ERROR_CORRUPT;
+    while(!failed) {
+      uint32_t length = read_be32();
+      uint32_t type = read_be32();
+
+      if(type == PNG_PLTE && !png_palette) {
+        png_palette = new uint8_t[256 * 3]();
+        for(auto i = 0u; i < length; i++) {
+          uint8_t v = read_byte();
+          if(i < 256 * 3) png_palette[i] = v;
+        }
+        read_be32(); // crc
+      } else if(type == PNG_IDAT) {
+        if(colour_type == 3 && !png_palette) break;
+        idat_remaining = length;
+        result = inflate();
+        break;
+      } else if(type == PNG_IEND) {
+        break;
+      } else {
+        // skip anything else along with its crc
+        for(auto i = 0u; i < length + 4 && !failed; i++) read_byte();
+      }
+    }
+    if(failed && result != OK) result = ERROR_READ;
+
+    delete[] huffman;
+    delete[] window;
+    delete[] prev_row;
+    delete[] row_data;
+    huffman = nullptr;
+    window = nullptr;
+    prev_row = nullptr;
+    row_data = nullptr;
+
+    return result;
+  }
+
+  uint8_t ImageDecoder::idat_byte() {
+    // compressed data can be split across any number of IDAT chunks
+    while(idat_remaining == 0) {
+      if(failed) return 0;
+      read_be32(); // crc
+      idat_remaining = read_be32();
+      if(read_be32() != PNG_IDAT) {
+        failed = true;
+        return 0;
+      }
+    }
+    idat_remaining--;
+    return read_byte();
+  }
+
+  uint ImageDecoder::bits(uint n) {
+    while(bit_count < n) {
+      bit_buffer |= uint32_t(idat_byte()) << bit_count;
+      bit_count += 8;
+    }
+    uint v = bit_buffer & ((1u << n) - 1);
+    bit_buffer >>= n;
+    bit_count -= n;
+    return v;
+  }
+
+  bool ImageDecoder::build_huffman(Huffman &h, const uint8_t *lengths, uint n) {
+    memset(h.count, 0, sizeof(h.count));
+    for(auto i = 0u; i < n; i++) h.count[lengths[i]]++;
+
+    // reject over-subscribed codes which would decode out of range
+    int left = 1;
+    for(auto len = 1u; len < 16; len++) {
+      left <<= 1;
+      left -= h.count[len];
+      if(left < 0) return false;
+    }
+
+    uint16_t offsets[16];
+    offsets[1] = 0;
+    for(auto len = 1u; len < 15; len++) offsets[len + 1] = offsets[len] + h.count[len];
+
+    for(auto i = 0u; i < n; i++) {
+      if(lengths[i]) h.symbol[offsets[lengths[i]]++] = i;
+    }
+    return true;
+  }
+
+  int ImageDecoder::decode_symbol(const Huffman &h) {
+    // canonical codes are decoded a bit at a time, see zlib's puff.c
+    int code = 0, first = 0, index = 0;
+    for(auto len = 1u; len < 16; len++) {
+      code |= bits(1);
+      int count = h.count[len];
+      if(code - count < first) return h.symbol[index + (code - first)];
+      index += count;
+      first += count;
+      first <<= 1;
+      code <<= 1;
+    }
+    return -1;
+  }
+
+  ImageDecoder::Result ImageDecoder::inflate() {
+    static const uint8_t code_length_order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+    uint8_t cmf = idat_byte();
+    uint8_t flg = idat_byte();
+    if((cmf & 0x0f) != 8 || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20)) return ERROR_CORRUPT;
+
+    bit_buffer = 0;
+    bit_count = 0;
+    window_pos = 0;
+
+    bool last;
+    do {
+      last = bits(1);
+      uint type = bits(2);
+      Result result = OK;
+
+      if(type == 0) {
+        // stored, starts on a byte boundary
+        bit_buffer = 0;
+        bit_count = 0;
+        uint len = idat_byte();
+        len |= idat_byte() << 8;
+        uint nlen = idat_byte();
+        nlen |= idat_byte() << 8;
+        if(len != (~nlen & 0xffff)) return ERROR_CORRUPT;
+        while(len-- && !failed && !complete) png_output(idat_byte());
+      } else if(type == 1) {
+        uint8_t lengths[288 + 30];
+        memset(lengths, 8, 144);
+        memset(lengths + 144, 9, 112);
+        memset(lengths + 256, 7, 24);
+        memset(lengths + 280, 8, 8);
+        memset(lengths + 288, 5, 30);
+        build_huffman(huffman[0], lengths, 288);
+        build_huffman(huffman[1], lengths + 288, 30);
+        result = inflate_block(huffman[0], huffman[1]);
+      } else if(type == 2) {
+        uint hlit = bits(5) + 257;
+        uint hdist = bits(5) + 1;
+        uint hclen = bits(4) + 4;
+        if(hlit > 286 || hdist > 30) return ERROR_CORRUPT;
+
+        uint8_t lengths[288 + 30] = {};
+        for(auto i = 0u; i < hclen; i++) lengths[code_length_order[i]] = bits(3);
+        if(!build_huffman(huffman[0], lengths, 19)) return ERROR_CORRUPT;
+
+        uint i = 0;
+        while(i < hlit + hdist && !failed) {
+          int sym = decode_symbol(huffman[0]);
+          uint repeat;
+          uint8_t value = 0;
+          if(sym < 0) {
+            return ERROR_CORRUPT;
+          } else if(sym < 16) {
+            lengths[i++] = sym;
+            continue;
+          } else if(sym == 16) {
+            if(i == 0) return ERROR_CORRUPT;
+            value = lengths[i - 1];
+            repeat = 3 + bits(2);
+          } else if(sym == 17) {
+            repeat = 3 + bits(3);
+          } else {
+            repeat = 11 + bits(7);
+          }
+          if(i + repeat > hlit + hdist) return ERROR_CORRUPT;
+          while(repeat--) lengths[i++] = value;
+        }
+
+        if(lengths[256] == 0) return ERROR_CORRUPT;
+        if(!build_huffman(huffman[0], lengths, hlit)) return ERROR_CORRUPT;
+        if(!build_huffman(huffman[1], lengths + hlit, hdist)) return ERROR_CORRUPT;
+        result = inflate_block(huffman[0], huffman[1]);
+      } else {
+        return ERROR_CORRUPT;
+      }
+
+      if(result != OK) return result;
+      if(corrupt) return ERROR_CORRUPT;
+      if(failed) return ERROR_READ;
+      if(complete) return OK;
+    } while(!last);
+
+    return src_y == height ? OK : ERROR_CORRUPT;
+  }
+
+  ImageDecoder::Result ImageDecoder::inflate_block(const Huffman &lengths, const Huffman &distances) {
+    static const uint16_t length_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const uint8_t length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const uint16_t distance_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    static const uint8_t distance_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    while(!failed && !complete) {
+      int sym = decode_symbol(lengths);
+      if(sym < 0) return ERROR_CORRUPT;
+
+      if(sym < 256) {
+        png_output(sym);
+      } else if(sym == 256) {
+        return OK;
+      } else {
+        sym -= 257;
+        if(sym >= 29) return ERROR_CORRUPT;
+        uint len = length_base[sym] + bits(length_extra[sym]);
+
+        int d = decode_symbol(distances);
+        if(d < 0 || d >= 30) return ERROR_CORRUPT;
+        uint32_t distance = distance_base[d] + bits(distance_extra[d]);
+        if(distance > window_pos) return ERROR_CORRUPT;
+
+        while(len--) png_output(window[(window_pos - distance) & (WINDOW_SIZE - 1)]);
+      }
+    }
+
+    return OK;
+  }
+
+  void ImageDecoder::png_output(uint8_t v) {
+    window[window_pos++ & (WINDOW_SIZE - 1)] = v;
+
+    // each row is preceded by its filter type
+    if(need_filter) {
+      filter = v;
+      need_filter = false;
+      return;
+    }
+
+    row_data[row_pos++] = v;
+    if(row_pos == row_bytes) {
+      row_pos = 0;
+      need_filter = true;
+      if(src_y < height && !complete) png_row();
+    }
+  }
+
+  void ImageDecoder::png_row() {
+    uint8_t *row = row_data;
+    uint8_t *prev = prev_row;
+    uint bpp = std::max(1u, png_channels(colour_type) * bit_depth / 8);
+
+    switch(filter) {
+      case 0:
+        break;
+      case 1:
+        for(auto i = bpp; i < row_bytes; i++) row[i] += row[i - bpp];
+        break;
+      case 2:
+        for(auto i = 0u; i < row_bytes; i++) row[i] += prev[i];
+        break;
+      case 3:
+        for(auto i = 0u; i < bpp; i++) row[i] += prev[i] >> 1;
+        for(auto i = bpp; i < row_bytes; i++) row[i] += (row[i - bpp] + prev[i]) >> 1;
+        break;
+      case 4:
+        for(auto i = 0u; i < row_bytes; i++) {
+          int a = i >= bpp ? row[i - bpp] : 0;
+          int b = prev[i];
+          int c = i >= bpp ? prev[i - bpp] : 0;
+          int p = a + b - c;
+          int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+          row[i] += (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+        }
+        break;
+      default:
+        corrupt = true;
+        complete = true;
+        return;
+    }
+
+    if(bit_depth < 8) {
+      uint mask = (1u << bit_depth) - 1;
+      for(auto x = 0u; x < width; x++) {
+        uint bit = x * bit_depth;
+        uint v = (row[bit >> 3] >> (8 - bit_depth - (bit & 7))) & mask;
+        if(colour_type == 3) {
+          const uint8_t *c = &png_palette[v * 3];
+          src_row[x] = RGB(c[0], c[1], c[2]);
+        } else {
+          v = v * 255 / mask;
+          src_row[x] = RGB(v, v, v);
+        }
+      }
+    } else {
+      // 16-bit samples only keep their most significant byte
+      uint sample = bit_depth / 8;
+      uint stride = png_channels(colour_type) * sample;
+      const uint8_t *p = row;
+      for(auto x = 0u; x < width; x++, p += stride) {
+        switch(colour_type) {
+          case 0:
+          case 4:
+            src_row[x] = RGB(p[0], p[0], p[0]);
+            break;
+          case 3:
+            src_row[x] = RGB(png_palette[p[0] * 3], png_palette[p[0] * 3 + 1], png_palette[p[0] * 3 + 2]);
+            break;
+          default:
+            src_row[x] = RGB(p[0], p[sample], p[sample * 2]);
+            break;
+        }
+      }
+    }
+
+    std::swap(row_data, prev_row);
+    emit_row();
+  }
+
+}
@@ -6,7 +6,7 @@ namespace pimoroni {
     : PicoGraphics(width, height, layers, frame_buffer) {
     this->pen_type = PEN_1BIT;
     if(this->frame_buffer == nullptr) {
-      this->frame_buffer = (void *)(new uint8_t[buffer_size(width, height) * layers]);
+      this->frame_buffer = allocate_frame_buffer(buffer_size(width, height));
     }
   }
 
@@ -54,4 +54,32 @@ namespace pimoroni {
     }
   }
 
+  void PicoGraphics_Pen1Bit::set_pixel_column(const Point &p, uint l) {
+    uint8_t *buf = (uint8_t *)frame_buffer;
+    uint8_t bit = 1U << (7 - (p.x & 0b111));
+
+    // the dither only changes with the row inside each 4x4 block
+    uint8_t rows[4];
+    for(uint i = 0; i < 4; i++) {
+      uint8_t _dmv = dither16_pattern[(p.x & 0b11) | (i << 2)];
+      rows[i] = color == 15 || (color != 0 && color > _dmv) ? bit : 0;
+    }
+
+    int32_t y = p.y;
+    for(int32_t row = p.y * bounds.w; l--; y++, row += bounds.w) {
+      uint8_t *f = &buf[(p.x / 8) + (row / 8)];
+      *f = (*f & ~bit) | rows[y & 0b11];
+    }
+  }
+
+  void PicoGraphics_Pen1Bit::get_pixel_span(const Point &p, uint l, RGB *c) {
+    uint8_t *buf = (uint8_t *)frame_buffer;
+    buf += p.y * bounds.w / 8;
+
+    for(auto x = p.x; x < p.x + (int32_t)l; x++) {
+      bool on = buf[x / 8] & (1U << (7 - (x & 0b111)));
+      *c++ = on ? RGB(255, 255, 255) : RGB(0, 0, 0);
+    }
+  }
+
 }
\ No newline at end of file
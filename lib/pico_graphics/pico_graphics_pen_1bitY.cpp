@@ -6,7 +6,7 @@ namespace pimoroni {
     : PicoGraphics(width, height, layers, frame_buffer) {
     this->pen_type = PEN_1BIT;
     if(this->frame_buffer == nullptr) {
-      this->frame_buffer = (void *)(new uint8_t[buffer_size(width, height)]);
+      this->frame_buffer = allocate_frame_buffer(buffer_size(width, height));
     }
   }
 
@@ -54,4 +54,39 @@ namespace pimoroni {
     }
   }
 
+  void PicoGraphics_Pen1BitY::set_pixel_column(const Point &p, uint l) {
+    // columns are contiguous in this framebuffer, so they are written up to
+    // eight pixels at a time
+    uint8_t *buf = (uint8_t *)frame_buffer;
+    buf += p.x * bounds.h / 8;
+
+    // the dither repeats every four rows, so every byte of a column is the same
+    uint8_t fill = 0;
+    for(uint i = 0; i < 8; i++) {
+      uint8_t _dmv = dither16_pattern[(p.x & 0b11) | ((i & 0b11) << 2)];
+      if(color == 15 || (color != 0 && color > _dmv)) fill |= 0x80 >> i;
+    }
+
+    int32_t y = p.y;
+    int32_t end = p.y + l;
+    while(y < end) {
+      uint bo = y & 0b111;
+      uint n = std::min(end - y, int32_t(8 - bo));
+      uint8_t mask = (0xff >> bo) & (0xff << (8 - bo - n));
+      uint8_t *f = &buf[y / 8];
+      *f = (*f & ~mask) | (fill & mask);
+      y += n;
+    }
+  }
+
+  void PicoGraphics_Pen1BitY::get_pixel_span(const Point &p, uint l, RGB *c) {
+    uint8_t *buf = (uint8_t *)frame_buffer;
+    uint bo = 7 - (p.y & 0b111);
+
+    for(auto x = p.x; x < p.x + (int32_t)l; x++) {
+      bool on = buf[(p.y / 8) + (x * bounds.h / 8)] & (1U << bo);
+      *c++ = on ? RGB(255, 255, 255) : RGB(0, 0, 0);
+    }
+  }
+
 }
\ No newline at end of file
@@ -6,9 +6,8 @@ namespace pimoroni {
     : PicoGraphics(width, height, layers, frame_buffer) {
         this->pen_type = PEN_3BIT;
         if(this->frame_buffer == nullptr) {
-            this->frame_buffer = (void *)(new uint8_t[buffer_size(width, height)]);
+            this->frame_buffer = allocate_frame_buffer(buffer_size(width, height));
         }
-        cache_built = false;
     }
     void PicoGraphics_Pen3Bit::_set_pixel(const Point &p, uint col) {
         uint offset = (bounds.w * bounds.h) / 8;
@@ -62,60 +61,66 @@ namespace pimoroni {
             lp.x++;
         }
     }
-    void PicoGraphics_Pen3Bit::get_dither_candidates(const RGB &col, const RGB *palette, size_t len, std::array<uint8_t, 16> &candidates) {
-        RGB error;
-        for(size_t i = 0; i < candidates.size(); i++) {
-            candidates[i] = (col + error).closest(palette, len);
-            error += (col - palette[candidates[i]]);
+    void PicoGraphics_Pen3Bit::set_pixel_column(const Point &p, uint l) {
+        if ((color & 0x7f000000) == 0x7f000000) {
+            PicoGraphics::set_pixel_column(p, l);
+            return;
         }
 
-        // sort by a rough approximation of luminance, this ensures that neighbouring
-        // pixels in the dither matrix are at extreme opposites of luminence
-        // giving a more balanced output
-        std::sort(candidates.begin(), candidates.end(), [palette](int a, int b) {
-            return palette[a].luminance() > palette[b].luminance();
-        });
+        // the same bit in each of the three planes, a row apart every step
+        uint offset = (bounds.w * bounds.h) / 8;
+        uint8_t *buf = (uint8_t *)frame_buffer;
+
+        uint8_t bit = 1U << (7 - (p.x & 0b111));
+        uint8_t cA = (color & 0b100) ? bit : 0;
+        uint8_t cB = (color & 0b010) ? bit : 0;
+        uint8_t cC = (color & 0b001) ? bit : 0;
+
+        for(int32_t row = p.y * bounds.w; l--; row += bounds.w) {
+            uint8_t *bufA = &buf[(p.x / 8) + (row / 8)];
+            uint8_t *bufB = bufA + offset;
+            uint8_t *bufC = bufA + offset + offset;
+            *bufA = (*bufA & ~bit) | cA;
+            *bufB = (*bufB & ~bit) | cB;
+            *bufC = (*bufC & ~bit) | cC;
+        }
+    }
+    void PicoGraphics_Pen3Bit::get_pixel_span(const Point &p, uint l, RGB *c) {
+        uint offset = (bounds.w * bounds.h) / 8;
+        uint8_t *buf = (uint8_t *)frame_buffer;
+        buf += p.y * bounds.w / 8;
+
+        for(auto x = p.x; x < p.x + (int32_t)l; x++) {
+            uint bo = 7 - (x & 0b111);
+            uint8_t *bufA = &buf[x / 8];
+            uint i = ((*bufA >> bo) & 1U) << 2;
+            i |= ((bufA[offset] >> bo) & 1U) << 1;
+            i |= (bufA[offset + offset] >> bo) & 1U;
+            *c++ = palette[i];
+        }
     }
 
     void PicoGraphics_Pen3Bit::set_pixel_dither(const Point &p, const RGB &c) {
         if(!bounds.contains(p)) return;
 
-        if(!cache_built) {
-            for(uint i = 0; i < 512; i++) {
-                uint r = (i & 0x1c0) >> 1;
-                uint g = (i & 0x38) << 2;
-                uint b = (i & 0x7) << 5;
-                RGB cache_col(
-                    r | (r >> 3) | (r >> 6),
-                    g | (g >> 3) | (g >> 6),
-                    b | (b >> 3) | (b >> 6)
-                );
-                get_dither_candidates(cache_col, palette, palette_size, candidate_cache[i]);
-            }
-            cache_built = true;
-        }
+        if(!dither.ready()) dither.set_palette(palette, palette_size);
 
-        uint cache_key = ((c.r & 0xE0) << 1) | ((c.g & 0xE0) >> 2) | ((c.b & 0xE0) >> 5);
-        //get_dither_candidates(c, palette, 256, candidates);
-
-        // find the pattern coordinate offset
-        uint pattern_index = (p.x & 0b11) | ((p.y & 0b11) << 2);
-
-        // set the pixel
-        //color = candidates[pattern[pattern_index]];
-        _set_pixel(p, candidate_cache[cache_key][dither16_pattern[pattern_index]]);
+        _set_pixel(p, dither.get(p, c));
     }
-    void PicoGraphics_Pen3Bit::frame_convert(PenType type, conversion_callback_func callback) {
+    void PicoGraphics_Pen3Bit::frame_convert(PenType type, const ConvertBuffers &target) {
         if(type == PEN_P4) {
-            uint8_t row_buf[bounds.w / 2];
             uint offset = (bounds.w * bounds.h) / 8;
             uint8_t *buf = (uint8_t *)frame_buffer;
 
-            for(auto y = 0; y < bounds.h; y++) {
-                for(auto x = 0; x < bounds.w; x++) {
-                    uint bo = 7 - (x & 0b111);
+            // gather a pixel from each of the three bit planes and pack them
+            // into nibbles, two to a byte
+            frame_convert_kernel(target, 4, [&](void *buffer, uint start, uint count) {
+                uint8_t *dst = (uint8_t *)buffer;
+                for(auto i = 0u; i < count; i++) {
+                    uint p = start + i;
+                    uint bo = 7 - (p & 0b111);
 
-                    uint8_t *bufA = &buf[(x / 8) + (y * bounds.w / 8)];
+                    uint8_t *bufA = &buf[p / 8];
                     uint8_t *bufB = bufA + offset;
                     uint8_t *bufC = bufA + offset + offset;
 
@@ -124,13 +129,14 @@ namespace pimoroni {
                     nibble |= (*bufB >> bo) & 1U;
                     nibble <<= 1;
                     nibble |= (*bufC >> bo) & 1U;
-                    nibble <<= (x & 0b1) ? 0 : 4;
 
-                    row_buf[x / 2] &= (x & 0b1) ? 0b11110000 : 0b00001111;
-                    row_buf[x / 2] |= nibble;
+                    if(i & 0b1) {
+                        dst[i / 2] |= nibble;
+                    } else {
+                        dst[i / 2] = nibble << 4;
+                    }
                 }
-                callback(row_buf, bounds.w / 2);
-            }
+            });
         }
     }
 }
\ No newline at end of file
@@ -5,6 +5,10 @@ namespace pimoroni {
   : PicoGraphics(width, height, layers, nullptr),
     driver(direct_display_driver) {
       this->pen_type = PEN_INKY7;
+      row = new uint8_t[width];
+  }
+  PicoGraphics_PenInky7::~PicoGraphics_PenInky7() {
+    delete[] row;
   }
   void PicoGraphics_PenInky7::set_pen(uint c) {
     color = c;
@@ -25,81 +29,102 @@ namespace pimoroni {
       driver.write_pixel(p, color & 0x07);
     }
   }
+  // clamp a span to the display, false if none of it is left
+  static bool clamp_span(const Rect &bounds, Point &p, uint &l, uint &skip) {
+    skip = 0;
+    if(p.y < 0 || p.y >= bounds.h || l == 0) return false;
+    if(p.x < 0) {
+      if(uint(-p.x) >= l) return false;
+      skip = -p.x;
+      l -= skip;
+      p.x = 0;
+    }
+    if(p.x >= bounds.w) return false;
+    if(p.x + (int32_t)l > bounds.w) l = bounds.w - p.x;
+    return true;
+  }
   void PicoGraphics_PenInky7::set_pixel_span(const Point &p, uint l) {
     if ((color & 0x7f000000) == 0x7f000000) {
-      for(auto x = 0u; x < l; x++) {
-        set_pixel_dither(p + Point(x, 0), RGB(color));
+      Point dest = p;
+      uint skip;
+      if(!clamp_span(bounds, dest, l, skip)) return;
+
+      if(!dither.ready()) dither.set_palette(palette, palette_size);
+
+      // a flat colour dithers to a pattern that repeats every four pixels,
+      // so work out one repeat and copy it along the row
+      RGB c(color);
+      uint8_t pattern[4];
+      for(auto i = 0u; i < 4; i++) {
+        pattern[(dest.x + i) & 0b11] = dither.get(dest + Point(i, 0), c) & 0x07;
+      }
+      for(auto i = 0u; i < l; i++) {
+        row[i] = pattern[(dest.x + i) & 0b11];
       }
+      driver.write_pixels(dest, l, row);
       return;
     }
     driver.write_pixel_span(p, l, color);
   }
-  void PicoGraphics_PenInky7::get_dither_candidates(const RGB &col, const RGB *palette, size_t len, std::array<uint8_t, 16> &candidates) {
-    RGB error;
-    for(size_t i = 0; i < candidates.size(); i++) {
-        candidates[i] = (col + error).closest(palette, len);
-        error += (col - palette[candidates[i]]);
+  void PicoGraphics_PenInky7::get_pixel_span(const Point &p, uint l, RGB *c) {
+    // read back from the display driver in small chunks
+    Point lp = p;
+    while(l > 0) {
+      uint8_t data[32] = {};
+      uint n = std::min(l, (uint)sizeof(data));
+      driver.read_pixel_span(lp, n, data);
+      for(auto i = 0u; i < n; i++) {
+        *c++ = palette[data[i] & 0x07];
+      }
+      lp.x += n;
+      l -= n;
     }
-
-    // sort by a rough approximation of luminance, this ensures that neighbouring
-    // pixels in the dither matrix are at extreme opposites of luminence
-    // giving a more balanced output
-    std::sort(candidates.begin(), candidates.end(), [palette](int a, int b) {
-        return palette[a].luminance() > palette[b].luminance();
-    });
   }
   void PicoGraphics_PenInky7::set_pixel_dither(const Point &p, const RGB &c) {
     if(!bounds.contains(p)) return;
 
-    if(!cache_built) {
-        for(uint i = 0; i < 512; i++) {
-            uint r = (i & 0x1c0) >> 1;
-            uint g = (i & 0x38) << 2;
-            uint b = (i & 0x7) << 5;
-            RGB cache_col(
-                r | (r >> 3) | (r >> 6),
-                g | (g >> 3) | (g >> 6),
-                b | (b >> 3) | (b >> 6)
-            );
-            get_dither_candidates(cache_col, palette, palette_size, candidate_cache[i]);
-        }
-        cache_built = true;
-    }
+    if(!dither.ready()) dither.set_palette(palette, palette_size);
 
-    uint cache_key = ((c.r & 0xE0) << 1) | ((c.g & 0xE0) >> 2) | ((c.b & 0xE0) >> 5);
-    //get_dither_candidates(c, palette, 256, candidates);
+    driver.write_pixel(p, dither.get(p, c) & 0x07);
+  }
+  void PicoGraphics_PenInky7::set_pixel_dither_span(const Point &p, uint l, const RGB *c) {
+    Point dest = p;
+    uint skip;
+    if(!clamp_span(bounds, dest, l, skip)) return;
 
-    // find the pattern coordinate offset
-    uint pattern_index = (p.x & 0b11) | ((p.y & 0b11) << 2);
+    if(!dither.ready()) dither.set_palette(palette, palette_size);
 
-    // set the pixel
-    //color = candidates[pattern[pattern_index]];
-    driver.write_pixel(p, candidate_cache[cache_key][dither16_pattern[pattern_index]] & 0x07);
+    dither.dither_span(dest, l, c + skip, row);
+    driver.write_pixels(dest, l, row);
   }
-  void PicoGraphics_PenInky7::frame_convert(PenType type, conversion_callback_func callback) {
+  void PicoGraphics_PenInky7::frame_convert(PenType type, const ConvertBuffers &target) {
     if(type == PEN_INKY7) {
-      uint byte_count = bounds.w/2;
-      uint8_t buffer[bounds.w];
+      frame_convert_kernel(target, 4, [&](void *buffer, uint offset, uint count) {
+        uint8_t *dst = (uint8_t *)buffer;
 
-      for(int32_t r = 0; r < bounds.h; r++)
-      {
-        driver.read_pixel_span(Point(0, r), bounds.w, buffer);
-        // for(int y=0; y < 800; y++)
-        //   buffer[y] = rand() % 7;
+        // read back from the driver a row segment at a time and convert
+        // byte storage to nibble storage. segments end at odd pixels when
+        // the width is odd, so pixels are packed by their position in the
+        // buffer and a half filled byte carries over to the next segment
+        uint i = 0;
+        while(count > 0) {
+          Point p(offset % bounds.w, offset / bounds.w);
+          uint8_t pixels[64];
+          uint n = std::min(count, std::min((uint)sizeof(pixels), uint(bounds.w - p.x)));
+          driver.read_pixel_span(p, n, pixels);
 
-        // convert byte storage to nibble storage
-        uint8_t *pDst = buffer;
-        uint8_t *pSrc = buffer;
-                
-        for(uint c = 0; c < byte_count; c++)
-        {
-          uint8_t nibble = ((*pSrc++) << 4);
-          nibble |= ((*pSrc++) & 0xf);
-          *pDst++ = nibble;
-        }
+          for(auto j = 0u; j < n; j++, i++) {
+            if(i & 1) {
+              dst[i / 2] |= pixels[j] & 0xf;
+            } else {
+              dst[i / 2] = pixels[j] << 4;
+            }
+          }
 
-        callback(buffer, byte_count);
-      }
+          offset += n;
+          count -= n;
+        }
+      });
     }
   }
 }
\ No newline at end of file
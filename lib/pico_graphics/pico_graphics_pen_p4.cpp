@@ -2,11 +2,18 @@
 
 namespace pimoroni {
 
+    // only the contiguous run of used entries is considered when dithering
+    static uint used_palette_entries(const bool *used, uint len) {
+        uint count = 0;
+        while(count < len && used[count]) count++;
+        return count;
+    }
+
     PicoGraphics_PenP4::PicoGraphics_PenP4(uint16_t width, uint16_t height, void *frame_buffer, uint16_t layers)
     : PicoGraphics(width, height, layers, frame_buffer) {
         this->pen_type = PEN_P4;
         if(this->frame_buffer == nullptr) {
-            this->frame_buffer = (void *)(new uint8_t[buffer_size(width, height)]);
+            this->frame_buffer = allocate_frame_buffer(buffer_size(width, height));
         }
         for(auto i = 0u; i < palette_size; i++) {
             palette[i] = {
@@ -16,7 +23,14 @@ namespace pimoroni {
             };
             used[i] = false;
         }
-        cache_built = false;
+    }
+    PicoGraphics_PenP4::~PicoGraphics_PenP4() {
+        delete[] rgb565_lut;
+        delete[] rgb888_lut;
+    }
+    void PicoGraphics_PenP4::palette_changed() {
+        dither.invalidate();
+        rgb565_lut_valid = rgb888_lut_valid = false;
     }
     void PicoGraphics_PenP4::set_pen(uint c) {
         color = c & 0xf;
@@ -29,7 +43,7 @@ namespace pimoroni {
         i &= 0xf;
         used[i] = true;
         palette[i] = {r, g, b};
-        cache_built = false;
+        palette_changed();
         return i;
     }
     int PicoGraphics_PenP4::create_pen(uint8_t r, uint8_t g, uint8_t b) {
@@ -38,7 +52,7 @@ namespace pimoroni {
             if(!used[i]) {
                 palette[i] = {r, g, b};
                 used[i] = true;
-                cache_built = false;
+                palette_changed();
                 return i;
             }
         }
@@ -51,10 +65,11 @@ namespace pimoroni {
     int PicoGraphics_PenP4::reset_pen(uint8_t i) {
         palette[i] = {0, 0, 0};
         used[i] = false;
-        cache_built = false;
+        palette_changed();
         return i;
     }
     void PicoGraphics_PenP4::set_pixel(const Point &p) {
+        touch(p);
         auto i = (p.x + p.y * bounds.w);
 
         // pointer to byte in framebuffer that contains this pixel
@@ -75,6 +90,8 @@ namespace pimoroni {
         // and trying to write 2GB of pixels.
         if (l == 0) {return;}
 
+        touch(p, l);
+
         auto i = (p.x + p.y * bounds.w);
 
         // pointer to byte in framebuffer that contains this pixel
@@ -94,95 +111,148 @@ namespace pimoroni {
         // handle the last pixel if not byte aligned
         if(l) {*f &= 0b00001111; *f |= (cc & 0b11110000);}
     }
+    void PicoGraphics_PenP4::set_pixel_column(const Point &p, uint l) {
+        touch_column(p, l);
+        auto i = (p.x + p.y * bounds.w);
 
-    void PicoGraphics_PenP4::get_dither_candidates(const RGB &col, const RGB *palette, size_t len, std::array<uint8_t, 16> &candidates) {
-        RGB error;
-        for(size_t i = 0; i < candidates.size(); i++) {
-            candidates[i] = (col + error).closest(palette, len);
-            error += (col - palette[candidates[i]]);
+        uint8_t *buf = (uint8_t *)frame_buffer;
+        buf += this->layer_offset / 2;
+
+        // with an even width every pixel in the column is in the same nibble
+        if(!(bounds.w & 0b1)) {
+            uint8_t *f = &buf[i / 2];
+            uint8_t  o = (~i & 0b1) * 4;
+            uint8_t  m = ~(0b1111 << o);
+            uint8_t  b = color << o;
+            uint stride = bounds.w / 2;
+            while(l--) {*f = (*f & m) | b; f += stride;}
+            return;
         }
 
-        // sort by a rough approximation of luminance, this ensures that neighbouring
-        // pixels in the dither matrix are at extreme opposites of luminence
-        // giving a more balanced output
-        std::sort(candidates.begin(), candidates.end(), [palette](int a, int b) {
-            return palette[a].luminance() > palette[b].luminance();
-        });
+        for(; l--; i += bounds.w) {
+            uint8_t *f = &buf[i / 2];
+            uint8_t  o = (~i & 0b1) * 4;
+            *f = (*f & ~(0b1111 << o)) | (color << o);
+        }
+    }
+    void PicoGraphics_PenP4::get_pixel_span(const Point &p, uint l, RGB *c) {
+        auto i = (p.x + p.y * bounds.w);
+
+        uint8_t *buf = (uint8_t *)frame_buffer;
+        buf += this->layer_offset / 2;
+
+        while(l--) {
+            uint8_t v = buf[i / 2];
+            *c++ = palette[(i & 0b1) ? v & 0xf : v >> 4];
+            i++;
+        }
     }
 
     void PicoGraphics_PenP4::set_pixel_dither(const Point &p, const RGB &c) {
         if(!bounds.contains(p)) return;
 
-        uint used_palette_entries = 0;
-        for(auto i = 0u; i < palette_size; i++) {
-            if(!used[i]) break;
-            used_palette_entries++;
+        if(!dither.ready()) dither.set_palette(palette, used_palette_entries(used, palette_size));
+
+        color = dither.get(p, c);
+        set_pixel(p);
+    }
+
+    void PicoGraphics_PenP4::set_pixel_dither_span(const Point &p, uint l, const RGB *c) {
+        if(p.y < 0 || p.y >= bounds.h || l == 0) return;
+
+        // clamp the span to the frame buffer
+        Point dest = p;
+        if(dest.x < 0) {
+            if(uint(-dest.x) >= l) return;
+            l += dest.x; c -= dest.x; dest.x = 0;
         }
+        if(dest.x + (int32_t)l > bounds.w) {
+            if(dest.x >= bounds.w) return;
+            l = bounds.w - dest.x;
+        }
+
+        touch(dest, l);
+
+        if(!dither.ready()) dither.set_palette(palette, used_palette_entries(used, palette_size));
+
+        uint8_t *buf = (uint8_t *)frame_buffer;
+        buf += this->layer_offset / 2;
 
-        if(!cache_built) {
-            for(uint i = 0; i < 512; i++) {
-                RGB cache_col((i & 0x1C0) >> 1, (i & 0x38) << 2, (i & 0x7) << 5);
-                get_dither_candidates(cache_col, palette, used_palette_entries, candidate_cache[i]);
+        // dither into a small buffer of palette indices, then pack into nibbles
+        const uint BUF_LEN = 64;
+        uint8_t indices[BUF_LEN];
+        while(l) {
+            uint n = std::min(l, BUF_LEN);
+            dither.dither_span(dest, n, c, indices);
+
+            auto i = dest.x + dest.y * bounds.w;
+            for(auto j = 0u; j < n; j++, i++) {
+                uint8_t *f = &buf[i / 2];
+                uint8_t  o = (~i & 0b1) * 4;
+                *f = (*f & ~(0b1111 << o)) | (indices[j] << o);
             }
-            cache_built = true;
+
+            dest.x += n; c += n; l -= n;
         }
+    }
+    void PicoGraphics_PenP4::frame_convert(PenType type, const ConvertBuffers &target) {
+        // each framebuffer byte is looked up as a pair of pixels, a single
+        // index is found in the first pixel of the pair with it in the high
+        // nibble when compositing the layers above the first
+        auto convert = [&](auto lut) {
+            typedef typename std::remove_reference<decltype(lut[0][0])>::type T;
+            uint8_t *src = (uint8_t *)frame_buffer;
+            uint layer_size = bounds.w * bounds.h / 2;
+
+            auto base = [&](T *dst, uint offset, uint count) {
+                const uint8_t *p = src + offset / 2;
+                if(offset & 0b1) {
+                    *dst++ = lut[*p++][1];
+                    count--;
+                }
+                for(; count >= 8; count -= 8, p += 4, dst += 8) {
+                    dst[0] = lut[p[0]][0]; dst[1] = lut[p[0]][1];
+                    dst[2] = lut[p[1]][0]; dst[3] = lut[p[1]][1];
+                    dst[4] = lut[p[2]][0]; dst[5] = lut[p[2]][1];
+                    dst[6] = lut[p[3]][0]; dst[7] = lut[p[3]][1];
+                }
+                for(; count >= 2; count -= 2, dst += 2) {
+                    dst[0] = lut[*p][0];
+                    dst[1] = lut[*p++][1];
+                }
+                if(count) *dst = lut[*p][0];
+            };
 
-        uint cache_key = ((c.r & 0xE0) << 1) | ((c.g & 0xE0) >> 2) | ((c.b & 0xE0) >> 5);
-        //get_dither_candidates(c, palette, 256, candidates);
+            auto fetch = [&](uint layer, uint i) {
+                uint8_t c = src[layer_size * layer + i / 2];
+                return uint((i & 0b1) ? c & 0xf : c >> 4);
+            };
 
-        // find the pattern coordinate offset
-        uint pattern_index = (p.x & 0b11) | ((p.y & 0b11) << 2);
+            frame_convert_kernel(target, sizeof(T) * 8, [&](void *buffer, uint offset, uint count) {
+                composite((T *)buffer, offset, count, base, fetch, [&](uint c) {return lut[c << 4][0];});
+            });
+        };
 
-        // set the pixel
-        //color = candidates[pattern[pattern_index]];
-        color = candidate_cache[cache_key][dither16_pattern[pattern_index]];
-        set_pixel(p);
-    }
-    void PicoGraphics_PenP4::frame_convert(PenType type, conversion_callback_func callback) {
         if(type == PEN_RGB565) {
-            // Cache the RGB888 palette as RGB565
-            RGB565 cache[palette_size];
-            for(auto i = 0u; i < palette_size; i++) {
-                cache[i] = palette[i].to_rgb565();
+            if(!rgb565_lut) rgb565_lut = new RGB565[256][2];
+            if(!rgb565_lut_valid) {
+                for(auto i = 0u; i < 256; i++) {
+                    rgb565_lut[i][0] = palette[i >> 4].to_rgb565();
+                    rgb565_lut[i][1] = palette[i & 0xf].to_rgb565();
+                }
+                rgb565_lut_valid = true;
             }
-
-            // Treat our void* frame_buffer as uint8_t
-            uint8_t *src = (uint8_t *)frame_buffer;
-            uint8_t o = 4;
-
-            if(this->layers > 1) {
-
-                uint offset = this->bounds.w * this->bounds.h / 2;
-
-                frame_convert_rgb565(callback, [&]() {
-                    uint8_t b = 0;
-
-                    // Iterate through layers in reverse order
-                    // Return the first nonzero (not transparent) pixel
-                    for(auto layer = this->layers; layer > 0; layer--) {
-                        uint8_t c = *(src + offset * (layer - 1));
-                        b = (c >> o) & 0xf; // bit value shifted to position
-                        if (b) break;
-                    }
-
-                    // Increment to next 4-bit entry 
-                    o ^= 4;
-                    if (o != 0) src++;
-
-                    return cache[b];
-                });
-            } else {
-                frame_convert_rgb565(callback, [&]() {
-                    uint8_t c = *src;
-                    uint8_t b = (c >> o) & 0xf; // bit value shifted to position
-                    
-                    // Increment to next 4-bit entry 
-                    o ^= 4;
-                    if (o != 0) ++src;
-
-                    return cache[b];
-                });
+            convert(rgb565_lut);
+        } else if(type == PEN_RGB888) {
+            if(!rgb888_lut) rgb888_lut = new RGB888[256][2];
+            if(!rgb888_lut_valid) {
+                for(auto i = 0u; i < 256; i++) {
+                    rgb888_lut[i][0] = palette[i >> 4].to_rgb888();
+                    rgb888_lut[i][1] = palette[i & 0xf].to_rgb888();
+                }
+                rgb888_lut_valid = true;
             }
+            convert(rgb888_lut);
         }
     }
     bool PicoGraphics_PenP4::render_tile(const Tile *tile) {
@@ -5,13 +5,20 @@ namespace pimoroni {
     : PicoGraphics(width, height, layers, frame_buffer) {
         this->pen_type = PEN_P8;
         if(this->frame_buffer == nullptr) {
-            this->frame_buffer = (void *)(new uint8_t[buffer_size(width, height)]);
+            this->frame_buffer = allocate_frame_buffer(buffer_size(width, height));
         }
         for(auto i = 0u; i < palette_size; i++) {
             palette[i] = {uint8_t(i), uint8_t(i), uint8_t(i)};
             used[i] = false;
         }
-        cache_built = false;
+    }
+    PicoGraphics_PenP8::~PicoGraphics_PenP8() {
+        delete[] rgb565_lut;
+        delete[] rgb888_lut;
+    }
+    void PicoGraphics_PenP8::palette_changed() {
+        dither.invalidate();
+        rgb565_lut_valid = rgb888_lut_valid = false;
     }
     void PicoGraphics_PenP8::set_pen(uint c) {
         color = c;
@@ -24,7 +31,7 @@ namespace pimoroni {
         i &= 0xff;
         used[i] = true;
         palette[i] = {r, g, b};
-        cache_built = false;
+        palette_changed();
         return i;
     }
     int PicoGraphics_PenP8::create_pen(uint8_t r, uint8_t g, uint8_t b) {
@@ -33,7 +40,7 @@ namespace pimoroni {
             if(!used[i]) {
                 palette[i] = {r, g, b};
                 used[i] = true;
-                cache_built = false;
+                palette_changed();
                 return i;
             }
         }
@@ -46,16 +53,18 @@ namespace pimoroni {
     int PicoGraphics_PenP8::reset_pen(uint8_t i) {
         palette[i] = {0, 0, 0};
         used[i] = false;
-        cache_built = false;
+        palette_changed();
         return i;
     }
     void PicoGraphics_PenP8::set_pixel(const Point &p) {
+        touch(p);
         uint8_t *buf = (uint8_t *)frame_buffer;
         buf += this->layer_offset;
         buf[p.y * bounds.w + p.x] = color;
     }
     
     void PicoGraphics_PenP8::set_pixel_span(const Point &p, uint l) {
+        touch(p, l);
         // pointer to byte in framebuffer that contains this pixel
         uint8_t *buf = (uint8_t *)frame_buffer;
         buf += this->layer_offset;
@@ -65,110 +74,97 @@ namespace pimoroni {
             *buf++ = color;
         }
     }
+    void PicoGraphics_PenP8::set_pixel_column(const Point &p, uint l) {
+        touch_column(p, l);
+        uint8_t *buf = (uint8_t *)frame_buffer;
+        buf += this->layer_offset;
+        buf = &buf[p.y * bounds.w + p.x];
 
-    void PicoGraphics_PenP8::get_dither_candidates(const RGB &col, const RGB *palette, size_t len, std::array<uint8_t, 16> &candidates) {
-        RGB error;
-        for(size_t i = 0; i < candidates.size(); i++) {
-            candidates[i] = (col + error).closest(palette, len);
-            error += (col - palette[candidates[i]]);
+        while(l--) {
+            *buf = color;
+            buf += bounds.w;
         }
+    }
+    void PicoGraphics_PenP8::get_pixel_span(const Point &p, uint l, RGB *c) {
+        uint8_t *buf = (uint8_t *)frame_buffer;
+        buf += this->layer_offset;
+        buf = &buf[p.y * bounds.w + p.x];
 
-        // sort by a rough approximation of luminance, this ensures that neighbouring
-        // pixels in the dither matrix are at extreme opposites of luminence
-        // giving a more balanced output
-        std::sort(candidates.begin(), candidates.end(), [palette](int a, int b) {
-            return palette[a].luminance() > palette[b].luminance();
-        });
+        while(l--) {
+            *c++ = palette[*buf++];
+        }
     }
 
     void PicoGraphics_PenP8::set_pixel_dither(const Point &p, const RGB &c) {
         if(!bounds.contains(p)) return;
 
-        if(!cache_built) {
-            for(uint i = 0; i < 512; i++) {
-                RGB cache_col((i & 0x1C0) >> 1, (i & 0x38) << 2, (i & 0x7) << 5);
-                get_dither_candidates(cache_col, palette, palette_size, candidate_cache[i]);
-            }
-            cache_built = true;
+        if(!dither.ready()) dither.set_palette(palette, palette_size);
+
+        color = dither.get(p, c);
+        set_pixel(p);
+    }
+
+    void PicoGraphics_PenP8::set_pixel_dither_span(const Point &p, uint l, const RGB *c) {
+        if(p.y < 0 || p.y >= bounds.h || l == 0) return;
+
+        // clamp the span to the frame buffer
+        Point dest = p;
+        if(dest.x < 0) {
+            if(uint(-dest.x) >= l) return;
+            l += dest.x; c -= dest.x; dest.x = 0;
+        }
+        if(dest.x + (int32_t)l > bounds.w) {
+            if(dest.x >= bounds.w) return;
+            l = bounds.w - dest.x;
         }
 
-        uint cache_key = ((c.r & 0xE0) << 1) | ((c.g & 0xE0) >> 2) | ((c.b & 0xE0) >> 5);
-        //get_dither_candidates(c, palette, 256, candidates);
+        touch(dest, l);
 
-        // find the pattern coordinate offset
-        uint pattern_index = (p.x & 0b11) | ((p.y & 0b11) << 2);
+        if(!dither.ready()) dither.set_palette(palette, palette_size);
 
-        // set the pixel
-        //color = candidates[pattern[pattern_index]];
-        color = candidate_cache[cache_key][dither16_pattern[pattern_index]];
-        set_pixel(p);
+        // palette indices can be written straight into the frame buffer
+        uint8_t *buf = (uint8_t *)frame_buffer;
+        buf += this->layer_offset;
+        dither.dither_span(dest, l, c, &buf[dest.y * bounds.w + dest.x]);
     }
 
-    void PicoGraphics_PenP8::frame_convert(PenType type, conversion_callback_func callback) {
+    void PicoGraphics_PenP8::frame_convert(PenType type, const ConvertBuffers &target) {
         // Treat our void* frame_buffer as uint8_t
         uint8_t *src = (uint8_t *)frame_buffer;
 
-        if(layers > 1) {
-            // The size of a single layer
-            uint offset = this->bounds.w * this->bounds.h;
+        // The size of a single layer
+        uint layer_size = this->bounds.w * this->bounds.h;
+
+        auto convert = [&](auto *lut) {
+            typedef typename std::remove_reference<decltype(*lut)>::type T;
 
-            if(type == PEN_RGB565) {
-                // Cache the RGB888 palette as RGB565
-                RGB565 cache[palette_size];
+            // Layers are keyed on the *palette* index, rather than the colour
+            frame_convert_kernel(target, sizeof(T) * 8, [&](void *buffer, uint offset, uint count) {
+                composite((T *)buffer, offset, count,
+                    [&](T *dst, uint offset, uint count) {convert_lut(src + offset, dst, count, lut);},
+                    [&](uint layer, uint i) {return uint(src[layer_size * layer + i]);},
+                    [&](uint c) {return lut[c];});
+            });
+        };
+
+        if(type == PEN_RGB565) {
+            if(!rgb565_lut) rgb565_lut = new RGB565[palette_size];
+            if(!rgb565_lut_valid) {
                 for(auto i = 0u; i < palette_size; i++) {
-                    cache[i] = palette[i].to_rgb565();
+                    rgb565_lut[i] = palette[i].to_rgb565();
                 }
-
-                frame_convert_rgb565(callback, [&]() {
-                    // Check the *palette* index, rather than the colour
-                    // Thus palette entry 0 is *always* transparent
-                    uint8_t c = 0;
-
-                    // Iterate through layers in reverse order
-                    // Return the first nonzero (not transparent) pixel
-                    for(auto layer = this->layers; layer > 0; layer--) {
-                        c = *(src + offset * (layer - 1));
-                        if (c) break;
-                    }
-
-                    src++;
-
-                    return cache[c];
-                });
-            } else if (type == PEN_RGB888) {
-                frame_convert_rgb888(callback, [&]() {
-                    // Check the *palette* index, rather than the colour
-                    // Thus palette entry 0 is *always* transparent
-                    uint8_t c = 0;
-
-                    // Iterate through layers in reverse order
-                    // Return the first nonzero (not transparent) pixel
-                    for(auto layer = this->layers; layer > 0; layer--) {
-                        c = *(src + offset * (layer - 1));
-                        if (c) break;
-                    }
-
-                    src++;
-
-                    return palette[c].to_rgb888();
-                });
+                rgb565_lut_valid = true;
             }
-        } else {
-            if(type == PEN_RGB565) {
-                // Cache the RGB888 palette as RGB565
-                RGB565 cache[palette_size];
+            convert(rgb565_lut);
+        } else if (type == PEN_RGB888) {
+            if(!rgb888_lut) rgb888_lut = new RGB888[palette_size];
+            if(!rgb888_lut_valid) {
                 for(auto i = 0u; i < palette_size; i++) {
-                    cache[i] = palette[i].to_rgb565();
+                    rgb888_lut[i] = palette[i].to_rgb888();
                 }
-
-                frame_convert_rgb565(callback, [&]() {
-                    return cache[*src++];
-                });
-            } else if (type == PEN_RGB888) {
-                frame_convert_rgb888(callback, [&]() {
-                    return palette[*src++].to_rgb888();
-                });
+                rgb888_lut_valid = true;
             }
+            convert(rgb888_lut);
         }
     }
 
@@ -6,7 +6,7 @@ namespace pimoroni {
     : PicoGraphics(width, height, layers, frame_buffer) {
         this->pen_type = PEN_RGB332;
         if(this->frame_buffer == nullptr) {
-            this->frame_buffer = (void *)(new uint8_t[buffer_size(width, height) * layers]);
+            this->frame_buffer = allocate_frame_buffer(buffer_size(width, height));
         }
     }
     void PicoGraphics_PenRGB332::set_pen(uint c) {
@@ -22,11 +22,13 @@ namespace pimoroni {
         return RGB::from_hsv(h, s, v).to_rgb332();
     }
     void PicoGraphics_PenRGB332::set_pixel(const Point &p) {
+        touch(p);
         uint8_t *buf = (uint8_t *)frame_buffer;
         buf += this->layer_offset;
         buf[p.y * bounds.w + p.x] = color;
     }
     void PicoGraphics_PenRGB332::set_pixel_span(const Point &p, uint l) {
+        touch(p, l);
         // pointer to byte in framebuffer that contains this pixel
         uint8_t *buf = (uint8_t *)frame_buffer;
         buf += this->layer_offset;
@@ -36,8 +38,29 @@ namespace pimoroni {
             *buf++ = color;
         }
     }
+    void PicoGraphics_PenRGB332::set_pixel_column(const Point &p, uint l) {
+        touch_column(p, l);
+        uint8_t *buf = (uint8_t *)frame_buffer;
+        buf += this->layer_offset;
+        buf += p.y * bounds.w + p.x;
+
+        while(l--) {
+            *buf = color;
+            buf += bounds.w;
+        }
+    }
+    void PicoGraphics_PenRGB332::get_pixel_span(const Point &p, uint l, RGB *c) {
+        uint8_t *buf = (uint8_t *)frame_buffer;
+        buf += this->layer_offset;
+        buf = &buf[p.y * bounds.w + p.x];
+
+        while(l--) {
+            *c++ = RGB((RGB332)*buf++);
+        }
+    }
     void PicoGraphics_PenRGB332::set_pixel_alpha(const Point &p, const uint8_t a) {
         if(!bounds.contains(p)) return;
+        touch(p);
 
         uint8_t *buf = (uint8_t *)frame_buffer;
         buf += this->layer_offset;
@@ -93,59 +116,32 @@ namespace pimoroni {
 
         set_pixel(p);
     }
-    void PicoGraphics_PenRGB332::frame_convert(PenType type, conversion_callback_func callback) {
+    void PicoGraphics_PenRGB332::frame_convert(PenType type, const ConvertBuffers &target) {
         if(type == PEN_RGB565) {
 
             // Treat our void* frame_buffer as uint8_t
             uint8_t *src = (uint8_t *)frame_buffer;
 
-            if(this->layers > 1) {
-                // The size of a single layer
-                uint offset = this->bounds.w * this->bounds.h;
-
-                frame_convert_rgb565(callback, [&]() {
-                    uint8_t c = 0;
-
-                    // Iterate through layers in reverse order
-                    // Return the first nonzero (not transparent) pixel
-                    for(auto layer = this->layers; layer > 0; layer--) {
-                        c = *(src + offset * (layer - 1));
-                        if (c) break;
-                    }
+            // The size of a single layer
+            uint layer_size = this->bounds.w * this->bounds.h;
 
-                    src++;
-
-                    return rgb332_to_rgb565_lut[c];
-                });
-            } else {
-                frame_convert_rgb565(callback, [&]() {
-                    return rgb332_to_rgb565_lut[*src++];
-                });
-            }
+            frame_convert_kernel(target, 16, [&](void *buffer, uint offset, uint count) {
+                composite((RGB565 *)buffer, offset, count,
+                    [&](RGB565 *dst, uint offset, uint count) {convert_lut(src + offset, dst, count, rgb332_to_rgb565_lut);},
+                    [&](uint layer, uint i) {return uint(src[layer_size * layer + i]);},
+                    [&](uint c) {return rgb332_to_rgb565_lut[c];});
+            });
         }
     }
     void PicoGraphics_PenRGB332::sprite(void* data, const Point &sprite, const Point &dest, const int scale, const int transparent) {
-        //int sprite_x = (sprite & 0x0f) << 3;
-        //int sprite_y = (sprite & 0xf0) >> 1;
-        Point s {
-            sprite.x << 3,
-            sprite.y << 3
-        };
-        RGB332 *ptr = (RGB332 *)data;
-        Point o = {0, 0};
-        for(o.y = 0; o.y < 8 * scale; o.y++) {
-            Point so = {
-                0,
-                o.y / scale
-            };
-            for(o.x = 0; o.x < 8 * scale; o.x++) {
-                so.x = o.x / scale;
-                color = ptr[(s.y + so.y) * 128 + (s.x + so.x)];
-                if(color != transparent) pixel(dest + o);
-            }
-        }
+        // sprites are 8x8 tiles on a 128 pixel wide sheet
+        PicoGraphics_PenRGB332 sheet(128, (sprite.y + 1) * 8, data);
+        uint flags = transparent >= 0 && transparent <= 0xff ? BLIT_COLOUR_KEY : 0;
+        blit(&sheet, Rect(sprite.x * 8, sprite.y * 8, 8, 8), Rect(dest.x, dest.y, 8 * scale, 8 * scale), flags, RGB((RGB332)transparent));
     }
     bool PicoGraphics_PenRGB332::render_tile(const Tile *tile) {
+        touch(Rect(tile->x, tile->y, tile->w, tile->h));
+
         for(int y = 0; y < tile->h; y++) {
             uint8_t *palpha = &tile->data[(y * tile->stride)];
 
@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "pico_graphics.hpp"
 
 namespace pimoroni {
@@ -5,7 +7,7 @@ namespace pimoroni {
     : PicoGraphics(width, height, layers, frame_buffer) {
         this->pen_type = PEN_RGB565;
         if(this->frame_buffer == nullptr) {
-            this->frame_buffer = (void *)(new uint8_t[buffer_size(width, height)]);
+            this->frame_buffer = allocate_frame_buffer(buffer_size(width, height));
         }
     }
     void PicoGraphics_PenRGB565::set_pen(uint c) {
@@ -22,12 +24,14 @@ namespace pimoroni {
         return RGB::from_hsv(h, s, v).to_rgb565();
     }
     void PicoGraphics_PenRGB565::set_pixel(const Point &p) {
+        touch(p);
         uint16_t *buf = (uint16_t *)frame_buffer;
         // We can't use buffer_size because our pointer is uint16_t
         buf += this->layer_offset;
         buf[p.y * bounds.w + p.x] = color;
     }
     void PicoGraphics_PenRGB565::set_pixel_span(const Point &p, uint l) {
+        touch(p, l);
         // pointer to byte in framebuffer that contains this pixel
         uint16_t *buf = (uint16_t *)frame_buffer;
         // We can't use buffer_size because our pointer is uint16_t
@@ -38,32 +42,47 @@ namespace pimoroni {
             *buf++ = color;
         }
     }
+    void PicoGraphics_PenRGB565::set_pixel_column(const Point &p, uint l) {
+        touch_column(p, l);
+        uint16_t *buf = (uint16_t *)frame_buffer;
+        buf += this->layer_offset;
+        buf = &buf[p.y * bounds.w + p.x];
+
+        while(l--) {
+            *buf = color;
+            buf += bounds.w;
+        }
+    }
+    void PicoGraphics_PenRGB565::get_pixel_span(const Point &p, uint l, RGB *c) {
+        uint16_t *buf = (uint16_t *)frame_buffer;
+        buf += this->layer_offset;
+        buf = &buf[p.y * bounds.w + p.x];
+
+        while(l--) {
+            *c++ = RGB((RGB565)*buf++);
+        }
+    }
 
-    void PicoGraphics_PenRGB565::frame_convert(PenType type, conversion_callback_func callback) {
+    void PicoGraphics_PenRGB565::frame_convert(PenType type, const ConvertBuffers &target) {
         if(type == PEN_RGB565) {
-            // Treat our void* frame_buffer as uint8_t
+            // Treat our void* frame_buffer as uint16_t
             uint16_t *src = (uint16_t *)frame_buffer;
 
-            if(layers > 1) {
-                // Assume only two layers for now
-                // We can't use buffer_size because our pointer is uint16_t
-                uint16_t *src_layer2 = src + this->bounds.w * this->bounds.h;
-
-                frame_convert_rgb565(callback, [&]() {
-                    RGB565 c1 = *src++;
-                    RGB565 c2 = *src_layer2++;
-                    return c2 ? c2 : c1;
-                });
-            } else {
-                frame_convert_rgb565(callback, [&]() {
-                    return *src++;
-                });
-            }
+            // We can't use buffer_size because our pointer is uint16_t
+            uint layer_size = this->bounds.w * this->bounds.h;
+
+            frame_convert_kernel(target, 16, [&](void *buffer, uint offset, uint count) {
+                composite((RGB565 *)buffer, offset, count,
+                    [&](RGB565 *dst, uint offset, uint count) {memcpy(dst, src + offset, count * sizeof(RGB565));},
+                    [&](uint layer, uint i) {return uint(src[layer_size * layer + i]);},
+                    [&](uint c) {return RGB565(c);});
+            });
         }
     }
 
     void PicoGraphics_PenRGB565::set_pixel_alpha(const Point &p, const uint8_t a) {
         if(!bounds.contains(p)) return;
+        touch(p);
 
         uint16_t *buf = (uint16_t *)frame_buffer;
         buf += this->layer_offset;
@@ -74,28 +93,15 @@ namespace pimoroni {
     };
 
     void PicoGraphics_PenRGB565::sprite(void* data, const Point &sprite, const Point &dest, const int scale, const int transparent) {
-        //int sprite_x = (sprite & 0x0f) << 3;
-        //int sprite_y = (sprite & 0xf0) >> 1;
-        Point s {
-            sprite.x << 3,
-            sprite.y << 3
-        };
-        RGB565 *ptr = (RGB565 *)data;
-        Point o = {0, 0};
-        for(o.y = 0; o.y < 8 * scale; o.y++) {
-            Point so = {
-                0,
-                o.y / scale
-            };
-            for(o.x = 0; o.x < 8 * scale; o.x++) {
-                so.x = o.x / scale;
-                color = ptr[(s.y + so.y) * 128 + (s.x + so.x)];
-                if(color != transparent) pixel(dest + o);
-            }
-        }
+        // sprites are 8x8 tiles on a 128 pixel wide sheet
+        PicoGraphics_PenRGB565 sheet(128, (sprite.y + 1) * 8, data);
+        uint flags = transparent >= 0 && transparent <= 0xffff ? BLIT_COLOUR_KEY : 0;
+        blit(&sheet, Rect(sprite.x * 8, sprite.y * 8, 8, 8), Rect(dest.x, dest.y, 8 * scale, 8 * scale), flags, RGB((RGB565)transparent));
     }
 
     bool PicoGraphics_PenRGB565::render_tile(const Tile *tile) {
+        touch(Rect(tile->x, tile->y, tile->w, tile->h));
+
         for(int y = 0; y < tile->h; y++) {
             uint8_t *p_alpha = &tile->data[(y * tile->stride)];
 
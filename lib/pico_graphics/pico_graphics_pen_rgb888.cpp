@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "pico_graphics.hpp"
 
 namespace pimoroni {
@@ -5,7 +7,7 @@ namespace pimoroni {
     : PicoGraphics(width, height, layers, frame_buffer) {
         this->pen_type = PEN_RGB888;
         if(this->frame_buffer == nullptr) {
-            this->frame_buffer = (void *)(new uint8_t[buffer_size(width, height)]);
+            this->frame_buffer = allocate_frame_buffer(buffer_size(width, height));
         }
     }
     void PicoGraphics_PenRGB888::set_pen(uint c) {
@@ -22,11 +24,13 @@ namespace pimoroni {
         return RGB::from_hsv(h, s, v).to_rgb888();
     }
     void PicoGraphics_PenRGB888::set_pixel(const Point &p) {
+        touch(p);
         uint32_t *buf = (uint32_t *)frame_buffer;
         buf += this->layer_offset;
         buf[p.y * bounds.w + p.x] = color;
     }
     void PicoGraphics_PenRGB888::set_pixel_span(const Point &p, uint l) {
+        touch(p, l);
         // pointer to byte in framebuffer that contains this pixel
         uint32_t *buf = (uint32_t *)frame_buffer;
         buf += this->layer_offset;
@@ -36,6 +40,67 @@ namespace pimoroni {
             *buf++ = color;
         }
     }
+    void PicoGraphics_PenRGB888::set_pixel_column(const Point &p, uint l) {
+        touch_column(p, l);
+        uint32_t *buf = (uint32_t *)frame_buffer;
+        buf += this->layer_offset;
+        buf = &buf[p.y * bounds.w + p.x];
+
+        while(l--) {
+            *buf = color;
+            buf += bounds.w;
+        }
+    }
+    void PicoGraphics_PenRGB888::get_pixel_span(const Point &p, uint l, RGB *c) {
+        uint32_t *buf = (uint32_t *)frame_buffer;
+        buf += this->layer_offset;
+        buf = &buf[p.y * bounds.w + p.x];
+
+        while(l--) {
+            *c++ = RGB((uint)*buf++);
+        }
+    }
+    void PicoGraphics_PenRGB888::set_pixel_alpha(const Point &p, const uint8_t a) {
+        if(!bounds.contains(p)) return;
+        touch(p);
+
+        uint32_t *buf = (uint32_t *)frame_buffer;
+        buf += this->layer_offset;
+
+        RGB888 blended = RGB((uint)buf[p.y * bounds.w + p.x]).blend(RGB((uint)color), a).to_rgb888();
+
+        buf[p.y * bounds.w + p.x] = blended;
+    }
+    void PicoGraphics_PenRGB888::frame_convert(PenType type, const ConvertBuffers &target) {
+        uint32_t *src = (uint32_t *)frame_buffer;
+        uint layer_size = bounds.w * bounds.h;
+
+        auto fetch = [&](uint layer, uint i) {
+            return uint(src[layer_size * layer + i] & 0xffffff);
+        };
+
+        if(type == PEN_RGB565) {
+            auto to_rgb565 = [](uint c) {
+                uint16_t p = ((c >> 8) & 0b1111100000000000) |
+                             ((c >> 5) & 0b0000011111100000) |
+                             ((c >> 3) & 0b0000000000011111);
+                return RGB565(__builtin_bswap16(p));
+            };
+            frame_convert_kernel(target, 16, [&](void *buffer, uint offset, uint count) {
+                composite((RGB565 *)buffer, offset, count,
+                    [&](RGB565 *dst, uint offset, uint count) {
+                        for(auto i = offset; i < offset + count; i++) *dst++ = to_rgb565(src[i]);
+                    },
+                    fetch, to_rgb565);
+            });
+        } else if(type == PEN_RGB888) {
+            frame_convert_kernel(target, 32, [&](void *buffer, uint offset, uint count) {
+                composite((RGB888 *)buffer, offset, count,
+                    [&](RGB888 *dst, uint offset, uint count) {memcpy(dst, src + offset, count * sizeof(RGB888));},
+                    fetch, [](uint c) {return RGB888(c);});
+            });
+        }
+    }
     bool PicoGraphics_PenRGB888::render_tile(const Tile *tile) {
         // Unpack our pen colour
         uint32_t sr = (color >> 16) & 0xff;
@@ -0,0 +1,57 @@
+#include "bench.hpp"
+#include "surfaces.hpp"
+#include "pico_scroll.hpp"
+#include "pico_sdk_mock.hpp"
+
+// PicoScroll::update_async(PicoGraphics *) on an unchanged 17x7 frame, so
+// each op is the conversion to brightness and the check for changed leds,
+// with nothing sent. with two layers the pens that have them composite
+// through RGB565 first
+using namespace bench;
+
+static void draw(PicoGraphics *g) {
+  for(auto y = 0; y < PicoScroll::HEIGHT; y++) {
+    for(auto x = 0; x < PicoScroll::WIDTH; x++) {
+      g->set_pen(x * 15, y * 36, 255 - x * 15);
+      g->pixel(Point(x, y));
+    }
+  }
+}
+
+// the pens with layers that are composited
+static bool layered(const std::string &pen) {
+  return pen == "P4" || pen == "P8" || pen == "RGB332" || pen == "RGB565" || pen == "RGB888";
+}
+
+BENCH_SUITE(pico_scroll) {
+  mock::reset();
+  mock::RegisterDevice device;
+  mock::bus(i2c0).attach(0x74, &device);
+  PicoScroll scroll;
+  scroll.init();
+
+  for(auto pen : pen_names()) {
+    for(uint16_t layers : {1, 2}) {
+      if(layers > 1 && !layered(pen)) continue;
+
+      Surface s = make_surface(pen, PicoScroll::WIDTH, PicoScroll::HEIGHT, layers);
+      draw(s.graphics.get());
+      if(layers > 1) {
+        s->set_layer(1);
+        s->set_pen(255, 255, 255);
+        s->rectangle(Rect(4, 2, 8, 3));
+      }
+
+      // the first update sends the frame, the rest find nothing changed
+      scroll.update(s.graphics.get());
+
+      Params params = {{"pen", pen}, {"layers", str(int64_t(layers))}};
+      Result *r = runner.run("pico_scroll", "convert", params, [&]() {
+        scroll.update_async(s.graphics.get());
+      });
+      if(r) {
+        r->counters.push_back({"conversions_per_sec", 1e9 / r->ns_per_op});
+      }
+    }
+  }
+}
@@ -6,7 +6,8 @@ add_library(pico_scroll INTERFACE)
 
 set(PICO_SCROLL_SOURCES
   ${CMAKE_CURRENT_LIST_DIR}/pico_scroll.cpp
-  ${CMAKE_CURRENT_LIST_DIR}/pico_scroll_font.cpp)
+  ${CMAKE_CURRENT_LIST_DIR}/pico_scroll_font.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/pico_scroll_text.cpp)
 
 target_sources(pico_scroll INTERFACE
   ${PICO_SCROLL_SOURCES}
@@ -15,4 +16,12 @@ target_sources(pico_scroll INTERFACE
 target_include_directories(pico_scroll INTERFACE ${CMAKE_CURRENT_LIST_DIR})
 
 # Pull in pico libraries that we need
-target_link_libraries(pico_scroll INTERFACE pico_stdlib pico_graphics hardware_i2c)
\ No newline at end of file
+target_link_libraries(pico_scroll INTERFACE pico_stdlib pico_graphics hardware_i2c hardware_dma)
+
+# host build, alongside the pico_graphics benchmarks
+if(TARGET pico_graphics_bench_harness)
+  add_executable(pico_scroll_bench
+    ${CMAKE_CURRENT_LIST_DIR}/bench/convert.cpp
+  )
+  target_link_libraries(pico_scroll_bench pico_scroll pico_graphics_bench_harness pico_graphics_surfaces)
+endif()
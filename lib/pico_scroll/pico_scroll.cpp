@@ -3,6 +3,7 @@
 
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
+#include "hardware/dma.h"
 
 #include "pico_scroll.hpp"
 #include "pico_scroll_font.hpp"
@@ -35,9 +36,36 @@ enum reg {
 
 namespace pimoroni {
 
+  // the panel is wired as two interleaved halves, this gives the offset in
+  // the framebuffer of each pixel in raster order
+  struct PixelMap {
+    uint8_t offset[PicoScroll::WIDTH * PicoScroll::HEIGHT];
+
+    constexpr PixelMap() : offset() {
+      for(uint8_t y = 0; y < PicoScroll::HEIGHT; y++) {
+        for(uint8_t x = 0; x < PicoScroll::WIDTH; x++) {
+          uint8_t px = x, py = (PicoScroll::HEIGHT - 1) - y;
+          if(px > 8) {
+            px = px - 8;
+            py = (PicoScroll::HEIGHT - 1) - (py + 8);
+          } else {
+            px = 8 - px;
+          }
+          offset[y * PicoScroll::WIDTH + x] = px * (PicoScroll::WIDTH - 1) + py;
+        }
+      }
+    }
+  };
+
+  static constexpr PixelMap pixel_map;
+
   PicoScroll::~PicoScroll() {
     clear();
     update();
+
+    if(__dma_channel >= 0) {
+      dma_channel_unclaim(__dma_channel);
+    }
   }
 
   void PicoScroll::init() {
@@ -62,24 +90,23 @@ namespace pimoroni {
     gpio_set_function(pin::X, GPIO_FUNC_SIO); gpio_set_dir(pin::X, GPIO_IN); gpio_pull_up(pin::X);
     gpio_set_function(pin::Y, GPIO_FUNC_SIO); gpio_set_dir(pin::Y, GPIO_IN); gpio_pull_up(pin::Y);
 
+    // frames are sent by dma, which feeds the i2c tx fifo
+    __dma_channel = dma_claim_unused_channel(false);
+
     // reset the screen
     clear();
     update();
   }
 
   void PicoScroll::set_pixel(uint8_t x, uint8_t y, uint8_t v) {
-    if(x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT) return;
-
-    y = (HEIGHT - 1) - y;
-    if(x > 8) {
-      x = x - 8;
-      y = (HEIGHT - 1) - (y + 8);
-    }else{
-      x = 8 - x;
-    }
+    if(x >= WIDTH || y >= HEIGHT) return;
 
-    uint8_t o = x * (WIDTH - 1) + y;
-    __fb[o] = v;
+    __fb[pixel_map.offset[y * WIDTH + x]] = v;
+  }
+
+  void PicoScroll::set_gamma(float gamma) {
+    __gamma_value = gamma;
+    __gamma_built = false;
   }
 
   bool PicoScroll::is_pressed(uint8_t button) {
@@ -162,10 +189,161 @@ namespace pimoroni {
   }
 
   void PicoScroll::update() {
-    i2c_write(COLOR_OFFSET, (const char *)__fb, BUFFER_SIZE);
+    update_async();
+    wait_for_update();
+  }
+
+  // append a register write to the i2c commands, writes after the first
+  // begin with a repeated start so an update is a single transfer
+  static uint16_t *queue_write(uint16_t *tx, bool first, uint8_t reg, const uint8_t *data, uint len) {
+    *tx++ = reg | (first ? 0 : I2C_IC_DATA_CMD_RESTART_BITS);
+    while(len--) {
+      *tx++ = *data++;
+    }
+    return tx;
+  }
+
+  uint16_t *PicoScroll::queue_dirty(uint16_t *tx, uint bank) {
+    const uint8_t *shadow = __shadow[bank];
+    bool valid = __shadow_valid[bank];
+    bool first = tx == __tx[__tx_next];
+
+    uint i = 0;
+    while(i < BUFFER_SIZE) {
+      if(valid && __fb[i] == shadow[i]) {
+        i++;
+        continue;
+      }
+
+      // extend the write over short clean runs to the last dirty byte
+      uint end = i + 1;
+      for(uint j = end; j < BUFFER_SIZE && j - end <= MERGE_GAP; j++) {
+        if(!valid || __fb[j] != shadow[j]) end = j + 1;
+      }
+
+      tx = queue_write(tx, first, COLOR_OFFSET + i, &__fb[i], end - i);
+      first = false;
+      i = end;
+    }
+
+    memcpy(__shadow[bank], __fb, BUFFER_SIZE);
+    __shadow_valid[bank] = true;
+    return tx;
+  }
+
+  void PicoScroll::update_async() {
+    // fill the idle buffer before waiting, so that overlaps the last frame
+    uint16_t *start = __tx[__tx_next];
+    uint16_t *tx = start;
+
+    if(__page_flip) {
+      // nothing to do if the visible bank already shows this frame
+      if(__shadow_valid[__bank] && memcmp(__fb, __shadow[__bank], BUFFER_SIZE) == 0) return;
+
+      uint8_t bank = __bank ^ 1;
+      uint8_t function_bank = 0x0b;
+      tx = queue_write(tx, true, BANK_ADDRESS, &bank, 1);
+      tx = queue_dirty(tx, bank);
+      tx = queue_write(tx, false, BANK_ADDRESS, &function_bank, 1);
+      tx = queue_write(tx, false, FRAME_REGISTER, &bank, 1);
+      __bank = bank;
+    } else {
+      tx = queue_dirty(tx, 0);
+      if(tx == start) return;
+    }
+
+    tx[-1] |= I2C_IC_DATA_CMD_STOP_BITS;
+    __tx_next ^= 1;
+
+    send(start, tx - start);
+  }
+
+  void PicoScroll::send(const uint16_t *tx, uint count) {
+    wait_for_update();
+
+    if(__dma_channel < 0) {
+      // split the commands back into separate blocking writes
+      uint8_t buffer[TX_SIZE];
+      uint length = 0;
+      for(uint i = 0; i < count; i++) {
+        if(i > 0 && (tx[i] & I2C_IC_DATA_CMD_RESTART_BITS)) {
+          i2c_write_blocking(i2c0, DEFAULT_ADDRESS, buffer, length, false);
+          length = 0;
+        }
+        buffer[length++] = tx[i] & 0xff;
+      }
+      i2c_write_blocking(i2c0, DEFAULT_ADDRESS, buffer, length, false);
+      return;
+    }
+
+    i2c_hw_t *hw = i2c_get_hw(i2c0);
+    hw->enable = 0;
+    hw->tar = DEFAULT_ADDRESS;
+    hw->enable = 1;
+    (void)hw->clr_stop_det;
+
+    dma_channel_config config = dma_channel_get_default_config(__dma_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_dreq(&config, i2c_get_dreq(i2c0, true));
+    dma_channel_configure(__dma_channel, &config, &hw->data_cmd, tx, count, true);
+
+    __dma_pending = true;
+  }
+
+  bool PicoScroll::update_in_progress() {
+    if(!__dma_pending) return false;
+
+    // the dma finishes once the last byte is queued, the frame has been sent
+    // when the stop condition goes out. a nak aborts the transfer and the
+    // fifo stops taking data, so the dma has to be stopped too
+    i2c_hw_t *hw = i2c_get_hw(i2c0);
+    uint32_t status = hw->raw_intr_stat;
+    if(status & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+      dma_channel_abort(__dma_channel);
+      (void)hw->clr_tx_abrt;
+
+      // the panel may have taken some of the frame, so resend all of it
+      __shadow_valid[0] = __shadow_valid[1] = false;
+    } else if(dma_channel_is_busy(__dma_channel) || !(status & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS)) {
+      return true;
+    }
+
+    (void)hw->clr_stop_det;
+    __dma_pending = false;
+    return false;
+  }
+
+  void PicoScroll::wait_for_update() {
+    while(update_in_progress()) {
+      tight_loop_contents();
+    }
+  }
+
+  void PicoScroll::set_page_flip(bool enable) {
+    if(enable == __page_flip) return;
+    wait_for_update();
+
+    if(enable) {
+      // the second bank needs its leds enabling like the first
+      i2c_write(reg::BANK_ADDRESS, "\x01", 1);
+      i2c_write(reg::ENABLE_OFFSET, "\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x00", 18);
+      __shadow_valid[1] = false;
+    } else {
+      // back to writing and showing the first bank
+      i2c_write(reg::BANK_ADDRESS, "\x0b", 1);
+      i2c_write(reg::FRAME_REGISTER, "\x00", 1);
+      i2c_write(reg::BANK_ADDRESS, "\x00", 1);
+      __bank = 0;
+    }
+
+    __page_flip = enable;
   }
 
   void PicoScroll::i2c_write(uint8_t reg, const char *data, uint8_t len) {
+    wait_for_update();
+
     uint8_t buffer[256];
     buffer[0] = reg;
     memcpy(&buffer[1], data, len);
@@ -173,59 +351,137 @@ namespace pimoroni {
   }
 
   void PicoScroll::update(PicoGraphics *graphics) {
-    if(graphics->pen_type == PicoGraphics::PEN_RGB888) {
-      uint32_t *p = (uint32_t *)graphics->frame_buffer;
-
-      for(int y = 0; y < HEIGHT; y++) {
-        for(int x = 0; x < WIDTH; x++) {
-          uint32_t col = *p;
-          uint8_t r = (col & 0xff0000) >> 16;
-          uint8_t g = (col & 0x00ff00) >>  8;
-          uint8_t b = (col & 0x0000ff) >>  0;
-          p++;
-
-          set_pixel(x, y, (r + g + b) / 3);
-        }
-      }
+    convert(graphics);
+    update();
+  }
 
-      update();
+  void PicoScroll::update_async(PicoGraphics *graphics) {
+    convert(graphics);
+    update_async();
+  }
+
+  void PicoScroll::convert(PicoGraphics *graphics) {
+    if(!__gamma_built) {
+      for(uint i = 0; i < 256; i++) {
+        __gamma[i] = roundf(powf(i / 255.0f, __gamma_value) * 255.0f);
+      }
+      __gamma_built = true;
     }
-    else if(graphics->pen_type == PicoGraphics::PEN_RGB565) {
-      uint16_t *p = (uint16_t *)graphics->frame_buffer;
-      for(int y = 0; y < HEIGHT; y++) {
-        for(int x = 0; x < WIDTH; x++) {
-          uint16_t col = __builtin_bswap16(*p);
-          uint8_t r = (col & 0b1111100000000000) >> 8;
-          uint8_t g = (col & 0b0000011111100000) >> 3;
-          uint8_t b = (col & 0b0000000000011111) << 3;
-          p++;
-
-          set_pixel(x, y, (r + g + b) / 3);
+
+    // rec. 709 luminance, the weights add up to 256
+    const uint8_t *gamma = __gamma;
+    auto level = [gamma](uint r, uint g, uint b) -> uint8_t {
+      return gamma[(r * 54 + g * 183 + b * 19) >> 8];
+    };
+
+    auto level565 = [&level](uint16_t c) {
+      c = __builtin_bswap16(c);
+      uint r = (c >> 11) & 0x1f, g = (c >> 5) & 0x3f, b = c & 0x1f;
+      return level((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+    };
+    auto level332 = [&level](uint8_t c) {
+      RGB rgb((RGB332)c);
+      return level(rgb.r, rgb.g, rgb.b);
+    };
+
+    int w = graphics->bounds.w < WIDTH ? graphics->bounds.w : WIDTH;
+    int h = graphics->bounds.h < HEIGHT ? graphics->bounds.h : HEIGHT;
+    uint stride = graphics->bounds.w;
+    const uint8_t *map = pixel_map.offset;
+
+    // layers are composited by the pen, into RGB565 a run at a time. the
+    // other pens draw every layer into the one framebuffer
+    if(graphics->layers > 1) {
+      switch(graphics->pen_type) {
+        case PicoGraphics::PEN_P4:
+        case PicoGraphics::PEN_P8:
+        case PicoGraphics::PEN_RGB332:
+        case PicoGraphics::PEN_RGB565:
+        case PicoGraphics::PEN_RGB888: {
+          // RGB332 loses its low bits going to RGB565, so take it back again
+          bool rgb332 = graphics->pen_type == PicoGraphics::PEN_RGB332;
+          uint i = 0;
+          uint end = h * stride;
+          graphics->frame_convert(PicoGraphics::PEN_RGB565, [&](void *data, size_t length) {
+            const uint16_t *src = (const uint16_t *)data;
+            for(size_t n = 0; n < length / sizeof(uint16_t) && i < end; n++, i++) {
+              uint x = i % stride;
+              if(x >= uint(w)) continue;
+              __fb[map[(i / stride) * WIDTH + x]] = rgb332 ? level332(PicoGraphics::rgb565_to_rgb332(src[n])) : level565(src[n]);
+            }
+          });
+          return;
         }
+        default:
+          break;
       }
-
-      update();
     }
-    else if(graphics->pen_type == PicoGraphics::PEN_P8 || graphics->pen_type == PicoGraphics::PEN_P4) {
-      int offset = 0;
-      graphics->frame_convert(PicoGraphics::PEN_RGB888, [this, offset](void *data, size_t length) mutable {
-        uint32_t *p = (uint32_t *)data;
-        for(auto i = 0u; i < length / 4; i++) {
-          int x = offset % WIDTH;
-          int y = offset / WIDTH;
-
-          uint32_t col = *p;
-          uint8_t r = (col & 0xff0000) >> 16;
-          uint8_t g = (col & 0x00ff00) >>  8;
-          uint8_t b = (col & 0x0000ff) >>  0;
-
-          set_pixel(x, y, (r + g + b) / 3);
-          offset++;
-          p++;
-        }
-      });
 
-      update();
+    // read the framebuffer directly for the common pens, including the
+    // palette ones, and fall back to asking the pen for anything else
+    auto each_pixel = [&](auto pixel) {
+      for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+          __fb[map[y * WIDTH + x]] = pixel(y * stride + x);
+        }
+      }
+    };
+
+    switch(graphics->pen_type) {
+      case PicoGraphics::PEN_RGB888: {
+        const uint32_t *src = (const uint32_t *)graphics->frame_buffer;
+        each_pixel([&](uint i) {
+          uint32_t c = src[i];
+          return level((c >> 16) & 0xff, (c >> 8) & 0xff, c & 0xff);
+        });
+        break;
+      }
+      case PicoGraphics::PEN_RGB565: {
+        const uint16_t *src = (const uint16_t *)graphics->frame_buffer;
+        each_pixel([&](uint i) {
+          return level565(src[i]);
+        });
+        break;
+      }
+      case PicoGraphics::PEN_RGB332: {
+        const uint8_t *src = (const uint8_t *)graphics->frame_buffer;
+        each_pixel([&](uint i) {
+          return level332(src[i]);
+        });
+        break;
+      }
+      case PicoGraphics::PEN_P8: {
+        const uint8_t *src = (const uint8_t *)graphics->frame_buffer;
+        const RGB *palette = graphics->get_palette();
+        each_pixel([&](uint i) {
+          const RGB &c = palette[src[i]];
+          return level(c.r, c.g, c.b);
+        });
+        break;
+      }
+      case PicoGraphics::PEN_P4: {
+        // a level for each of the 16 palette entries, then two pixels a byte
+        uint8_t levels[16];
+        const RGB *palette = graphics->get_palette();
+        for(uint c = 0; c < 16; c++) {
+          levels[c] = level(palette[c].r, palette[c].g, palette[c].b);
+        }
+        const uint8_t *src = (const uint8_t *)graphics->frame_buffer;
+        each_pixel([&](uint i) {
+          return levels[(src[i / 2] >> ((~i & 1) * 4)) & 0xf];
+        });
+        break;
+      }
+      default: {
+        RGB row[WIDTH];
+        for(int y = 0; y < h; y++) {
+          graphics->get_pixel_span(Point(0, y), w, row);
+          for(int x = 0; x < w; x++) {
+            __fb[map[y * WIDTH + x]] = level(row[x].r, row[x].g, row[x].b);
+          }
+        }
+        break;
+      }
     }
   }
 }
\ No newline at end of file
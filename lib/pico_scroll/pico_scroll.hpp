@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <atomic>
 #include "pico_graphics.hpp"
 
 namespace pimoroni {
@@ -18,12 +19,49 @@ namespace pimoroni {
     static const uint8_t Y = 15;
 
   private:
+    // clean runs up to this long are rewritten rather than starting a new
+    // write, which costs a restart, the address and the register
+    static const uint MERGE_GAP = 2;
+
+    // room for the frame as register writes, plus selecting and showing a
+    // frame bank when page flipping
+    static const uint TX_SIZE = BUFFER_SIZE + 7;
+
     uint8_t __fb[BUFFER_SIZE];
+
+    // brightness for each luminance when converting from PicoGraphics
+    uint8_t __gamma[256];
+    float __gamma_value = 2.2f;
+    bool __gamma_built = false;
+
+    // what each of the two frame banks in use last had written to it
+    uint8_t __shadow[2][BUFFER_SIZE];
+    bool __shadow_valid[2] = {false, false};
+    bool __page_flip = false;
+    uint8_t __bank = 0;
+
+    // i2c commands for an update, each a 16-bit data/command word, one
+    // being sent while the other is filled
+    uint16_t __tx[2][TX_SIZE];
+    uint __tx_next = 0;
+    int __dma_channel = -1;
+    bool __dma_pending = false;
   
   public:
     ~PicoScroll();
     void init();
     void update();
+
+    // start sending the frame and return straight away, the framebuffer can
+    // be drawn into again immediately. waits only if the previous frame is
+    // still being sent
+    void update_async();
+    bool update_in_progress();
+    void wait_for_update();
+
+    // draw each frame into the hidden bank of two and then show it, rather
+    // than updating the visible one as it is being displayed
+    void set_page_flip(bool enable);
     void set_pixels(const char *pixels);
     void set_bitmap_1d(const char *bitmap, size_t bitmap_len, int brightness, int offset);
     void scroll_text(const char *text, size_t text_len, int brightness, int delay_ms);
@@ -35,12 +73,78 @@ namespace pimoroni {
       set_text(text.c_str(), text.length(), brightness, offset);
     }
     void set_pixel(uint8_t x, uint8_t y, uint8_t v);
+
+    // gamma applied to luminance when updating from PicoGraphics, 1.0 for
+    // brightness proportional to luminance
+    void set_gamma(float gamma);
     void clear();
     bool is_pressed(uint8_t button);
 
+    // convert the top left 17x7 of graphics to brightness and send it. the
+    // layers of P4, P8, RGB332, RGB565 and RGB888 pens are composited first
+    // (through RGB565, so brightness may be a step or two out)
     void update(PicoGraphics *graphics);
+    void update_async(PicoGraphics *graphics);
   private:
     void i2c_write(uint8_t reg, const char *data, uint8_t len);
+    uint16_t *queue_dirty(uint16_t *tx, uint bank);
+    void send(const uint16_t *tx, uint count);
+    void convert(PicoGraphics *graphics);
+  };
+
+  // Scrolls text across a PicoScroll without blocking. Text is rendered into
+  // a ring of columns as it is appended, and tick() moves it along and sends
+  // a frame when it has moved, so it can be called often from a loop or a
+  // FreeRTOS timer. One task may append while another ticks.
+  class PicoScrollText {
+  public:
+    uint8_t brightness;
+    uint32_t column_ms;
+
+    // blend neighbouring columns to move a fraction of a column at a time
+    bool smooth = true;
+
+    PicoScrollText(PicoScroll &scroll, uint8_t brightness = 64, uint32_t column_ms = 100,
+                   uint ring_size = 512, uint8_t *ring = nullptr);
+    ~PicoScrollText();
+
+    // add text to the end, entering from the right if the display has run
+    // out of text. returns false if there isn't room for all of it yet
+    bool append(const char *text, size_t text_len);
+    bool append(std::string text) {
+      return append(text.c_str(), text.length());
+    }
+
+    // advance to now_ms, returns true if a frame was sent
+    bool tick(uint32_t now_ms);
+
+    // drop any text not yet shown, call from the ticking task
+    void clear();
+
+    // all of the text has scrolled off
+    bool idle() const { return position.load() >= written.load(); }
+
+  private:
+    PicoScroll &scroll;
+    uint8_t *ring;
+    uint ring_size;
+    bool owns_ring;
+
+    // absolute column counts, the left edge of the display and the end of
+    // the text. position is only moved by tick, written only by append
+    std::atomic<uint32_t> position{0};
+    std::atomic<uint32_t> written{0};
+    uint8_t fraction = 0;
+    uint32_t carry = 0;
+
+    bool started = false;
+    uint32_t last_ms = 0;
+    bool drawn = false;
+    uint32_t drawn_position = 0;
+    uint8_t drawn_fraction = 0;
+
+    uint8_t column(uint32_t c, uint32_t end) const;
+    void draw(uint32_t pos, uint32_t end, uint8_t fraction);
   };
 
 }
\ No newline at end of file
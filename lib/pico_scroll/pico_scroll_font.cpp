@@ -139,7 +139,7 @@ int render_text(const char *text, unsigned int nchr, unsigned char *buffer, unsi
     memset(buffer, 0, nbfr);
 
     for (unsigned int i = 0; i < nchr; i++) {
-        const unsigned char *symbol = __bitmap[(unsigned int)text[i]];
+        const unsigned char *symbol = __bitmap[(unsigned char)text[i]];
         for (unsigned int j = 0; j < 5; j++) {
             unsigned int offset = i * 6 + j;
             if (offset >= nbfr) return -1;
@@ -0,0 +1,115 @@
+#include <string.h>
+#include <algorithm>
+
+#include "pico_scroll.hpp"
+#include "pico_scroll_font.hpp"
+
+namespace pimoroni {
+
+  // columns rendered for each character, five of glyph and one of space
+  static const uint CHAR_COLUMNS = 6;
+
+  PicoScrollText::PicoScrollText(PicoScroll &scroll, uint8_t brightness, uint32_t column_ms, uint ring_size, uint8_t *ring)
+    : brightness(brightness), column_ms(column_ms), scroll(scroll), ring(ring), ring_size(ring_size), owns_ring(ring == nullptr) {
+    if(this->ring == nullptr) {
+      this->ring = new uint8_t[ring_size];
+    }
+  }
+
+  PicoScrollText::~PicoScrollText() {
+    if(owns_ring) delete[] ring;
+  }
+
+  bool PicoScrollText::append(const char *text, size_t text_len) {
+    uint32_t pos = position.load(std::memory_order_acquire);
+    uint32_t end = written.load(std::memory_order_relaxed);
+
+    // start off the right hand edge if the current text ends on screen
+    uint32_t lead = pos + PicoScroll::WIDTH > end ? pos + PicoScroll::WIDTH - end : 0;
+    if(end - pos + lead + text_len * CHAR_COLUMNS > ring_size) return false;
+
+    while(lead--) {
+      ring[end++ % ring_size] = 0;
+    }
+
+    for(size_t i = 0; i < text_len; i++) {
+      unsigned char columns[CHAR_COLUMNS];
+      render_text(&text[i], 1, columns, CHAR_COLUMNS);
+      for(uint j = 0; j < CHAR_COLUMNS; j++) {
+        ring[end++ % ring_size] = columns[j];
+      }
+    }
+
+    // publish the new columns only once they are written
+    written.store(end, std::memory_order_release);
+    return true;
+  }
+
+  void PicoScrollText::clear() {
+    position.store(written.load(std::memory_order_acquire), std::memory_order_release);
+    fraction = 0;
+    carry = 0;
+  }
+
+  uint8_t PicoScrollText::column(uint32_t c, uint32_t end) const {
+    return int32_t(end - c) > 0 ? ring[c % ring_size] : 0;
+  }
+
+  void PicoScrollText::draw(uint32_t pos, uint32_t end, uint8_t fraction) {
+    for(int x = 0; x < PicoScroll::WIDTH; x++) {
+      uint8_t a = column(pos + x, end);
+      uint8_t b = fraction ? column(pos + x + 1, end) : 0;
+      for(int y = 0; y < PicoScroll::HEIGHT; y++) {
+        uint va = ((a >> y) & 1) * brightness;
+        uint vb = ((b >> y) & 1) * brightness;
+        scroll.set_pixel(x, y, (va * (256 - fraction) + vb * fraction) >> 8);
+      }
+    }
+  }
+
+  bool PicoScrollText::tick(uint32_t now_ms) {
+    if(!started) {
+      started = true;
+      last_ms = now_ms;
+    }
+
+    // cap the step so a long stall can't overflow the arithmetic below
+    uint32_t elapsed = std::min<uint32_t>(now_ms - last_ms, 60000);
+    last_ms = now_ms;
+
+    uint32_t end = written.load(std::memory_order_acquire);
+    uint32_t pos = position.load(std::memory_order_relaxed);
+
+    if(int32_t(end - pos) > 0) {
+      // advance in 1/256ths of a column, keeping the remainder of the time
+      uint32_t total = elapsed * 256 + carry;
+      uint32_t step = std::max<uint32_t>(column_ms, 1);
+      uint32_t sub = fraction + total / step;
+      carry = total % step;
+      pos += sub >> 8;
+      fraction = sub & 0xff;
+
+      if(int32_t(end - pos) <= 0) {
+        pos = end;
+        fraction = 0;
+        carry = 0;
+      }
+      position.store(pos, std::memory_order_release);
+    }
+
+    uint8_t shown = smooth ? fraction : 0;
+    if(drawn && pos == drawn_position && shown == drawn_fraction) return false;
+
+    // don't hold up the caller waiting for the last frame, try again next tick
+    if(scroll.update_in_progress()) return false;
+
+    draw(pos, end, shown);
+    scroll.update_async();
+
+    drawn = true;
+    drawn_position = pos;
+    drawn_fraction = shown;
+    return true;
+  }
+
+}
@@ -0,0 +1,133 @@
+#include <cstring>
+
+#include "bench.hpp"
+#include "surfaces.hpp"
+#include "tile_codec.hpp"
+
+// TileCodec on a recorded sequence of UI frames at 320x240: a list with a
+// moving selection, a progress bar and a ticking clock drawn by each pen
+// with a row-major framebuffer. keyframe encodes every tile of the first
+// frame, update encodes the tiles that changed between frames against the
+// previous one, and decode applies the keyframe. ratio is the size of the
+// pixels encoded over the size of the encoded tiles, mb_per_sec is pixel
+// data (in the framebuffer's format) per second
+using namespace bench;
+
+static const uint16_t WIDTH = 320;
+static const uint16_t HEIGHT = 240;
+static const uint32_t FRAMES = 16;
+
+static void draw_ui(PicoGraphics *g, uint32_t n) {
+  g->set_pen(0, 0, 0);
+  g->clear();
+
+  // title bar with a clock that changes every frame
+  g->set_pen(0, 0, 255);
+  g->rectangle(Rect(0, 0, WIDTH, 20));
+  g->set_pen(255, 255, 255);
+  g->set_font("bitmap8");
+  g->text("Settings", Point(4, 4), WIDTH, 1.0f);
+  char clock[16];
+  snprintf(clock, sizeof(clock), "12:%02u:%02u", (n / 60) % 60, n % 60);
+  g->text(clock, Point(WIDTH - 60, 4), WIDTH, 1.0f);
+
+  // a list of items, the selected one highlighted
+  static const char *items[] = {"Wi-Fi", "Bluetooth", "Display", "Sound", "Storage", "Battery", "About", "Reset"};
+  for(auto i = 0u; i < 8; i++) {
+    int32_t y = 28 + i * 22;
+    if(i == n % 8) {
+      g->set_pen(255, 128, 0);
+      g->rectangle(Rect(4, y - 2, WIDTH - 8, 20));
+      g->set_pen(0, 0, 0);
+    } else {
+      g->set_pen(128, 128, 128);
+    }
+    g->text(items[i], Point(10, y + 2), WIDTH, 1.0f);
+  }
+
+  // progress bar along the bottom
+  g->set_pen(64, 64, 64);
+  g->rectangle(Rect(10, HEIGHT - 30, WIDTH - 20, 12));
+  g->set_pen(0, 255, 0);
+  g->rectangle(Rect(10, HEIGHT - 30, (WIDTH - 20) * (n + 1) / FRAMES, 12));
+}
+
+BENCH_SUITE(tile_codec) {
+  static const struct { const char *pen; uint8_t bits; } formats[] = {
+    {"1Bit", 1}, {"P4", 4}, {"P8", 8}, {"RGB565", 16}, {"RGB888", 32}
+  };
+
+  for(auto format : formats) {
+    // record the frames as the framebuffer holds them
+    Surface s = make_surface(format.pen, WIDTH, HEIGHT);
+    size_t frame_bytes = (WIDTH * HEIGHT * format.bits + 7) / 8;
+    std::vector<std::vector<uint8_t>> frames;
+    for(auto n = 0u; n < FRAMES; n++) {
+      draw_ui(s.graphics.get(), n);
+      uint8_t *fb = (uint8_t *)s->frame_buffer;
+      frames.emplace_back(fb, fb + frame_bytes);
+    }
+
+    for(uint8_t tile_size : {8, 16}) {
+      TileCodec codec(WIDTH, HEIGHT, format.bits, tile_size);
+      std::vector<uint8_t> out(codec.max_encoded_size());
+      Params params = {{"pen", format.pen}, {"tile", str(int64_t(tile_size))}, {"size", "320x240"}};
+
+      // the keyframe, encoded once more to have something to decode
+      std::vector<uint8_t> keyframe;
+      for(uint32_t t = 0; t < codec.tile_count(); t++) {
+        size_t length = codec.encode(frames[0].data(), nullptr, t, out.data());
+        keyframe.insert(keyframe.end(), out.data(), out.data() + length);
+      }
+
+      Result *r = runner.run("tile_codec", "keyframe", params, [&]() {
+        for(uint32_t t = 0; t < codec.tile_count(); t++) {
+          codec.encode(frames[0].data(), nullptr, t, out.data());
+        }
+      });
+      if(r) {
+        r->counters.push_back({"ratio", double(frame_bytes) / keyframe.size()});
+        r->counters.push_back({"encoded_bytes", double(keyframe.size())});
+        r->counters.push_back({"mb_per_sec", frame_bytes * 1e3 / r->ns_per_op});
+      }
+
+      std::vector<uint8_t> decoded(frame_bytes);
+      r = runner.run("tile_codec", "decode", params, [&]() {
+        const uint8_t *p = keyframe.data();
+        const uint8_t *end = p + keyframe.size();
+        for(uint32_t t = 0; t < codec.tile_count() && p < end; t++) {
+          p += codec.decode(p, end - p, decoded.data(), t);
+        }
+      });
+      if(r) {
+        if(decoded != frames[0]) fprintf(stderr, "tile_codec: %s decoded keyframe differs\n", format.pen);
+        r->counters.push_back({"mb_per_sec", frame_bytes * 1e3 / r->ns_per_op});
+      }
+
+      // the changed tiles of each frame, as a frame stream sends them. raw
+      // is the size of those tiles unencoded
+      size_t raw = 0, encoded = 0;
+      for(auto n = 1u; n < FRAMES; n++) {
+        for(uint32_t t = 0; t < codec.tile_count(); t++) {
+          if(!codec.changed(frames[n].data(), frames[n - 1].data(), t)) continue;
+          raw += codec.max_encoded_size() - 1;
+          encoded += codec.encode(frames[n].data(), frames[n - 1].data(), t, out.data());
+        }
+      }
+
+      r = runner.run("tile_codec", "update", params, [&]() {
+        for(auto n = 1u; n < FRAMES; n++) {
+          for(uint32_t t = 0; t < codec.tile_count(); t++) {
+            if(!codec.changed(frames[n].data(), frames[n - 1].data(), t)) continue;
+            codec.encode(frames[n].data(), frames[n - 1].data(), t, out.data());
+          }
+        }
+      });
+      if(r) {
+        r->counters.push_back({"ratio", double(raw) / encoded});
+        r->counters.push_back({"bytes_per_frame", double(encoded) / (FRAMES - 1)});
+        r->counters.push_back({"frames_per_sec", (FRAMES - 1) * 1e9 / r->ns_per_op});
+      }
+    }
+  }
+}
@@ -0,0 +1,15 @@
+if(NOT TARGET tile_codec)
+    add_library(tile_codec
+        ${CMAKE_CURRENT_LIST_DIR}/tile_codec.cpp
+    )
+
+    target_include_directories(tile_codec INTERFACE ${CMAKE_CURRENT_LIST_DIR})
+
+    # host build, alongside the pico_graphics benchmarks
+    if(TARGET pico_graphics_bench_harness)
+        add_executable(tile_codec_bench
+            ${CMAKE_CURRENT_LIST_DIR}/bench/tile_codec.cpp
+        )
+        target_link_libraries(tile_codec_bench tile_codec pico_graphics_bench_harness pico_graphics_surfaces)
+    endif()
+endif()
@@ -0,0 +1,337 @@
+#include <string.h>
+#include <algorithm>
+
+#include "tile_codec.hpp"
+
+namespace pimoroni {
+
+  // longest run a single RLE entry can describe
+  static const uint32_t MAX_RUN = 256;
+
+  static const uint32_t MAX_PALETTE = 16;
+
+  TileCodec::TileCodec(uint16_t width, uint16_t height, uint8_t bits_per_pixel, uint8_t tile_size)
+    : width(width), height(height), bits_per_pixel(bits_per_pixel), tile_size(tile_size == 8 ? 8 : MAX_TILE_SIZE) {
+    tiles_x = (width + this->tile_size - 1) / this->tile_size;
+    tiles_y = (height + this->tile_size - 1) / this->tile_size;
+    value_bytes = bits_per_pixel < 8 ? 1 : bits_per_pixel / 8;
+  }
+
+  size_t TileCodec::max_encoded_size() const {
+    return 1 + (tile_size * tile_size * bits_per_pixel + 7) / 8;
+  }
+
+  void TileCodec::tile_rect(uint32_t tile, uint32_t &x, uint32_t &y, uint32_t &w, uint32_t &h) const {
+    x = (tile % tiles_x) * tile_size;
+    y = (tile / tiles_x) * tile_size;
+    w = std::min<uint32_t>(tile_size, width - x);
+    h = std::min<uint32_t>(tile_size, height - y);
+  }
+
+  uint32_t TileCodec::read_value(const uint8_t *p) const {
+    uint32_t v = 0;
+    memcpy(&v, p, value_bytes);
+    return v;
+  }
+
+  void TileCodec::write_value(uint8_t *p, uint32_t v) const {
+    memcpy(p, &v, value_bytes);
+  }
+
+  uint32_t TileCodec::get(const uint8_t *frame, uint32_t i) const {
+    if(bits_per_pixel >= 8) return read_value(frame + i * value_bytes);
+    uint32_t bit = i * bits_per_pixel;
+    return (frame[bit / 8] >> (8 - bits_per_pixel - bit % 8)) & ((1u << bits_per_pixel) - 1);
+  }
+
+  void TileCodec::put(uint8_t *frame, uint32_t i, uint32_t v) const {
+    if(bits_per_pixel >= 8) {
+      write_value(frame + i * value_bytes, v);
+      return;
+    }
+    uint32_t bit = i * bits_per_pixel;
+    uint32_t shift = 8 - bits_per_pixel - bit % 8;
+    uint8_t mask = ((1u << bits_per_pixel) - 1) << shift;
+    frame[bit / 8] = (frame[bit / 8] & ~mask) | ((v << shift) & mask);
+  }
+
+  bool TileCodec::byte_aligned(uint32_t i, uint32_t count) const {
+    // packed pixels can be compared and copied a byte at a time when they
+    // start and end on a byte boundary, which is usual for even widths
+    return (i * bits_per_pixel) % 8 == 0 && (count * bits_per_pixel) % 8 == 0;
+  }
+
+  void TileCodec::read_tile(const uint8_t *frame, uint32_t tile, uint32_t *pixels) const {
+    uint32_t x, y, w, h;
+    tile_rect(tile, x, y, w, h);
+
+    for(uint32_t row = 0; row < h; row++) {
+      uint32_t i = (y + row) * width + x;
+      switch(bits_per_pixel) {
+        case 8:
+          for(uint32_t col = 0; col < w; col++) *pixels++ = frame[i + col];
+          break;
+        case 16: {
+          uint16_t v[MAX_TILE_SIZE];
+          memcpy(v, frame + i * 2, w * 2);
+          for(uint32_t col = 0; col < w; col++) *pixels++ = v[col];
+          break;
+        }
+        case 32:
+          memcpy(pixels, frame + i * 4, w * 4);
+          pixels += w;
+          break;
+        default:
+          for(uint32_t col = 0; col < w; col++) *pixels++ = get(frame, i + col);
+          break;
+      }
+    }
+  }
+
+  bool TileCodec::changed(const void *frame, const void *previous, uint32_t tile) const {
+    uint32_t x, y, w, h;
+    tile_rect(tile, x, y, w, h);
+    const uint8_t *a = (const uint8_t *)frame;
+    const uint8_t *b = (const uint8_t *)previous;
+
+    for(uint32_t row = 0; row < h; row++) {
+      uint32_t i = (y + row) * width + x;
+      if(byte_aligned(i, w)) {
+        size_t offset = i * bits_per_pixel / 8;
+        if(memcmp(a + offset, b + offset, w * bits_per_pixel / 8) != 0) return true;
+      } else {
+        for(uint32_t col = 0; col < w; col++) {
+          if(get(a, i + col) != get(b, i + col)) return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  void TileCodec::copy(const void *from, void *to, uint32_t tile) const {
+    uint32_t x, y, w, h;
+    tile_rect(tile, x, y, w, h);
+    const uint8_t *src = (const uint8_t *)from;
+    uint8_t *dst = (uint8_t *)to;
+
+    for(uint32_t row = 0; row < h; row++) {
+      uint32_t i = (y + row) * width + x;
+      if(byte_aligned(i, w)) {
+        memcpy(dst + i * bits_per_pixel / 8, src + i * bits_per_pixel / 8, w * bits_per_pixel / 8);
+      } else {
+        for(uint32_t col = 0; col < w; col++) put(dst, i + col, get(src, i + col));
+      }
+    }
+  }
+
+  static uint32_t count_runs(const uint32_t *pixels, uint32_t count) {
+    uint32_t runs = 1, run = 1;
+    for(uint32_t i = 1; i < count; i++) {
+      if(pixels[i] != pixels[i - 1] || run == MAX_RUN) {
+        runs++;
+        run = 1;
+      } else {
+        run++;
+      }
+    }
+    return runs;
+  }
+
+  size_t TileCodec::encode(const void *frame, const void *previous, uint32_t tile, uint8_t *out) const {
+    uint32_t x, y, w, h;
+    tile_rect(tile, x, y, w, h);
+    uint32_t count = w * h;
+
+    uint32_t pixels[MAX_TILE_SIZE * MAX_TILE_SIZE];
+    read_tile((const uint8_t *)frame, tile, pixels);
+
+    // count distinct values, up to a palette's worth
+    uint32_t palette[MAX_PALETTE];
+    uint32_t colours = 0;
+    for(uint32_t i = 0; i < count && colours <= MAX_PALETTE; i++) {
+      uint32_t c = 0;
+      while(c < colours && palette[c] != pixels[i]) c++;
+      if(c == colours) {
+        if(colours < MAX_PALETTE) palette[c] = pixels[i];
+        colours++;
+      }
+    }
+
+    uint8_t *p = out + 1;
+
+    if(colours == 1) {
+      out[0] = SOLID;
+      write_value(p, pixels[0]);
+      return 1 + value_bytes;
+    }
+
+    uint32_t index_bits = colours <= 2 ? 1 : colours <= 4 ? 2 : 4;
+    size_t raw_size = (count * bits_per_pixel + 7) / 8;
+    size_t rle_size = count_runs(pixels, count) * (1 + value_bytes);
+    size_t palette_size = colours <= MAX_PALETTE && index_bits < bits_per_pixel
+                        ? 1 + colours * value_bytes + (count * index_bits + 7) / 8 : SIZE_MAX;
+
+    // the difference from the previous frame is mostly zero where only part
+    // of the tile has changed
+    uint32_t delta[MAX_TILE_SIZE * MAX_TILE_SIZE];
+    size_t delta_size = SIZE_MAX;
+    if(previous) {
+      read_tile((const uint8_t *)previous, tile, delta);
+      for(uint32_t i = 0; i < count; i++) delta[i] ^= pixels[i];
+      delta_size = count_runs(delta, count) * (1 + value_bytes);
+    }
+
+    size_t best = std::min({raw_size, rle_size, palette_size, delta_size});
+
+    auto write_runs = [&](const uint32_t *values) {
+      for(uint32_t i = 0; i < count;) {
+        uint32_t run = 1;
+        while(i + run < count && run < MAX_RUN && values[i + run] == values[i]) run++;
+        *p++ = run - 1;
+        write_value(p, values[i]);
+        p += value_bytes;
+        i += run;
+      }
+    };
+
+    if(best == raw_size) {
+      out[0] = RAW;
+      if(bits_per_pixel >= 8) {
+        for(uint32_t i = 0; i < count; i++) {
+          write_value(p, pixels[i]);
+          p += value_bytes;
+        }
+      } else {
+        memset(p, 0, raw_size);
+        for(uint32_t i = 0; i < count; i++) put(p, i, pixels[i]);
+        p += raw_size;
+      }
+    } else if(best == palette_size) {
+      out[0] = PALETTE;
+      *p++ = colours;
+      for(uint32_t c = 0; c < colours; c++) {
+        write_value(p, palette[c]);
+        p += value_bytes;
+      }
+      uint32_t acc = 0, acc_bits = 0;
+      for(uint32_t i = 0; i < count; i++) {
+        uint32_t c = 0;
+        while(palette[c] != pixels[i]) c++;
+        acc = (acc << index_bits) | c;
+        acc_bits += index_bits;
+        if(acc_bits == 8) {
+          *p++ = acc;
+          acc = acc_bits = 0;
+        }
+      }
+      if(acc_bits) *p++ = acc << (8 - acc_bits);
+    } else if(best == rle_size) {
+      out[0] = RLE;
+      write_runs(pixels);
+    } else {
+      out[0] = XOR_RLE;
+      write_runs(delta);
+    }
+
+    return p - out;
+  }
+
+  size_t TileCodec::decode(const uint8_t *data, size_t length, void *frame, uint32_t tile) const {
+    if(length < 1 || tile >= tile_count()) return 0;
+
+    uint32_t x, y, w, h;
+    tile_rect(tile, x, y, w, h);
+    uint32_t count = w * h;
+
+    uint8_t *fb = (uint8_t *)frame;
+    const uint8_t *p = data + 1;
+    const uint8_t *end = data + length;
+
+    // write pixels in raster order across the tile
+    uint32_t row = 0, col = 0;
+    auto next = [&]() {
+      uint32_t i = (y + row) * width + x + col;
+      if(++col == w) {
+        col = 0;
+        row++;
+      }
+      return i;
+    };
+
+    switch(data[0]) {
+      case RAW: {
+        size_t size = (count * bits_per_pixel + 7) / 8;
+        if(size_t(end - p) < size) return 0;
+        if(bits_per_pixel >= 8) {
+          for(row = 0; row < h; row++) {
+            memcpy(fb + ((y + row) * width + x) * value_bytes, p + row * w * value_bytes, w * value_bytes);
+          }
+        } else {
+          for(uint32_t i = 0; i < count; i++) put(fb, next(), get(p, i));
+        }
+        p += size;
+        break;
+      }
+
+      case SOLID: {
+        if(size_t(end - p) < value_bytes) return 0;
+        uint32_t v = read_value(p);
+        p += value_bytes;
+        for(uint32_t i = 0; i < count; i++) put(fb, next(), v);
+        break;
+      }
+
+      case RLE:
+      case XOR_RLE:
+        for(uint32_t i = 0; i < count;) {
+          if(size_t(end - p) < 1u + value_bytes) return 0;
+          uint32_t run = std::min<uint32_t>(p[0] + 1, count - i);
+          uint32_t v = read_value(p + 1);
+          p += 1 + value_bytes;
+          i += run;
+          if(data[0] == RLE) {
+            while(run--) put(fb, next(), v);
+          } else if(v == 0) {
+            // unchanged pixels, skip over them
+            col += run;
+            row += col / w;
+            col %= w;
+          } else {
+            while(run--) {
+              uint32_t n = next();
+              put(fb, n, get(fb, n) ^ v);
+            }
+          }
+        }
+        break;
+
+      case PALETTE: {
+        if(end - p < 1) return 0;
+        uint32_t colours = *p++;
+        if(colours == 0 || colours > MAX_PALETTE || size_t(end - p) < colours * value_bytes) return 0;
+        uint32_t palette[MAX_PALETTE];
+        for(uint32_t c = 0; c < colours; c++) {
+          palette[c] = read_value(p);
+          p += value_bytes;
+        }
+        uint32_t index_bits = colours <= 2 ? 1 : colours <= 4 ? 2 : 4;
+        size_t size = (count * index_bits + 7) / 8;
+        if(size_t(end - p) < size) return 0;
+        uint32_t mask = (1 << index_bits) - 1;
+        for(uint32_t i = 0; i < count; i++) {
+          uint32_t bit = i * index_bits;
+          uint32_t c = (p[bit / 8] >> (8 - index_bits - bit % 8)) & mask;
+          put(fb, next(), palette[c < colours ? c : 0]);
+        }
+        p += size;
+        break;
+      }
+
+      default:
+        return 0;
+    }
+
+    return p - data;
+  }
+
+}
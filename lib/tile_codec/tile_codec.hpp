@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Compresses square tiles of a framebuffer, picking the cheapest of several
+// encodings for each one, and decodes them straight back into a framebuffer.
+//
+// Framebuffers hold pixels in raster order with no padding between rows,
+// either packed 1, 2 or 4-bit values (most significant first in each byte)
+// or whole 8, 16 or 32-bit values. This matches the PicoGraphics pens:
+//
+//   PEN_1BIT             1 (width a multiple of 8)
+//   PEN_P4               4
+//   PEN_P8, PEN_RGB332   8
+//   PEN_RGB565           16
+//   PEN_RGB888           32
+//
+// PEN_3BIT (bitplanes), PEN_1BITY (vertical bytes) and PEN_INKY7 (no local
+// framebuffer) aren't laid out in rows and can't be encoded.
+//
+// An encoded tile is an encoding byte followed by its data. Pixel values in
+// the data are stored as the bytes found in the framebuffer (one byte for
+// packed formats) so both ends must have the same byte order.
+namespace pimoroni {
+
+  class TileCodec {
+    public:
+      enum Encoding : uint8_t {
+        RAW,      // every pixel, packed as in the framebuffer
+        SOLID,    // one pixel value
+        RLE,      // (count - 1, pixel) runs in raster order
+        PALETTE,  // value count, up to 16 values, then 1, 2 or 4-bit indices
+        XOR_RLE   // runs of the pixels xor the previous frame, mostly zero
+      };
+
+      static const uint32_t MAX_TILE_SIZE = 16;
+
+      uint16_t width;
+      uint16_t height;
+      uint8_t bits_per_pixel;
+      uint8_t tile_size;
+      uint32_t tiles_x;
+      uint32_t tiles_y;
+
+      TileCodec(uint16_t width, uint16_t height, uint8_t bits_per_pixel, uint8_t tile_size = MAX_TILE_SIZE);
+
+      uint32_t tile_count() const { return tiles_x * tiles_y; }
+
+      // the largest an encoded tile can be (an unencoded one)
+      size_t max_encoded_size() const;
+
+      // true if the tile is different in the two frames
+      bool changed(const void *frame, const void *previous, uint32_t tile) const;
+
+      // copy a tile from one frame to another
+      void copy(const void *from, void *to, uint32_t tile) const;
+
+      // encode a tile into out (max_encoded_size bytes), returning its length.
+      // previous, if given, is the frame the decoder will already have, which
+      // allows XOR_RLE. the tile and its delta are held on the stack, a
+      // little over 2K of it
+      size_t encode(const void *frame, const void *previous, uint32_t tile, uint8_t *out) const;
+
+      // decode a tile into frame, which must hold the previous frame for
+      // XOR_RLE. returns the number of bytes used or 0 if data is invalid
+      size_t decode(const uint8_t *data, size_t length, void *frame, uint32_t tile) const;
+
+    private:
+      uint8_t value_bytes;
+
+      void tile_rect(uint32_t tile, uint32_t &x, uint32_t &y, uint32_t &w, uint32_t &h) const;
+      bool byte_aligned(uint32_t i, uint32_t count) const;
+      void read_tile(const uint8_t *frame, uint32_t tile, uint32_t *pixels) const;
+      uint32_t get(const uint8_t *frame, uint32_t i) const;
+      void put(uint8_t *frame, uint32_t i, uint32_t v) const;
+      uint32_t read_value(const uint8_t *p) const;
+      void write_value(uint8_t *p, uint32_t v) const;
+  };
+
+}
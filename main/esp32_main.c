@@ -7,6 +7,7 @@
 #include "esp_wifi.h"
 #include "esp_wifi_types_generic.h"
 #include "nvs_flash.h"
+#include "fb_stream.h"
 #include "tcp.h"
 #include "udp.h"
 
@@ -22,6 +23,11 @@
 #define TCP_SERVER_TASK_STACK_SIZE 4096
 #define TCP_SERVER_TASK_PRIORITY 5
 
+// TileCodec::encode keeps two tiles of pixels on the stack (2.3K), on top
+// of what lwip_sendto and logging need
+#define FB_STREAM_TASK_STACK_SIZE 8192
+#define FB_STREAM_TASK_PRIORITY 5
+
 static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                                int32_t event_id, void *event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_AP_START) {
@@ -70,4 +76,6 @@ void app_main(void) {
                 UDP_SERVER_TASK_PRIORITY, NULL);
     xTaskCreate(tcp_server_task, "tcp_server", TCP_SERVER_TASK_STACK_SIZE, NULL,
                 TCP_SERVER_TASK_PRIORITY, NULL);
+    xTaskCreate(fb_stream_server_task, "fb_stream", FB_STREAM_TASK_STACK_SIZE,
+                NULL, FB_STREAM_TASK_PRIORITY, NULL);
 }
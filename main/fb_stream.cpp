@@ -0,0 +1,181 @@
+#include "fb_stream.h"
+
+#include <lwip/inet.h>
+#include <lwip/sockets.h>
+#include <string.h>
+
+#include "frame_stream.hpp"
+
+#ifdef BUILD_PICO
+#include "pico_graphics.hpp"
+#include "pico_scroll.hpp"
+#endif
+
+#define FB_STREAM_PORT 8082
+#define ESP32_IP "192.168.4.1" // default
+
+// sized for the Pico Scroll, pixels are RGB888 as in PicoGraphics_PenRGB888
+#define FB_STREAM_WIDTH 17
+#define FB_STREAM_HEIGHT 7
+#define FB_STREAM_BITS_PER_PIXEL 32
+
+#define FB_STREAM_PACKET_SIZE 1024
+#define FB_STREAM_FRAME_MS 33
+#define FB_STREAM_KEYFRAME_INTERVAL 300 // frames
+#define FB_STREAM_CLIENT_TIMEOUT_MS 1000
+
+using namespace pimoroni;
+
+typedef struct {
+    int sock;
+    struct sockaddr_in peer;
+    bool has_peer;
+} fb_stream_context_t;
+
+static void fb_stream_send(void *context, const uint8_t *data, size_t length) {
+    fb_stream_context_t *ctx = (fb_stream_context_t *)context;
+    if (!ctx->has_peer) {
+        return;
+    }
+
+    if (lwip_sendto(ctx->sock, data, length, 0, (struct sockaddr *)&ctx->peer,
+                    sizeof(ctx->peer)) < 0) {
+        LOG_WARN(TAG, "frame stream send failed");
+    }
+}
+
+static int fb_stream_socket(uint16_t port) {
+    int sock = lwip_socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        LOG_ERROR(TAG, "failed to create frame stream socket");
+        return -1;
+    }
+
+    struct sockaddr_in bind_addr;
+    memset(&bind_addr, 0, sizeof(bind_addr));
+    bind_addr.sin_family = AF_INET;
+    bind_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    bind_addr.sin_port = htons(port);
+
+    if (lwip_bind(sock, (struct sockaddr *)&bind_addr, sizeof(bind_addr)) < 0) {
+        LOG_ERROR(TAG, "failed to bind frame stream socket");
+        lwip_close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+// a test pattern, a bright column sweeping across with a fading trail
+static void fb_stream_test_frame(uint32_t *frame, uint32_t n) {
+    int head = n % (FB_STREAM_WIDTH + 8);
+    for (int x = 0; x < FB_STREAM_WIDTH; x++) {
+        int age = head - x;
+        uint32_t v = (age >= 0 && age < 8) ? 255 >> age : 0;
+        for (int y = 0; y < FB_STREAM_HEIGHT; y++) {
+            frame[y * FB_STREAM_WIDTH + x] = (v << 16) | (v << 8) | v;
+        }
+    }
+}
+
+void fb_stream_server_task(void *pvParameters) {
+    LOG_INFO(TAG, "frame stream server task started\n");
+
+    static fb_stream_context_t ctx;
+    ctx.sock = fb_stream_socket(FB_STREAM_PORT);
+    ctx.has_peer = false;
+    if (ctx.sock < 0) {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    static uint32_t frame[FB_STREAM_WIDTH * FB_STREAM_HEIGHT];
+    static uint8_t rx_buf[64];
+
+    FrameStreamServer server(FB_STREAM_WIDTH, FB_STREAM_HEIGHT,
+                             FB_STREAM_BITS_PER_PIXEL, fb_stream_send, &ctx,
+                             FB_STREAM_PACKET_SIZE);
+    server.keyframe_interval = FB_STREAM_KEYFRAME_INTERVAL;
+
+    uint32_t n = 0;
+    while (true) {
+        // keyframe requests also tell us where the client is
+        struct sockaddr_in from;
+        socklen_t slen = sizeof(from);
+        int len;
+        while ((len = lwip_recvfrom(ctx.sock, rx_buf, sizeof(rx_buf),
+                                    MSG_DONTWAIT, (struct sockaddr *)&from,
+                                    &slen)) > 0) {
+            if (!ctx.has_peer ||
+                ctx.peer.sin_addr.s_addr != from.sin_addr.s_addr ||
+                ctx.peer.sin_port != from.sin_port) {
+                LOG_INFO(TAG, "frame stream client joined");
+            }
+            ctx.peer = from;
+            ctx.has_peer = true;
+            server.receive(rx_buf, len);
+        }
+
+        if (ctx.has_peer) {
+            fb_stream_test_frame(frame, n++);
+            server.send_frame(frame);
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(FB_STREAM_FRAME_MS));
+    }
+}
+
+#ifdef BUILD_PICO
+void fb_stream_client_task(void *pvParameters) {
+    LOG_INFO(TAG, "frame stream client task started\n");
+
+    static PicoGraphics_PenRGB888 graphics(PicoScroll::WIDTH, PicoScroll::HEIGHT, nullptr);
+    static PicoScroll scroll;
+    scroll.init();
+
+    static fb_stream_context_t ctx;
+    ctx.sock = fb_stream_socket(FB_STREAM_PORT);
+    if (ctx.sock < 0) {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    memset(&ctx.peer, 0, sizeof(ctx.peer));
+    ctx.peer.sin_family = AF_INET;
+    ctx.peer.sin_port = htons(FB_STREAM_PORT);
+    inet_aton(ESP32_IP, &ctx.peer.sin_addr);
+    ctx.has_peer = true;
+
+    static uint8_t rx_buf[FB_STREAM_PACKET_SIZE];
+
+    FrameStreamClient client(graphics.frame_buffer, FB_STREAM_WIDTH,
+                             FB_STREAM_HEIGHT, FB_STREAM_BITS_PER_PIXEL,
+                             fb_stream_send, &ctx);
+    client.request_keyframe();
+
+    TickType_t last_rx = xTaskGetTickCount();
+    while (true) {
+        int len = lwip_recvfrom(ctx.sock, rx_buf, sizeof(rx_buf), MSG_DONTWAIT,
+                                NULL, NULL);
+        if (len > 0) {
+            last_rx = xTaskGetTickCount();
+            if (client.receive(rx_buf, len)) {
+                // the frame goes out by dma while the next packets arrive
+                scroll.update_async(&graphics);
+            }
+            continue;
+        }
+
+        // nothing heard for a while, the server may not know about us yet
+        if (xTaskGetTickCount() - last_rx >
+            pdMS_TO_TICKS(FB_STREAM_CLIENT_TIMEOUT_MS)) {
+            LOG_INFO(TAG, "frame stream idle, requesting keyframe (lost %lu)",
+                     (unsigned long)client.lost);
+            client.request_keyframe();
+            last_rx = xTaskGetTickCount();
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+}
+#endif
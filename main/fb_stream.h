@@ -0,0 +1,18 @@
+#ifndef FB_STREAM_H
+#define FB_STREAM_H
+
+#include "platform.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// streams a framebuffer from the ESP32 (server) to the Pico (client) over UDP
+void fb_stream_server_task(void *pvParameters);
+void fb_stream_client_task(void *pvParameters);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !FB_STREAM_H
@@ -14,6 +14,7 @@
 #include "lwip/pbuf.h"
 #include "lwip/sockets.h"
 #include "lwip/udp.h"
+#include "fb_stream.h"
 #include "tcp.h"
 #include "udp.h"
 
@@ -60,6 +61,7 @@ void wifi_connect_task(void *pvParameters) {
 
     xTaskCreate(udp_client_task, "udp_client", 2048, NULL, WORKER_TASK_PRIORITY, NULL);
     xTaskCreate(tcp_client_task, "tcp_client", 2048, NULL, WORKER_TASK_PRIORITY, NULL);
+    xTaskCreate(fb_stream_client_task, "fb_stream", 2048, NULL, WORKER_TASK_PRIORITY, NULL);
 
     // this task is done, can kill itself
     vTaskDelete(NULL);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdio>
+
+// Checks for the host tests. Each test is its own executable which reports
+// every failed check and returns non-zero if there were any.
+namespace check {
+  inline int failures = 0;
+
+  inline int result() {
+    if(failures) fprintf(stderr, "%d checks failed\n", failures);
+    return failures ? 1 : 0;
+  }
+}
+
+#define CHECK(cond) do { \
+    if(!(cond)) { \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      check::failures++; \
+    } \
+  } while(0)
+
+#define CHECK_EQ(a, b) do { \
+    auto _a = (a); auto _b = (b); \
+    if(!(_a == _b)) { \
+      fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, (long long)_a, (long long)_b); \
+      check::failures++; \
+    } \
+  } while(0)
@@ -0,0 +1,198 @@
+// a FrameStreamServer and FrameStreamClient talking over UDP on the
+// loopback interface, as fb_stream does between the ESP32 and the Pico.
+// every frame the client completes must match the one the server sent, and
+// a dropped packet must be recovered from with a keyframe. frames/sec and
+// bytes per frame are reported for static, scrolling and full-motion content
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include "check.hpp"
+#include "frame_stream.hpp"
+#include "pico_graphics.hpp"
+
+using namespace pimoroni;
+
+static const uint16_t WIDTH = 320;
+static const uint16_t HEIGHT = 240;
+static const uint8_t BITS_PER_PIXEL = 16;
+static const uint32_t FRAMES = 60;
+
+struct Endpoint {
+  int sock;
+  sockaddr_in peer;
+  // packets sent, bytes sent and, when set, the index of a packet to drop
+  uint32_t packets = 0;
+  size_t bytes = 0;
+  int32_t drop = -1;
+};
+
+static int open_socket(sockaddr_in &addr) {
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if(sock < 0) return -1;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  socklen_t len = sizeof(addr);
+  if(bind(sock, (sockaddr *)&addr, len) < 0 || getsockname(sock, (sockaddr *)&addr, &len) < 0) {
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+static void send_packet(void *context, const uint8_t *data, size_t length) {
+  Endpoint *e = (Endpoint *)context;
+  if(int32_t(e->packets++) == e->drop) return;
+  e->bytes += length;
+  if(sendto(e->sock, data, length, 0, (sockaddr *)&e->peer, sizeof(e->peer)) < 0) {
+    fprintf(stderr, "sendto failed\n");
+    check::failures++;
+  }
+}
+
+struct Link {
+  Endpoint server;
+  Endpoint client;
+  sockaddr_in server_addr;
+  sockaddr_in client_addr;
+  std::vector<uint8_t> client_frame;
+  PicoGraphics_PenRGB565 graphics;
+  FrameStreamServer stream_server;
+  FrameStreamClient stream_client;
+
+  Link()
+    : client_frame(WIDTH * HEIGHT * 2), graphics(WIDTH, HEIGHT, nullptr),
+      stream_server(WIDTH, HEIGHT, BITS_PER_PIXEL, send_packet, &server),
+      stream_client(client_frame.data(), WIDTH, HEIGHT, BITS_PER_PIXEL, send_packet, &client) {
+    server.sock = open_socket(server_addr);
+    client.sock = open_socket(client_addr);
+    server.peer = client_addr;
+    client.peer = server_addr;
+    // an unencoded frame is 150 packets, keep them all queued
+    int size = 1 << 20;
+    setsockopt(client.sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  }
+
+  ~Link() {
+    close(server.sock);
+    close(client.sock);
+  }
+
+  // hand everything waiting on a socket to f
+  template<typename F>
+  static void drain(int sock, F f) {
+    static uint8_t buffer[2048];
+    ssize_t len;
+    while((len = recv(sock, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) f(buffer, len);
+  }
+
+  // send the current frame and let the client take it, true if the client
+  // now has a complete, up to date frame
+  bool exchange() {
+    drain(server.sock, [this](const uint8_t *data, size_t len) { stream_server.receive(data, len); });
+    stream_server.send_frame(graphics.frame_buffer);
+    bool done = false;
+    drain(client.sock, [&](const uint8_t *data, size_t len) { done |= stream_client.receive(data, len); });
+    return done;
+  }
+
+  bool matches() const {
+    return memcmp(client_frame.data(), graphics.frame_buffer, client_frame.size()) == 0;
+  }
+};
+
+typedef void (*draw_func)(PicoGraphics &g, uint32_t n);
+
+static void draw_text(PicoGraphics &g, int32_t offset) {
+  g.set_pen(0, 0, 0);
+  g.clear();
+  g.set_font("bitmap8");
+  for(auto i = 0; i < 30; i++) {
+    int32_t y = i * 16 - offset;
+    g.set_pen(i * 8, 255 - i * 8, 128);
+    g.rectangle(Rect(0, y, 6, 12));
+    g.text("The quick brown fox jumps over", Point(10, y + 2), WIDTH, 1.0f);
+  }
+}
+
+// a UI that doesn't change
+static void draw_static(PicoGraphics &g, uint32_t n) {
+  draw_text(g, 0);
+}
+
+// text scrolling up a couple of pixels a frame
+static void draw_scrolling(PicoGraphics &g, uint32_t n) {
+  draw_text(g, (n * 2) % 240);
+}
+
+// every pixel changes every frame
+static void draw_full_motion(PicoGraphics &g, uint32_t n) {
+  uint16_t *fb = (uint16_t *)g.frame_buffer;
+  for(auto y = 0; y < HEIGHT; y++) {
+    for(auto x = 0; x < WIDTH; x++) {
+      uint8_t r = x + n * 3, gr = y + n * 5, b = (x ^ y) + n * 7;
+      fb[y * WIDTH + x] = RGB(r, gr, b).to_rgb565();
+    }
+  }
+}
+
+static void run(const char *name, draw_func draw) {
+  Link link;
+  CHECK(link.server.sock >= 0 && link.client.sock >= 0);
+  if(link.server.sock < 0 || link.client.sock < 0) return;
+
+  // the client announces itself, and gets its first keyframe
+  link.stream_client.request_keyframe();
+  draw(link.graphics, 0);
+  CHECK(link.exchange());
+  CHECK(link.matches());
+
+  uint32_t completed = 0;
+  size_t bytes = link.server.bytes;
+  auto start = std::chrono::steady_clock::now();
+  for(auto n = 1u; n <= FRAMES; n++) {
+    draw(link.graphics, n);
+    if(link.exchange()) {
+      completed++;
+      if(!link.matches()) {
+        fprintf(stderr, "%s: frame %u differs\n", name, n);
+        check::failures++;
+      }
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  bytes = link.server.bytes - bytes;
+  CHECK_EQ(completed, FRAMES);
+  CHECK_EQ(link.stream_client.lost, 0u);
+
+  double seconds = std::chrono::duration<double>(end - start).count();
+  printf("%-12s %4u frames %10.1f frames/sec %10.1f bytes/frame\n", name, completed, completed / seconds, double(bytes) / FRAMES);
+
+  // lose a packet from the middle of the next frame, the client notices,
+  // asks for a keyframe and is back in step a frame later
+  uint32_t lost = link.stream_client.lost;
+  link.server.drop = link.server.packets + (draw == draw_static ? 0 : 1);
+  draw(link.graphics, FRAMES + 1);
+  CHECK(!link.exchange());
+  draw(link.graphics, FRAMES + 2);
+  link.exchange();
+  CHECK_EQ(link.stream_client.lost, lost + 1);
+  CHECK(!link.stream_client.synced());
+  draw(link.graphics, FRAMES + 3);
+  CHECK(link.exchange());
+  CHECK(link.matches());
+}
+
+int main() {
+  run("static", draw_static);
+  run("scrolling", draw_scrolling);
+  run("full-motion", draw_full_motion);
+  return check::result();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "pico.h"
+
+#define NUM_DMA_CHANNELS 12
+#define DREQ_FORCE 0x3f
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2
+};
+
+typedef struct {
+    enum dma_channel_transfer_size size;
+    bool read_increment;
+    bool write_increment;
+    uint dreq;
+} dma_channel_config;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int dma_claim_unused_channel(bool required);
+void dma_channel_claim(uint channel);
+void dma_channel_unclaim(uint channel);
+bool dma_channel_is_claimed(uint channel);
+
+static inline dma_channel_config dma_channel_get_default_config(uint channel) {
+    dma_channel_config c = {DMA_SIZE_32, true, false, DREQ_FORCE};
+    (void)channel;
+    return c;
+}
+
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) {
+    c->size = size;
+}
+
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr) {
+    c->read_increment = incr;
+}
+
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr) {
+    c->write_increment = incr;
+}
+
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq) {
+    c->dreq = dreq;
+}
+
+// transfers paced by an i2c dreq move a value whenever the i2c fifo is
+// ready for it, unpaced ones complete straight away
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger);
+void dma_channel_abort(uint channel);
+bool dma_channel_is_busy(uint channel);
+void dma_channel_wait_for_finish_blocking(uint channel);
+
+#ifdef __cplusplus
+}
+#endif
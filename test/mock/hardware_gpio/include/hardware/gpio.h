@@ -0,0 +1,39 @@
+#pragma once
+
+#include "pico.h"
+
+typedef enum gpio_function {
+    GPIO_FUNC_XIP = 0,
+    GPIO_FUNC_SPI = 1,
+    GPIO_FUNC_UART = 2,
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_PWM = 4,
+    GPIO_FUNC_SIO = 5,
+    GPIO_FUNC_PIO0 = 6,
+    GPIO_FUNC_PIO1 = 7,
+    GPIO_FUNC_GPCK = 8,
+    GPIO_FUNC_USB = 9,
+    GPIO_FUNC_NULL = 0x1f
+} gpio_function_t;
+
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void gpio_init(uint gpio);
+void gpio_set_function(uint gpio, gpio_function_t fn);
+gpio_function_t gpio_get_function(uint gpio);
+void gpio_pull_up(uint gpio);
+void gpio_pull_down(uint gpio);
+void gpio_disable_pulls(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+// inputs read high (pulled up) unless set otherwise with mock::set_pin
+bool gpio_get(uint gpio);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "pico.h"
+
+#define I2C_IC_DATA_CMD_RESTART_BITS 0x00000400u
+#define I2C_IC_DATA_CMD_STOP_BITS 0x00000200u
+#define I2C_IC_DATA_CMD_CMD_BITS 0x00000100u
+#define I2C_IC_DATA_CMD_DAT_BITS 0x000000ffu
+
+#define I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS 0x00000040u
+#define I2C_IC_RAW_INTR_STAT_STOP_DET_BITS 0x00000200u
+#define I2C_IC_INTR_MASK_M_TX_ABRT_BITS 0x00000040u
+#define I2C_IC_INTR_MASK_M_STOP_DET_BITS 0x00000200u
+
+#define DREQ_I2C0_TX 32
+#define DREQ_I2C0_RX 33
+#define DREQ_I2C1_TX 34
+#define DREQ_I2C1_RX 35
+
+// the registers the drivers touch. reads can't be seen on the host, so the
+// read-to-clear registers do nothing: the interrupt status is cleared when
+// a transfer starts instead
+typedef struct {
+    io_rw_32 con;
+    io_rw_32 tar;
+    io_rw_32 data_cmd;
+    io_ro_32 intr_stat;
+    io_rw_32 intr_mask;
+    io_ro_32 raw_intr_stat;
+    io_ro_32 clr_intr;
+    io_ro_32 clr_tx_abrt;
+    io_ro_32 clr_stop_det;
+    io_rw_32 enable;
+    io_ro_32 status;
+    io_ro_32 txflr;
+    io_ro_32 rxflr;
+} i2c_hw_t;
+
+typedef struct i2c_inst {
+    i2c_hw_t *hw;
+    bool restart_on_next;
+} i2c_inst_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern i2c_inst_t i2c0_inst;
+extern i2c_inst_t i2c1_inst;
+
+#define i2c0 (&i2c0_inst)
+#define i2c1 (&i2c1_inst)
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+void i2c_deinit(i2c_inst_t *i2c);
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate);
+
+// transfers take the simulated time they would on the bus, at the baudrate
+// given to i2c_init
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+
+static inline i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c) {
+    return i2c->hw;
+}
+
+static inline uint i2c_hw_index(i2c_inst_t *i2c) {
+    return i2c == i2c1 ? 1 : 0;
+}
+
+static inline uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx) {
+    return (i2c == i2c1 ? DREQ_I2C1_TX : DREQ_I2C0_TX) + (is_tx ? 0 : 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "pico.h"
+
+#define I2C0_IRQ 23
+#define I2C1_IRQ 24
+#define NUM_IRQS 32
+
+typedef void (*irq_handler_t)(void);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// handlers are called as the simulated clock reaches the event that raised
+// them, unless a critical section is held
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_remove_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+bool irq_is_enabled(uint num);
+
+#ifdef __cplusplus
+}
+#endif
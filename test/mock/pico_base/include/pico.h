@@ -0,0 +1,34 @@
+#pragma once
+
+// The parts of the pico-sdk the drivers use, for building and testing them
+// on the host. Each library has its own include directory as in the sdk, so
+// a driver that doesn't link a library it uses won't build here either.
+// pico_sdk_mock.hpp controls the simulated clock, dma and i2c buses.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+typedef volatile uint32_t io_rw_32;
+typedef const volatile uint32_t io_ro_32;
+typedef volatile uint32_t io_wo_32;
+
+enum pico_error_codes {
+    PICO_OK = 0,
+    PICO_ERROR_NONE = 0,
+    PICO_ERROR_TIMEOUT = -1,
+    PICO_ERROR_GENERIC = -2,
+    PICO_ERROR_NO_DATA = -3
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// moves the simulated clock on by pico_sdk_mock's spin time
+void tight_loop_contents(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,19 @@
+# the pico-sdk libraries the drivers use, as interface targets with the sdk's
+# names so the drivers' own .cmake files link them unchanged. each has just
+# its own headers, so a driver missing a library fails to build as it would
+# on the pico
+set(PICO_SDK_MOCK_LIBRARIES hardware_gpio hardware_i2c hardware_dma hardware_irq pico_sync pico_time pico_stdlib)
+
+add_library(pico_sdk_mock ${CMAKE_CURRENT_LIST_DIR}/pico_sdk_mock.cpp)
+target_include_directories(pico_sdk_mock PUBLIC
+    ${CMAKE_CURRENT_LIST_DIR}
+    ${CMAKE_CURRENT_LIST_DIR}/pico_base/include)
+foreach(LIBRARY ${PICO_SDK_MOCK_LIBRARIES})
+    target_include_directories(pico_sdk_mock PRIVATE ${CMAKE_CURRENT_LIST_DIR}/${LIBRARY}/include)
+
+    add_library(${LIBRARY} INTERFACE)
+    target_include_directories(${LIBRARY} INTERFACE ${CMAKE_CURRENT_LIST_DIR}/${LIBRARY}/include)
+    target_link_libraries(${LIBRARY} INTERFACE pico_sdk_mock)
+endforeach()
+
+target_link_libraries(pico_stdlib INTERFACE hardware_gpio pico_time)
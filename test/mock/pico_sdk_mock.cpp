@@ -0,0 +1,520 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "pico_sdk_mock.hpp"
+
+// the read-only registers are const, so the blocks are kept as words
+static uint32_t i2c_regs[2][sizeof(i2c_hw_t) / sizeof(uint32_t)];
+static i2c_hw_t *const i2c_hw = (i2c_hw_t *)i2c_regs;
+i2c_inst_t i2c0_inst = {&i2c_hw[0], false};
+i2c_inst_t i2c1_inst = {&i2c_hw[1], false};
+
+namespace mock {
+
+  uint64_t spin_ns = 1000;
+  static uint64_t clock_ns = 0;
+
+  static const size_t FIFO_DEPTH = 16;
+
+  // an i2c block, what its bus has recorded and the command being clocked out
+  struct Block {
+    Bus bus;
+    std::deque<uint16_t> fifo;
+
+    bool busy = false;          // the front of the fifo is on the bus
+    bool segment = false;       // and it starts with a start or repeated start
+    uint64_t done_ns = 0;
+
+    bool in_transfer = false;   // between a start and a stop
+    bool reading = false;
+    size_t transfer = 0;        // index in bus.transfers
+    Device *device = nullptr;
+    bool aborted = false;       // a nak, the fifo takes nothing more
+
+    // a blocking transfer left open by nostop
+    bool open = false;
+    uint8_t open_address = 0;
+    Device *open_device = nullptr;
+  };
+
+  struct Channel {
+    bool claimed = false;
+    dma_channel_config config;
+    volatile uint8_t *write = nullptr;
+    const volatile uint8_t *read = nullptr;
+    uint remaining = 0;
+    int block = -1;
+    bool tx = false;
+  };
+
+  static Block blocks[2];
+  static Channel channels[NUM_DMA_CHANNELS];
+  static uint dma_available = NUM_DMA_CHANNELS;
+
+  static irq_handler_t handlers[NUM_IRQS];
+  static bool enabled[NUM_IRQS];
+  static bool pending[NUM_IRQS];
+  static uint32_t counts[NUM_IRQS];
+  static int critical = 0;
+  static bool in_irq = false;
+
+  static bool pins[32];
+  static gpio_function_t functions[32];
+
+  static int index(i2c_inst_t *i2c) {
+    return i2c == i2c1 ? 1 : 0;
+  }
+
+  static uint64_t bit_ns(int b) {
+    return 1000000000ull / blocks[b].bus.baudrate;
+  }
+
+  static void set_raw(int b, uint32_t raw) {
+    i2c_hw_t *hw = &i2c_hw[b];
+    *(volatile uint32_t *)&hw->raw_intr_stat = raw;
+    *(volatile uint32_t *)&hw->intr_stat = raw & hw->intr_mask;
+  }
+
+  // interrupts are edge triggered here, the handler runs once for each
+  // event its mask lets through
+  static void raise(int b, uint32_t bits) {
+    set_raw(b, i2c_hw[b].raw_intr_stat | bits);
+    if(i2c_hw[b].intr_mask & bits) pending[b ? I2C1_IRQ : I2C0_IRQ] = true;
+  }
+
+  static void deliver() {
+    if(in_irq || critical) return;
+    for(uint num = 0; num < NUM_IRQS; num++) {
+      if(!pending[num] || !enabled[num] || !handlers[num]) continue;
+      pending[num] = false;
+      counts[num]++;
+      in_irq = true;
+      handlers[num]();
+      in_irq = false;
+    }
+  }
+
+  // the start of a new transfer stands in for the driver clearing the
+  // interrupt status, which can't be seen. a blocking transfer left open
+  // is ended
+  static void begin(int b) {
+    Block &k = blocks[b];
+    set_raw(b, 0);
+    k.aborted = false;
+    if(k.open) {
+      k.open_device->stop();
+      k.bus.transfers.back().end_ns = clock_ns;
+      k.open = false;
+    }
+  }
+
+  static Device *find(int b, uint8_t address) {
+    auto i = blocks[b].bus.devices.find(address);
+    return i == blocks[b].bus.devices.end() ? nullptr : i->second;
+  }
+
+  static void start_command(int b) {
+    Block &k = blocks[b];
+    if(k.busy || k.fifo.empty()) return;
+
+    uint16_t cmd = k.fifo.front();
+    bool read = cmd & I2C_IC_DATA_CMD_CMD_BITS;
+    k.segment = !k.in_transfer || (cmd & I2C_IC_DATA_CMD_RESTART_BITS) || read != k.reading;
+
+    // a start and the address, the byte and its ack, and the stop
+    uint64_t bits = (k.segment ? 10 : 0) + 9 + (cmd & I2C_IC_DATA_CMD_STOP_BITS ? 1 : 0);
+    k.busy = true;
+    k.done_ns = clock_ns + bits * bit_ns(b);
+
+    if(!k.in_transfer) {
+      Transfer t;
+      t.address = i2c_hw[b].tar & 0x7f;
+      t.dma = true;
+      t.start_ns = clock_ns;
+      k.bus.transfers.push_back(t);
+      k.transfer = k.bus.transfers.size() - 1;
+      k.in_transfer = true;
+    }
+  }
+
+  // the dma keeps the tx fifo topped up, reading each command from memory
+  // as it goes in
+  static void pump(int b) {
+    Block &k = blocks[b];
+    for(auto &c : channels) {
+      if(c.block != b || !c.tx) continue;
+      while(c.remaining && !k.aborted && k.fifo.size() < FIFO_DEPTH) {
+        uint32_t v = 0;
+        switch(c.config.size) {
+          case DMA_SIZE_8: v = *c.read; break;
+          case DMA_SIZE_16: v = *(const volatile uint16_t *)c.read; break;
+          case DMA_SIZE_32: v = *(const volatile uint32_t *)c.read; break;
+        }
+        k.fifo.push_back(v & 0x7ff);
+        if(c.config.read_increment) c.read += 1 << c.config.size;
+        c.remaining--;
+      }
+    }
+    start_command(b);
+  }
+
+  static void complete(int b) {
+    Block &k = blocks[b];
+    uint16_t cmd = k.fifo.front();
+    k.fifo.pop_front();
+    k.busy = false;
+    bool read = cmd & I2C_IC_DATA_CMD_CMD_BITS;
+
+    Transfer &t = k.bus.transfers[k.transfer];
+
+    if(k.segment) {
+      t.starts++;
+      k.reading = read;
+      k.device = find(b, t.address);
+      if(!k.device || !k.device->start(read)) {
+        // the controller flushes its fifo and sends a stop
+        t.nak = true;
+        t.end_ns = clock_ns;
+        k.in_transfer = false;
+        k.aborted = true;
+        k.fifo.clear();
+        raise(b, I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS | I2C_IC_RAW_INTR_STAT_STOP_DET_BITS);
+        return;
+      }
+    }
+
+    if(read) {
+      uint8_t v = k.device->read();
+      t.read.push_back(v);
+      for(auto &c : channels) {
+        if(c.block != b || c.tx || !c.remaining) continue;
+        *c.write = v;
+        if(c.config.write_increment) c.write++;
+        c.remaining--;
+        break;
+      }
+    } else {
+      k.device->write(cmd & I2C_IC_DATA_CMD_DAT_BITS);
+      t.written.push_back(cmd & I2C_IC_DATA_CMD_DAT_BITS);
+    }
+
+    if(cmd & I2C_IC_DATA_CMD_STOP_BITS) {
+      k.device->stop();
+      t.end_ns = clock_ns;
+      k.in_transfer = false;
+      raise(b, I2C_IC_RAW_INTR_STAT_STOP_DET_BITS);
+    }
+
+    pump(b);
+  }
+
+  void advance(uint64_t ns) {
+    uint64_t target = clock_ns + ns;
+    while(true) {
+      int next = -1;
+      for(int b = 0; b < 2; b++) {
+        if(blocks[b].busy && blocks[b].done_ns <= target && (next < 0 || blocks[b].done_ns < blocks[next].done_ns)) next = b;
+      }
+      if(next < 0) break;
+      clock_ns = std::max(clock_ns, blocks[next].done_ns);
+      complete(next);
+      deliver();
+    }
+    clock_ns = std::max(clock_ns, target);
+    deliver();
+  }
+
+  uint64_t now_ns() {
+    return clock_ns;
+  }
+
+  Bus &bus(i2c_inst_t *i2c) {
+    return blocks[index(i2c)].bus;
+  }
+
+  void reset() {
+    for(auto &k : blocks) k = Block();
+    for(auto &c : channels) c = Channel();
+    memset(i2c_regs, 0, sizeof(i2c_regs));
+    i2c0_inst.restart_on_next = false;
+    i2c1_inst.restart_on_next = false;
+    dma_available = NUM_DMA_CHANNELS;
+    for(uint num = 0; num < NUM_IRQS; num++) {
+      handlers[num] = nullptr;
+      enabled[num] = pending[num] = false;
+      counts[num] = 0;
+    }
+    critical = 0;
+    for(auto &p : pins) p = true;
+    for(auto &f : functions) f = GPIO_FUNC_NULL;
+  }
+
+  void set_dma_channels(uint count) {
+    dma_available = count < NUM_DMA_CHANNELS ? count : NUM_DMA_CHANNELS;
+  }
+
+  uint32_t irq_count(uint num) {
+    return num < NUM_IRQS ? counts[num] : 0;
+  }
+
+  void set_pin(uint pin, bool value) {
+    if(pin < 32) pins[pin] = value;
+  }
+
+  // a blocking write or read, returning the bytes moved or an error
+  static int blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, uint8_t *dst, size_t len, bool nostop) {
+    int b = index(i2c);
+    Block &k = blocks[b];
+    if(k.busy || !k.fifo.empty() || k.in_transfer) k.bus.collisions++;
+
+    // carry on from a transfer left open, with a repeated start
+    if(!k.open || k.open_address != addr) {
+      begin(b);
+      Transfer t;
+      t.address = addr;
+      t.start_ns = clock_ns;
+      k.bus.transfers.push_back(t);
+    }
+    size_t ti = k.bus.transfers.size() - 1;
+    k.bus.transfers[ti].starts++;
+
+    Device *device = find(b, addr);
+    if(!device || !device->start(dst != nullptr)) {
+      advance(11 * bit_ns(b));
+      Transfer &t = k.bus.transfers[ti];
+      t.nak = true;
+      t.end_ns = clock_ns;
+      k.open = false;
+      raise(b, I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS | I2C_IC_RAW_INTR_STAT_STOP_DET_BITS);
+      deliver();
+      return PICO_ERROR_GENERIC;
+    }
+
+    for(size_t i = 0; i < len; i++) {
+      if(dst) {
+        dst[i] = device->read();
+        k.bus.transfers[ti].read.push_back(dst[i]);
+      } else {
+        device->write(src[i]);
+        k.bus.transfers[ti].written.push_back(src[i]);
+      }
+    }
+
+    advance((10 + 9 * len + (nostop ? 0 : 1)) * bit_ns(b));
+
+    i2c->restart_on_next = nostop;
+    if(nostop) {
+      k.open = true;
+      k.open_address = addr;
+      k.open_device = device;
+    } else {
+      device->stop();
+      k.bus.transfers[ti].end_ns = clock_ns;
+      k.open = false;
+      raise(b, I2C_IC_RAW_INTR_STAT_STOP_DET_BITS);
+      deliver();
+    }
+    return len;
+  }
+
+  static struct Init {
+    Init() { reset(); }
+  } init;
+}
+
+using namespace mock;
+
+extern "C" {
+
+void tight_loop_contents(void) {
+  advance(spin_ns);
+}
+
+uint64_t time_us_64(void) {
+  return clock_ns / 1000;
+}
+
+uint32_t time_us_32(void) {
+  return uint32_t(clock_ns / 1000);
+}
+
+void sleep_us(uint64_t us) {
+  advance(us * 1000);
+}
+
+void sleep_ms(uint32_t ms) {
+  advance(uint64_t(ms) * 1000000);
+}
+
+void critical_section_init(critical_section_t *crit_sec) {
+  crit_sec->depth = 0;
+}
+
+void critical_section_enter_blocking(critical_section_t *crit_sec) {
+  crit_sec->depth++;
+  critical++;
+}
+
+void critical_section_exit(critical_section_t *crit_sec) {
+  crit_sec->depth--;
+  critical--;
+  deliver();
+}
+
+void critical_section_deinit(critical_section_t *crit_sec) {
+}
+
+void gpio_init(uint gpio) {
+  gpio_set_function(gpio, GPIO_FUNC_SIO);
+}
+
+void gpio_set_function(uint gpio, gpio_function_t fn) {
+  if(gpio < 32) functions[gpio] = fn;
+}
+
+gpio_function_t gpio_get_function(uint gpio) {
+  return gpio < 32 ? functions[gpio] : GPIO_FUNC_NULL;
+}
+
+void gpio_pull_up(uint gpio) {
+}
+
+void gpio_pull_down(uint gpio) {
+}
+
+void gpio_disable_pulls(uint gpio) {
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+}
+
+void gpio_put(uint gpio, bool value) {
+  set_pin(gpio, value);
+}
+
+bool gpio_get(uint gpio) {
+  return gpio < 32 ? pins[gpio] : false;
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+  if(handlers[num] && handlers[num] != handler) {
+    fprintf(stderr, "irq %u already has a handler\n", num);
+    abort();
+  }
+  handlers[num] = handler;
+}
+
+void irq_remove_handler(uint num, irq_handler_t handler) {
+  if(handlers[num] == handler) handlers[num] = nullptr;
+}
+
+void irq_set_enabled(uint num, bool enable) {
+  enabled[num] = enable;
+  deliver();
+}
+
+bool irq_is_enabled(uint num) {
+  return enabled[num];
+}
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+  int b = index(i2c);
+  blocks[b].fifo.clear();
+  blocks[b].busy = blocks[b].in_transfer = blocks[b].open = false;
+  blocks[b].bus.baudrate = baudrate;
+  i2c->restart_on_next = false;
+  return baudrate;
+}
+
+void i2c_deinit(i2c_inst_t *i2c) {
+}
+
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate) {
+  blocks[index(i2c)].bus.baudrate = baudrate;
+  return baudrate;
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+  return blocking(i2c, addr, src, nullptr, len, nostop);
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+  return blocking(i2c, addr, nullptr, dst, len, nostop);
+}
+
+int dma_claim_unused_channel(bool required) {
+  uint in_use = 0;
+  for(auto &c : channels) in_use += c.claimed;
+  for(uint i = 0; i < NUM_DMA_CHANNELS && in_use < dma_available; i++) {
+    if(!channels[i].claimed) {
+      channels[i].claimed = true;
+      return i;
+    }
+  }
+  if(required) {
+    fprintf(stderr, "no dma channels left\n");
+    abort();
+  }
+  return -1;
+}
+
+void dma_channel_claim(uint channel) {
+  channels[channel].claimed = true;
+}
+
+void dma_channel_unclaim(uint channel) {
+  channels[channel] = Channel();
+}
+
+bool dma_channel_is_claimed(uint channel) {
+  return channels[channel].claimed;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger) {
+  Channel &c = channels[channel];
+  c.config = *config;
+  c.write = (volatile uint8_t *)write_addr;
+  c.read = (const volatile uint8_t *)read_addr;
+  c.remaining = trigger ? transfer_count : 0;
+  c.block = -1;
+
+  if(config->dreq >= DREQ_I2C0_TX && config->dreq <= DREQ_I2C1_RX) {
+    c.block = (config->dreq - DREQ_I2C0_TX) / 2;
+    c.tx = (config->dreq - DREQ_I2C0_TX) % 2 == 0;
+    if(c.tx && c.remaining) {
+      begin(c.block);
+      pump(c.block);
+    }
+    return;
+  }
+
+  // unpaced, memory to memory
+  size_t size = 1 << config->size;
+  for(; c.remaining; c.remaining--) {
+    memcpy((void *)c.write, (const void *)c.read, size);
+    if(config->read_increment) c.read += size;
+    if(config->write_increment) c.write += size;
+  }
+}
+
+void dma_channel_abort(uint channel) {
+  channels[channel].remaining = 0;
+}
+
+bool dma_channel_is_busy(uint channel) {
+  return channels[channel].remaining > 0;
+}
+
+void dma_channel_wait_for_finish_blocking(uint channel) {
+  while(dma_channel_is_busy(channel)) tight_loop_contents();
+}
+
+}
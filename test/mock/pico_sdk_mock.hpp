@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "hardware/i2c.h"
+
+// Control of the mock pico-sdk the host tests build the drivers against.
+//
+// Time only moves when something waits: sleep_ms/us, tight_loop_contents
+// (spin_ns a call) and the blocking i2c calls. As it moves the dma feeds
+// the i2c tx fifos, each bus clocks its commands out at the baudrate given
+// to i2c_init and interrupts are delivered, in the order they would happen.
+// Everything is single threaded.
+namespace mock {
+
+  // a device on a bus. start is called for each start or repeated start
+  // addressed to the device, which naks by returning false
+  class Device {
+    public:
+      virtual ~Device() {}
+      virtual bool start(bool read) { return true; }
+      virtual void write(uint8_t data) {}
+      virtual uint8_t read() { return 0xff; }
+      virtual void stop() {}
+  };
+
+  // 256 registers behind a register pointer, which the first byte written
+  // after a start sets and every byte moves on
+  class RegisterDevice : public Device {
+    public:
+      uint8_t regs[256] = {};
+      uint8_t pointer = 0;
+
+      bool start(bool read) override {
+        first = !read;
+        return true;
+      }
+      void write(uint8_t data) override {
+        if(first) {
+          pointer = data;
+          first = false;
+        } else {
+          regs[pointer++] = data;
+        }
+      }
+      uint8_t read() override {
+        return regs[pointer++];
+      }
+
+    private:
+      bool first = false;
+  };
+
+  // from a start to a stop, including any repeated starts between
+  struct Transfer {
+    uint8_t address = 0;
+    // the start and repeated starts, each followed by the address byte
+    uint32_t starts = 0;
+    std::vector<uint8_t> written;
+    std::vector<uint8_t> read;
+    bool nak = false;
+    // sent by dma rather than a blocking call
+    bool dma = false;
+    uint64_t start_ns = 0;
+    uint64_t end_ns = 0;
+
+    // bytes on the bus, addresses included
+    size_t bytes() const { return starts + written.size() + read.size(); }
+  };
+
+  class Bus {
+    public:
+      uint32_t baudrate = 100000;
+      std::vector<Transfer> transfers;
+      // blocking calls made while a dma transfer was under way
+      uint32_t collisions = 0;
+      std::map<uint8_t, Device *> devices;
+
+      void attach(uint8_t address, Device *device) { devices[address] = device; }
+      void detach(uint8_t address) { devices.erase(address); }
+
+      size_t bytes() const {
+        size_t n = 0;
+        for(auto &t : transfers) n += t.bytes();
+        return n;
+      }
+  };
+
+  Bus &bus(i2c_inst_t *i2c);
+
+  // the simulated clock
+  uint64_t now_ns();
+  void advance(uint64_t ns);
+  extern uint64_t spin_ns;
+
+  // forget every transfer, device, dma channel, handler and pin. the clock
+  // carries on
+  void reset();
+
+  // how many dma channels can be claimed, to test drivers without dma
+  void set_dma_channels(uint count);
+
+  // times the handler for an irq has been called
+  uint32_t irq_count(uint num);
+
+  void set_pin(uint pin, bool value);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "pico.h"
+
+// interrupts are held off between enter and exit, as on the Pico
+typedef struct {
+    int depth;
+} critical_section_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void critical_section_init(critical_section_t *crit_sec);
+void critical_section_enter_blocking(critical_section_t *crit_sec);
+void critical_section_exit(critical_section_t *crit_sec);
+void critical_section_deinit(critical_section_t *crit_sec);
+
+#ifdef __cplusplus
+}
+#endif
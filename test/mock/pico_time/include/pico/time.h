@@ -0,0 +1,17 @@
+#pragma once
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the simulated clock, sleeping moves it on
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+#ifdef __cplusplus
+}
+#endif
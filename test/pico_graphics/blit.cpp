@@ -0,0 +1,126 @@
+// blit between surfaces of the same type copies pixels directly, check it
+// gives the same colours as the generic path, which reads the source back
+// as RGB and compares the colour key with those colours
+#include <vector>
+
+#include "check.hpp"
+#include "surfaces.hpp"
+
+using namespace bench;
+
+static const uint16_t WIDTH = 32;
+static const uint16_t HEIGHT = 16;
+
+// vertical stripes of the first 16 palette entries, or their colours
+static void stripes(Surface &s) {
+  for(auto i = 0; i < 16; i++) {
+    if(s->pen_type == PicoGraphics::PEN_P8) {
+      s->set_pen(i);
+    } else {
+      s->set_pen(PALETTE[i].r, PALETTE[i].g, PALETTE[i].b);
+    }
+    s->rectangle(Rect(i * 2, 0, 2, HEIGHT));
+  }
+}
+
+// what the destination should hold after the source is blitted over it
+// unscaled, every pixel not matching the key replaced by the source colour
+static std::vector<uint8_t> expected(const Surface &src, const Surface &dst, bool use_key, const RGB &key) {
+  std::vector<uint8_t> s = src.read_rgb(), d = dst.read_rgb();
+  for(auto i = 0u; i < s.size(); i += 3) {
+    bool keyed = use_key && s[i] == key.r && s[i + 1] == key.g && s[i + 2] == key.b;
+    if(!keyed) {
+      d[i] = s[i];
+      d[i + 1] = s[i + 1];
+      d[i + 2] = s[i + 2];
+    }
+  }
+  return d;
+}
+
+static void blit(Surface &src, Surface &dst, bool use_key, const RGB &key = RGB()) {
+  std::vector<uint8_t> want = expected(src, dst, use_key, key);
+  dst->blit(src.graphics.get(), src->bounds, dst->bounds, use_key ? PicoGraphics::BLIT_COLOUR_KEY : 0, key);
+  CHECK(dst.read_rgb() == want);
+}
+
+int main() {
+  // P8 surfaces with the same colours at different indices
+  {
+    Surface src = make_surface("P8", WIDTH, HEIGHT);
+    Surface dst = make_surface("P8", WIDTH, HEIGHT);
+    for(auto i = 0u; i < 16; i++) {
+      dst->update_pen(i, PALETTE[15 - i].r, PALETTE[15 - i].g, PALETTE[15 - i].b);
+    }
+    stripes(src);
+    blit(src, dst, false);
+    blit(src, dst, true, PALETTE[4]);
+  }
+
+  // P8 with the key colour at more than one index, all of them are skipped
+  {
+    Surface src = make_surface("P8", WIDTH, HEIGHT);
+    Surface dst = make_surface("P8", WIDTH, HEIGHT);
+    RGB key(10, 200, 30);
+    for(auto s : {&src, &dst}) {
+      (*s)->update_pen(3, key.r, key.g, key.b);
+      (*s)->update_pen(9, key.r, key.g, key.b);
+    }
+    stripes(src);
+    dst->set_pen(5);
+    dst->clear();
+    blit(src, dst, true, key);
+  }
+
+  // RGB332 and RGB565 keys, one the format can represent and one it would
+  // round to black
+  for(auto name : {"RGB332", "RGB565", "RGB888"}) {
+    for(auto key : {PALETTE[0], PALETTE[2], RGB(10, 10, 10)}) {
+      Surface src = make_surface(name, WIDTH, HEIGHT);
+      Surface dst = make_surface(name, WIDTH, HEIGHT);
+      stripes(src);
+      dst->set_pen(PALETTE[1].r, PALETTE[1].g, PALETTE[1].b);
+      dst->clear();
+      blit(src, dst, true, key);
+    }
+  }
+
+  // blits that draw through the pen leave the caller's pen as it was:
+  // converting, scaled bilinearly and alpha blended
+  static const struct { const char *src; const char *dst; uint flags; } drawn[] = {
+    {"RGB565", "P8", 0}, {"P8", "RGB565", 0}, {"RGB332", "1Bit", 0},
+    {"RGB565", "RGB565", PicoGraphics::BLIT_BILINEAR}, {"RGB888", "RGB565", PicoGraphics::BLIT_ALPHA},
+    {"RGB888", "RGB888", PicoGraphics::BLIT_ALPHA}, {"RGB565", "3Bit", 0}
+  };
+  for(auto &d : drawn) {
+    Surface src = make_surface(d.src, WIDTH, HEIGHT);
+    Surface dst = make_surface(d.dst, WIDTH * 2, HEIGHT * 2);
+    stripes(src);
+    if(d.flags & PicoGraphics::BLIT_ALPHA) {
+      // half the pixels half transparent
+      uint32_t *fb = (uint32_t *)src->frame_buffer;
+      for(auto i = 0; i < WIDTH * HEIGHT; i++) fb[i] = (fb[i] & 0xffffff) | ((i & 1) ? 0x80000000 : 0xff000000);
+    }
+
+    // a pen that none of the source's colours are drawn with, the dithering
+    // pens' pixels depend on where they are so compare the same one
+    Point p(WIDTH * 2 - 1, HEIGHT * 2 - 1);
+    dst->set_pen(10, 200, 30);
+    Surface ref = make_surface(d.dst, WIDTH * 2, HEIGHT * 2);
+    ref->set_pen(10, 200, 30);
+    ref->pixel(p);
+
+    Rect to = d.flags & PicoGraphics::BLIT_BILINEAR ? dst->bounds : src->bounds;
+    dst->blit(src.graphics.get(), src->bounds, to, d.flags);
+    dst->pixel(p);
+    RGB want, got;
+    ref->get_pixel_span(p, 1, &want);
+    dst->get_pixel_span(p, 1, &got);
+    if(want.r != got.r || want.g != got.g || want.b != got.b) {
+      fprintf(stderr, "%s to %s: pen changed by blit\n", d.src, d.dst);
+      check::failures++;
+    }
+  }
+
+  return check::result();
+}
@@ -0,0 +1,162 @@
+// DisplayList::render splitting a frame between workers, checked against a
+// single replay of the same list, and values too big for the 16-bit fields
+// of a list
+#include <vector>
+
+#include "check.hpp"
+#include "surfaces.hpp"
+
+using namespace bench;
+
+static const uint16_t WIDTH = 160;
+static const uint16_t HEIGHT = 120;
+
+static void append(void *context, void *data, size_t length) {
+  std::vector<uint8_t> *out = (std::vector<uint8_t> *)context;
+  out->insert(out->end(), (uint8_t *)data, (uint8_t *)data + length);
+}
+
+// the composited frame, as the display would be sent it
+static std::vector<uint8_t> convert(PicoGraphics *g) {
+  std::vector<uint8_t> out;
+  static uint8_t buffer[512];
+  static void *const pointers[1] = {buffer};
+  PicoGraphics::ConvertBuffers target = {pointers, 1, sizeof(buffer), append, &out};
+  g->frame_convert(PicoGraphics::PEN_RGB565, target);
+  return out;
+}
+
+static void scene(DisplayList &list) {
+  // clipped in from the edges, so the dirty area of the layer is smaller
+  // than the frame
+  list.set_clip(Rect(5, 3, WIDTH - 12, HEIGHT - 9));
+  list.set_pen(2);
+  for(auto i = 0; i < 40; i++) {
+    list.set_pen(1 + i % 15);
+    list.rectangle(Rect((i * 37) % WIDTH, (i * 23) % HEIGHT, 12, 9));
+    list.circle(Point((i * 53) % WIDTH, (i * 29) % HEIGHT), 6);
+    list.line(Point(0, i * 3), Point(WIDTH - 1, HEIGHT - 1 - i * 3));
+  }
+  // enough text on every row of bands that one worker can't finish the
+  // frame before the others have started
+  list.set_font("sans");
+  for(auto y = 0; y < HEIGHT; y += 8) {
+    list.set_pen(1 + y % 15);
+    for(auto i = 0; i < 20; i++) {
+      list.text("display list", Point(i - 10, y), WIDTH, 0.5f);
+    }
+  }
+}
+
+// count targets of the named pen sharing one framebuffer, drawing on layer
+static std::vector<PicoGraphics *> targets(Surface &s, std::vector<std::unique_ptr<PicoGraphics>> &owned, uint count, uint layer) {
+  std::vector<PicoGraphics *> list = {s.graphics.get()};
+  for(auto i = 1u; i < count; i++) {
+    if(s->pen_type == PicoGraphics::PEN_P4) {
+      owned.emplace_back(new PicoGraphics_PenP4(WIDTH, HEIGHT, s->frame_buffer, s->layers));
+      for(auto p = 0u; p < 16; p++) owned.back()->update_pen(p, PALETTE[p].r, PALETTE[p].g, PALETTE[p].b);
+    } else {
+      owned.emplace_back(new PicoGraphics_PenRGB565(WIDTH, HEIGHT, s->frame_buffer, s->layers));
+    }
+    list.push_back(owned.back().get());
+  }
+  for(auto t : list) {
+    t->set_layer(layer);
+    t->layer_settings[1].dirty = Rect(0, 0, 0, 0);
+  }
+  return list;
+}
+
+// a list drawn into a fresh surface, against the same ops drawn directly
+static void check_replay(const char *what, const DisplayList &list, void (*draw)(PicoGraphics *)) {
+  Surface want = make_surface("RGB565", WIDTH, HEIGHT);
+  Surface got = make_surface("RGB565", WIDTH, HEIGHT);
+  draw(want.graphics.get());
+  list.replay(got.graphics.get());
+  if(convert(got.graphics.get()) != convert(want.graphics.get())) {
+    fprintf(stderr, "%s differs from drawing directly\n", what);
+    check::failures++;
+  }
+}
+
+static void out_of_range() {
+  // thicker than a byte, which only hershey text uses
+  DisplayList thick;
+  thick.set_pen(3);
+  thick.set_font("sans");
+  thick.set_thickness(300);
+  thick.text("-", Point(70, 55), WIDTH, 0.5f);
+  check_replay("thickness 300", thick, [](PicoGraphics *g) {
+    g->set_pen(3);
+    g->set_font("sans");
+    g->set_thickness(300);
+    g->text("-", Point(70, 55), WIDTH, 0.5f);
+  });
+
+  // wider than 16 bits, stored clipped
+  DisplayList wide;
+  wide.set_pen(4);
+  wide.rectangle(Rect(-40000, 10, 80040, 20));
+  check_replay("rectangle beyond 16 bits", wide, [](PicoGraphics *g) {
+    g->set_pen(4);
+    g->rectangle(Rect(-40000, 10, 80040, 20));
+  });
+
+  // a point that can't be stored is dropped rather than wrapped
+  DisplayList far;
+  far.set_pen(5);
+  size_t size = far.size();
+  far.line(Point(10, 10), Point(40000, 20));
+  far.triangle(Point(10, 10), Point(20, -40000), Point(30, 10));
+  far.polygon({Point(0, 0), Point(10, 0), Point(0, 40000)});
+  far.circle(Point(-40000, 10), 5);
+  far.circle(Point(10, 10), 40000);
+  far.text("far", Point(40000, 0), WIDTH);
+  CHECK_EQ(far.size(), size);
+}
+
+int main() {
+  out_of_range();
+
+  DisplayList list;
+  scene(list);
+
+  for(auto name : {"RGB565", "P4"}) {
+    for(uint layer : {0u, 1u}) {
+      // make_surface clears every layer, forget that so only what the list
+      // draws is counted
+      Surface reference = make_surface(name, WIDTH, HEIGHT, 2);
+      reference->layer_settings[1].dirty = Rect(0, 0, 0, 0);
+      reference->set_layer(layer);
+      list.replay(reference.graphics.get());
+      std::vector<uint8_t> want = convert(reference.graphics.get());
+
+      for(auto count : {1u, 2u, 3u, 4u, 8u}) {
+        Surface s = make_surface(name, WIDTH, HEIGHT, 2);
+        std::vector<std::unique_ptr<PicoGraphics>> owned;
+        std::vector<PicoGraphics *> t = targets(s, owned, count, layer);
+
+        // the workers are kept between renders, so go round a few times
+        for(auto frame = 0; frame < 3; frame++) {
+          list.render(t.data(), count);
+        }
+
+        // whatever the other workers drew on the layer is known to the
+        // first target, which the frame is converted from
+        if(layer) {
+          for(auto i = 1u; i < count; i++) CHECK(t[i]->layer_settings[layer].dirty.empty());
+          const Rect &d = s->layer_settings[layer].dirty;
+          const Rect &r = reference->layer_settings[layer].dirty;
+          CHECK(d.x == r.x && d.y == r.y && d.w == r.w && d.h == r.h);
+          CHECK(r.w < WIDTH && r.h < HEIGHT);
+        }
+        if(convert(s.graphics.get()) != want) {
+          fprintf(stderr, "%s layer %u with %u workers differs from replay\n", name, layer, count);
+          check::failures++;
+        }
+      }
+    }
+  }
+
+  return check::result();
+}
@@ -0,0 +1,159 @@
+// frame buffers allocated by the pens: each pen type with 1-4 layers asks
+// for buffer_size * layers, aligned, draws into every layer without going
+// past the end and gives the buffer back when destroyed. a FrameBufferArena
+// hands the same memory out again as a display is reconfigured and passes
+// on what doesn't fit to its fallback
+#include <cstring>
+#include <map>
+
+#include "check.hpp"
+#include "surfaces.hpp"
+
+using namespace bench;
+
+// the pens' buffer_size assumes a frame fills whole bytes, which a P4 or
+// 1Bit frame with an odd number of pixels doesn't
+static const uint16_t WIDTH = 40;
+static const uint16_t HEIGHT = 24;
+static const size_t GUARD = 64;
+
+// hands out heap buffers with guard bytes after them, checked on release
+class GuardedAllocator : public FrameBufferAllocator {
+  public:
+    std::map<void *, size_t> live;
+    std::vector<size_t> sizes;
+    std::vector<size_t> alignments;
+    uint32_t releases = 0;
+    uint32_t overruns = 0;
+
+    void *allocate(size_t size, size_t alignment) override {
+      sizes.push_back(size);
+      alignments.push_back(alignment);
+      uint8_t *p = new uint8_t[size + GUARD];
+      memset(p + size, 0xa5, GUARD);
+      live[p] = size;
+      return p;
+    }
+
+    void release(void *buffer) override {
+      auto i = live.find(buffer);
+      if(i == live.end()) {
+        fprintf(stderr, "released a buffer that wasn't allocated\n");
+        check::failures++;
+        return;
+      }
+      uint8_t *p = (uint8_t *)buffer;
+      for(auto g = 0u; g < GUARD; g++) {
+        if(p[i->second + g] != 0xa5) {
+          overruns++;
+          break;
+        }
+      }
+      delete[] p;
+      live.erase(i);
+      releases++;
+    }
+};
+
+static size_t layer_size(const std::string &name) {
+  if(name == "1Bit") return PicoGraphics_Pen1Bit::buffer_size(WIDTH, HEIGHT);
+  if(name == "1BitY") return PicoGraphics_Pen1BitY::buffer_size(WIDTH, HEIGHT);
+  if(name == "3Bit") return PicoGraphics_Pen3Bit::buffer_size(WIDTH, HEIGHT);
+  if(name == "P4") return PicoGraphics_PenP4::buffer_size(WIDTH, HEIGHT);
+  if(name == "P8") return PicoGraphics_PenP8::buffer_size(WIDTH, HEIGHT);
+  if(name == "RGB332") return PicoGraphics_PenRGB332::buffer_size(WIDTH, HEIGHT);
+  if(name == "RGB565") return PicoGraphics_PenRGB565::buffer_size(WIDTH, HEIGHT);
+  if(name == "RGB888") return PicoGraphics_PenRGB888::buffer_size(WIDTH, HEIGHT);
+  // Inky7 draws straight to its driver
+  return 0;
+}
+
+static void sizing() {
+  GuardedAllocator guarded;
+  PicoGraphics::allocator = &guarded;
+
+  for(auto name : pen_names()) {
+    for(uint16_t layers = 1; layers <= 4; layers++) {
+      guarded.sizes.clear();
+      guarded.alignments.clear();
+      uint32_t releases = guarded.releases;
+      size_t expected = layer_size(name) * layers;
+      {
+        Surface s = make_surface(name, WIDTH, HEIGHT, layers);
+        if(expected == 0) {
+          CHECK(guarded.sizes.empty());
+        } else {
+          CHECK_EQ(guarded.sizes.size(), size_t(1));
+          if(guarded.sizes.size() == 1) {
+            if(guarded.sizes[0] != expected) {
+              fprintf(stderr, "%s with %u layers: allocated %zu bytes, expected %zu\n", name, layers, guarded.sizes[0], expected);
+              check::failures++;
+            }
+            CHECK_EQ(guarded.alignments[0], PicoGraphics::FRAME_BUFFER_ALIGNMENT);
+            CHECK_EQ(uintptr_t(s->frame_buffer) % PicoGraphics::FRAME_BUFFER_ALIGNMENT, uintptr_t(0));
+          }
+        }
+
+        // fill every layer, the last pixel of the last layer included
+        for(auto l = 0u; l < layers; l++) {
+          s->set_layer(l);
+          s->set_pen(1);
+          s->clear();
+          s->pixel(Point(WIDTH - 1, HEIGHT - 1));
+        }
+        s->set_layer(0);
+      }
+      CHECK_EQ(guarded.releases - releases, expected ? 1u : 0u);
+    }
+  }
+
+  CHECK_EQ(guarded.overruns, 0u);
+  CHECK(guarded.live.empty());
+  PicoGraphics::allocator = nullptr;
+}
+
+static void arena() {
+  static uint8_t memory[64 * 1024];
+  GuardedAllocator fallback;
+  FrameBufferArena sram({memory + 1, sizeof(memory) - 1}, &fallback);
+  PicoGraphics::allocator = &sram;
+  size_t total = sram.free_space();
+
+  // a display set up again and again with different pens and layers keeps
+  // landing in the arena, and leaves it whole each time
+  static const struct { const char *pen; uint16_t w, h, layers; } configs[] = {
+    {"RGB565", 160, 120, 1}, {"P8", 160, 120, 2}, {"RGB888", 64, 64, 3},
+    {"P4", 240, 135, 4}, {"1Bit", 128, 64, 2}, {"RGB332", 120, 120, 4}
+  };
+  for(int pass = 0; pass < 3; pass++) {
+    for(auto &c : configs) {
+      Surface s = make_surface(c.pen, c.w, c.h, c.layers);
+      uint8_t *fb = (uint8_t *)s->frame_buffer;
+      CHECK(fb >= memory && fb < memory + sizeof(memory));
+      CHECK_EQ(uintptr_t(fb) % PicoGraphics::FRAME_BUFFER_ALIGNMENT, uintptr_t(0));
+    }
+    CHECK_EQ(sram.free_space(), total);
+    CHECK_EQ(sram.largest_free(), total);
+  }
+  CHECK(fallback.sizes.empty());
+
+  // two displays at once, the second too big for what is left
+  {
+    Surface a = make_surface("RGB565", 160, 120, 1);
+    Surface b = make_surface("RGB565", 160, 120, 1);
+    CHECK((uint8_t *)a->frame_buffer >= memory && (uint8_t *)a->frame_buffer < memory + sizeof(memory));
+    CHECK_EQ(fallback.sizes.size(), size_t(1));
+    CHECK(fallback.live.count(b->frame_buffer) == 1);
+  }
+  CHECK(fallback.live.empty());
+  CHECK_EQ(fallback.overruns, 0u);
+  CHECK_EQ(sram.free_space(), total);
+
+  PicoGraphics::allocator = nullptr;
+}
+
+int main() {
+  sizing();
+  arena();
+  return check::result();
+}
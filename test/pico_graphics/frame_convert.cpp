@@ -0,0 +1,72 @@
+// frame_convert packing pixels into the target buffers, for frame widths
+// and buffer sizes that don't line up with the pixels in a byte
+#include <vector>
+
+#include "check.hpp"
+#include "surfaces.hpp"
+
+using namespace bench;
+
+static void append(void *context, void *data, size_t length) {
+  std::vector<uint8_t> *out = (std::vector<uint8_t> *)context;
+  out->insert(out->end(), (uint8_t *)data, (uint8_t *)data + length);
+}
+
+static std::vector<uint8_t> convert(Surface &s, PicoGraphics::PenType type, size_t length) {
+  std::vector<uint8_t> out;
+  std::vector<uint8_t> buffers[2] = {std::vector<uint8_t>(length), std::vector<uint8_t>(length)};
+  void *pointers[2] = {buffers[0].data(), buffers[1].data()};
+  PicoGraphics::ConvertBuffers target = {pointers, 2, length, append, &out};
+  s->frame_convert(type, target);
+  return out;
+}
+
+int main() {
+  // odd widths either side of the 64 pixel segments Inky7 reads from its
+  // driver, with buffers a few bytes long and larger than a row
+  for(uint16_t width : {1, 7, 37, 64, 65, 101, 128}) {
+    for(size_t length : {1, 3, 16, 100}) {
+      const uint16_t height = 5;
+      Surface s = make_surface("Inky7", width, height);
+      std::vector<uint8_t> &pixels = s.driver->pixels;
+      for(auto i = 0u; i < pixels.size(); i++) pixels[i] = (i * 5 + i / 3) % 7;
+
+      // two pixels a byte, first in the high nibble, across the whole frame
+      std::vector<uint8_t> want((pixels.size() + 1) / 2);
+      for(auto i = 0u; i < pixels.size(); i++) {
+        want[i / 2] |= i & 1 ? pixels[i] : pixels[i] << 4;
+      }
+
+      std::vector<uint8_t> got = convert(s, PicoGraphics::PEN_INKY7, length);
+      if(got != want) {
+        fprintf(stderr, "Inky7 %ux%u with %zu byte buffers packed wrongly\n", width, height, length);
+        check::failures++;
+      }
+    }
+  }
+
+  // the P4 and P8 convert lookups follow palette changes, including
+  // entries written directly followed by palette_changed()
+  for(auto name : {"P4", "P8"}) {
+    Surface s = make_surface(name, 8, 2);
+    s->set_pen(3);
+    s->clear();
+    convert(s, PicoGraphics::PEN_RGB565, 16);
+
+    s->update_pen(3, 255, 0, 0);
+    std::vector<uint8_t> red = convert(s, PicoGraphics::PEN_RGB565, 16);
+    CHECK_EQ(*(RGB565 *)red.data(), RGB(255, 0, 0).to_rgb565());
+
+    RGB *palette = s->get_palette();
+    palette[3] = RGB(0, 0, 255);
+    if(s->pen_type == PicoGraphics::PEN_P4) {
+      ((PicoGraphics_PenP4 *)s.graphics.get())->palette_changed();
+    } else {
+      ((PicoGraphics_PenP8 *)s.graphics.get())->palette_changed();
+    }
+    std::vector<uint8_t> blue = convert(s, PicoGraphics::PEN_RGB565, 16);
+    CHECK_EQ(*(RGB565 *)blue.data(), RGB(0, 0, 255).to_rgb565());
+  }
+
+  return check::result();
+}
@@ -0,0 +1,301 @@
+// Golden image tests for pico_graphics.
+//
+// A fixed set of scenes is drawn through every pen type and compared pixel
+// for pixel with the images stored in test/pico_graphics/golden. When a
+// scene doesn't match, a side by side PPM of the golden image, what was
+// drawn and the differences (in red) is written to the report directory.
+//
+// Run with --update to write new golden images after an intended change,
+// and check the differences before committing them.
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "surfaces.hpp"
+
+using namespace bench;
+
+static const uint16_t WIDTH = 128;
+static const uint16_t HEIGHT = 80;
+
+// outlines, fills, lines at every angle and clipping
+static void scene_shapes(PicoGraphics *g) {
+  g->set_pen(255, 0, 0);
+  g->rectangle(Rect(2, 2, 30, 20));
+  g->set_pen(0, 255, 0);
+  g->circle(Point(50, 16), 14);
+  g->set_pen(0, 0, 255);
+  g->circle(Point(72, 6), 1);
+  g->circle(Point(78, 6), 0);
+
+  g->set_pen(255, 255, 0);
+  for(auto a = 0; a < 360; a += 15) {
+    float r = a * float(M_PI) / 180.0f;
+    g->line(Point(100, 24), Point(100 + int32_t(22 * cosf(r)), 24 + int32_t(22 * sinf(r))));
+  }
+  g->line(Point(-20, -5), Point(200, 150));
+  g->line(Point(3, 78), Point(3, 40));
+  g->line(Point(0, 60), Point(127, 60));
+
+  g->set_pen(0, 255, 255);
+  g->thick_line(Point(8, 30), Point(40, 54), 5);
+  g->thick_line(Point(44, 30), Point(44, 56), 3);
+  g->thick_line(Point(50, 40), Point(70, 44), 1);
+
+  g->set_pen(255, 0, 255);
+  g->triangle(Point(60, 50), Point(90, 76), Point(52, 78));
+  g->set_pen(128, 64, 200);
+  g->polygon({Point(96, 50), Point(126, 54), Point(122, 76), Point(106, 68), Point(92, 74)});
+
+  // a circle clipped by a clip nested inside another
+  g->push_clip(Rect(70, 30, 40, 30));
+  g->push_clip(Rect(60, 40, 30, 30));
+  g->set_pen(255, 128, 0);
+  g->circle(Point(80, 50), 12);
+  g->pop_clip();
+  g->pop_clip();
+}
+
+// every bitmap font, rotated, wrapped and with accents, and Hershey text
+static void scene_text(PicoGraphics *g) {
+  g->set_pen(255, 255, 255);
+  g->set_font("bitmap6");
+  g->text("Pico 6px \xc3\xa9\xc3\xa0\xc3\xbc", Point(2, 2), WIDTH, 1);
+  g->set_font("bitmap8");
+  g->text("Wrapped at forty", Point(2, 12), 40, 1);
+  g->set_font("bitmap14_outline");
+  g->set_pen(255, 255, 0);
+  g->text("Out", Point(48, 12), WIDTH, 1);
+
+  g->set_font("bitmap8");
+  g->set_pen(0, 255, 255);
+  g->text("90", Point(100, 2), WIDTH, 1, 90);
+  g->text("180", Point(124, 30), WIDTH, 1, 180);
+  g->text("270", Point(90, 40), WIDTH, 1, 270);
+  g->text("x2", Point(60, 30), WIDTH, 2);
+
+  g->set_font("sans");
+  g->set_pen(255, 0, 255);
+  g->text("Hershey", Point(2, 56), WIDTH, 0.6f);
+  g->set_thickness(2);
+  g->set_pen(0, 255, 0);
+  g->text("Tilt", Point(70, 70), WIDTH, 0.5f, 20.0f);
+  g->set_thickness(1);
+}
+
+// ordered dithering from single pixels and spans, and error diffusion
+static void scene_dither(PicoGraphics *g) {
+  for(auto y = 0; y < 24; y++) {
+    for(auto x = 0; x < WIDTH; x++) {
+      g->set_pixel_dither(Point(x, y), RGB(x * 2, y * 10, 255 - x * 2));
+    }
+  }
+
+  std::vector<RGB> row(WIDTH);
+  for(auto y = 24; y < 48; y++) {
+    for(auto x = 0; x < WIDTH; x++) {
+      row[x] = RGB::from_hsv(x / float(WIDTH), 1.0f, 0.3f + y / 70.0f);
+    }
+    g->set_pixel_dither_span(Point(0, y), WIDTH, row.data());
+  }
+
+  for(auto mode : {ErrorDiffusion::FLOYD_STEINBERG, ErrorDiffusion::ATKINSON}) {
+    int32_t x0 = mode == ErrorDiffusion::ATKINSON ? WIDTH / 2 : 0;
+    ErrorDiffusion diffusion(g, Rect(x0, 48, WIDTH / 2, 32), mode);
+    for(auto y = 0; y < 32; y++) {
+      for(auto x = 0; x < WIDTH / 2; x++) {
+        row[x] = RGB(x * 4, 128 + y * 2, 255 - y * 8);
+      }
+      diffusion.write_row(row.data());
+    }
+  }
+}
+
+// coverage tiles, antialiased shapes, alpha pixels and scaled blits
+static void scene_alpha(PicoGraphics *g) {
+  static uint8_t alpha[32 * 24];
+  for(auto y = 0; y < 24; y++) {
+    for(auto x = 0; x < 32; x++) {
+      alpha[y * 32 + x] = (x * 8 + y * 10) & 0xff;
+    }
+  }
+
+  g->set_pen(0, 255, 128);
+  Tile tile = {2, 2, 32, 24, 32, alpha};
+  if(!g->render_tile(&tile)) {
+    for(auto y = 0; y < 24; y++) {
+      for(auto x = 0; x < 32; x++) {
+        if(alpha[y * 32 + x] >= 128) g->pixel(Point(2 + x, 2 + y));
+      }
+    }
+  }
+
+  if(g->supports_alpha_blend()) {
+    g->set_pen(255, 0, 0);
+    for(auto x = 0; x < 60; x++) {
+      g->set_pixel_alpha(Point(2 + x, 30), x * 4);
+      g->set_pixel_alpha(Point(2 + x, 31), x * 4);
+    }
+  }
+
+  g->set_pen(255, 255, 255);
+  g->aa_line(Point(40, 4), Point(120, 20), 1);
+  g->aa_line(Point(40, 12), Point(110, 34), 4);
+  g->set_pen(255, 255, 0);
+  g->aa_circle(Point(20, 56), 14);
+  g->set_pen(0, 128, 255);
+  g->aa_arc(Point(60, 56), 16, 30.0f, 250.0f, 4);
+
+  // a small RGB888 source blitted scaled, with a colour key and filtered
+  PicoGraphics_PenRGB888 src(8, 8, nullptr);
+  for(auto y = 0; y < 8; y++) {
+    for(auto x = 0; x < 8; x++) {
+      src.set_pen(x * 32, y * 32, 255 - x * 32);
+      src.pixel(Point(x, y));
+    }
+  }
+  src.set_pen(0, 0, 0);
+  src.pixel(Point(3, 3));
+  g->blit(&src, Rect(0, 0, 8, 8), Rect(84, 40, 16, 16), PicoGraphics::BLIT_COLOUR_KEY, RGB(0, 0, 0));
+  g->blit(&src, Rect(0, 0, 8, 8), Rect(104, 40, 20, 20), PicoGraphics::BLIT_BILINEAR);
+}
+
+struct Scene {
+  const char *name;
+  void (*draw)(PicoGraphics *g);
+};
+
+static const Scene scenes[] = {
+  {"shapes", scene_shapes},
+  {"text", scene_text},
+  {"dither", scene_dither},
+  {"alpha", scene_alpha},
+};
+
+static bool write_ppm(const std::string &path, uint w, uint h, const std::vector<uint8_t> &rgb) {
+  FILE *f = fopen(path.c_str(), "wb");
+  if(!f) return false;
+  fprintf(f, "P6\n%u %u\n255\n", w, h);
+  fwrite(rgb.data(), 1, rgb.size(), f);
+  fclose(f);
+  return true;
+}
+
+static bool read_ppm(const std::string &path, uint &w, uint &h, std::vector<uint8_t> &rgb) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if(!f) return false;
+  uint max = 0;
+  bool ok = fscanf(f, "P6 %u %u %u", &w, &h, &max) == 3 && max == 255 && fgetc(f) != EOF;
+  if(ok) {
+    rgb.resize(w * h * 3);
+    ok = fread(rgb.data(), 1, rgb.size(), f) == rgb.size();
+  }
+  fclose(f);
+  return ok;
+}
+
+// golden | drawn | differences, the differences in red over a dimmed copy
+// of the golden image
+static std::vector<uint8_t> side_by_side(const std::vector<uint8_t> &golden, const std::vector<uint8_t> &drawn, uint &w) {
+  const uint GAP = 4;
+  w = WIDTH * 3 + GAP * 2;
+  std::vector<uint8_t> out(w * HEIGHT * 3, 64);
+  for(auto y = 0u; y < HEIGHT; y++) {
+    for(auto x = 0u; x < WIDTH; x++) {
+      const uint8_t *a = &golden[(y * WIDTH + x) * 3];
+      const uint8_t *b = &drawn[(y * WIDTH + x) * 3];
+      uint8_t *row = &out[y * w * 3];
+      memcpy(row + x * 3, a, 3);
+      memcpy(row + (WIDTH + GAP + x) * 3, b, 3);
+      uint8_t *d = row + ((WIDTH + GAP) * 2 + x) * 3;
+      if(memcmp(a, b, 3) != 0) {
+        d[0] = 255;
+        d[1] = d[2] = 0;
+      } else {
+        d[0] = d[1] = d[2] = (a[0] + a[1] + a[2]) / 12;
+      }
+    }
+  }
+  return out;
+}
+
+int main(int argc, char **argv) {
+  std::string golden_dir = "golden";
+  std::string report_dir = ".";
+  bool update = false;
+
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--update") == 0) {
+      update = true;
+    } else if(strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+      golden_dir = argv[++i];
+    } else if(strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+      report_dir = argv[++i];
+    } else {
+      fprintf(stderr, "usage: %s [--update] [--golden dir] [--report dir]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  uint failed = 0, checked = 0;
+  for(auto &scene : scenes) {
+    for(auto pen : pen_names()) {
+      Surface s = make_surface(pen, WIDTH, HEIGHT);
+      scene.draw(s.graphics.get());
+      std::vector<uint8_t> drawn = s.read_rgb();
+
+      std::string name = std::string(scene.name) + "_" + pen;
+      std::string path = golden_dir + "/" + name + ".ppm";
+      checked++;
+
+      if(update) {
+        if(!write_ppm(path, WIDTH, HEIGHT, drawn)) {
+          fprintf(stderr, "%s: can't write %s\n", name.c_str(), path.c_str());
+          failed++;
+        }
+        continue;
+      }
+
+      uint w, h;
+      std::vector<uint8_t> golden;
+      if(!read_ppm(path, w, h, golden) || w != WIDTH || h != HEIGHT) {
+        fprintf(stderr, "%s: missing or unreadable golden image %s\n", name.c_str(), path.c_str());
+        failed++;
+        continue;
+      }
+
+      // count the differing pixels and find the area they cover
+      uint differ = 0;
+      Rect box(WIDTH, HEIGHT, 0, 0);
+      Point br(0, 0);
+      for(auto y = 0; y < HEIGHT; y++) {
+        for(auto x = 0; x < WIDTH; x++) {
+          if(memcmp(&golden[(y * WIDTH + x) * 3], &drawn[(y * WIDTH + x) * 3], 3) == 0) continue;
+          differ++;
+          box.x = std::min(box.x, int32_t(x));
+          box.y = std::min(box.y, int32_t(y));
+          br.x = std::max(br.x, int32_t(x));
+          br.y = std::max(br.y, int32_t(y));
+        }
+      }
+      if(differ == 0) continue;
+
+      failed++;
+      uint rw;
+      std::vector<uint8_t> composite = side_by_side(golden, drawn, rw);
+      std::string report = report_dir + "/" + name + "_diff.ppm";
+      bool written = write_ppm(report, rw, HEIGHT, composite);
+      fprintf(stderr, "%s: %u pixels differ between (%d, %d) and (%d, %d)%s%s\n", name.c_str(), differ,
+        box.x, box.y, br.x, br.y, written ? ", see " : "", written ? report.c_str() : "");
+    }
+  }
+
+  if(update) {
+    printf("wrote %u golden images to %s\n", checked - failed, golden_dir.c_str());
+  } else {
+    printf("%u of %u scenes match their golden images\n", checked - failed, checked);
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,154 @@
+// ImageDecoder against the reference images in test/pico_graphics/images,
+// which make_images.py writes along with a PPM of what each should decode to
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "surfaces.hpp"
+
+using namespace bench;
+
+static std::string images;
+
+static std::vector<uint8_t> load(const std::string &name) {
+  std::vector<uint8_t> data;
+  FILE *f = fopen((images + "/" + name).c_str(), "rb");
+  if(!f) return data;
+  uint8_t buffer[4096];
+  size_t n;
+  while((n = fread(buffer, 1, sizeof(buffer), f)) > 0) data.insert(data.end(), buffer, buffer + n);
+  fclose(f);
+  return data;
+}
+
+static bool load_ppm(const std::string &name, uint &w, uint &h, std::vector<uint8_t> &rgb) {
+  std::vector<uint8_t> data = load(name);
+  uint max = 0;
+  int offset = 0;
+  data.push_back(0);
+  if(sscanf((const char *)data.data(), "P6 %u %u %u%n", &w, &h, &max, &offset) != 3 || max != 255) return false;
+  offset++;
+  if(data.size() - 1 < offset + w * h * 3) return false;
+  rgb.assign(data.begin() + offset, data.begin() + offset + w * h * 3);
+  return true;
+}
+
+// decode into an RGB888 surface the size of the image, optionally feeding
+// the decoder a few bytes at a time to exercise the streaming
+static void check_image(const char *file, const char *reference, size_t chunk = 0) {
+  std::vector<uint8_t> data = load(file);
+  uint w, h;
+  std::vector<uint8_t> expected;
+  if(data.empty() || !load_ppm(reference, w, h, expected)) {
+    fprintf(stderr, "%s: can't load the reference images from %s\n", file, images.c_str());
+    check::failures++;
+    return;
+  }
+
+  size_t pos = 0;
+  ImageDecoder decoder = chunk == 0 ? ImageDecoder(data.data(), data.size()) : ImageDecoder([&](uint8_t *out, size_t len) {
+    size_t n = std::min({len, chunk, data.size() - pos});
+    memcpy(out, &data[pos], n);
+    pos += n;
+    return n;
+  });
+
+  CHECK_EQ(decoder.open(), ImageDecoder::OK);
+  CHECK_EQ(decoder.width, w);
+  CHECK_EQ(decoder.height, h);
+
+  Surface s = make_surface("RGB888", w, h);
+  CHECK_EQ(decoder.draw(s.graphics.get(), Point(0, 0)), ImageDecoder::OK);
+
+  std::vector<uint8_t> drawn = s.read_rgb();
+  uint wrong = 0;
+  for(auto i = 0u; i < drawn.size(); i += 3) {
+    if(drawn[i] != expected[i] || drawn[i + 1] != expected[i + 1] || drawn[i + 2] != expected[i + 2]) wrong++;
+  }
+  if(wrong) {
+    fprintf(stderr, "%s: %u of %u pixels differ from %s\n", file, wrong, w * h, reference);
+    check::failures++;
+  }
+}
+
+// scaled draws pick the source pixel under the centre of each destination
+// pixel, and clipped draws leave everything outside the clip alone
+static void check_scaled(const char *file, const char *reference) {
+  std::vector<uint8_t> data = load(file);
+  uint w, h;
+  std::vector<uint8_t> expected;
+  if(data.empty() || !load_ppm(reference, w, h, expected)) {
+    check::failures++;
+    return;
+  }
+
+  const uint16_t SW = 50, SH = 17;
+  Surface s = make_surface("RGB888", 64, 32);
+  s->set_clip(Rect(4, 2, SW, SH - 4));
+  ImageDecoder decoder(data.data(), data.size());
+  CHECK_EQ(decoder.open(), ImageDecoder::OK);
+  CHECK_EQ(decoder.draw(s.graphics.get(), Rect(4, 2, SW, SH)), ImageDecoder::OK);
+
+  std::vector<uint8_t> drawn = s.read_rgb();
+  uint wrong = 0;
+  for(auto y = 0; y < 32; y++) {
+    for(auto x = 0; x < 64; x++) {
+      const uint8_t *p = &drawn[(y * 64 + x) * 3];
+      uint8_t want[3] = {0, 0, 0};
+      if(x >= 4 && x < 4 + SW && y >= 2 && y < 2 + SH - 4) {
+        uint sx = ((2 * (x - 4) + 1) * w) / (2 * SW);
+        uint sy = ((2 * (y - 2) + 1) * h) / (2 * SH);
+        memcpy(want, &expected[(sy * w + sx) * 3], 3);
+      }
+      if(memcmp(p, want, 3) != 0) wrong++;
+    }
+  }
+  if(wrong) {
+    fprintf(stderr, "%s: %u pixels differ when scaled and clipped\n", file, wrong);
+    check::failures++;
+  }
+}
+
+static void check_rejected(const char *file, size_t truncate, ImageDecoder::Result open, ImageDecoder::Result draw) {
+  std::vector<uint8_t> data = load(file);
+  if(truncate) data.resize(truncate);
+  ImageDecoder decoder(data.data(), data.size());
+  Surface s = make_surface("RGB888", 64, 32);
+  CHECK_EQ(decoder.open(), open);
+  if(open == ImageDecoder::OK) CHECK_EQ(decoder.draw(s.graphics.get(), Point(0, 0)), draw);
+}
+
+int main(int argc, char **argv) {
+  if(argc != 2) {
+    fprintf(stderr, "usage: %s images_dir\n", argv[0]);
+    return 1;
+  }
+  images = argv[1];
+
+  for(auto name : {"grey1", "grey2", "grey4", "grey8", "grey16", "grey_alpha8",
+                   "palette1", "palette2", "palette4", "palette8",
+                   "rgb8", "rgb16", "rgba8", "rgba16",
+                   "rgb8_stored", "rgb8_fixed", "rgb8_split"}) {
+    check_image((std::string(name) + ".png").c_str(), (std::string(name) + ".ppm").c_str());
+  }
+  check_image("rgba.qoi", "rgba.ppm");
+
+  // a byte at a time, and in chunks that don't line up with anything
+  check_image("rgb16.png", "rgb16.ppm", 1);
+  check_image("rgb8_split.png", "rgb8_split.ppm", 7);
+  check_image("rgba.qoi", "rgba.ppm", 1);
+
+  check_scaled("rgb8.png", "rgb8.ppm");
+  check_scaled("rgba.qoi", "rgba.ppm");
+
+  check_rejected("rgb8_interlaced.png", 0, ImageDecoder::ERROR_UNSUPPORTED, ImageDecoder::OK);
+  check_rejected("rgb8.ppm", 0, ImageDecoder::ERROR_FORMAT, ImageDecoder::OK);
+  check_rejected("rgb8.png", 4, ImageDecoder::ERROR_READ, ImageDecoder::OK);
+  check_rejected("rgb8.png", 600, ImageDecoder::OK, ImageDecoder::ERROR_READ);
+  check_rejected("rgba.qoi", 2000, ImageDecoder::OK, ImageDecoder::ERROR_READ);
+
+  return check::result();
+}
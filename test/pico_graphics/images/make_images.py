@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+# Writes the reference images for image_decoder.cpp: PNGs covering every
+# colour type and bit depth the decoder accepts, each filter type and stored,
+# fixed and dynamic deflate blocks, a QOI using every op, and for each of
+# them a PPM of what it should decode to.
+#
+# The images are committed, this only needs running again if it changes.
+import os
+import struct
+import zlib
+
+W, H = 37, 23
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def lcg(seed):
+    while True:
+        seed = (seed * 1103515245 + 12345) & 0x7fffffff
+        yield seed >> 8
+
+
+def source():
+    # gradients, flat areas (runs), a few repeated colours and some noise,
+    # as 16-bit samples so the 16-bit images have a low byte to drop
+    rand = lcg(1)
+    px = []
+    for y in range(H):
+        row = []
+        for x in range(W):
+            if y < 6:
+                c = (x * 1800, y * 10000, 65535 - x * 1700)
+            elif y < 12:
+                c = [(65535, 0, 0), (0, 65535, 0), (0, 0, 65535), (65535, 65535, 65535)][(x // 5) % 4]
+            elif y < 18:
+                c = (next(rand) & 0xffff, next(rand) & 0xffff, next(rand) & 0xffff)
+            else:
+                c = (32768 + x * 64, 32768 + x * 32, 32768 - x * 64)
+            a = (x * 7 + y * 11) * 257 & 0xffff
+            row.append((c[0], c[1], c[2], a))
+        px.append(row)
+    return px
+
+
+def chunk(kind, data):
+    body = kind + data
+    return struct.pack(">I", len(data)) + body + struct.pack(">I", zlib.crc32(body) & 0xffffffff)
+
+
+def pack(samples, depth):
+    # one row of samples to bytes, most significant bits first
+    if depth == 16:
+        return b"".join(struct.pack(">H", s) for s in samples)
+    if depth == 8:
+        return bytes(samples)
+    out = bytearray()
+    per = 8 // depth
+    for i in range(0, len(samples), per):
+        b = 0
+        for j in range(per):
+            s = samples[i + j] if i + j < len(samples) else 0
+            b |= s << (8 - depth * (j + 1))
+        out.append(b)
+    return bytes(out)
+
+
+def filter_row(kind, row, prev, bpp):
+    out = bytearray()
+    for i, v in enumerate(row):
+        a = row[i - bpp] if i >= bpp else 0
+        b = prev[i]
+        c = prev[i - bpp] if i >= bpp else 0
+        if kind == 0:
+            p = 0
+        elif kind == 1:
+            p = a
+        elif kind == 2:
+            p = b
+        elif kind == 3:
+            p = (a + b) >> 1
+        else:
+            q = a + b - c
+            pa, pb, pc = abs(q - a), abs(q - b), abs(q - c)
+            p = a if pa <= pb and pa <= pc else (b if pb <= pc else c)
+        out.append((v - p) & 0xff)
+    return bytes([kind]) + bytes(out)
+
+
+def png(name, colour_type, depth, rows, palette=None, compress=None, idat_split=None, interlace=0, expect=None):
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[colour_type]
+    bpp = max(1, channels * depth // 8)
+    raw = bytearray()
+    prev = bytes(len(pack(rows[0], depth)))
+    for y, samples in enumerate(rows):
+        row = pack(samples, depth)
+        raw += filter_row(y % 5, row, prev, bpp)
+        prev = row
+
+    if compress == "stored":
+        z = zlib.compressobj(0)
+    elif compress == "fixed":
+        z = zlib.compressobj(9, zlib.DEFLATED, 15, 9, zlib.Z_FIXED)
+    else:
+        z = zlib.compressobj(9)
+    data = z.compress(bytes(raw)) + z.flush()
+
+    out = b"\x89PNG\r\n\x1a\n"
+    out += chunk(b"IHDR", struct.pack(">IIBBBBB", W, H, depth, colour_type, 0, 0, interlace))
+    out += chunk(b"tEXt", b"Comment\0skipped by the decoder")
+    if palette:
+        out += chunk(b"PLTE", bytes(v for c in palette for v in c))
+    split = idat_split or len(data)
+    for i in range(0, len(data), split):
+        out += chunk(b"IDAT", data[i:i + split])
+    out += chunk(b"IEND", b"")
+
+    with open(os.path.join(HERE, name + ".png"), "wb") as f:
+        f.write(out)
+    if expect:
+        ppm(name, expect)
+
+
+def qoi(name, pixels):
+    out = bytearray(b"qoif" + struct.pack(">IIBB", W, H, 4, 0))
+    index = [(0, 0, 0, 0)] * 64
+    prev = (0, 0, 0, 255)
+    run = 0
+    flat = [p for row in pixels for p in row]
+    for i, p in enumerate(flat):
+        if p == prev:
+            run += 1
+            if run == 62 or i == len(flat) - 1:
+                out.append(0xc0 | (run - 1))
+                run = 0
+            continue
+        if run:
+            out.append(0xc0 | (run - 1))
+            run = 0
+        h = (p[0] * 3 + p[1] * 5 + p[2] * 7 + p[3] * 11) % 64
+        if index[h] == p:
+            out.append(h)
+        elif p[3] != prev[3]:
+            out += bytes([0xff, p[0], p[1], p[2], p[3]])
+        else:
+            dr, dg, db = [((p[c] - prev[c] + 128) & 0xff) - 128 for c in range(3)]
+            if -2 <= dr < 2 and -2 <= dg < 2 and -2 <= db < 2:
+                out.append(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2))
+            elif -32 <= dg < 32 and -8 <= dr - dg < 8 and -8 <= db - dg < 8:
+                out += bytes([0x80 | (dg + 32), (dr - dg + 8) << 4 | (db - dg + 8)])
+            else:
+                out += bytes([0xfe, p[0], p[1], p[2]])
+        index[h] = p
+        prev = p
+    out += b"\0" * 7 + b"\1"
+    with open(os.path.join(HERE, name + ".qoi"), "wb") as f:
+        f.write(out)
+    ppm(name, [[p[:3] for p in row] for row in pixels])
+
+
+def ppm(name, rgb):
+    with open(os.path.join(HERE, name + ".ppm"), "wb") as f:
+        f.write(b"P6\n%d %d\n255\n" % (W, H))
+        f.write(bytes(v for row in rgb for c in row for v in c))
+
+
+def main():
+    src = source()
+    grey16 = [[(p[0] * 2 + p[1] * 5 + p[2]) // 8 for p in row] for row in src]
+
+    for depth in (1, 2, 4, 8, 16):
+        mask = (1 << depth) - 1
+        samples = [[g >> (16 - depth) for g in row] for row in grey16]
+        expect = [[(v * 255 // mask if depth < 8 else v >> (depth - 8),) * 3 for v in row] for row in samples]
+        png("grey%d" % depth, 0, depth, samples, expect=expect)
+
+    for depth in (1, 2, 4, 8):
+        count = 1 << depth
+        palette = [((i * 97) & 0xff, (i * 53 + 40) & 0xff, (255 - i * 29) & 0xff) for i in range(count)]
+        samples = [[(p[0] >> 8 ^ p[1] >> 9) % count for p in row] for row in src]
+        png("palette%d" % depth, 3, depth, samples, palette=palette,
+            expect=[[palette[v] for v in row] for row in samples])
+
+    rgb8 = [[v >> 8 for p in row for v in p[:3]] for row in src]
+    expect8 = [[tuple(v >> 8 for v in p[:3]) for p in row] for row in src]
+    png("rgb8", 2, 8, rgb8, expect=expect8)
+    png("rgb16", 2, 16, [[v for p in row for v in p[:3]] for row in src], expect=expect8)
+    png("rgba8", 6, 8, [[v >> 8 for p in row for v in p] for row in src], expect=expect8)
+    png("rgba16", 6, 16, [[v for p in row for v in p] for row in src], expect=expect8)
+    png("grey_alpha8", 4, 8, [[v for g, p in zip(grow, row) for v in (g >> 8, p[3] >> 8)] for grow, row in zip(grey16, src)],
+        expect=[[(g >> 8,) * 3 for g in row] for row in grey16])
+
+    png("rgb8_stored", 2, 8, rgb8, compress="stored", expect=expect8)
+    png("rgb8_fixed", 2, 8, rgb8, compress="fixed", expect=expect8)
+    png("rgb8_split", 2, 8, rgb8, idat_split=61, expect=expect8)
+    png("rgb8_interlaced", 2, 8, rgb8, interlace=1)
+
+    qoi("rgba", [[tuple(v >> 8 for v in p) for p in row] for row in src])
+
+
+if __name__ == "__main__":
+    main()
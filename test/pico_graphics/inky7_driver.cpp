@@ -0,0 +1,52 @@
+// driver calls and bytes for dithered Inky7 drawing: a full screen clear is
+// a write_pixels call a row, with the same pixels as a driver that takes
+// them one write_pixel at a time
+#include "check.hpp"
+#include "surfaces.hpp"
+
+using namespace bench;
+
+static const uint16_t WIDTH = 800;
+static const uint16_t HEIGHT = 480;
+
+int main() {
+  CountingDriver bulk(WIDTH, HEIGHT), single(WIDTH, HEIGHT, false);
+  PicoGraphics_PenInky7 rows(WIDTH, HEIGHT, bulk), pixels(WIDTH, HEIGHT, single);
+
+  static const RGB colours[] = {{255, 128, 0}, {128, 128, 128}, {0, 128, 128}};
+  for(auto &c : colours) {
+    bulk.reset();
+    single.reset();
+    rows.set_pen(c.r, c.g, c.b);
+    pixels.set_pen(c.r, c.g, c.b);
+    rows.clear();
+    pixels.clear();
+
+    CHECK_EQ(bulk.calls, uint64_t(HEIGHT));
+    CHECK_EQ(bulk.bytes, uint64_t(WIDTH * HEIGHT));
+    CHECK_EQ(single.calls, uint64_t(WIDTH * HEIGHT));
+    CHECK(bulk.pixels == single.pixels);
+    printf("dithered clear %3d,%3d,%3d: %6llu calls with write_pixels, %6llu with write_pixel, %llu bytes\n", c.r, c.g, c.b,
+           (unsigned long long)bulk.calls, (unsigned long long)single.calls, (unsigned long long)bulk.bytes);
+  }
+
+  // clipped to the display, a call for each row left
+  bulk.reset();
+  single.reset();
+  rows.set_pen(200, 50, 50);
+  pixels.set_pen(200, 50, 50);
+  rows.rectangle(Rect(-30, HEIGHT - 20, 100, 50));
+  pixels.rectangle(Rect(-30, HEIGHT - 20, 100, 50));
+  CHECK_EQ(bulk.calls, 20u);
+  CHECK_EQ(bulk.bytes, 20u * 70u);
+  CHECK(bulk.pixels == single.pixels);
+
+  // a palette pen is a single write_pixel_span a row
+  bulk.reset();
+  rows.set_pen(3);
+  rows.clear();
+  CHECK_EQ(bulk.calls, uint64_t(HEIGHT));
+  CHECK_EQ(bulk.bytes, uint64_t(HEIGHT));
+
+  return check::result();
+}
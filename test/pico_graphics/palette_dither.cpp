@@ -0,0 +1,92 @@
+// PaletteDither shares its lookup tables between pens with the same palette,
+// check that palettes which only share a hash get tables of their own and
+// that pens on several threads can share tables safely
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+#include "pico_graphics.hpp"
+
+using namespace pimoroni;
+
+static const uint16_t WIDTH = 64;
+static const uint16_t HEIGHT = 32;
+
+// these differ only in their last two entries, and have the same FNV-1a
+// hash that the tables are looked up by
+static const RGB COMMON[14] = {
+  {  0,   0,   0}, {255, 255, 255}, {255,   0,   0}, {  0, 255,   0},
+  {  0,   0, 255}, {255, 255,   0}, {  0, 255, 255}, {255,   0, 255},
+  {128, 128, 128}, { 64,  64,  64}, {255, 128,   0}, {128,   0, 255},
+  {128,  64,   0}, {255, 128, 192}
+};
+static const RGB LAST_A[2] = {{125, 192, 78}, {83, 108, 8}};
+static const RGB LAST_B[2] = {{92, 42, 73}, {54, 21, 126}};
+static const RGB LAST_C[2] = {{10, 20, 30}, {40, 50, 60}};
+
+static void set_palette(PicoGraphics_PenP4 &g, const RGB *last) {
+  for(auto i = 0u; i < 16; i++) {
+    RGB c = i < 14 ? COMMON[i] : last[i - 14];
+    g.update_pen(i, c.r, c.g, c.b);
+  }
+}
+
+// dither a spread of colours over the whole frame
+static std::vector<uint8_t> draw(PicoGraphics_PenP4 &g) {
+  std::vector<RGB> row(WIDTH);
+  for(auto y = 0; y < HEIGHT; y++) {
+    for(auto x = 0; x < WIDTH; x++) {
+      row[x] = RGB(x * 4, y * 8, (x + y) * 2);
+    }
+    g.set_pixel_dither_span(Point(0, y), WIDTH, row.data());
+  }
+  uint8_t *fb = (uint8_t *)g.frame_buffer;
+  return std::vector<uint8_t>(fb, fb + PicoGraphics_PenP4::buffer_size(WIDTH, HEIGHT));
+}
+
+static std::vector<uint8_t> draw_alone(const RGB *last) {
+  PicoGraphics_PenP4 g(WIDTH, HEIGHT, nullptr);
+  set_palette(g, last);
+  return draw(g);
+}
+
+int main() {
+  // what each palette gives on its own, using a third palette in between so
+  // the idle table left behind by A can't be picked up by B
+  std::vector<uint8_t> a = draw_alone(LAST_A);
+  draw_alone(LAST_C);
+  std::vector<uint8_t> b = draw_alone(LAST_B);
+  CHECK(a != b);
+
+  // both alive at once, B must not be given A's table
+  {
+    PicoGraphics_PenP4 pa(WIDTH, HEIGHT, nullptr), pb(WIDTH, HEIGHT, nullptr);
+    set_palette(pa, LAST_A);
+    set_palette(pb, LAST_B);
+    CHECK(draw(pa) == a);
+    CHECK(draw(pb) == b);
+  }
+
+  // and the other way around, with A arriving while B's table is idle
+  CHECK(draw_alone(LAST_B) == b);
+  CHECK(draw_alone(LAST_A) == a);
+
+  // pens created, drawn with and destroyed on several threads at once, half
+  // of them sharing each table
+  std::atomic<int> mismatches{0};
+  std::vector<std::thread> threads;
+  for(auto t = 0; t < 4; t++) {
+    threads.emplace_back([&, t]() {
+      for(auto i = 0; i < 50; i++) {
+        const RGB *last = (t + i) & 1 ? LAST_A : LAST_B;
+        if(draw_alone(last) != (last == LAST_A ? a : b)) mismatches++;
+      }
+    });
+  }
+  for(auto &t : threads) t.join();
+  CHECK_EQ(mismatches.load(), 0);
+
+  return check::result();
+}
@@ -0,0 +1,155 @@
+// PicoScroll sending frames by dma on the mock i2c bus: update_async returns
+// without waiting, the frame that arrives is the one drawn when it was
+// called, it takes as long as its bytes do at 400kHz and a second update
+// waits only for the first. without a dma channel the same frame goes as
+// blocking writes, and a nak is recovered from by resending everything
+#include <cstring>
+
+#include "check.hpp"
+#include "is31fl3731.hpp"
+#include "pico_scroll.hpp"
+
+using namespace pimoroni;
+
+static const uint64_t BIT_NS = 2500;
+
+static void draw(PicoScroll &scroll, uint8_t seed) {
+  for(uint8_t y = 0; y < PicoScroll::HEIGHT; y++) {
+    for(uint8_t x = 0; x < PicoScroll::WIDTH; x++) {
+      scroll.set_pixel(x, y, uint8_t(x * 13 + y * 29 + seed));
+    }
+  }
+}
+
+static bool shows(const IS31FL3731 &device, uint8_t seed) {
+  for(uint8_t y = 0; y < PicoScroll::HEIGHT; y++) {
+    for(uint8_t x = 0; x < PicoScroll::WIDTH; x++) {
+      if(device.pixel(x, y) != uint8_t(x * 13 + y * 29 + seed)) return false;
+    }
+  }
+  return true;
+}
+
+// the bus time for a transfer: a start and address byte for each start or
+// repeated start, nine bits a byte and the stop
+static uint64_t bus_ns(const mock::Transfer &t) {
+  return (t.starts * 10 + (t.bytes() - t.starts) * 9 + 1) * BIT_NS;
+}
+
+static void dma_updates() {
+  mock::reset();
+  IS31FL3731 device;
+  mock::Bus &bus = mock::bus(i2c0);
+  bus.attach(IS31FL3731::ADDRESS, &device);
+
+  PicoScroll scroll;
+  scroll.init();
+  CHECK_EQ(bus.baudrate, 400000u);
+  CHECK_EQ(device.banks[IS31FL3731::FUNCTION_BANK][0x0a], 1);
+  CHECK(shows(device, 0) == false);
+  CHECK_EQ(bus.transfers.back().written.size(), 1u + 144u);
+
+  // returns before any of it is on the bus, and the framebuffer is free
+  draw(scroll, 1);
+  uint64_t start = mock::now_ns();
+  scroll.update_async();
+  CHECK_EQ(mock::now_ns(), start);
+  CHECK(scroll.update_in_progress());
+  draw(scroll, 2);
+  scroll.wait_for_update();
+  CHECK(!scroll.update_in_progress());
+  CHECK(shows(device, 1));
+
+  const mock::Transfer &t = bus.transfers.back();
+  CHECK(t.dma && !t.nak);
+  CHECK_EQ(t.start_ns, start);
+  CHECK_EQ(t.end_ns - t.start_ns, bus_ns(t));
+  // waiting notices the end of the frame within a spin of it
+  CHECK(mock::now_ns() - t.end_ns <= mock::spin_ns);
+
+  // the second update waits for the first to finish, and no longer
+  size_t before = bus.transfers.size();
+  scroll.update_async();
+  CHECK_EQ(bus.transfers.size(), before + 1);
+  CHECK_EQ(bus.transfers[before].end_ns, 0u);
+  draw(scroll, 3);
+  scroll.update_async();
+  uint64_t first_end = bus.transfers[before].end_ns;
+  CHECK(first_end > 0);
+  CHECK(mock::now_ns() >= first_end && mock::now_ns() - first_end <= mock::spin_ns);
+  CHECK(shows(device, 2));
+  scroll.wait_for_update();
+  CHECK(shows(device, 3));
+
+  // nothing changed, nothing sent
+  before = bus.transfers.size();
+  scroll.update();
+  CHECK_EQ(bus.transfers.size(), before);
+
+  // blocking writes only ever go between frames
+  scroll.set_page_flip(true);
+  draw(scroll, 4);
+  scroll.update();
+  CHECK(shows(device, 4));
+  CHECK_EQ(bus.collisions, 0u);
+}
+
+static void blocking_updates() {
+  mock::reset();
+  mock::set_dma_channels(0);
+  IS31FL3731 device;
+  mock::Bus &bus = mock::bus(i2c0);
+  bus.attach(IS31FL3731::ADDRESS, &device);
+
+  PicoScroll scroll;
+  scroll.init();
+
+  // a write for each run of changed leds, each its own transfer
+  draw(scroll, 5);
+  scroll.update();
+  CHECK(shows(device, 5));
+  scroll.set_pixel(0, 0, 0);
+  scroll.set_pixel(16, 6, 0);
+  size_t before = bus.transfers.size();
+  scroll.update();
+  CHECK_EQ(bus.transfers.size(), before + 2);
+  for(size_t i = before; i < bus.transfers.size(); i++) {
+    CHECK(!bus.transfers[i].dma);
+    CHECK_EQ(bus.transfers[i].written.size(), 2u);
+  }
+  CHECK_EQ(device.pixel(0, 0), 0);
+  CHECK_EQ(device.pixel(16, 6), 0);
+}
+
+static void nak() {
+  mock::reset();
+  IS31FL3731 device;
+  mock::Bus &bus = mock::bus(i2c0);
+  bus.attach(IS31FL3731::ADDRESS, &device);
+
+  PicoScroll scroll;
+  scroll.init();
+  draw(scroll, 6);
+  scroll.update();
+
+  // the panel goes away mid-frame, the update still finishes
+  bus.detach(IS31FL3731::ADDRESS);
+  draw(scroll, 7);
+  scroll.update();
+  CHECK(bus.transfers.back().nak);
+  CHECK(shows(device, 6));
+
+  // and the next one resends every led, as the panel may have taken some
+  bus.attach(IS31FL3731::ADDRESS, &device);
+  scroll.update();
+  CHECK(!bus.transfers.back().nak);
+  CHECK_EQ(bus.transfers.back().written.size(), 1u + 144u);
+  CHECK(shows(device, 7));
+}
+
+int main() {
+  dma_updates();
+  blocking_updates();
+  nak();
+  return check::result();
+}
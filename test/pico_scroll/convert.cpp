@@ -0,0 +1,80 @@
+// PicoScroll::update(PicoGraphics *) with layered surfaces: the panel shows
+// the composited frame, the same as a single layer surface with the same
+// picture drawn on it but for rounding through RGB565
+#include <cstdlib>
+
+#include "check.hpp"
+#include "is31fl3731.hpp"
+#include "pico_scroll.hpp"
+#include "surfaces.hpp"
+
+using namespace pimoroni;
+using namespace bench;
+
+static void background(PicoGraphics *g) {
+  g->set_pen(80, 80, 80);
+  g->rectangle(Rect(0, 0, PicoScroll::WIDTH, PicoScroll::HEIGHT));
+  g->set_pen(255, 0, 0);
+  g->rectangle(Rect(2, 1, 5, 3));
+}
+
+static void foreground(PicoGraphics *g) {
+  g->set_pen(255, 255, 255);
+  g->rectangle(Rect(5, 2, 6, 2));
+  g->pixel(Point(16, 6));
+}
+
+static std::vector<uint8_t> shown(PicoScroll &scroll, IS31FL3731 &device, PicoGraphics *g) {
+  scroll.update(g);
+  std::vector<uint8_t> leds;
+  for(uint8_t y = 0; y < PicoScroll::HEIGHT; y++) {
+    for(uint8_t x = 0; x < PicoScroll::WIDTH; x++) {
+      leds.push_back(device.pixel(x, y));
+    }
+  }
+  return leds;
+}
+
+static bool close(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b) {
+  for(size_t i = 0; i < a.size(); i++) {
+    if(abs(a[i] - b[i]) > 2) return false;
+  }
+  return true;
+}
+
+int main() {
+  mock::reset();
+  IS31FL3731 device;
+  mock::bus(i2c0).attach(IS31FL3731::ADDRESS, &device);
+  PicoScroll scroll;
+  scroll.init();
+
+  for(const char *pen : {"P4", "P8", "RGB332", "RGB565", "RGB888"}) {
+    // both parts of the picture drawn on one layer
+    Surface flat = make_surface(pen, PicoScroll::WIDTH, PicoScroll::HEIGHT);
+    background(flat.graphics.get());
+    foreground(flat.graphics.get());
+    std::vector<uint8_t> expected = shown(scroll, device, flat.graphics.get());
+
+    // and on two, left drawing to the top one
+    Surface layered = make_surface(pen, PicoScroll::WIDTH, PicoScroll::HEIGHT, 2);
+    background(layered.graphics.get());
+    layered->set_layer(1);
+    foreground(layered.graphics.get());
+    if(!close(shown(scroll, device, layered.graphics.get()), expected)) {
+      fprintf(stderr, "%s: two layers don't show the same as one\n", pen);
+      check::failures++;
+    }
+
+    // hiding the top layer leaves the background
+    Surface below = make_surface(pen, PicoScroll::WIDTH, PicoScroll::HEIGHT);
+    background(below.graphics.get());
+    layered->set_layer_visible(1, false);
+    if(!close(shown(scroll, device, layered.graphics.get()), shown(scroll, device, below.graphics.get()))) {
+      fprintf(stderr, "%s: a hidden layer is still shown\n", pen);
+      check::failures++;
+    }
+  }
+
+  return check::result();
+}
@@ -0,0 +1,155 @@
+// bytes on the i2c bus for PicoScroll updates, which send only the leds
+// that changed since the last frame. counts are bus bytes: the address
+// byte of each start or repeated start, the register and the data. a full
+// frame is 146 of them
+#include <cstring>
+
+#include "check.hpp"
+#include "is31fl3731.hpp"
+#include "pico_scroll.hpp"
+#include "pico_scroll_font.hpp"
+
+using namespace pimoroni;
+
+static const size_t FULL_FRAME = 1 + 1 + 144;
+
+struct Rig {
+  IS31FL3731 device;
+  mock::Bus &bus;
+  PicoScroll scroll;
+
+  Rig() : bus(mock::bus(i2c0)) {
+    bus.attach(IS31FL3731::ADDRESS, &device);
+    scroll.init();
+  }
+
+  // the bus bytes and starts for an update
+  size_t update(uint32_t *starts = nullptr) {
+    size_t before = bus.transfers.size();
+    scroll.update();
+    size_t bytes = 0;
+    if(starts) *starts = 0;
+    for(size_t i = before; i < bus.transfers.size(); i++) {
+      bytes += bus.transfers[i].bytes();
+      if(starts) *starts += bus.transfers[i].starts;
+    }
+    return bytes;
+  }
+};
+
+// the x, y of the led at a framebuffer offset
+static bool at(uint8_t offset, uint8_t &x, uint8_t &y) {
+  for(y = 0; y < PicoScroll::HEIGHT; y++) {
+    for(x = 0; x < PicoScroll::WIDTH; x++) {
+      if(IS31FL3731::led(x, y) == offset) return true;
+    }
+  }
+  return false;
+}
+
+static void single_pixels() {
+  mock::reset();
+  Rig rig;
+  uint32_t starts;
+
+  // the first frame after init is sent whole
+  CHECK_EQ(rig.bus.transfers.back().bytes(), FULL_FRAME);
+
+  // one led is the address, the register and its value
+  rig.scroll.set_pixel(3, 2, 100);
+  CHECK_EQ(rig.update(&starts), 3u);
+  CHECK_EQ(starts, 1u);
+  CHECK_EQ(rig.device.pixel(3, 2), 100);
+
+  // setting it again to the same value sends nothing
+  rig.scroll.set_pixel(3, 2, 100);
+  CHECK_EQ(rig.update(), 0u);
+
+  // two leds far apart are two writes chained with a repeated start
+  rig.scroll.set_pixel(0, 0, 10);
+  rig.scroll.set_pixel(16, 6, 20);
+  CHECK_EQ(rig.update(&starts), 6u);
+  CHECK_EQ(starts, 2u);
+  CHECK_EQ(rig.device.pixel(0, 0), 10);
+  CHECK_EQ(rig.device.pixel(16, 6), 20);
+
+  // leds with a clean gap of up to two are one write over the gap, three
+  // apart they are split
+  uint8_t x0, y0, x1, y1;
+  CHECK(at(40, x0, y0) && at(43, x1, y1));
+  rig.scroll.set_pixel(x0, y0, 1);
+  rig.scroll.set_pixel(x1, y1, 1);
+  CHECK_EQ(rig.update(&starts), 1u + 1u + 4u);
+  CHECK_EQ(starts, 1u);
+  CHECK(at(60, x0, y0) && at(64, x1, y1));
+  rig.scroll.set_pixel(x0, y0, 1);
+  rig.scroll.set_pixel(x1, y1, 1);
+  CHECK_EQ(rig.update(&starts), 6u);
+  CHECK_EQ(starts, 2u);
+
+  // page flipping writes the led to the hidden bank, which is a frame
+  // behind, then selects the function bank and shows the frame
+  rig.scroll.set_page_flip(true);
+  rig.update();
+  rig.scroll.set_pixel(8, 3, 50);
+  rig.update();
+  rig.scroll.set_pixel(8, 3, 60);
+  CHECK_EQ(rig.update(&starts), 3u + 3u + 3u + 3u);
+  CHECK_EQ(starts, 4u);
+  CHECK_EQ(rig.device.pixel(8, 3), 60);
+  CHECK_EQ(rig.bus.collisions, 0u);
+}
+
+// text scrolling a column at a time as scroll_text draws it, each frame
+// checked against the text rendered whole
+static void scrolling_text(bool page_flip) {
+  static const char text[] = "Hello, PicoScroll!";
+  static const int BRIGHTNESS = 64;
+  size_t len = strlen(text);
+  int columns = 6 * len;
+  unsigned char rendered[6 * sizeof(text)];
+  render_text(text, len, rendered, columns);
+
+  mock::reset();
+  Rig rig;
+  rig.scroll.set_page_flip(page_flip);
+
+  size_t bytes = 0;
+  uint32_t frames = 0;
+  for(int offset = -PicoScroll::WIDTH; offset <= columns; offset++) {
+    rig.scroll.clear();
+    rig.scroll.set_bitmap_1d((const char *)rendered, columns, BRIGHTNESS, offset);
+    bytes += rig.update();
+    frames++;
+
+    for(int x = 0; x < PicoScroll::WIDTH; x++) {
+      int k = offset + x;
+      uint8_t column = k >= 0 && k < columns ? rendered[k] : 0;
+      for(int y = 0; y < PicoScroll::HEIGHT; y++) {
+        uint8_t expected = (column >> y) & 1 ? BRIGHTNESS : 0;
+        if(rig.device.pixel(x, y) != expected) {
+          fprintf(stderr, "offset %d: led %d, %d is %d not %d\n", offset, x, y, rig.device.pixel(x, y), expected);
+          check::failures++;
+          return;
+        }
+      }
+    }
+  }
+
+  double per_frame = double(bytes) / frames;
+  printf("scrolling text%-13s %6.1f bytes/frame, %5.1f%% of a full frame\n",
+         page_flip ? " (page flip)" : "", per_frame, per_frame * 100 / FULL_FRAME);
+
+  // the text lights fewer than a third of the leds, so most of the frame
+  // stays clean from one column to the next. a hidden bank is two columns
+  // behind, so more of it changes
+  CHECK(per_frame < (page_flip ? FULL_FRAME * 2 / 3 : FULL_FRAME / 2));
+  CHECK_EQ(rig.bus.collisions, 0u);
+}
+
+int main() {
+  single_pixels();
+  scrolling_text(false);
+  scrolling_text(true);
+  return check::result();
+}
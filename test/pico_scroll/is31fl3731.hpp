@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstring>
+
+#include "pico_sdk_mock.hpp"
+
+// the IS31FL3731 on the PicoScroll as it sits on the mock i2c bus: eight
+// frame banks and the function bank, chosen by writing the command
+// register. shown() is the brightness of each led as displayed
+class IS31FL3731 : public mock::RegisterDevice {
+  public:
+    static const uint8_t ADDRESS = 0x74;
+    static const uint8_t COMMAND = 0xfd;
+    static const uint8_t FUNCTION_BANK = 0x0b;
+    static const uint8_t FRAME = 0x01;
+    static const uint8_t COLOR_OFFSET = 0x24;
+    static const uint LEDS = 144;
+
+    uint8_t banks[12][256] = {};
+    uint8_t bank = 0;
+
+    bool start(bool read) override {
+      first = !read;
+      return true;
+    }
+
+    void write(uint8_t data) override {
+      if(first) {
+        pointer = data;
+        first = false;
+      } else if(pointer == COMMAND) {
+        bank = data;
+        pointer++;
+      } else {
+        if(bank < 12) banks[bank][pointer] = data;
+        pointer++;
+      }
+    }
+
+    uint8_t read() override {
+      return bank < 12 ? banks[bank][pointer++] : 0;
+    }
+
+    const uint8_t *shown() const {
+      return &banks[banks[FUNCTION_BANK][FRAME] & 0x07][COLOR_OFFSET];
+    }
+
+    // the led at x, y of the 17x7 display, as the PicoScroll is wired
+    static uint8_t led(uint8_t x, uint8_t y) {
+      uint8_t px = x, py = 6 - y;
+      if(px > 8) {
+        px = px - 8;
+        py = 6 - (py + 8);
+      } else {
+        px = 8 - px;
+      }
+      return px * 16 + py;
+    }
+
+    uint8_t pixel(uint8_t x, uint8_t y) const {
+      return shown()[led(x, y)];
+    }
+
+  private:
+    bool first = false;
+};
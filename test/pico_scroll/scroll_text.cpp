@@ -0,0 +1,189 @@
+// PicoScrollText driven by the mock's simulated clock, ticked every few
+// milliseconds as a FreeRTOS timer would. the text must move a column every
+// column_ms, tick must never wait on the bus, and text appended while
+// scrolling follows on without a gap
+#include <cstring>
+#include <vector>
+
+#include "check.hpp"
+#include "is31fl3731.hpp"
+#include "pico_scroll.hpp"
+#include "pico_scroll_font.hpp"
+#include "pico/time.h"
+
+using namespace pimoroni;
+
+static const uint8_t BRIGHTNESS = 64;
+static const uint32_t COLUMN_MS = 100;
+
+static uint32_t now_ms() {
+  return time_us_64() / 1000;
+}
+
+// the columns a scroller shows for some text appended while the display is
+// empty: a display's width of blank, then the glyphs
+static std::vector<uint8_t> columns(const char *text) {
+  std::vector<uint8_t> c(PicoScroll::WIDTH, 0);
+  size_t len = strlen(text);
+  c.resize(PicoScroll::WIDTH + 6 * len);
+  render_text(text, len, &c[PicoScroll::WIDTH], 6 * len);
+  return c;
+}
+
+static bool shows(const IS31FL3731 &device, const std::vector<uint8_t> &c, uint32_t pos) {
+  for(uint8_t x = 0; x < PicoScroll::WIDTH; x++) {
+    uint8_t column = pos + x < c.size() ? c[pos + x] : 0;
+    for(uint8_t y = 0; y < PicoScroll::HEIGHT; y++) {
+      if(device.pixel(x, y) != ((column >> y) & 1 ? BRIGHTNESS : 0)) return false;
+    }
+  }
+  return true;
+}
+
+struct Rig {
+  IS31FL3731 device;
+  mock::Bus &bus;
+  PicoScroll scroll;
+
+  Rig() : bus(mock::bus(i2c0)) {
+    bus.attach(IS31FL3731::ADDRESS, &device);
+    scroll.init();
+  }
+};
+
+// a column every column_ms, each frame sent once, without tick waiting
+static void steady() {
+  mock::reset();
+  Rig rig;
+  PicoScrollText text(rig.scroll, BRIGHTNESS, COLUMN_MS);
+  text.smooth = false;
+
+  std::vector<uint8_t> c = columns("Hi there");
+  CHECK(text.append("Hi there"));
+  CHECK(!text.idle());
+
+  uint32_t start = now_ms();
+  uint32_t frames = 0, ticks = 0;
+  while(!text.idle() && now_ms() - start < 10000) {
+    uint64_t before = mock::now_ns();
+    uint32_t now = now_ms();
+    bool sent = text.tick(now);
+    CHECK_EQ(mock::now_ns(), before);
+    ticks++;
+
+    if(sent) {
+      frames++;
+      rig.scroll.wait_for_update();
+      uint32_t pos = (now - start) / COLUMN_MS;
+      if(!shows(rig.device, c, pos)) {
+        fprintf(stderr, "at %ums the display isn't showing column %u\n", now - start, pos);
+        check::failures++;
+        break;
+      }
+    }
+    sleep_ms(5);
+  }
+
+  // the last column leaves as the time for all of them runs out
+  uint32_t elapsed = now_ms() - start;
+  CHECK(elapsed >= c.size() * COLUMN_MS && elapsed < c.size() * COLUMN_MS + 10);
+  // a frame for each column moved, however often it was ticked
+  CHECK_EQ(frames, uint32_t(c.size() + 1));
+  CHECK(ticks > frames * 10);
+  CHECK_EQ(rig.bus.collisions, 0u);
+}
+
+// text appended part way through carries on straight after what was there
+static void append_while_scrolling() {
+  mock::reset();
+  Rig rig;
+  PicoScrollText text(rig.scroll, BRIGHTNESS, COLUMN_MS);
+  text.smooth = false;
+
+  std::vector<uint8_t> c = columns("ab");
+  std::vector<uint8_t> more = columns("cd");
+  c.insert(c.end(), more.begin() + PicoScroll::WIDTH, more.end());
+
+  CHECK(text.append("ab"));
+  uint32_t start = now_ms();
+  bool appended = false;
+  while(!text.idle() && now_ms() - start < 10000) {
+    uint32_t now = now_ms();
+    if(!appended && now - start >= 1000) {
+      CHECK(text.append("cd"));
+      appended = true;
+    }
+    if(text.tick(now)) {
+      rig.scroll.wait_for_update();
+      if(!shows(rig.device, c, (now - start) / COLUMN_MS)) {
+        fprintf(stderr, "at %ums after appending the display is wrong\n", now - start);
+        check::failures++;
+        break;
+      }
+    }
+    sleep_ms(5);
+  }
+  uint32_t elapsed = now_ms() - start;
+  CHECK(elapsed >= c.size() * COLUMN_MS && elapsed < c.size() * COLUMN_MS + 10);
+
+  // clear drops what hasn't been shown and blanks the display
+  CHECK(text.append("efgh"));
+  sleep_ms(500);
+  text.tick(now_ms());
+  rig.scroll.wait_for_update();
+  text.clear();
+  CHECK(text.idle());
+  sleep_ms(5);
+  text.tick(now_ms());
+  rig.scroll.wait_for_update();
+  CHECK(shows(rig.device, {}, 0));
+}
+
+// smooth scrolling blends neighbouring columns, and a tick that finds the
+// last frame still on the bus skips it rather than waiting
+static void smooth() {
+  mock::reset();
+  Rig rig;
+  // a column every 20ms, a frame for each 1/256th would be more than the
+  // bus can carry
+  PicoScrollText text(rig.scroll, BRIGHTNESS, 20);
+
+  CHECK(text.append("||||"));
+  uint32_t start = now_ms();
+  uint32_t frames = 0, skipped = 0;
+  bool blended = false;
+  while(!text.idle() && now_ms() - start < 10000) {
+    // look at what the panel shows when no frame is on the way
+    bool busy = rig.scroll.update_in_progress();
+    if(!busy) {
+      for(uint8_t x = 0; x < PicoScroll::WIDTH; x++) {
+        for(uint8_t y = 0; y < PicoScroll::HEIGHT; y++) {
+          uint8_t v = rig.device.pixel(x, y);
+          if(v != 0 && v != BRIGHTNESS) blended = true;
+        }
+      }
+    }
+
+    uint64_t before = mock::now_ns();
+    bool sent = text.tick(now_ms());
+    CHECK_EQ(mock::now_ns(), before);
+    if(busy) {
+      CHECK(!sent);
+      skipped++;
+    }
+    if(sent) frames++;
+    sleep_ms(1);
+  }
+
+  CHECK(blended);
+  CHECK(skipped > 0);
+  CHECK(frames > 0);
+  CHECK_EQ(rig.bus.collisions, 0u);
+}
+
+int main() {
+  steady();
+  append_while_scrolling();
+  smooth();
+  return check::result();
+}
@@ -0,0 +1,120 @@
+// I2CQueue on the mock i2c bus: transactions go by dma with the interrupt
+// starting each after the last, devices take turns, a nak fails only its
+// own transaction, and while the queue is idle the i2c interrupt is masked
+// so blocking calls on the same bus are left alone
+#include <vector>
+
+#include "check.hpp"
+#include "pimoroni_i2c_queue.hpp"
+#include "pico_sdk_mock.hpp"
+#include "hardware/irq.h"
+
+using namespace pimoroni;
+
+static const uint64_t BIT_NS = 1000000000 / I2C_DEFAULT_BAUDRATE;
+static const uint32_t CLAIMED = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+
+static std::vector<uint8_t> order;
+
+static void finished(I2CQueue::Transaction *t, void *context) {
+  order.push_back(t->address);
+}
+
+int main() {
+  mock::reset();
+  mock::RegisterDevice a, b;
+  mock::Bus &bus = mock::bus(i2c0);
+  bus.attach(0x20, &a);
+  bus.attach(0x21, &b);
+  for(uint i = 0; i < 256; i++) {
+    a.regs[i] = i;
+    b.regs[i] = 255 - i;
+  }
+
+  I2C i2c(4, 5);
+  CHECK(i2c.get_i2c() == i2c0);
+  I2CQueue queue(&i2c);
+  i2c_hw_t *hw = i2c_get_hw(i2c0);
+
+  // idle, a blocking call's stop isn't the queue's business
+  CHECK_EQ(hw->intr_mask, 0u);
+  i2c.reg_write_uint8(0x20, 0x80, 0x5a);
+  CHECK_EQ(i2c.reg_read_uint8(0x20, 0x80), 0x5a);
+  CHECK_EQ(mock::irq_count(I2C0_IRQ), 0u);
+
+  // a register read, a write then a read after a repeated start
+  uint8_t reg = 0x10;
+  uint8_t data[4] = {};
+  I2CQueue::Transaction t;
+  t.address = 0x20;
+  t.write = &reg;
+  t.write_len = 1;
+  t.read = data;
+  t.read_len = 4;
+  size_t before = bus.transfers.size();
+  CHECK(queue.submit(&t));
+  CHECK_EQ(hw->intr_mask, CLAIMED);
+  CHECK(queue.busy());
+  while(!t.done) tight_loop_contents();
+  CHECK_EQ(t.result, 5);
+  CHECK(data[0] == 0x10 && data[3] == 0x13);
+  CHECK(!queue.busy());
+  CHECK_EQ(hw->intr_mask, 0u);
+  CHECK_EQ(mock::irq_count(I2C0_IRQ), 1u);
+
+  CHECK_EQ(bus.transfers.size(), before + 1);
+  const mock::Transfer &r = bus.transfers.back();
+  CHECK(r.dma && !r.nak);
+  CHECK_EQ(r.starts, 2u);
+  CHECK_EQ(r.written.size(), 1u);
+  CHECK_EQ(r.read.size(), 4u);
+  CHECK_EQ(r.end_ns - r.start_ns, (2 * 10 + 5 * 9 + 1) * BIT_NS);
+
+  // submitted together, the first starts straight away and then the other
+  // device gets its turn before the first's second, which keeps its order
+  uint8_t w[3][2] = {{0x40, 1}, {0x41, 2}, {0x40, 3}};
+  I2CQueue::Transaction ts[3];
+  uint8_t addresses[3] = {0x20, 0x20, 0x21};
+  order.clear();
+  for(int i = 0; i < 3; i++) {
+    ts[i].address = addresses[i];
+    ts[i].write = w[i];
+    ts[i].write_len = 2;
+    ts[i].callback = finished;
+    CHECK(queue.submit(&ts[i]));
+  }
+  while(queue.busy()) tight_loop_contents();
+  CHECK(ts[0].done && ts[1].done && ts[2].done);
+  CHECK(order == std::vector<uint8_t>({0x20, 0x21, 0x20}));
+  CHECK_EQ(a.regs[0x40], 1);
+  CHECK_EQ(a.regs[0x41], 2);
+  CHECK_EQ(b.regs[0x40], 3);
+
+  // a nak fails its own transaction and the next goes ahead
+  I2CQueue::Transaction missing, after;
+  missing.address = 0x30;
+  missing.write = w[0];
+  missing.write_len = 2;
+  after.address = 0x21;
+  after.write = w[1];
+  after.write_len = 2;
+  CHECK(queue.submit(&missing));
+  CHECK_EQ(queue.transfer(&after), 2);
+  CHECK_EQ(missing.result, PICO_ERROR_GENERIC);
+  CHECK(missing.done);
+  CHECK_EQ(b.regs[0x41], 2);
+  CHECK_EQ(hw->intr_mask, 0u);
+
+  // and blocking calls are fine again once it's idle
+  uint32_t irqs = mock::irq_count(I2C0_IRQ);
+  CHECK_EQ(i2c.reg_read_uint8(0x21, 0x41), 2);
+  CHECK_EQ(i2c.write_blocking(0x30, w[0], 2, false), PICO_ERROR_GENERIC);
+  CHECK_EQ(mock::irq_count(I2C0_IRQ), irqs);
+  CHECK_EQ(bus.collisions, 0u);
+
+  // empty and oversized transactions are turned away
+  I2CQueue::Transaction empty;
+  CHECK(!queue.submit(&empty));
+
+  return check::result();
+}
@@ -0,0 +1,138 @@
+// I2C::read_registers and write_registers on the mock bus, against reading
+// and writing the same registers one at a time: the same values, in fewer
+// transactions and bus bytes. blocks longer than the merge limit and more
+// ops than are sorted at once still work, without variable length arrays
+#include <cstring>
+#include <vector>
+
+#include "check.hpp"
+#include "pimoroni_i2c.hpp"
+#include "pico_sdk_mock.hpp"
+
+using namespace pimoroni;
+
+struct Count {
+  size_t transfers;
+  size_t bytes;
+};
+
+static Count since(const mock::Bus &bus, size_t before) {
+  Count c = {bus.transfers.size() - before, 0};
+  for(size_t i = before; i < bus.transfers.size(); i++) c.bytes += bus.transfers[i].bytes();
+  return c;
+}
+
+static void fill(mock::RegisterDevice &d, uint8_t seed) {
+  for(uint i = 0; i < 256; i++) d.regs[i] = uint8_t(i * 7 + seed);
+}
+
+int main() {
+  mock::reset();
+  mock::RegisterDevice a, b;
+  mock::Bus &bus = mock::bus(i2c0);
+  bus.attach(0x20, &a);
+  bus.attach(0x21, &b);
+  fill(a, 1);
+  fill(b, 2);
+  I2C i2c(4, 5);
+
+  // a sensor driver's reads: status, a block of samples split in three,
+  // overlapping calibration blocks and another device in between
+  struct { uint8_t address, reg, len; } blocks[] = {
+    {0x20, 0x00, 1}, {0x20, 0x10, 6}, {0x21, 0x30, 2}, {0x20, 0x16, 6},
+    {0x20, 0x1c, 4}, {0x21, 0x32, 1}, {0x20, 0x80, 8}, {0x20, 0x84, 8}
+  };
+  const size_t count = sizeof(blocks) / sizeof(blocks[0]);
+  uint8_t batched[count][8] = {}, single[count][8] = {};
+  RegisterOp ops[count];
+  size_t registers = 0;
+  for(size_t i = 0; i < count; i++) {
+    ops[i] = {blocks[i].address, blocks[i].reg, batched[i], blocks[i].len};
+    registers += blocks[i].len;
+  }
+
+  size_t before = bus.transfers.size();
+  CHECK_EQ(i2c.read_registers(ops, count), 1 + 6 + 6 + 4 + 12 + 3);
+  Count batch = since(bus, before);
+
+  before = bus.transfers.size();
+  for(size_t i = 0; i < count; i++) {
+    for(uint8_t r = 0; r < blocks[i].len; r++) {
+      single[i][r] = i2c.reg_read_uint8(blocks[i].address, blocks[i].reg + r);
+    }
+  }
+  Count each = since(bus, before);
+  CHECK(memcmp(batched, single, sizeof(batched)) == 0);
+
+  // one transaction per device, against a write and a read per register
+  CHECK_EQ(batch.transfers, 2u);
+  CHECK_EQ(each.transfers, 2 * registers);
+  CHECK(batch.bytes * 3 < each.bytes);
+  printf("read  %2zu blocks: %3zu transactions %4zu bytes batched, %3zu transactions %4zu bytes a register at a time\n",
+         count, batch.transfers, batch.bytes, each.transfers, each.bytes);
+
+  // writes, in order, merging the blocks that follow on
+  uint8_t values[count][8];
+  for(size_t i = 0; i < count; i++) {
+    for(uint8_t r = 0; r < 8; r++) values[i][r] = uint8_t(0xa0 + i * 8 + r);
+    ops[i].buffer = values[i];
+  }
+  // the overlapping blocks would write twice, leave the second out
+  before = bus.transfers.size();
+  CHECK_EQ(i2c.write_registers(ops, count - 1), int(registers - 8));
+  batch = since(bus, before);
+  for(size_t i = 0; i < count - 1; i++) {
+    mock::RegisterDevice &d = blocks[i].address == 0x20 ? a : b;
+    CHECK(memcmp(&d.regs[blocks[i].reg], values[i], blocks[i].len) == 0);
+  }
+
+  before = bus.transfers.size();
+  for(size_t i = 0; i < count - 1; i++) {
+    for(uint8_t r = 0; r < blocks[i].len; r++) {
+      i2c.reg_write_uint8(blocks[i].address, blocks[i].reg + r, values[i][r]);
+    }
+  }
+  each = since(bus, before);
+  CHECK(batch.transfers < each.transfers);
+  CHECK(batch.bytes * 2 < each.bytes);
+  printf("write %2zu blocks: %3zu transactions %4zu bytes batched, %3zu transactions %4zu bytes a register at a time\n",
+         count - 1, batch.transfers, batch.bytes, each.transfers, each.bytes);
+
+  // a block longer than the merge limit is written in two parts, the
+  // registers wrapping as they would for a single write
+  std::vector<uint8_t> big(300);
+  for(size_t i = 0; i < big.size(); i++) big[i] = uint8_t(i * 3);
+  RegisterOp write_big = {0x21, 0x00, big.data(), big.size()};
+  before = bus.transfers.size();
+  CHECK_EQ(i2c.write_registers(&write_big, 1), 300);
+  for(size_t i = 0; i < 256; i++) {
+    CHECK_EQ(b.regs[i], big[i < 300 - 256 ? i + 256 : i]);
+  }
+  Count chunks = since(bus, before);
+  CHECK_EQ(chunks.transfers, 1u);
+  CHECK_EQ(chunks.bytes, 2 + 2 + 300u);
+
+  fill(a, 3);
+  CHECK_EQ(i2c.write_bytes(0x20, 0x10, big.data(), 300), 301);
+  CHECK_EQ(a.regs[0x10], big[256]);
+  CHECK_EQ(a.regs[0x0f], big[255]);
+
+  // more ops than are sorted at once, each register read on its own
+  fill(a, 4);
+  std::vector<RegisterOp> many;
+  std::vector<uint8_t> got(100);
+  for(uint i = 0; i < 100; i++) {
+    many.push_back({0x20, uint8_t((i * 37) % 256), &got[i], 1});
+  }
+  CHECK_EQ(i2c.read_registers(many.data(), many.size()), 100);
+  for(uint i = 0; i < 100; i++) {
+    CHECK_EQ(got[i], a.regs[(i * 37) % 256]);
+  }
+
+  // a missing device fails the batch
+  RegisterOp gone = {0x30, 0x00, got.data(), 4};
+  CHECK_EQ(i2c.read_registers(&gone, 1), PICO_ERROR_GENERIC);
+  CHECK_EQ(i2c.write_registers(&gone, 1), PICO_ERROR_GENERIC);
+
+  return check::result();
+}